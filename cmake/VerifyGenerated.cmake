@@ -40,7 +40,7 @@ if(NOT generator_result EQUAL 0)
     )
 endif()
 
-foreach(index RANGE 1 2)
+foreach(index RANGE 1 3)
     if(DEFINED GENERATED_FILE_${index} OR DEFINED EXPECTED_FILE_${index})
         if(NOT DEFINED GENERATED_FILE_${index} OR NOT DEFINED EXPECTED_FILE_${index})
             message(FATAL_ERROR "generated/expected file ${index} must be specified together")
@@ -10,6 +10,7 @@
 #include <cstring>
 #include <string>
 #include <utility>
+#include <algorithm>
 #include <atomic>
 #include <memory>
 #include <bitset>
@@ -40,6 +41,60 @@ struct Unwrapper { using Type = T; };
 template <typename T>
 struct Unwrapper<std::unique_ptr<T>> { using Type = T; };
 
+template <typename T> class ArrayEX;
+template <typename K, typename V> class MapEX;
+
+// Messages are held by pointers, which hand out mutable objects even through
+// const references, so whether they are untouched is asked one by one.
+template <typename T>
+struct HoldsMessage : std::false_type {};
+
+template <typename T>
+struct HoldsMessage<std::unique_ptr<T>> : std::true_type {};
+
+template <typename T>
+struct HoldsMessage<ArrayEX<T>> : HoldsMessage<typename Adapter<T>::TypeEX> {};
+
+template <typename K, typename V>
+struct HoldsMessage<MapEX<K,V>> : HoldsMessage<typename Adapter<V>::TypeEX> {};
+
+// Original data of maps from another writer has its own index and pair
+// order, so deterministic mode encodes what may hold maps again, instead of
+// copying it.
+template <typename T>
+struct MayVary : HoldsMessage<T> {};
+
+template <typename T>
+struct MayVary<ArrayEX<T>> : MayVary<typename Adapter<T>::TypeEX> {};
+
+template <typename K, typename V>
+struct MayVary<MapEX<K,V>> : std::true_type {};
+
+template <typename T>
+static inline bool CanCopy(const Buffer& buf) noexcept {
+	return !MayVary<T>::value || !buf.Deterministic();
+}
+
+template <typename T>
+static inline bool IsClean(const T&) noexcept {
+	return true;
+}
+
+template <typename T>
+static inline bool IsClean(const std::unique_ptr<T>& obj) noexcept {
+	return obj != nullptr && obj->CleanHead() != nullptr;
+}
+
+template <typename T>
+static inline bool IsClean(const ArrayEX<T>& obj) noexcept {
+	return obj.CleanHead() != nullptr;
+}
+
+template <typename K, typename V>
+static inline bool IsClean(const MapEX<K,V>& obj) noexcept {
+	return obj.CleanHead() != nullptr;
+}
+
 template <typename T>
 class BaseArrayEX {
 protected:
@@ -47,37 +102,57 @@ protected:
 	using Iterator = typename std::vector<TypeEX>::iterator;
 	using ConstIterator = typename std::vector<TypeEX>::const_iterator;
 	std::vector<TypeEX> core_;
+	const uint32_t* origin_ = nullptr;	// extracted from, until handed out for mutation
+
+	std::vector<TypeEX>& Touch() noexcept {
+		origin_ = nullptr;
+		return core_;
+	}
 
 public:
 	static Slice<uint32_t> Detect(const uint32_t* ptr, const uint32_t* end=nullptr) noexcept {
 		return ArrayT<typename Unwrapper<T>::Type>::Detect(ptr, end);
 	}
+	// original data which can be copied as it is, or nullptr
+	const uint32_t* CleanHead() const noexcept {
+		if constexpr (HoldsMessage<TypeEX>::value) {
+			if (origin_ != nullptr) {
+				for (auto& one : core_) {
+					if (!IsClean(one)) {
+						return nullptr;
+					}
+				}
+			}
+		}
+		return origin_;
+	}
 
 	size_t size() const noexcept { return core_.size(); }
 	bool empty() const noexcept { return core_.empty(); }
-	void clear() noexcept { core_.clear(); }
+	void clear() noexcept { Touch().clear(); }
 	void reserve(size_t n) { core_.reserve(n); }
-	void resize(size_t n) { core_.resize(n); }
-	Iterator begin() noexcept { return core_.begin(); }
+	void resize(size_t n) { Touch().resize(n); }
+	Iterator begin() noexcept { return Touch().begin(); }
 	ConstIterator begin() const noexcept { return core_.begin(); }
-	Iterator end() noexcept { return core_.end(); }
+	Iterator end() noexcept { return Touch().end(); }
 	ConstIterator end() const noexcept { return core_.end(); }
-	TypeEX& operator[](size_t pos) noexcept { return core_[pos]; }
+	TypeEX& operator[](size_t pos) noexcept { return Touch()[pos]; }
 	const TypeEX& operator[](size_t pos) const noexcept { return core_[pos]; }
-	TypeEX& front() noexcept { return core_.front(); }
+	TypeEX& front() noexcept { return Touch().front(); }
 	const TypeEX& front() const noexcept { return core_.front(); }
-	TypeEX& back() noexcept { return core_.back(); }
+	TypeEX& back() noexcept { return Touch().back(); }
 	const TypeEX& back() const noexcept { return core_.back(); }
-	void pop_back() noexcept { core_.pop_back(); }
+	void pop_back() noexcept { Touch().pop_back(); }
 
 	template< class... Args >
 	void emplace_back(Args&&... args) {
-		core_.emplace_back(std::forward<Args>(args)...);
+		Touch().emplace_back(std::forward<Args>(args)...);
 	}
 };
 
-template <typename T> class ArrayEX;
-template <typename K, typename V> class MapEX;
+// elements worth serializing in parallel
+template <typename T>
+struct IsHeavy : std::bool_constant<!std::is_scalar_v<T> && !std::is_same_v<T, std::string>> {};
 
 template <typename T>
 static inline bool Serialize(const T& obj, const uint32_t*, Buffer& buf, Unit& unit) {
@@ -102,6 +177,29 @@ static inline bool Serialize(const std::unique_ptr<T>& obj, const uint32_t* end,
 	return obj->Serialize(buf, unit, end);
 }
 
+template <typename T>
+static inline bool Measure(const T& obj, const uint32_t*, Unit& unit) {
+	return Measure(obj, unit);
+}
+
+template <typename T>
+static inline bool Measure(const ArrayEX<T>& obj, const uint32_t* end, Unit& unit) {
+	return obj.Measure(unit, end);
+}
+
+template <typename K, typename V>
+static inline bool Measure(const MapEX<K,V>& obj, const uint32_t* end, Unit& unit) {
+	return obj.Measure(unit, end);
+}
+
+template <typename T>
+static inline bool Measure(const std::unique_ptr<T>& obj, const uint32_t* end, Unit& unit) {
+	if (obj == nullptr) {
+		return false;
+	}
+	return obj->Measure(unit, end);
+}
+
 template <typename T>
 class ArrayEX final : public BaseArrayEX<T> {
 private:
@@ -123,14 +221,32 @@ public:
 		for (size_t i = 0; i < this->core_.size(); i++) {
 			Extract(view[i].GetObject(end), end, this->core_[i]);
 		}
+		this->origin_ = data;
 	}
 	bool Serialize(Buffer* buf, const uint32_t* end=nullptr) const {
 		Unit dummy;
 		return Serialize(*buf, dummy, end);
 	}
+	// Untouched elements of message, array or map types copy their own
+	// original data, the rest are encoded again.
 	bool Serialize(Buffer& buf, Unit& unit, const uint32_t* end) const {
+		auto clean_head = CanCopy<ArrayEX<T>>(buf) ? this->CleanHead() : nullptr;
+		if (clean_head != nullptr) {
+			return Copy(this->Detect(clean_head, end), buf, unit);
+		}
 		std::vector<Unit> elements(this->size());
 		auto last = buf.Size();
+		if constexpr (IsHeavy<typename BaseArrayEX<T>::TypeEX>::value) {
+			if (UseParallel(buf, this->size())) {
+				if (!SerializeParallel(buf, elements.data(), this->size(), 1,
+						[this, end](unsigned, size_t i, Buffer& part, Unit* out)->bool {
+							return ::protocache::Serialize(this->core_[i], end, part, *out);
+						})) {
+					return false;
+				}
+				return SerializeArray(elements, buf, last, unit);
+			}
+		}
 		for (size_t i = this->size(); i-- > 0;) {
 			if (!::protocache::Serialize(this->core_[i], end, buf, elements[i])) {
 				return false;
@@ -138,6 +254,21 @@ public:
 		}
 		return SerializeArray(elements, buf, last, unit);
 	}
+	bool Measure(Unit& unit, const uint32_t* end) const {
+		auto clean_head = this->CleanHead();
+		if (clean_head != nullptr) {
+			return MeasureCopy(this->Detect(clean_head, end), unit);
+		}
+		ArraySize elements;
+		for (auto& one : this->core_) {
+			Unit part;
+			if (!::protocache::Measure(one, end, part)) {
+				return false;
+			}
+			elements.Add(part);
+		}
+		return MeasureArray(elements, unit);
+	}
 };
 
 template<typename T>
@@ -147,23 +278,26 @@ struct ScalarArrayEX : public BaseArrayEX<T> {
 		static_assert(std::is_scalar_v<T>);
 		auto view = Array(data, end).Numbers<T>();
 		this->core_.assign(view.begin(), view.end());
+		this->origin_ = data;
 	};
-	bool Serialize(Buffer& buf, Unit& unit, const uint32_t*) const {
-		static_assert(sizeof(T) == 4 || sizeof(T) == 8);
+	bool Serialize(Buffer& buf, Unit& unit, const uint32_t* end) const {
+		if (this->origin_ != nullptr) {
+			return Copy(this->Detect(this->origin_, end), buf, unit);
+		}
+		return ::protocache::SerializeArray(Slice<T>(this->core_.data(), this->size()), buf, unit);
+	}
+	bool Measure(Unit& unit, const uint32_t* end) const {
+		if (this->origin_ != nullptr) {
+			return MeasureCopy(this->Detect(this->origin_, end), unit);
+		}
 		constexpr unsigned m = sizeof(T) / 4;
 		if (this->size() == 0) {
 			unit.len = 1;
-			unit.data[0] = m;
 			return true;
 		} else if (m*this->size() >= (1U << 30U)) {
 			return false;
 		}
-		auto last = buf.Size();
-		for (size_t i = this->size(); i-- > 0;) {
-			*reinterpret_cast<T*>(buf.Expand(m)) = this->core_[i];
-		}
-		buf.Put((this->size() << 2U) | m);
-		unit = Segment(last, buf.Size());
+		unit = Segment(0, 1 + m*this->size());
 		return true;
 	}
 };
@@ -175,10 +309,20 @@ struct ArrayEX<bool> final : BaseArrayEX<bool> {
 		auto view = String(data, end).GetBoolArray();
 		this->core_.resize(view.size());
 		memcpy(this->core_.data(), view.data(), view.size());
+		this->origin_ = data;
 	}
-	bool Serialize(Buffer& buf, Unit& unit, const uint32_t*) const {
+	bool Serialize(Buffer& buf, Unit& unit, const uint32_t* end) const {
+		if (origin_ != nullptr) {
+			return Copy(Detect(origin_, end), buf, unit);
+		}
 		return ::protocache::Serialize(Slice<uint8_t>(core_), buf, unit);
 	}
+	bool Measure(Unit& unit, const uint32_t* end) const {
+		if (origin_ != nullptr) {
+			return MeasureCopy(Detect(origin_, end), unit);
+		}
+		return MeasureString(core_.size(), unit);
+	}
 };
 
 template <>
@@ -223,6 +367,7 @@ template <> inline ArrayEX<Slice<char>>::ArrayEX(const uint32_t* data, const uin
 	for (auto one : view) {
 		core_.emplace_back(one.data(), one.size());
 	}
+	origin_ = data;
 }
 
 template <> inline ArrayEX<Slice<uint8_t>>::ArrayEX(const uint32_t* data, const uint32_t* end) {
@@ -231,6 +376,7 @@ template <> inline ArrayEX<Slice<uint8_t>>::ArrayEX(const uint32_t* data, const
 	for (auto one : view) {
 		core_.emplace_back(one.data(), one.size());
 	}
+	origin_ = data;
 }
 
 template <typename Key, typename Val>
@@ -240,7 +386,22 @@ private:
 	using ValEX = typename Adapter<Val>::TypeEX;
 	using Iterator = typename std::unordered_map<KeyEX,ValEX>::iterator;
 	using ConstIterator = typename std::unordered_map<KeyEX,ValEX>::const_iterator;
+	using Entry = std::pair<const KeyEX,ValEX>;
 	std::unordered_map<KeyEX,ValEX> core_;
+	const uint32_t* origin_ = nullptr;	// extracted from
+	bool dirty_ = false;				// values handed out for mutation
+	std::vector<const Entry*> slots_;	// entries in original order, until key set changes
+
+	std::unordered_map<KeyEX,ValEX>& Touch() noexcept {
+		dirty_ = true;
+		return core_;
+	}
+	std::unordered_map<KeyEX,ValEX>& Reshape() noexcept {
+		dirty_ = true;
+		slots_.clear();
+		slots_.shrink_to_fit();
+		return core_;
+	}
 
 	template <typename T>
 	struct IsUniquePtr : std::false_type {};
@@ -291,17 +452,85 @@ private:
 			size_t idx_ = 0;
 		};
 
+	// book holds entries in slot order of index
+	bool SerializeBook(const Slice<uint8_t>& index, const std::vector<const Entry*>& book,
+					   Buffer& buf, Unit& unit, const uint32_t* end) const {
+		std::vector<std::pair<Unit,Unit>> units(book.size());
+		auto last = buf.Size();
+		if constexpr (IsHeavy<ValEX>::value) {
+			if (UseParallel(buf, book.size())) {
+				std::vector<Unit> flat(book.size()*2);
+				if (!SerializeParallel(buf, flat.data(), book.size(), 2,
+						[&book, end](unsigned, size_t i, Buffer& part, Unit* out)->bool {
+							auto& pair = *book[i];
+							return ::protocache::Serialize(pair.second, end, part, out[1])
+								&& ::protocache::Serialize(pair.first, part, out[0]);
+						})) {
+					return false;
+				}
+				for (size_t i = 0; i < units.size(); i++) {
+					units[i] = {flat[i*2], flat[i*2+1]};
+				}
+				return ::protocache::SerializeMap(index, units, buf, last, unit);
+			}
+		}
+		for (size_t i = book.size(); i-- > 0;) {
+			auto& pair = *book[i];
+			if (!::protocache::Serialize(pair.second, end, buf, units[i].second)
+				|| !::protocache::Serialize(pair.first, buf, units[i].first)) {
+				return false;
+			}
+		}
+		return ::protocache::SerializeMap(index, units, buf, last, unit);
+	}
+
 public:
 	MapEX() = default;
-	MapEX(const uint32_t* data, const uint32_t* end) {
+	MapEX(const uint32_t* data, const uint32_t* end) : origin_(data) {
 		auto view = Map(data, end);
 		core_.reserve(view.Size());
+		slots_.reserve(view.Size());
 		for (auto pair : view) {
 			auto key = Extract<Key>(pair.Key(), end);
 			auto val = Extract<Val>(pair.Value(), end);
-			core_.emplace(std::move(key), std::move(val));
+			auto ret = core_.emplace(std::move(key), std::move(val));
+			if (ret.second) {
+				slots_.push_back(&*ret.first);
+			}
+		}
+		if (slots_.size() != view.Size()) {
+			Reshape();
 		}
 	}
+	// slots point into core_, so they are dropped by copy, but kept by move
+	MapEX(const MapEX& other) : core_(other.core_), origin_(other.origin_), dirty_(true) {}
+	MapEX(MapEX&& other) noexcept = default;
+	MapEX& operator=(const MapEX& other) {
+		if (&other != this) {
+			core_ = other.core_;
+			origin_ = other.origin_;
+			Reshape();
+		}
+		return *this;
+	}
+	MapEX& operator=(MapEX&& other) noexcept = default;
+
+	// original data which can be copied as it is, or nullptr
+	const uint32_t* CleanHead() const noexcept {
+		if (dirty_) {
+			return nullptr;
+		}
+		if constexpr (HoldsMessage<ValEX>::value) {
+			if (origin_ != nullptr) {
+				for (auto& pair : core_) {
+					if (!IsClean(pair.second)) {
+						return nullptr;
+					}
+				}
+			}
+		}
+		return origin_;
+	}
 	static Slice<uint32_t> Detect(const uint32_t* ptr, const uint32_t* end=nullptr) noexcept {
 		return MapT<Key,typename Unwrapper<Val>::Type>::Detect(ptr, end);
 	}
@@ -309,92 +538,137 @@ public:
 		Unit dummy;
 		return Serialize(*buf, dummy, end);
 	}
+	// With an unchanged key set, the original index and slot order are reused,
+	// and untouched values of message, array or map types copy their own data.
+	// Deterministic mode builds the index again from sorted keys.
 	bool Serialize(Buffer& buf, Unit& unit, const uint32_t* end) const {
-		std::vector<const std::pair<const KeyEX,ValEX>*> memo;
+		auto clean_head = CanCopy<MapEX>(buf) ? CleanHead() : nullptr;
+		if (clean_head != nullptr) {
+			return Copy(Detect(clean_head, end), buf, unit);
+		}
+		if (!slots_.empty() && !buf.Deterministic()) {
+			auto index = Map(origin_, end).Index();
+			if (index.empty()) {
+				return false;
+			}
+			return SerializeBook(index, slots_, buf, unit, end);
+		}
+		std::vector<const Entry*> memo;
 		memo.reserve(this->size());
 		for (auto& p : core_) {
 			memo.push_back(&p);
 		}
+		if (buf.Deterministic()) {
+			std::sort(memo.begin(), memo.end(), [](const Entry* a, const Entry* b)->bool {
+				return a->first < b->first;
+			});
+		}
 		MapKeyReader<KeyEX,ValEX> reader(memo);
-		auto index = PerfectHashObject::Build(reader, true);
+		auto index = PerfectHashObject::Build(reader, true, buf.Deterministic());
 		if (!index) {
 			return false;
 		}
 		reader.Reset();
-		std::vector<const std::pair<const KeyEX,ValEX>*> book(memo.size());
+		std::vector<const Entry*> book(memo.size());
 		for (size_t i = 0; i < memo.size(); i++) {
 			auto key = reader.Read();
 			auto pos = index.Locate(key.data(), key.size());
 			assert(pos < book.size());
 			book[pos] = memo[i];
 		}
-
-		std::vector<std::pair<Unit,Unit>> units(book.size());
-		auto last = buf.Size();
-		for (size_t i = book.size(); i-- > 0;) {
-			auto& pair = *book[i];
-			if (!::protocache::Serialize(pair.second, end, buf, units[i].second)
-				|| !::protocache::Serialize(pair.first, buf, units[i].first)) {
+		return SerializeBook(index.Data(), book, buf, unit, end);
+	}
+	bool Measure(Unit& unit, const uint32_t* end) const {
+		auto clean_head = CleanHead();
+		if (clean_head != nullptr) {
+			return MeasureCopy(Detect(clean_head, end), unit);
+		}
+		auto index_size = PerfectHash::DataSize(core_.size());
+		if (index_size == 0) {
+			return false;
+		}
+		ArraySize keys;
+		ArraySize values;
+		for (auto& pair : core_) {
+			Unit key;
+			Unit value;
+			if (!::protocache::Measure(pair.first, key)
+				|| !::protocache::Measure(pair.second, end, value)) {
 				return false;
 			}
+			keys.Add(key);
+			values.Add(value);
 		}
-		return ::protocache::SerializeMap(index.Data(), units, buf, last, unit);
+		return MeasureMap(index_size, keys, values, unit);
 	}
 
 	size_t size() const noexcept { return core_.size(); }
 	bool empty() const noexcept { return core_.empty(); }
-	void clear() noexcept { core_.clear(); }
+	void clear() noexcept { Reshape().clear(); }
 	void reserve(size_t n) { core_.reserve(n); }
-	Iterator find(const KeyEX& key) { return core_.find(key); }
+	Iterator find(const KeyEX& key) { return Touch().find(key); }
 	ConstIterator find(const KeyEX& key) const { return core_.find(key); }
-	Iterator begin() noexcept { return core_.begin(); }
+	Iterator begin() noexcept { return Touch().begin(); }
 	ConstIterator begin() const noexcept { return core_.begin(); }
-	Iterator end() noexcept { return core_.end(); }
+	Iterator end() noexcept { return Touch().end(); }
 	ConstIterator end() const noexcept { return core_.end(); }
-	Iterator erase(Iterator pos) { return core_.erase(pos); }
-	bool erase(const KeyEX& key) { return core_.erase(key) != 0; }
+	Iterator erase(Iterator pos) { return Reshape().erase(pos); }
+	bool erase(const KeyEX& key) {
+		if (core_.find(key) == core_.end()) {
+			return false;
+		}
+		return Reshape().erase(key) != 0;
+	}
 
 	template< class... Args >
 	std::pair<Iterator , bool> emplace(Args&&... args) {
-		return core_.emplace(std::forward<Args>(args)...);
-	}
-};
-
-static inline bool Copy(const Slice<uint32_t>& src, Buffer& buf, Unit& unit, bool fold=false) {
-	if (fold && src.size() < 4) {
-		unit.len = src.size();
-		for (unsigned i = 0; i < unit.len; i++) {
-			unit.data[i] = src[i];
+		auto ret = Touch().emplace(std::forward<Args>(args)...);
+		if (ret.second) {
+			Reshape();
 		}
-		return true;
+		return ret;
 	}
-	auto last = buf.Size();
-	buf.Put(src);
-	unit = Segment(last, buf.Size());
-	return true;
-}
+};
 
 template <size_t N>
 class MessageEX final : private Message {
 private:
-	std::bitset<N> _accessed;
+	mutable std::bitset<N> _loaded;	// extracted into the EX copy
+	std::bitset<N> _dirty;				// handed out for mutation, need re-encoding
 
 	template <typename T>
-	void ExtractField(unsigned id, const uint32_t* end, T& out) {
+	void ExtractField(unsigned id, const uint32_t* end, T& out) const {
 		out = FieldT<T>(Message::GetField(id, end)).Get(end);
 	}
 
 	template <typename T>
-	void ExtractField(unsigned id, const uint32_t* end, std::unique_ptr<T>& out) {
+	void ExtractField(unsigned id, const uint32_t* end, std::unique_ptr<T>& out) const {
 		out = std::make_unique<T>();
 		*out = FieldT<T>(Message::GetField(id, end)).Get(end);
 	}
 
-	void ExtractField(unsigned id, const uint32_t* end, std::string& out) {
+	void ExtractField(unsigned id, const uint32_t* end, std::string& out) const {
 		auto view = FieldT<Slice<char>>(Message::GetField(id, end)).Get(end);
 		out.assign(view.data(), view.size());
 	}
 
+	// the field, or its extraction into temp if it is not loaded
+	template <typename T>
+	const T& Loaded(unsigned id, const uint32_t* end, const T& field, T& temp) const {
+		if (_loaded.test(id)) {
+			return field;
+		}
+		ExtractField(id, end, temp);
+		return temp;
+	}
+
+	// untouched and allowed to be copied from the original data
+	template <typename T>
+	bool Copyable(unsigned id, const uint32_t* end, const T& field, const Buffer& buf) const noexcept {
+		return !_dirty.test(id) && FieldClean(id, field)
+			&& (CanCopy<T>(buf) || !Message::HasField(id, end));
+	}
+
 	static bool MarkNil(Unit& unit) {
 		unit.len = 0;
 		unit.seg.len = 0;
@@ -410,7 +684,7 @@ public:
 	MessageEX() = default;
 	MessageEX(const uint32_t* ptr, const uint32_t* end) : Message(ptr, end) {}
 	const uint32_t* CleanHead() const noexcept {
-		if (_accessed.none()) {
+		if (_dirty.none()) {
 			return ptr_;
 		} else {
 			return nullptr;
@@ -418,17 +692,55 @@ public:
 	}
 	using Message::HasField;
 
+	// mutable access, the field will be re-encoded by SerializeField
 	template <typename T>
 	T& GetField(unsigned id, const uint32_t* end, T& field) {
-		if (!_accessed.test(id)) {
-			_accessed.set(id);
+		ViewField(id, end, field);
+		_dirty.set(id);
+		return field;
+	}
+
+	// read-only access to a composite field, which is extracted once but
+	// still copied from the original data by SerializeField. The extraction
+	// writes the object, so const access is not thread-safe either.
+	template <typename T>
+	const T& ViewField(unsigned id, const uint32_t* end, T& field) const {
+		if (!_loaded.test(id)) {
+			_loaded.set(id);
 			ExtractField(id, end, field);
 		}
 		return field;
 	}
 
+	// read-only access to a scalar field, nothing is extracted
+	template <typename T>
+	T ReadField(unsigned id, const uint32_t* end, const T& field) const {
+		static_assert(std::is_scalar_v<T>);
+		if (_loaded.test(id)) {
+			return field;
+		}
+		return FieldT<T>(Message::GetField(id, end)).Get(end);
+	}
+	Slice<char> ReadField(unsigned id, const uint32_t* end, const std::string& field) const {
+		if (_loaded.test(id)) {
+			return Slice<char>(field);
+		}
+		return FieldT<Slice<char>>(Message::GetField(id, end)).Get(end);
+	}
+
+	// whether a field not marked dirty still matches the original data, as
+	// messages in a field extracted by ViewField may be changed after all
+	template <typename T>
+	bool FieldClean(unsigned id, const T& field) const noexcept {
+		if constexpr (HoldsMessage<T>::value) {
+			return !_loaded.test(id) || IsClean(field);
+		} else {
+			return true;
+		}
+	}
+
 	bool SerializeField(unsigned id, const uint32_t* end, const std::string& field, Buffer& buf, Unit& unit) const {
-		if (!_accessed.test(id)) {
+		if (!_dirty.test(id)) {
 			return Copy(DetectField<Slice<char>>(*this, id, end), buf, unit, true);
 		} else if (field.empty()) {
 			return MarkNil(unit);
@@ -439,16 +751,17 @@ public:
 	template <typename T>
 	bool SerializeField(unsigned id, const uint32_t* end, const T& field, Buffer& buf, Unit& unit) const {
 		if constexpr (std::is_scalar_v<T>) {
-			if (!_accessed.test(id)) {
+			if (!_dirty.test(id)) {
 				return Copy(DetectField<T>(*this, id, end), buf, unit, true);
 			} else if (field == 0) {
 				return MarkNil(unit);
 			}
 			return ::protocache::Serialize(field, buf, unit);	// scalar is always folded
 		} else {
-			if (!_accessed.test(id)) {
+			T temp;
+			if (Copyable(id, end, field, buf)) {
 				Copy(DetectField<typename Unwrapper<T>::Type>(*this, id, end), buf, unit, true);
-			} else if (!::protocache::Serialize(field, end, buf, unit)) {
+			} else if (!::protocache::Serialize(Loaded(id, end, field, temp), end, buf, unit)) {
 				return false;
 			}
 		}
@@ -466,22 +779,93 @@ public:
 
 	template <typename T>
 	bool SerializeField(unsigned id, const uint32_t* end, const ArrayEX<T>& field, Buffer& buf, Unit& unit) const {
-		if (!_accessed.test(id)) {
+		if (Copyable(id, end, field, buf)) {
 			return Copy(DetectField<ArrayT<typename Unwrapper<T>::Type>>(*this, id, end), buf, unit, true);
-		} else if (field.empty()) {
+		}
+		ArrayEX<T> temp;
+		auto& one = Loaded(id, end, field, temp);
+		if (one.empty()) {
 			return MarkNil(unit);
 		}
-		return ::protocache::Serialize(field, end, buf, unit) && Fold(buf, unit);
+		return ::protocache::Serialize(one, end, buf, unit) && Fold(buf, unit);
 	}
 
 	template <typename K, typename V>
 	bool SerializeField(unsigned id, const uint32_t* end, const MapEX<K,V>& field, Buffer& buf, Unit& unit) const {
-		if (!_accessed.test(id)) {
+		if (Copyable(id, end, field, buf)) {
 			return Copy(DetectField<MapT<K,typename Unwrapper<V>::Type>>(*this, id, end), buf, unit, true);
+		}
+		MapEX<K,V> temp;
+		auto& one = Loaded(id, end, field, temp);
+		if (one.empty()) {
+			return MarkNil(unit);
+		}
+		return ::protocache::Serialize(one, end, buf, unit) && Fold(buf, unit);
+	}
+
+	// size pre-pass of SerializeField
+	bool MeasureField(unsigned id, const uint32_t* end, const std::string& field, Unit& unit) const {
+		if (!_dirty.test(id)) {
+			return MeasureCopy(DetectField<Slice<char>>(*this, id, end), unit, true);
+		} else if (field.empty()) {
+			return MarkNil(unit);
+		}
+		if (!::protocache::Measure(field, unit)) {
+			return false;
+		}
+		FoldSize(unit);
+		return true;
+	}
+
+	template <typename T>
+	bool MeasureField(unsigned id, const uint32_t* end, const T& field, Unit& unit) const {
+		if constexpr (std::is_scalar_v<T>) {
+			if (!_dirty.test(id)) {
+				return MeasureCopy(DetectField<T>(*this, id, end), unit, true);
+			} else if (field == 0) {
+				return MarkNil(unit);
+			}
+			return ::protocache::Measure(field, unit);
+		} else {
+			if (!_dirty.test(id) && FieldClean(id, field)) {
+				MeasureCopy(DetectField<typename Unwrapper<T>::Type>(*this, id, end), unit, true);
+			} else if (!::protocache::Measure(field, end, unit)) {
+				return false;
+			}
+		}
+		if (unit.size() == 1) {
+			return MarkNil(unit);
+		}
+		FoldSize(unit);
+		return true;
+	}
+
+	template <typename T>
+	bool MeasureField(unsigned id, const uint32_t* end, const ArrayEX<T>& field, Unit& unit) const {
+		if (!_dirty.test(id) && FieldClean(id, field)) {
+			return MeasureCopy(DetectField<ArrayT<typename Unwrapper<T>::Type>>(*this, id, end), unit, true);
 		} else if (field.empty()) {
 			return MarkNil(unit);
 		}
-		return ::protocache::Serialize(field, end, buf, unit) && Fold(buf, unit);
+		if (!::protocache::Measure(field, end, unit)) {
+			return false;
+		}
+		FoldSize(unit);
+		return true;
+	}
+
+	template <typename K, typename V>
+	bool MeasureField(unsigned id, const uint32_t* end, const MapEX<K,V>& field, Unit& unit) const {
+		if (!_dirty.test(id) && FieldClean(id, field)) {
+			return MeasureCopy(DetectField<MapT<K,typename Unwrapper<V>::Type>>(*this, id, end), unit, true);
+		} else if (field.empty()) {
+			return MarkNil(unit);
+		}
+		if (!::protocache::Measure(field, end, unit)) {
+			return false;
+		}
+		FoldSize(unit);
+		return true;
 	}
 };
 
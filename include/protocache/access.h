@@ -9,6 +9,7 @@
 #include <cassert>
 #include <cstdint>
 #include <string>
+#include <unordered_set>
 #include "utils.h"
 #include "perfect_hash.h"
 
@@ -20,6 +21,39 @@ namespace protocache {
 
 using EnumValue = int32_t;
 
+// max nesting level accepted by Verify
+constexpr unsigned kVerifyDepthLimit = 100;
+
+// Objects already checked in one Verify pass. Dedup lets many offsets point
+// to one object, so it is checked once for each type it is read as, and the
+// pass stays linear.
+class VerifyMarks final {
+public:
+	// false if the object has been checked as T
+	template <typename T>
+	bool Mark(const uint32_t* ptr) {
+		return seen_.insert({ptr, &kTag<T>}).second;
+	}
+
+private:
+	template <typename T>
+	static constexpr char kTag = 0;
+
+	struct Key {
+		const uint32_t* ptr;
+		const void* tag;
+		bool operator==(const Key& other) const noexcept {
+			return ptr == other.ptr && tag == other.tag;
+		}
+	};
+	struct KeyHash {
+		size_t operator()(const Key& key) const noexcept {
+			return std::hash<const void*>()(key.ptr) ^ std::hash<const void*>()(key.tag);
+		}
+	};
+	std::unordered_set<Key, KeyHash> seen_;
+};
+
 class String final {
 public:
 	String() noexcept = default;
@@ -68,6 +102,9 @@ public:
 		auto size = (off + str.data_.size() + 3) / 4;
 		return {ptr, size};
 	}
+	static bool Verify(const uint32_t* ptr, const uint32_t* end) noexcept {
+		return end != nullptr && !!String(ptr, end);
+	}
 
 	Slice<char> Get() const noexcept  {
 		return SliceCast<char>(data_);
@@ -182,6 +219,26 @@ public:
 		}
 		return {ptr, static_cast<size_t>(tail-ptr)};
 	}
+	// check header and field cells, but not the objects they point to
+	static bool Verify(const uint32_t* ptr, const uint32_t* end) noexcept {
+		if (ptr == nullptr || end == nullptr || ptr >= end) {
+			return false;
+		}
+		uint32_t section = *ptr & 0xff;
+		if (1 + section*2 > static_cast<size_t>(end - ptr)) {
+			return false;
+		}
+		auto body = ptr + 1 + section*2;
+		size_t cnt = Count32(*ptr >> 8U);
+		auto vec = reinterpret_cast<const uint64_t*>(ptr + 1);
+		for (uint32_t i = 0; i < section; i++) {
+			if ((vec[i] >> 50U) != cnt) {
+				return false;
+			}
+			cnt += Count64(vec[i] << 14U);
+		}
+		return cnt <= static_cast<size_t>(end - body);
+	}
 
 	bool HasField(unsigned id, const uint32_t* end=nullptr) const noexcept {
 		uint32_t section = *ptr_ & 0xff;
@@ -329,7 +386,7 @@ public:
 	template<typename T>
 	Slice<T> Numbers() const noexcept {
 		static_assert(std::is_scalar_v<T> && sizeof(T) % 4 == 0);
-		if (width_ != WordSize(sizeof(T))) {
+		if (width_ != WordSize(sizeof(T)) && size_ != 0) {	// empty ones may be written with width 1
 			return {};
 		}
 		return {reinterpret_cast<const T*>(body_), size_};
@@ -415,10 +472,22 @@ public:
 		}
 		return {ptr, static_cast<size_t>(tail-ptr)};
 	}
+	// check header, index and pair cells, but not the objects they point to
+	static bool Verify(const uint32_t* ptr, const uint32_t* end) noexcept {
+		if (ptr == nullptr || end == nullptr || ptr >= end) {
+			return false;
+		}
+		Map map(ptr, end);
+		return !!map && map.index_.Verify();
+	}
 
 	uint32_t Size() const noexcept {
 		return index_.Size();
 	}
+	// bytes of the perfect hash, cell widths are kept in the top bits
+	Slice<uint8_t> Index() const noexcept {
+		return index_.Data();
+	}
 
 	class Iterator final {
 	public:
@@ -460,15 +529,7 @@ public:
 
 	Iterator Find(const char* str, unsigned len, const uint32_t* end=nullptr) const noexcept {
 		auto pos = index_.Locate(reinterpret_cast<const uint8_t*>(str), len);
-		if (pos >= index_.Size()) {
-			return this->end();
-		}
-		Iterator it(body_ + (key_width_ + value_width_) * pos, key_width_, value_width_);
-		auto view = String((*it).Key().GetObject(end), end).Get();
-		if (!view || view != Slice<char>(str, len)) {
-			return this->end();
-		}
-		return it;
+		return Check(Slice<char>(str, len), pos, end);
 	}
 
 	Iterator Find(const Slice<char>& key, const uint32_t* end=nullptr) const noexcept {
@@ -482,10 +543,88 @@ public:
 	Iterator Find(T val, const uint32_t* end=nullptr) const noexcept {
 		static_assert(std::is_scalar_v<T>);
 		auto pos = index_.Locate(reinterpret_cast<const uint8_t *>(&val), sizeof(T));
+		return Check(val, pos, end);
+	}
+
+	// Same as calling Find on each key, but works on groups of keys and
+	// prefetches index and pair cells ahead, so cache misses can overlap.
+	void FindBatch(const Slice<char> keys[], unsigned n, Iterator out[], const uint32_t* end=nullptr) const noexcept {
+		Slice<uint8_t> group[kBatchGroup];
+		uint32_t pos[kBatchGroup];
+		for (unsigned i = 0; i < n; i += kBatchGroup) {
+			auto m = n-i < kBatchGroup? n-i : kBatchGroup;
+			for (unsigned j = 0; j < m; j++) {
+				group[j] = {reinterpret_cast<const uint8_t*>(keys[i+j].data()), keys[i+j].size()};
+			}
+			index_.LocateBatch(group, m, pos);
+			PrefetchCells(pos, m);
+			for (unsigned j = 0; j < m; j++) {
+				if (pos[j] < index_.Size()) {
+					Prefetch(Field(Cell(pos[j]), key_width_).GetObject(end));
+				}
+			}
+			for (unsigned j = 0; j < m; j++) {
+				out[i+j] = Check(keys[i+j], pos[j], end);
+			}
+		}
+	}
+
+	template<typename T>
+	void FindBatch(const T keys[], unsigned n, Iterator out[], const uint32_t* end=nullptr) const noexcept {
+		static_assert(std::is_scalar_v<T>);
+		Slice<uint8_t> group[kBatchGroup];
+		uint32_t pos[kBatchGroup];
+		for (unsigned i = 0; i < n; i += kBatchGroup) {
+			auto m = n-i < kBatchGroup? n-i : kBatchGroup;
+			for (unsigned j = 0; j < m; j++) {
+				group[j] = {reinterpret_cast<const uint8_t*>(&keys[i+j]), sizeof(T)};
+			}
+			index_.LocateBatch(group, m, pos);
+			PrefetchCells(pos, m);
+			for (unsigned j = 0; j < m; j++) {
+				out[i+j] = Check(keys[i+j], pos[j], end);
+			}
+		}
+	}
+
+private:
+	static constexpr unsigned kBatchGroup = 16;
+
+	PerfectHash index_;
+	const uint32_t* body_ = nullptr;
+	unsigned key_width_ = 0;
+	unsigned value_width_ = 0;
+
+	const uint32_t* Cell(uint32_t pos) const noexcept {
+		return body_ + (key_width_ + value_width_) * pos;
+	}
+
+	void PrefetchCells(const uint32_t pos[], unsigned n) const noexcept {
+		for (unsigned i = 0; i < n; i++) {
+			if (pos[i] < index_.Size()) {
+				Prefetch(Cell(pos[i]));
+			}
+		}
+	}
+
+	Iterator Check(const Slice<char>& key, uint32_t pos, const uint32_t* end) const noexcept {
 		if (pos >= index_.Size()) {
 			return this->end();
 		}
-		Iterator it(body_ + (key_width_ + value_width_) * pos, key_width_, value_width_);
+		Iterator it(Cell(pos), key_width_, value_width_);
+		auto view = String((*it).Key().GetObject(end), end).Get();
+		if (!view || view != key) {
+			return this->end();
+		}
+		return it;
+	}
+
+	template<typename T>
+	Iterator Check(T val, uint32_t pos, const uint32_t* end) const noexcept {
+		if (pos >= index_.Size()) {
+			return this->end();
+		}
+		Iterator it(Cell(pos), key_width_, value_width_);
 		auto view = (*it).Key().GetValue(end);
 		if (view.size() ==  (sizeof(T)+3) / 4
 			&& val == *reinterpret_cast<const T*>(view.data())) {
@@ -493,12 +632,6 @@ public:
 		}
 		return this->end();
 	}
-
-private:
-	PerfectHash index_;
-	const uint32_t* body_ = nullptr;
-	unsigned key_width_ = 0;
-	unsigned value_width_ = 0;
 };
 
 template <typename T>
@@ -521,6 +654,10 @@ public:
 		return core_.GetValue(end);
 	}
 
+	bool Verify(const uint32_t* end, unsigned=0, VerifyMarks* =nullptr) const {
+		return end != nullptr && core_.GetValue(end).size() == WordSize(sizeof(T));
+	}
+
 private:
 	Field core_;
 };
@@ -541,6 +678,10 @@ public:
 		return String::Detect(core_.GetObject(end), end);
 	}
 
+	bool Verify(const uint32_t* end, unsigned=0, VerifyMarks* =nullptr) const {
+		return String::Verify(core_.GetObject(end), end);
+	}
+
 private:
 	Field core_;
 };
@@ -561,6 +702,10 @@ public:
 		return T::Detect(core_.GetObject(end), end);
 	}
 
+	bool Verify(const uint32_t* end, unsigned depth=0, VerifyMarks* marks=nullptr) const {
+		return T::Verify(core_.GetObject(end), end, depth, marks);
+	}
+
 private:
 	Field core_;
 };
@@ -581,6 +726,10 @@ public:
 		return T::Detect(core_.GetObject(end), end);
 	}
 
+	bool Verify(const uint32_t* end, unsigned depth=0, VerifyMarks* marks=nullptr) const {
+		return T::Verify(core_.GetObject(end), end, depth, marks);
+	}
+
 private:
 	Field core_;
 };
@@ -660,6 +809,29 @@ public:
 		return view;
 	}
 
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0, VerifyMarks* marks=nullptr) {
+		if (depth >= kVerifyDepthLimit || ptr == nullptr || end == nullptr || ptr >= end) {
+			return false;
+		}
+		Array core(ptr, end);
+		if (!core) {
+			return false;
+		}
+		VerifyMarks local;
+		if (marks == nullptr) {
+			marks = &local;
+		}
+		if (!marks->Mark<ArrayT<T>>(ptr)) {
+			return true;
+		}
+		for (auto one : core) {
+			if (!FieldT<T>(one).Verify(end, depth+1, marks)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
 	uint32_t Size() const noexcept {
 		return core_.Size();
 	}
@@ -721,6 +893,12 @@ public:
 	static Slice<uint32_t> Detect(const uint32_t* ptr, const uint32_t* end=nullptr) noexcept {
 		return Array::Detect(ptr, end);
 	}
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned=0, VerifyMarks* =nullptr) noexcept {
+		if (ptr == nullptr || end == nullptr || ptr >= end) {
+			return false;
+		}
+		return !!Array(ptr, end).Numbers<T>();
+	}
 	uint32_t Size() const noexcept {
 		return core_.size();
 	}
@@ -744,6 +922,9 @@ struct ArrayT<bool> final : public ScalarArray<bool> {
 	static Slice<uint32_t> Detect(const uint32_t* ptr, const uint32_t* end=nullptr) noexcept {
 		return String::Detect(ptr, end);
 	}
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned=0, VerifyMarks* =nullptr) noexcept {
+		return String::Verify(ptr, end);
+	}
 };
 
 template <>
@@ -836,12 +1017,33 @@ public:
 		return view;
 	}
 
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0, VerifyMarks* marks=nullptr) {
+		if (depth >= kVerifyDepthLimit || !Map::Verify(ptr, end)) {
+			return false;
+		}
+		VerifyMarks local;
+		if (marks == nullptr) {
+			marks = &local;
+		}
+		if (!marks->Mark<MapT<K,V>>(ptr)) {
+			return true;
+		}
+		for (auto pair : Map(ptr, end)) {
+			if (!FieldT<K>(pair.Key()).Verify(end, depth+1, marks)
+				|| !FieldT<V>(pair.Value()).Verify(end, depth+1, marks)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
 	uint32_t Size() const noexcept {
 		return core_.Size();
 	}
 
 	class Iterator final {
 	public:
+		Iterator() = default;
 		explicit Iterator(const Map::Iterator& core) : core_(core) {}
 		bool operator==(const Iterator& other) const noexcept {
 			return core_ == other.core_;
@@ -873,6 +1075,18 @@ public:
 		return Iterator(core_.Find(key, end));
 	}
 
+	void FindBatch(const K keys[], unsigned n, Iterator out[], const uint32_t* end=nullptr) const noexcept {
+		constexpr unsigned kGroup = 64;
+		Map::Iterator tmp[kGroup];
+		for (unsigned i = 0; i < n; i += kGroup) {
+			auto m = n-i < kGroup? n-i : kGroup;
+			core_.FindBatch(keys+i, m, tmp, end);
+			for (unsigned j = 0; j < m; j++) {
+				out[i+j] = Iterator(tmp[j]);
+			}
+		}
+	}
+
 private:
 	Map core_;
 };
@@ -887,5 +1101,116 @@ static inline Slice<uint32_t> DetectField(const Message message, unsigned id, co
 	return FieldT<T>(message.GetField(id, end)).Detect(end);
 }
 
+// message should pass Message::Verify first, so absent field is really absent
+template <typename T>
+static inline bool VerifyField(const Message message, unsigned id, const uint32_t* end,
+							   unsigned depth=0, VerifyMarks* marks=nullptr) {
+	auto field = message.GetField(id, end);
+	if (!field) {
+		return true;
+	}
+	return FieldT<T>(field).Verify(end, depth, marks);
+}
+
+// Root message which has passed T::Verify once, so its accessors can be
+// called without end.
+template <typename T>
+class Verified final {
+public:
+	Verified() noexcept = default;
+	explicit Verified(const Slice<uint32_t>& data) noexcept : Verified(data.data(), data.end()) {}
+	Verified(const uint32_t* ptr, const uint32_t* end) noexcept {
+		if (T::Verify(ptr, end)) {
+			root_ = Message(ptr).Cast<T>();
+		}
+	}
+	bool operator!() const noexcept {
+		return root_ == nullptr;
+	}
+	const T& operator*() const noexcept {
+		return *root_;
+	}
+	const T* operator->() const noexcept {
+		return root_;
+	}
+
+private:
+	const T* root_ = nullptr;
+};
+
+// Writable view of a message in a mutable buffer, to patch a present scalar
+// field or an element of a number array in place. Setters fail when the field
+// is absent or stored in another width, then the message should be rewritten.
+// Objects shared by dedup are changed for every reference.
+class MutableView final {
+public:
+	MutableView() noexcept = default;
+	explicit MutableView(uint32_t* ptr, const uint32_t* end=nullptr) noexcept : core_(ptr, end) {}
+	bool operator!() const noexcept {
+		return !core_;
+	}
+
+	template<typename T>
+	T* Cast() const noexcept {
+		return const_cast<T*>(core_.Cast<T>());
+	}
+
+	MutableView GetMessage(unsigned id, const uint32_t* end=nullptr) const noexcept {
+		auto ptr = core_.GetField(id, end).GetObject(end);
+		if (ptr == nullptr) {
+			return {};
+		}
+		return MutableView(Writable(ptr), end);
+	}
+
+	template<typename T>
+	bool Set(unsigned id, T val, const uint32_t* end=nullptr) const noexcept {
+		static_assert(std::is_scalar_v<T>);
+		if (!core_) {
+			return false;
+		}
+		auto view = core_.GetField(id, end).GetValue(end);
+		if (view.size() != WordSize(sizeof(T))) {
+			return false;
+		}
+		Store(Writable(view.data()), val);
+		return true;
+	}
+
+	template<typename T>
+	bool SetElement(unsigned id, uint32_t pos, T val, const uint32_t* end=nullptr) const noexcept {
+		static_assert(std::is_scalar_v<T> && sizeof(T) % 4 == 0);
+		constexpr unsigned m = sizeof(T) / 4;
+		if (!core_) {
+			return false;
+		}
+		auto ptr = core_.GetField(id, end).GetObject(end);
+		if (ptr == nullptr || (*ptr & 3U) != m || pos >= (*ptr >> 2U)) {
+			return false;
+		}
+		auto cell = ptr + 1 + pos*m;
+		if (end != nullptr && cell + m > end) {
+			return false;
+		}
+		Store(Writable(cell), val);
+		return true;
+	}
+
+private:
+	Message core_;
+
+	// the whole buffer is writable as it's given by caller
+	static uint32_t* Writable(const uint32_t* ptr) noexcept {
+		return const_cast<uint32_t*>(ptr);
+	}
+
+	template<typename T>
+	static void Store(uint32_t* dest, T val) noexcept {
+		uint32_t cell[WordSize(sizeof(T))] = {};
+		memcpy(cell, &val, sizeof(T));
+		memcpy(dest, cell, sizeof(cell));
+	}
+};
+
 } // protocache
 #endif //PROTOCACHE_ACCESS_H_
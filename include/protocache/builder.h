@@ -0,0 +1,373 @@
+// Copyright (c) 2023, Ruan Kunliang.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#pragma once
+#ifndef PROTOCACHE_BUILDER_H_
+#define PROTOCACHE_BUILDER_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <numeric>
+#include <algorithm>
+#include <type_traits>
+#include "serialize.h"
+#include "perfect_hash.h"
+
+namespace protocache {
+
+// Builders write data straight into a buffer, without intermediate objects.
+// A builder is created on a buffer, filled, then sealed by Finish(unit).
+// Nested messages, arrays and maps are filled by callbacks with builders of
+// their own, which should not touch any outer builder. Elements of an array
+// or a map are filled from last to first.
+
+static inline Slice<char> StringOf(const Slice<char>& v) noexcept {
+	return v;
+}
+static inline Slice<char> StringOf(const Slice<uint8_t>& v) noexcept {
+	return SliceCast<char>(v);
+}
+static inline Slice<char> StringOf(const std::string& v) noexcept {
+	return Slice<char>(v);
+}
+static inline Slice<char> StringOf(const std::string_view& v) noexcept {
+	return {v.data(), v.size()};
+}
+static inline Slice<char> StringOf(const char* v) noexcept {
+	return Slice<char>(v);
+}
+
+// zero in bits, so -0.0 is not
+template <typename T>
+static inline bool IsZero(T v) noexcept {
+	if constexpr (std::is_floating_point_v<T>) {
+		std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t> bits;
+		static_assert(sizeof(bits) == sizeof(T));
+		memcpy(&bits, &v, sizeof(T));
+		return bits == 0;
+	} else {
+		return v == 0;
+	}
+}
+
+// Serialize an array of n elements, write(i, unit) writes the i-th one.
+template <typename F>
+static bool SerializeArrayBy(size_t n, Buffer& buf, Unit& unit, F&& write) {
+	std::vector<Unit> elements(n);
+	auto last = buf.Size();
+	for (size_t i = n; i-- > 0;) {
+		if (!write(i, elements[i])) {
+			return false;
+		}
+	}
+	return SerializeArray(elements, buf, last, unit);
+}
+
+template <typename K, typename L>
+class ListKeyReader final : public KeyReader {
+public:
+	ListKeyReader(const L& keys, const std::vector<uint32_t>& order) : keys_(keys), order_(order) {}
+	void Reset() override { idx_ = 0; }
+	size_t Total() override { return order_.size(); }
+	Slice<uint8_t> Read() override {
+		if (idx_ >= order_.size()) {
+			return {};
+		}
+		auto& key = keys_[order_[idx_++]];
+		if constexpr (std::is_same_v<K, Slice<char>>) {
+			return SliceCast<uint8_t>(StringOf(key));
+		} else {
+			tmp_ = static_cast<K>(key);
+			return {reinterpret_cast<const uint8_t*>(&tmp_), sizeof(K)};
+		}
+	}
+
+private:
+	const L& keys_;
+	const std::vector<uint32_t>& order_;
+	size_t idx_ = 0;
+	K tmp_ = {};
+};
+
+// Serialize a map with keys[i] as the i-th key, write(i, unit) writes the
+// value of it. Keys should be unique.
+template <typename K, typename L, typename F>
+static bool SerializeMapBy(const L& keys, Buffer& buf, Unit& unit, F&& write) {
+	std::vector<uint32_t> order(keys.size());
+	std::iota(order.begin(), order.end(), 0U);
+	if (buf.Deterministic()) {
+		std::sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b)->bool {
+			if constexpr (std::is_same_v<K, Slice<char>>) {
+				auto x = StringOf(keys[a]);
+				auto y = StringOf(keys[b]);
+				return std::string_view(x.data(), x.size()) < std::string_view(y.data(), y.size());
+			} else {
+				return static_cast<K>(keys[a]) < static_cast<K>(keys[b]);
+			}
+		});
+	}
+	ListKeyReader<K,L> reader(keys, order);
+	auto index = PerfectHashObject::Build(reader, true, buf.Deterministic());
+	if (!index) {
+		return false;
+	}
+	reader.Reset();
+	std::vector<uint32_t> book(order.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		auto key = reader.Read();
+		auto pos = index.Locate(key.data(), key.size());
+		assert(pos < book.size());
+		book[pos] = order[i];
+	}
+
+	std::vector<std::pair<Unit,Unit>> units(book.size());
+	auto last = buf.Size();
+	for (size_t i = book.size(); i-- > 0;) {
+		auto j = book[i];
+		bool done;
+		if constexpr (std::is_same_v<K, Slice<char>>) {
+			done = write(j, units[i].second) && Serialize(StringOf(keys[j]), buf, units[i].first);
+		} else {
+			done = write(j, units[i].second) && Serialize(static_cast<K>(keys[j]), buf, units[i].first);
+		}
+		if (!done) {
+			return false;
+		}
+	}
+	return SerializeMap(index.Data(), units, buf, last, unit);
+}
+
+template <typename P>
+class PairKeys final {
+public:
+	explicit PairKeys(const std::vector<const P*>& pairs) noexcept : pairs_(pairs) {}
+	size_t size() const noexcept { return pairs_.size(); }
+	const auto& operator[](size_t i) const noexcept { return pairs_[i]->first; }
+
+private:
+	const std::vector<const P*>& pairs_;
+};
+
+// Serialize a map from a container of pairs, like std::map or protobuf Map,
+// write(value, unit) writes a value.
+template <typename K, typename M, typename F>
+static bool SerializeMapOf(const M& map, Buffer& buf, Unit& unit, F&& write) {
+	std::vector<const typename M::value_type*> pairs;
+	pairs.reserve(map.size());
+	for (auto& one : map) {
+		pairs.push_back(&one);
+	}
+	PairKeys<typename M::value_type> keys(pairs);
+	return SerializeMapBy<K>(keys, buf, unit, [&pairs, &write](size_t i, Unit& one)->bool {
+		return write(pairs[i]->second, one);
+	});
+}
+
+template <typename B, typename F>
+static inline bool SerializeBy(F&& fill, Buffer& buf, Unit& unit) {
+	B one(buf);
+	fill(one);
+	return one.Finish(unit);
+}
+
+// Base of builders for arrays and maps, the content is written by Set.
+class CollectionBuilder {
+public:
+	explicit CollectionBuilder(Buffer& buf) noexcept : buf_(buf) {}
+	CollectionBuilder(const CollectionBuilder&) = delete;
+	CollectionBuilder& operator=(const CollectionBuilder&) = delete;
+
+	bool Finish(Unit& unit) noexcept {
+		if (!done_) {
+			unit.len = 1;	// empty array
+			unit.data[0] = 1U;
+			return true;
+		}
+		unit = unit_;
+		return ok_;
+	}
+
+protected:
+	Buffer& buf_;
+	Unit unit_;
+	bool done_ = false;
+	bool ok_ = false;
+
+	template <typename W>
+	void Done(W&& write) {
+		ok_ = !done_ && write(unit_);
+		done_ = true;
+	}
+};
+
+template <typename T>
+class ScalarArrayBuilder : public CollectionBuilder {
+public:
+	using CollectionBuilder::CollectionBuilder;
+	void Set(const Slice<T>& array) {
+		Done([this, &array](Unit& unit)->bool {
+			return SerializeArray(array, buf_, unit);
+		});
+	}
+};
+
+class StringArrayBuilder : public CollectionBuilder {
+public:
+	using CollectionBuilder::CollectionBuilder;
+	// list[i] can be std::string, Slice<char> or alike
+	template <typename L>
+	void Set(const L& list) {
+		Done([this, &list](Unit& unit)->bool {
+			return SerializeArrayBy(list.size(), buf_, unit, [this, &list](size_t i, Unit& one)->bool {
+				return Serialize(StringOf(list[i]), buf_, one);
+			});
+		});
+	}
+};
+
+template <typename B>
+class ArrayBuilder : public CollectionBuilder {
+public:
+	using CollectionBuilder::CollectionBuilder;
+	// fill(i, builder) fills the i-th element
+	template <typename F>
+	void Set(size_t n, F&& fill) {
+		Done([this, n, &fill](Unit& unit)->bool {
+			return SerializeArrayBy(n, buf_, unit, [this, &fill](size_t i, Unit& one)->bool {
+				return SerializeBy<B>([i, &fill](B& b) { fill(i, b); }, buf_, one);
+			});
+		});
+	}
+};
+
+template <typename K, typename V>
+class MapBuilder : public CollectionBuilder {
+public:
+	using CollectionBuilder::CollectionBuilder;
+	// value(i) gives the value of keys[i]
+	template <typename L, typename F>
+	void Set(const L& keys, F&& value) {
+		Done([this, &keys, &value](Unit& unit)->bool {
+			return SerializeMapBy<K>(keys, buf_, unit, [this, &value](size_t i, Unit& one)->bool {
+				if constexpr (std::is_same_v<V, Slice<char>> || std::is_same_v<V, Slice<uint8_t>>) {
+					return Serialize(StringOf(value(i)), buf_, one);
+				} else {
+					return Serialize(static_cast<V>(value(i)), buf_, one);
+				}
+			});
+		});
+	}
+	bool Finish(Unit& unit) {
+		if (!done_) {
+			Set(std::vector<K>(), [](size_t)->V { return {}; });
+		}
+		return CollectionBuilder::Finish(unit);
+	}
+};
+
+template <typename K, typename B>
+class MessageMapBuilder : public CollectionBuilder {
+public:
+	using CollectionBuilder::CollectionBuilder;
+	// fill(i, builder) fills the value of keys[i]
+	template <typename L, typename F>
+	void Set(const L& keys, F&& fill) {
+		Done([this, &keys, &fill](Unit& unit)->bool {
+			return SerializeMapBy<K>(keys, buf_, unit, [this, &fill](size_t i, Unit& one)->bool {
+				return SerializeBy<B>([i, &fill](B& b) { fill(i, b); }, buf_, one);
+			});
+		});
+	}
+	bool Finish(Unit& unit) {
+		if (!done_) {
+			Set(std::vector<K>(), [](size_t, B&) {});
+		}
+		return CollectionBuilder::Finish(unit);
+	}
+};
+
+// Base of generated message builders, N is the max field id.
+template <size_t N>
+class MessageBuilder {
+public:
+	explicit MessageBuilder(Buffer& buf) noexcept : buf_(buf), last_(buf.Size()) {}
+	MessageBuilder(const MessageBuilder&) = delete;
+	MessageBuilder& operator=(const MessageBuilder&) = delete;
+
+	// fails if any field failed
+	bool Finish(Unit& unit) {
+		return ok_ && SerializeMessage(parts_, buf_, last_, unit);
+	}
+	// for top level message
+	bool Finish() {
+		Unit unit;
+		return Finish(unit);
+	}
+
+protected:
+	template <typename T>
+	void SetScalar(unsigned id, T v) {
+		Serialize(v, buf_, parts_[id]);
+	}
+	void SetString(unsigned id, const Slice<char>& v) {
+		Set(id, false, [this, &v](Unit& unit)->bool {
+			return Serialize(v, buf_, unit);
+		});
+	}
+	template <typename T>
+	void SetArray(unsigned id, const Slice<T>& array) {
+		SetBy<ScalarArrayBuilder<T>>(id, [&array](ScalarArrayBuilder<T>& b) { b.Set(array); });
+	}
+	template <typename L>
+	void SetStrings(unsigned id, const L& list) {
+		SetBy<StringArrayBuilder>(id, [&list](StringArrayBuilder& b) { b.Set(list); });
+	}
+	template <typename B, typename F>
+	void SetArrayBy(unsigned id, size_t n, F&& fill) {
+		SetBy<ArrayBuilder<B>>(id, [n, &fill](ArrayBuilder<B>& b) { b.Set(n, fill); });
+	}
+	template <typename K, typename V, typename L, typename F>
+	void SetMap(unsigned id, const L& keys, F&& value) {
+		SetBy<MapBuilder<K,V>>(id, [&keys, &value](MapBuilder<K,V>& b) { b.Set(keys, value); });
+	}
+	template <typename K, typename B, typename L, typename F>
+	void SetMapBy(unsigned id, const L& keys, F&& fill) {
+		SetBy<MessageMapBuilder<K,B>>(id, [&keys, &fill](MessageMapBuilder<K,B>& b) { b.Set(keys, fill); });
+	}
+	// nested message, array or map
+	template <typename B, typename F>
+	void SetBy(unsigned id, F&& fill) {
+		Set(id, true, [this, &fill](Unit& unit)->bool {
+			return SerializeBy<B>(fill, buf_, unit);
+		});
+	}
+
+private:
+	Buffer& buf_;
+	size_t last_;
+	bool ok_ = true;
+	std::array<Unit,N> parts_;
+
+	template <typename W>
+	void Set(unsigned id, bool nested, W&& write) {
+		auto& unit = parts_[id];
+		unit = {};
+		if (!ok_ || !write(unit)) {
+			ok_ = false;
+			return;
+		}
+		if (nested) {
+			FoldNested(buf_, unit);
+		} else {
+			FoldField(buf_, unit);
+		}
+	}
+};
+
+} // protocache
+#endif //PROTOCACHE_BUILDER_H_
@@ -11,6 +11,8 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <google/protobuf/descriptor.pb.h>
+#include <google/protobuf/field_mask.pb.h>
+#include "../serialize.h"
 
 namespace protocache {
 namespace reflection {
@@ -73,6 +75,16 @@ private:
 	bool FixUnknownType(const std::string& fullname, Descriptor& descriptor) const;
 };
 
+// Converts a FieldMask into ids. A path names a field of the message, or of
+// singular message fields on the way, like "object.str".
+extern bool BuildFieldTree(DescriptorPool& pool, const Descriptor& descriptor,
+						   const google::protobuf::FieldMask& mask, FieldTree* tree);
+
+// Reflective version of the generated Project. Kept fields are detected by
+// walking the schema, then copied verbatim.
+extern bool Project(const Slice<uint32_t>& data, DescriptorPool& pool, const Descriptor& descriptor,
+					const FieldTree& tree, Buffer* buf);
+
 } // reflection
 } // protocache
 #endif //PROTOCACHE_EXT_REFLECTION_H_
\ No newline at end of file
@@ -8,8 +8,11 @@
 
 #include <cstdint>
 #include <string>
+#include <memory>
+#include <vector>
 #include <google/protobuf/message.h>
 #include <google/protobuf/descriptor.pb.h>
+#include <google/protobuf/field_mask.pb.h>
 #include "../utils.h"
 
 namespace protocache {
@@ -29,10 +32,102 @@ extern bool DumpJson(const google::protobuf::Message& message, const std::string
 // - alias messages whose only field is not a repeated field named "_"
 extern bool Serialize(const google::protobuf::Message& message, Buffer* buf);
 
+// Exact size in words of what Serialize() writes, with the same failure cases.
+// Reserve it to serialize in one allocation, or serialize into a region of it.
+extern bool SerializedSize(const google::protobuf::Message& message, size_t* size);
+
+// Serialize into a file through a writable mapping, without a heap buffer.
+extern bool SerializeToFile(const google::protobuf::Message& message, const std::string& path);
+
+// Transcodes protobuf wire format into ProtoCache directly, without building
+// protobuf objects. Fields of a message are buffered as slices of the input,
+// then written bottom-up. The output is the same as Serialize after parsing,
+// except that strings are not checked for UTF-8 and required fields are not
+// checked. Layouts of message types are cached, so reuse a transcoder for a
+// stream of messages. Not thread-safe.
+class Transcoder final {
+public:
+	// descriptor should outlive the transcoder
+	explicit Transcoder(const google::protobuf::Descriptor* descriptor);
+	~Transcoder() noexcept;
+	Transcoder(const Transcoder&) = delete;
+	Transcoder& operator=(const Transcoder&) = delete;
+
+	bool Transcode(const Slice<uint8_t>& data, Buffer* buf);
+	bool Transcode(const std::string& data, Buffer* buf) {
+		return Transcode({reinterpret_cast<const uint8_t*>(data.data()), data.size()}, buf);
+	}
+
+private:
+	class Context;
+	std::unique_ptr<Context> ctx_;
+};
+
 // Deserialize ProtoCache data into protobuf.
 // The protobuf schema is expected to obey the same ProtoCache schema constraints
 // as Serialize().
 extern bool Deserialize(const Slice<uint32_t>& raw, google::protobuf::Message* message);
 
+// A FieldMask compiled against a message type. A path names a field of the
+// message, or of singular message fields on the way, like "object.str". It
+// selects the whole field, and covers paths under it. Paths of unknown or
+// deprecated fields, or walking through other fields, make it invalid.
+class MaskTree final {
+public:
+	static constexpr unsigned kWhole = ~0U;
+	struct Child {
+		const google::protobuf::FieldDescriptor* field;
+		unsigned node;		// kWhole, or node of the picked fields in it
+	};
+
+	bool operator!() const noexcept {
+		return descriptor_ == nullptr;
+	}
+	const google::protobuf::Descriptor* Root() const noexcept {
+		return descriptor_;
+	}
+	// node 0 is for the root message
+	const std::vector<Child>& Children(unsigned node) const noexcept {
+		return nodes_[node].children;
+	}
+
+	static MaskTree Compile(const google::protobuf::Descriptor* descriptor, const google::protobuf::FieldMask& mask);
+
+private:
+	struct Node {
+		std::vector<Child> children;
+	};
+	const google::protobuf::Descriptor* descriptor_ = nullptr;
+	std::vector<Node> nodes_;
+};
+
+// Deserialize only fields selected by the mask, other parts of data are not
+// visited. Compile the mask once to deserialize many messages of its type.
+extern bool Deserialize(const Slice<uint32_t>& raw, const MaskTree& mask, google::protobuf::Message* message);
+extern bool Deserialize(const Slice<uint32_t>& raw, const google::protobuf::FieldMask& mask,
+						google::protobuf::Message* message);
+
+// Deserialize ProtoCache data straight into protobuf wire format, without
+// building protobuf objects. Lengths of nested records are counted in a
+// pre-pass, then the output is written in one go. It parses to the same
+// message as Deserialize, map entries may come in a different order.
+extern bool DeserializeToWire(const Slice<uint32_t>& raw, const google::protobuf::Descriptor* descriptor,
+							  std::string* out);
+
+// Deserialize into a new protobuf object on arena (or heap if arena is nullptr)
+// by ToProtobuf, which is generated by protoc-gen-pccx with option protobuf.
+// Returns nullptr on failure.
+template <typename T>
+static T* DeserializeOn(google::protobuf::Arena* arena, const Slice<uint32_t>& raw) {
+	auto out = google::protobuf::Arena::CreateMessage<T>(arena);
+	if (!ToProtobuf(raw, out)) {
+		if (arena == nullptr) {
+			delete out;
+		}
+		return nullptr;
+	}
+	return out;
+}
+
 } // protocache
 #endif //PROTOCACHE_EXT_UTILS_H_
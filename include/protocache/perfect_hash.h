@@ -7,6 +7,7 @@
 #define PROTOCACHE_PERFECT_HASH_H_
 
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <string>
 #include <memory>
@@ -22,6 +23,53 @@ struct KeyReader {
 	virtual ~KeyReader() noexcept = default;
 };
 
+// Reads keys from a file of records, each one is a 4-byte little-endian
+// length followed by the key bytes.
+class FileKeyReader final : public KeyReader {
+public:
+	FileKeyReader() noexcept = default;
+	FileKeyReader(const FileKeyReader&) = delete;
+	FileKeyReader& operator=(const FileKeyReader&) = delete;
+	FileKeyReader(FileKeyReader&& other) noexcept
+		: file_(other.file_), total_(other.total_), size_(other.size_), rest_(other.rest_),
+		  buffer_(std::move(other.buffer_)) {
+		other.file_ = nullptr;
+		other.total_ = 0;
+		other.size_ = 0;
+		other.rest_ = 0;
+	}
+	FileKeyReader& operator=(FileKeyReader&& other) noexcept {
+		if (&other != this) {
+			this->~FileKeyReader();
+			new(this)FileKeyReader(std::move(other));
+		}
+		return *this;
+	}
+	~FileKeyReader() noexcept override;
+
+	bool operator!() const noexcept {
+		return file_ == nullptr;
+	}
+
+	void Reset() override;
+	size_t Total() override {
+		return total_;
+	}
+	// the returned key is valid until next call, empty slice means end or error
+	Slice<uint8_t> Read() override;
+
+	static FileKeyReader Open(const std::string& path);
+	// write all keys from source into a file in the format above
+	static bool Dump(KeyReader& source, const std::string& path);
+
+private:
+	std::FILE* file_ = nullptr;
+	size_t total_ = 0;
+	size_t size_ = 0;	// file size
+	size_t rest_ = 0;	// bytes left to read
+	std::string buffer_;
+};
+
 class PerfectHash {
 public:
 	bool operator!() const noexcept {
@@ -39,6 +87,15 @@ public:
 
 	uint32_t Locate(const uint8_t* key, unsigned key_len) const noexcept;
 
+	// locate a group of keys in stages, so their cache misses can overlap
+	void LocateBatch(const Slice<uint8_t> keys[], unsigned n, uint32_t out[]) const noexcept;
+
+	// check the offset table against the bitmap
+	bool Verify() const noexcept;
+
+	// bytes of the index built for a key set of this size, 0 if too big
+	static uint32_t DataSize(uint32_t total) noexcept;
+
 protected:
 	uint32_t section_ = 0;
 	uint32_t data_size_ = 0;
@@ -54,7 +111,22 @@ public:
 
 	uint32_t Locate(const uint8_t* key, unsigned key_len) const noexcept;
 
-	static PerfectHashObject Build(KeyReader& source, bool no_check=false);
+	// With deterministic, seeds are derived from the key set instead of clock,
+	// so the same key sequence always gives the same output.
+	static PerfectHashObject Build(KeyReader& source, bool no_check=false, bool deterministic=false);
+
+	// Same output format as Build, but hashing runs on many threads.
+	// All keys are copied into memory first. threads == 0 means all cores.
+	static PerfectHashObject BuildParallel(KeyReader& source, unsigned threads=0,
+										   bool no_check=false, bool deterministic=false);
+
+	// Same output format as Build, for key sets too big to build in memory.
+	// Scratch data, stdio buffers of temporary files included, is kept within
+	// memory_budget bytes and the rest is spilled to temporary files under
+	// temp_dir (system default if empty). Keys are
+	// read once or more for every try, so source should be file-backed.
+	static PerfectHashObject BuildExternal(KeyReader& source, size_t memory_budget, const std::string& temp_dir={},
+										   bool no_check=false, bool deterministic=false);
 private:
 	std::unique_ptr<uint8_t[]> buffer_;
 	PerfectHashObject() noexcept = default;
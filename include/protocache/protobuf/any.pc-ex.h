@@ -21,12 +21,18 @@ struct Any final {
 	bool HasField(unsigned id, const uint32_t* end=nullptr) const noexcept {
 		return __view__.HasField(id, end);
 	}
+	// original data which can be copied as it is, or nullptr
+	const uint32_t* CleanHead() const noexcept {
+		auto clean_head = __view__.CleanHead();
+		if (clean_head == nullptr) return nullptr;
+		return clean_head;
+	}
 	bool Serialize(protocache::Buffer* buf, const uint32_t* end=nullptr) const {
 		protocache::Unit dummy;
 		return Serialize(*buf, dummy, end);
 	}
 	bool Serialize(protocache::Buffer& buf, protocache::Unit& unit, const uint32_t* end) const {
-		auto clean_head = __view__.CleanHead();
+		auto clean_head = CleanHead();
 		if (clean_head != nullptr) {
 			return protocache::Copy(Detect(clean_head, end), buf, unit);
 		}
@@ -36,10 +42,27 @@ struct Any final {
 		if (!__view__.SerializeField(_::type_url, end, _type_url, buf, parts[_::type_url])) return false;
 		return protocache::SerializeMessage(parts, buf, last, unit);
 	}
+	size_t SerializedSize(const uint32_t* end=nullptr) const {
+		protocache::Unit unit;
+		return Measure(unit, end) ? unit.size() : 0;
+	}
+	bool Measure(protocache::Unit& unit, const uint32_t* end) const {
+		auto clean_head = CleanHead();
+		if (clean_head != nullptr) {
+			return protocache::MeasureCopy(Detect(clean_head, end), unit);
+		}
+		std::array<protocache::Unit,2> parts;
+		if (!__view__.MeasureField(_::type_url, end, _type_url, parts[_::type_url])) return false;
+		if (!__view__.MeasureField(_::value, end, _value, parts[_::value])) return false;
+		return protocache::MeasureMessage(parts, unit);
+	}
 
 	std::string& type_url(const uint32_t* end=nullptr) { return __view__.GetField(_::type_url, end, _type_url); }
 	std::string& value(const uint32_t* end=nullptr) { return __view__.GetField(_::value, end, _value); }
 
+	protocache::Slice<char> type_url(const uint32_t* end=nullptr) const { return __view__.ReadField(_::type_url, end, _type_url); }
+	protocache::Slice<uint8_t> value(const uint32_t* end=nullptr) const { return protocache::SliceCast<uint8_t>(__view__.ReadField(_::value, end, _value)); }
+
 private:
 	using _ = ::google::protobuf::Any::_;
 	protocache::MessageEX<2> __view__;
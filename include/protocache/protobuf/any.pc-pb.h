@@ -0,0 +1,67 @@
+#pragma once
+#ifndef PROTOCACHE_INCLUDED_PB_google_protobuf_any_proto
+#define PROTOCACHE_INCLUDED_PB_google_protobuf_any_proto
+
+#include <protocache/builder.h>
+#include <protocache/extension/utils.h>
+#include "google/protobuf/any.pb.h"
+
+namespace google {
+namespace protobuf {
+
+inline bool FromProtobuf(const ::google::protobuf::Any& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::Any* out);
+
+inline bool FromProtobuf(const ::google::protobuf::Any& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	std::array<protocache::Unit,2> parts;
+	auto last = buf.Size();
+	if (!message.value().empty()) {
+		if (!protocache::Serialize(message.value(), buf, parts[1])) {
+			return false;
+		}
+		protocache::FoldField(buf, parts[1]);
+	}
+	if (!message.type_url().empty()) {
+		if (!protocache::Serialize(message.type_url(), buf, parts[0])) {
+			return false;
+		}
+		protocache::FoldField(buf, parts[0]);
+	}
+	return protocache::SerializeMessage(parts, buf, last, unit);
+}
+
+inline bool FromProtobuf(const ::google::protobuf::Any& message, protocache::Buffer& buf) {
+	protocache::Unit dummy;
+	return FromProtobuf(message, buf, dummy);
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::Any* out) {
+	protocache::Message message(data, end);
+	if (!message) {
+		return false;
+	}
+	if (auto field = message.GetField(0, end); !!field) {
+		auto v = protocache::FieldT<protocache::Slice<char>>(field).Get(end);
+		if (!v) {
+			return false;
+		}
+		out->mutable_type_url()->assign(v.data(), v.size());
+	}
+	if (auto field = message.GetField(1, end); !!field) {
+		auto v = protocache::FieldT<protocache::Slice<char>>(field).Get(end);
+		if (!v) {
+			return false;
+		}
+		out->mutable_value()->assign(v.data(), v.size());
+	}
+	return true;
+}
+
+inline bool ToProtobuf(const protocache::Slice<uint32_t>& data, ::google::protobuf::Any* out) {
+	out->Clear();
+	return ToProtobuf(data.data(), data.end(), out);
+}
+
+} // protobuf
+} // google
+#endif // PROTOCACHE_INCLUDED_PB_google_protobuf_any_proto
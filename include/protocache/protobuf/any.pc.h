@@ -3,6 +3,7 @@
 #define PROTOCACHE_INCLUDED_any_proto
 
 #include <protocache/access.h>
+#include <protocache/builder.h>
 
 namespace google {
 namespace protobuf {
@@ -33,12 +34,49 @@ public:
 		return view;
 	}
 
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0,
+			protocache::VerifyMarks* marks=nullptr) {
+		if (depth >= protocache::kVerifyDepthLimit || !protocache::Message::Verify(ptr, end)) return false;
+		protocache::Message core(ptr, end);
+		if (!protocache::VerifyField<protocache::Slice<char>>(core, _::type_url, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<protocache::Slice<uint8_t>>(core, _::value, end, depth+1, marks)) return false;
+		return true;
+	}
+
+	static bool Project(const uint32_t* ptr, const uint32_t* end, const protocache::FieldTree& tree, unsigned node,
+			protocache::Buffer& buf, protocache::Unit& unit) {
+		protocache::Message core(ptr, end);
+		if (!core) return false;
+		return protocache::ProjectMessage(core, end, tree, node, buf, unit,
+				[&core, end, &buf](unsigned id, unsigned, protocache::Unit& one) {
+			switch (id) {
+				case _::type_url:
+					return protocache::CopyField<protocache::Slice<char>>(core, id, end, buf, one);
+				case _::value:
+					return protocache::CopyField<protocache::Slice<uint8_t>>(core, id, end, buf, one);
+				default:
+					return false;
+			}
+		});
+	}
+
 	protocache::Slice<char> type_url(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<protocache::Slice<char>>(protocache::Message::Cast(this), _::type_url, end);
 	}
 	protocache::Slice<uint8_t> value(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<protocache::Slice<uint8_t>>(protocache::Message::Cast(this), _::value, end);
 	}
+
+	class Builder;
+};
+
+class Any::Builder final : public protocache::MessageBuilder<2> {
+public:
+	using MessageBuilder::MessageBuilder;
+	template <typename S>
+	void type_url(const S& v) { SetString(_::type_url, protocache::StringOf(v)); }
+	template <typename S>
+	void value(const S& v) { SetString(_::value, protocache::StringOf(v)); }
 };
 
 } // protobuf
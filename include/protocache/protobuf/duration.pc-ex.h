@@ -21,12 +21,18 @@ struct Duration final {
 	bool HasField(unsigned id, const uint32_t* end=nullptr) const noexcept {
 		return __view__.HasField(id, end);
 	}
+	// original data which can be copied as it is, or nullptr
+	const uint32_t* CleanHead() const noexcept {
+		auto clean_head = __view__.CleanHead();
+		if (clean_head == nullptr) return nullptr;
+		return clean_head;
+	}
 	bool Serialize(protocache::Buffer* buf, const uint32_t* end=nullptr) const {
 		protocache::Unit dummy;
 		return Serialize(*buf, dummy, end);
 	}
 	bool Serialize(protocache::Buffer& buf, protocache::Unit& unit, const uint32_t* end) const {
-		auto clean_head = __view__.CleanHead();
+		auto clean_head = CleanHead();
 		if (clean_head != nullptr) {
 			return protocache::Copy(Detect(clean_head, end), buf, unit);
 		}
@@ -36,15 +42,32 @@ struct Duration final {
 		if (!__view__.SerializeField(_::seconds, end, _seconds, buf, parts[_::seconds])) return false;
 		return protocache::SerializeMessage(parts, buf, last, unit);
 	}
+	size_t SerializedSize(const uint32_t* end=nullptr) const {
+		protocache::Unit unit;
+		return Measure(unit, end) ? unit.size() : 0;
+	}
+	bool Measure(protocache::Unit& unit, const uint32_t* end) const {
+		auto clean_head = CleanHead();
+		if (clean_head != nullptr) {
+			return protocache::MeasureCopy(Detect(clean_head, end), unit);
+		}
+		std::array<protocache::Unit,2> parts;
+		if (!__view__.MeasureField(_::seconds, end, _seconds, parts[_::seconds])) return false;
+		if (!__view__.MeasureField(_::nanos, end, _nanos, parts[_::nanos])) return false;
+		return protocache::MeasureMessage(parts, unit);
+	}
 
 	int64_t& seconds(const uint32_t* end=nullptr) { return __view__.GetField(_::seconds, end, _seconds); }
 	int32_t& nanos(const uint32_t* end=nullptr) { return __view__.GetField(_::nanos, end, _nanos); }
 
+	int64_t seconds(const uint32_t* end=nullptr) const { return __view__.ReadField(_::seconds, end, _seconds); }
+	int32_t nanos(const uint32_t* end=nullptr) const { return __view__.ReadField(_::nanos, end, _nanos); }
+
 private:
 	using _ = ::google::protobuf::Duration::_;
 	protocache::MessageEX<2> __view__;
-	int64_t _seconds;
-	int32_t _nanos;
+	int64_t _seconds{};
+	int32_t _nanos{};
 };
 
 } // protobuf
@@ -3,6 +3,7 @@
 #define PROTOCACHE_INCLUDED_duration_proto
 
 #include <protocache/access.h>
+#include <protocache/builder.h>
 
 namespace google {
 namespace protobuf {
@@ -29,12 +30,53 @@ public:
 		return view;
 	}
 
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0,
+			protocache::VerifyMarks* marks=nullptr) {
+		if (depth >= protocache::kVerifyDepthLimit || !protocache::Message::Verify(ptr, end)) return false;
+		protocache::Message core(ptr, end);
+		if (!protocache::VerifyField<int64_t>(core, _::seconds, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<int32_t>(core, _::nanos, end, depth+1, marks)) return false;
+		return true;
+	}
+
+	static bool Project(const uint32_t* ptr, const uint32_t* end, const protocache::FieldTree& tree, unsigned node,
+			protocache::Buffer& buf, protocache::Unit& unit) {
+		protocache::Message core(ptr, end);
+		if (!core) return false;
+		return protocache::ProjectMessage(core, end, tree, node, buf, unit,
+				[&core, end, &buf](unsigned id, unsigned, protocache::Unit& one) {
+			switch (id) {
+				case _::seconds:
+					return protocache::CopyField<int64_t>(core, id, end, buf, one);
+				case _::nanos:
+					return protocache::CopyField<int32_t>(core, id, end, buf, one);
+				default:
+					return false;
+			}
+		});
+	}
+
 	int64_t seconds(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<int64_t>(protocache::Message::Cast(this), _::seconds, end);
 	}
 	int32_t nanos(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<int32_t>(protocache::Message::Cast(this), _::nanos, end);
 	}
+	bool set_seconds_inplace(int64_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::seconds, val, end);
+	}
+	bool set_nanos_inplace(int32_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::nanos, val, end);
+	}
+
+	class Builder;
+};
+
+class Duration::Builder final : public protocache::MessageBuilder<2> {
+public:
+	using MessageBuilder::MessageBuilder;
+	void seconds(int64_t v) { SetScalar(_::seconds, v); }
+	void nanos(int32_t v) { SetScalar(_::nanos, v); }
 };
 
 } // protobuf
@@ -0,0 +1,53 @@
+#pragma once
+#ifndef PROTOCACHE_INCLUDED_PB_google_protobuf_timestamp_proto
+#define PROTOCACHE_INCLUDED_PB_google_protobuf_timestamp_proto
+
+#include <protocache/builder.h>
+#include <protocache/extension/utils.h>
+#include "google/protobuf/timestamp.pb.h"
+
+namespace google {
+namespace protobuf {
+
+inline bool FromProtobuf(const ::google::protobuf::Timestamp& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::Timestamp* out);
+
+inline bool FromProtobuf(const ::google::protobuf::Timestamp& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	std::array<protocache::Unit,2> parts;
+	auto last = buf.Size();
+	if (message.nanos() != 0) {
+		protocache::Serialize(message.nanos(), buf, parts[1]);
+	}
+	if (message.seconds() != 0) {
+		protocache::Serialize(message.seconds(), buf, parts[0]);
+	}
+	return protocache::SerializeMessage(parts, buf, last, unit);
+}
+
+inline bool FromProtobuf(const ::google::protobuf::Timestamp& message, protocache::Buffer& buf) {
+	protocache::Unit dummy;
+	return FromProtobuf(message, buf, dummy);
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::Timestamp* out) {
+	protocache::Message message(data, end);
+	if (!message) {
+		return false;
+	}
+	if (auto field = message.GetField(0, end); !!field) {
+		out->set_seconds(protocache::FieldT<int64_t>(field).Get(end));
+	}
+	if (auto field = message.GetField(1, end); !!field) {
+		out->set_nanos(protocache::FieldT<int32_t>(field).Get(end));
+	}
+	return true;
+}
+
+inline bool ToProtobuf(const protocache::Slice<uint32_t>& data, ::google::protobuf::Timestamp* out) {
+	out->Clear();
+	return ToProtobuf(data.data(), data.end(), out);
+}
+
+} // protobuf
+} // google
+#endif // PROTOCACHE_INCLUDED_PB_google_protobuf_timestamp_proto
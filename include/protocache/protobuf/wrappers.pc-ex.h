@@ -29,12 +29,18 @@ struct DoubleValue final {
 	bool HasField(unsigned id, const uint32_t* end=nullptr) const noexcept {
 		return __view__.HasField(id, end);
 	}
+	// original data which can be copied as it is, or nullptr
+	const uint32_t* CleanHead() const noexcept {
+		auto clean_head = __view__.CleanHead();
+		if (clean_head == nullptr) return nullptr;
+		return clean_head;
+	}
 	bool Serialize(protocache::Buffer* buf, const uint32_t* end=nullptr) const {
 		protocache::Unit dummy;
 		return Serialize(*buf, dummy, end);
 	}
 	bool Serialize(protocache::Buffer& buf, protocache::Unit& unit, const uint32_t* end) const {
-		auto clean_head = __view__.CleanHead();
+		auto clean_head = CleanHead();
 		if (clean_head != nullptr) {
 			return protocache::Copy(Detect(clean_head, end), buf, unit);
 		}
@@ -43,13 +49,28 @@ struct DoubleValue final {
 		if (!__view__.SerializeField(_::value, end, _value, buf, parts[_::value])) return false;
 		return protocache::SerializeMessage(parts, buf, last, unit);
 	}
+	size_t SerializedSize(const uint32_t* end=nullptr) const {
+		protocache::Unit unit;
+		return Measure(unit, end) ? unit.size() : 0;
+	}
+	bool Measure(protocache::Unit& unit, const uint32_t* end) const {
+		auto clean_head = CleanHead();
+		if (clean_head != nullptr) {
+			return protocache::MeasureCopy(Detect(clean_head, end), unit);
+		}
+		std::array<protocache::Unit,1> parts;
+		if (!__view__.MeasureField(_::value, end, _value, parts[_::value])) return false;
+		return protocache::MeasureMessage(parts, unit);
+	}
 
 	double& value(const uint32_t* end=nullptr) { return __view__.GetField(_::value, end, _value); }
 
+	double value(const uint32_t* end=nullptr) const { return __view__.ReadField(_::value, end, _value); }
+
 private:
 	using _ = ::google::protobuf::DoubleValue::_;
 	protocache::MessageEX<1> __view__;
-	double _value;
+	double _value{};
 };
 
 struct FloatValue final {
@@ -62,12 +83,18 @@ struct FloatValue final {
 	bool HasField(unsigned id, const uint32_t* end=nullptr) const noexcept {
 		return __view__.HasField(id, end);
 	}
+	// original data which can be copied as it is, or nullptr
+	const uint32_t* CleanHead() const noexcept {
+		auto clean_head = __view__.CleanHead();
+		if (clean_head == nullptr) return nullptr;
+		return clean_head;
+	}
 	bool Serialize(protocache::Buffer* buf, const uint32_t* end=nullptr) const {
 		protocache::Unit dummy;
 		return Serialize(*buf, dummy, end);
 	}
 	bool Serialize(protocache::Buffer& buf, protocache::Unit& unit, const uint32_t* end) const {
-		auto clean_head = __view__.CleanHead();
+		auto clean_head = CleanHead();
 		if (clean_head != nullptr) {
 			return protocache::Copy(Detect(clean_head, end), buf, unit);
 		}
@@ -76,13 +103,28 @@ struct FloatValue final {
 		if (!__view__.SerializeField(_::value, end, _value, buf, parts[_::value])) return false;
 		return protocache::SerializeMessage(parts, buf, last, unit);
 	}
+	size_t SerializedSize(const uint32_t* end=nullptr) const {
+		protocache::Unit unit;
+		return Measure(unit, end) ? unit.size() : 0;
+	}
+	bool Measure(protocache::Unit& unit, const uint32_t* end) const {
+		auto clean_head = CleanHead();
+		if (clean_head != nullptr) {
+			return protocache::MeasureCopy(Detect(clean_head, end), unit);
+		}
+		std::array<protocache::Unit,1> parts;
+		if (!__view__.MeasureField(_::value, end, _value, parts[_::value])) return false;
+		return protocache::MeasureMessage(parts, unit);
+	}
 
 	float& value(const uint32_t* end=nullptr) { return __view__.GetField(_::value, end, _value); }
 
+	float value(const uint32_t* end=nullptr) const { return __view__.ReadField(_::value, end, _value); }
+
 private:
 	using _ = ::google::protobuf::FloatValue::_;
 	protocache::MessageEX<1> __view__;
-	float _value;
+	float _value{};
 };
 
 struct Int64Value final {
@@ -95,12 +137,18 @@ struct Int64Value final {
 	bool HasField(unsigned id, const uint32_t* end=nullptr) const noexcept {
 		return __view__.HasField(id, end);
 	}
+	// original data which can be copied as it is, or nullptr
+	const uint32_t* CleanHead() const noexcept {
+		auto clean_head = __view__.CleanHead();
+		if (clean_head == nullptr) return nullptr;
+		return clean_head;
+	}
 	bool Serialize(protocache::Buffer* buf, const uint32_t* end=nullptr) const {
 		protocache::Unit dummy;
 		return Serialize(*buf, dummy, end);
 	}
 	bool Serialize(protocache::Buffer& buf, protocache::Unit& unit, const uint32_t* end) const {
-		auto clean_head = __view__.CleanHead();
+		auto clean_head = CleanHead();
 		if (clean_head != nullptr) {
 			return protocache::Copy(Detect(clean_head, end), buf, unit);
 		}
@@ -109,13 +157,28 @@ struct Int64Value final {
 		if (!__view__.SerializeField(_::value, end, _value, buf, parts[_::value])) return false;
 		return protocache::SerializeMessage(parts, buf, last, unit);
 	}
+	size_t SerializedSize(const uint32_t* end=nullptr) const {
+		protocache::Unit unit;
+		return Measure(unit, end) ? unit.size() : 0;
+	}
+	bool Measure(protocache::Unit& unit, const uint32_t* end) const {
+		auto clean_head = CleanHead();
+		if (clean_head != nullptr) {
+			return protocache::MeasureCopy(Detect(clean_head, end), unit);
+		}
+		std::array<protocache::Unit,1> parts;
+		if (!__view__.MeasureField(_::value, end, _value, parts[_::value])) return false;
+		return protocache::MeasureMessage(parts, unit);
+	}
 
 	int64_t& value(const uint32_t* end=nullptr) { return __view__.GetField(_::value, end, _value); }
 
+	int64_t value(const uint32_t* end=nullptr) const { return __view__.ReadField(_::value, end, _value); }
+
 private:
 	using _ = ::google::protobuf::Int64Value::_;
 	protocache::MessageEX<1> __view__;
-	int64_t _value;
+	int64_t _value{};
 };
 
 struct UInt64Value final {
@@ -128,12 +191,18 @@ struct UInt64Value final {
 	bool HasField(unsigned id, const uint32_t* end=nullptr) const noexcept {
 		return __view__.HasField(id, end);
 	}
+	// original data which can be copied as it is, or nullptr
+	const uint32_t* CleanHead() const noexcept {
+		auto clean_head = __view__.CleanHead();
+		if (clean_head == nullptr) return nullptr;
+		return clean_head;
+	}
 	bool Serialize(protocache::Buffer* buf, const uint32_t* end=nullptr) const {
 		protocache::Unit dummy;
 		return Serialize(*buf, dummy, end);
 	}
 	bool Serialize(protocache::Buffer& buf, protocache::Unit& unit, const uint32_t* end) const {
-		auto clean_head = __view__.CleanHead();
+		auto clean_head = CleanHead();
 		if (clean_head != nullptr) {
 			return protocache::Copy(Detect(clean_head, end), buf, unit);
 		}
@@ -142,13 +211,28 @@ struct UInt64Value final {
 		if (!__view__.SerializeField(_::value, end, _value, buf, parts[_::value])) return false;
 		return protocache::SerializeMessage(parts, buf, last, unit);
 	}
+	size_t SerializedSize(const uint32_t* end=nullptr) const {
+		protocache::Unit unit;
+		return Measure(unit, end) ? unit.size() : 0;
+	}
+	bool Measure(protocache::Unit& unit, const uint32_t* end) const {
+		auto clean_head = CleanHead();
+		if (clean_head != nullptr) {
+			return protocache::MeasureCopy(Detect(clean_head, end), unit);
+		}
+		std::array<protocache::Unit,1> parts;
+		if (!__view__.MeasureField(_::value, end, _value, parts[_::value])) return false;
+		return protocache::MeasureMessage(parts, unit);
+	}
 
 	uint64_t& value(const uint32_t* end=nullptr) { return __view__.GetField(_::value, end, _value); }
 
+	uint64_t value(const uint32_t* end=nullptr) const { return __view__.ReadField(_::value, end, _value); }
+
 private:
 	using _ = ::google::protobuf::UInt64Value::_;
 	protocache::MessageEX<1> __view__;
-	uint64_t _value;
+	uint64_t _value{};
 };
 
 struct Int32Value final {
@@ -161,12 +245,18 @@ struct Int32Value final {
 	bool HasField(unsigned id, const uint32_t* end=nullptr) const noexcept {
 		return __view__.HasField(id, end);
 	}
+	// original data which can be copied as it is, or nullptr
+	const uint32_t* CleanHead() const noexcept {
+		auto clean_head = __view__.CleanHead();
+		if (clean_head == nullptr) return nullptr;
+		return clean_head;
+	}
 	bool Serialize(protocache::Buffer* buf, const uint32_t* end=nullptr) const {
 		protocache::Unit dummy;
 		return Serialize(*buf, dummy, end);
 	}
 	bool Serialize(protocache::Buffer& buf, protocache::Unit& unit, const uint32_t* end) const {
-		auto clean_head = __view__.CleanHead();
+		auto clean_head = CleanHead();
 		if (clean_head != nullptr) {
 			return protocache::Copy(Detect(clean_head, end), buf, unit);
 		}
@@ -175,13 +265,28 @@ struct Int32Value final {
 		if (!__view__.SerializeField(_::value, end, _value, buf, parts[_::value])) return false;
 		return protocache::SerializeMessage(parts, buf, last, unit);
 	}
+	size_t SerializedSize(const uint32_t* end=nullptr) const {
+		protocache::Unit unit;
+		return Measure(unit, end) ? unit.size() : 0;
+	}
+	bool Measure(protocache::Unit& unit, const uint32_t* end) const {
+		auto clean_head = CleanHead();
+		if (clean_head != nullptr) {
+			return protocache::MeasureCopy(Detect(clean_head, end), unit);
+		}
+		std::array<protocache::Unit,1> parts;
+		if (!__view__.MeasureField(_::value, end, _value, parts[_::value])) return false;
+		return protocache::MeasureMessage(parts, unit);
+	}
 
 	int32_t& value(const uint32_t* end=nullptr) { return __view__.GetField(_::value, end, _value); }
 
+	int32_t value(const uint32_t* end=nullptr) const { return __view__.ReadField(_::value, end, _value); }
+
 private:
 	using _ = ::google::protobuf::Int32Value::_;
 	protocache::MessageEX<1> __view__;
-	int32_t _value;
+	int32_t _value{};
 };
 
 struct UInt32Value final {
@@ -194,12 +299,18 @@ struct UInt32Value final {
 	bool HasField(unsigned id, const uint32_t* end=nullptr) const noexcept {
 		return __view__.HasField(id, end);
 	}
+	// original data which can be copied as it is, or nullptr
+	const uint32_t* CleanHead() const noexcept {
+		auto clean_head = __view__.CleanHead();
+		if (clean_head == nullptr) return nullptr;
+		return clean_head;
+	}
 	bool Serialize(protocache::Buffer* buf, const uint32_t* end=nullptr) const {
 		protocache::Unit dummy;
 		return Serialize(*buf, dummy, end);
 	}
 	bool Serialize(protocache::Buffer& buf, protocache::Unit& unit, const uint32_t* end) const {
-		auto clean_head = __view__.CleanHead();
+		auto clean_head = CleanHead();
 		if (clean_head != nullptr) {
 			return protocache::Copy(Detect(clean_head, end), buf, unit);
 		}
@@ -208,13 +319,28 @@ struct UInt32Value final {
 		if (!__view__.SerializeField(_::value, end, _value, buf, parts[_::value])) return false;
 		return protocache::SerializeMessage(parts, buf, last, unit);
 	}
+	size_t SerializedSize(const uint32_t* end=nullptr) const {
+		protocache::Unit unit;
+		return Measure(unit, end) ? unit.size() : 0;
+	}
+	bool Measure(protocache::Unit& unit, const uint32_t* end) const {
+		auto clean_head = CleanHead();
+		if (clean_head != nullptr) {
+			return protocache::MeasureCopy(Detect(clean_head, end), unit);
+		}
+		std::array<protocache::Unit,1> parts;
+		if (!__view__.MeasureField(_::value, end, _value, parts[_::value])) return false;
+		return protocache::MeasureMessage(parts, unit);
+	}
 
 	uint32_t& value(const uint32_t* end=nullptr) { return __view__.GetField(_::value, end, _value); }
 
+	uint32_t value(const uint32_t* end=nullptr) const { return __view__.ReadField(_::value, end, _value); }
+
 private:
 	using _ = ::google::protobuf::UInt32Value::_;
 	protocache::MessageEX<1> __view__;
-	uint32_t _value;
+	uint32_t _value{};
 };
 
 struct BoolValue final {
@@ -227,12 +353,18 @@ struct BoolValue final {
 	bool HasField(unsigned id, const uint32_t* end=nullptr) const noexcept {
 		return __view__.HasField(id, end);
 	}
+	// original data which can be copied as it is, or nullptr
+	const uint32_t* CleanHead() const noexcept {
+		auto clean_head = __view__.CleanHead();
+		if (clean_head == nullptr) return nullptr;
+		return clean_head;
+	}
 	bool Serialize(protocache::Buffer* buf, const uint32_t* end=nullptr) const {
 		protocache::Unit dummy;
 		return Serialize(*buf, dummy, end);
 	}
 	bool Serialize(protocache::Buffer& buf, protocache::Unit& unit, const uint32_t* end) const {
-		auto clean_head = __view__.CleanHead();
+		auto clean_head = CleanHead();
 		if (clean_head != nullptr) {
 			return protocache::Copy(Detect(clean_head, end), buf, unit);
 		}
@@ -241,13 +373,28 @@ struct BoolValue final {
 		if (!__view__.SerializeField(_::value, end, _value, buf, parts[_::value])) return false;
 		return protocache::SerializeMessage(parts, buf, last, unit);
 	}
+	size_t SerializedSize(const uint32_t* end=nullptr) const {
+		protocache::Unit unit;
+		return Measure(unit, end) ? unit.size() : 0;
+	}
+	bool Measure(protocache::Unit& unit, const uint32_t* end) const {
+		auto clean_head = CleanHead();
+		if (clean_head != nullptr) {
+			return protocache::MeasureCopy(Detect(clean_head, end), unit);
+		}
+		std::array<protocache::Unit,1> parts;
+		if (!__view__.MeasureField(_::value, end, _value, parts[_::value])) return false;
+		return protocache::MeasureMessage(parts, unit);
+	}
 
 	bool& value(const uint32_t* end=nullptr) { return __view__.GetField(_::value, end, _value); }
 
+	bool value(const uint32_t* end=nullptr) const { return __view__.ReadField(_::value, end, _value); }
+
 private:
 	using _ = ::google::protobuf::BoolValue::_;
 	protocache::MessageEX<1> __view__;
-	bool _value;
+	bool _value{};
 };
 
 struct StringValue final {
@@ -260,12 +407,18 @@ struct StringValue final {
 	bool HasField(unsigned id, const uint32_t* end=nullptr) const noexcept {
 		return __view__.HasField(id, end);
 	}
+	// original data which can be copied as it is, or nullptr
+	const uint32_t* CleanHead() const noexcept {
+		auto clean_head = __view__.CleanHead();
+		if (clean_head == nullptr) return nullptr;
+		return clean_head;
+	}
 	bool Serialize(protocache::Buffer* buf, const uint32_t* end=nullptr) const {
 		protocache::Unit dummy;
 		return Serialize(*buf, dummy, end);
 	}
 	bool Serialize(protocache::Buffer& buf, protocache::Unit& unit, const uint32_t* end) const {
-		auto clean_head = __view__.CleanHead();
+		auto clean_head = CleanHead();
 		if (clean_head != nullptr) {
 			return protocache::Copy(Detect(clean_head, end), buf, unit);
 		}
@@ -274,9 +427,24 @@ struct StringValue final {
 		if (!__view__.SerializeField(_::value, end, _value, buf, parts[_::value])) return false;
 		return protocache::SerializeMessage(parts, buf, last, unit);
 	}
+	size_t SerializedSize(const uint32_t* end=nullptr) const {
+		protocache::Unit unit;
+		return Measure(unit, end) ? unit.size() : 0;
+	}
+	bool Measure(protocache::Unit& unit, const uint32_t* end) const {
+		auto clean_head = CleanHead();
+		if (clean_head != nullptr) {
+			return protocache::MeasureCopy(Detect(clean_head, end), unit);
+		}
+		std::array<protocache::Unit,1> parts;
+		if (!__view__.MeasureField(_::value, end, _value, parts[_::value])) return false;
+		return protocache::MeasureMessage(parts, unit);
+	}
 
 	std::string& value(const uint32_t* end=nullptr) { return __view__.GetField(_::value, end, _value); }
 
+	protocache::Slice<char> value(const uint32_t* end=nullptr) const { return __view__.ReadField(_::value, end, _value); }
+
 private:
 	using _ = ::google::protobuf::StringValue::_;
 	protocache::MessageEX<1> __view__;
@@ -293,12 +461,18 @@ struct BytesValue final {
 	bool HasField(unsigned id, const uint32_t* end=nullptr) const noexcept {
 		return __view__.HasField(id, end);
 	}
+	// original data which can be copied as it is, or nullptr
+	const uint32_t* CleanHead() const noexcept {
+		auto clean_head = __view__.CleanHead();
+		if (clean_head == nullptr) return nullptr;
+		return clean_head;
+	}
 	bool Serialize(protocache::Buffer* buf, const uint32_t* end=nullptr) const {
 		protocache::Unit dummy;
 		return Serialize(*buf, dummy, end);
 	}
 	bool Serialize(protocache::Buffer& buf, protocache::Unit& unit, const uint32_t* end) const {
-		auto clean_head = __view__.CleanHead();
+		auto clean_head = CleanHead();
 		if (clean_head != nullptr) {
 			return protocache::Copy(Detect(clean_head, end), buf, unit);
 		}
@@ -307,9 +481,24 @@ struct BytesValue final {
 		if (!__view__.SerializeField(_::value, end, _value, buf, parts[_::value])) return false;
 		return protocache::SerializeMessage(parts, buf, last, unit);
 	}
+	size_t SerializedSize(const uint32_t* end=nullptr) const {
+		protocache::Unit unit;
+		return Measure(unit, end) ? unit.size() : 0;
+	}
+	bool Measure(protocache::Unit& unit, const uint32_t* end) const {
+		auto clean_head = CleanHead();
+		if (clean_head != nullptr) {
+			return protocache::MeasureCopy(Detect(clean_head, end), unit);
+		}
+		std::array<protocache::Unit,1> parts;
+		if (!__view__.MeasureField(_::value, end, _value, parts[_::value])) return false;
+		return protocache::MeasureMessage(parts, unit);
+	}
 
 	std::string& value(const uint32_t* end=nullptr) { return __view__.GetField(_::value, end, _value); }
 
+	protocache::Slice<uint8_t> value(const uint32_t* end=nullptr) const { return protocache::SliceCast<uint8_t>(__view__.ReadField(_::value, end, _value)); }
+
 private:
 	using _ = ::google::protobuf::BytesValue::_;
 	protocache::MessageEX<1> __view__;
@@ -0,0 +1,317 @@
+#pragma once
+#ifndef PROTOCACHE_INCLUDED_PB_google_protobuf_wrappers_proto
+#define PROTOCACHE_INCLUDED_PB_google_protobuf_wrappers_proto
+
+#include <protocache/builder.h>
+#include <protocache/extension/utils.h>
+#include "google/protobuf/wrappers.pb.h"
+
+namespace google {
+namespace protobuf {
+
+inline bool FromProtobuf(const ::google::protobuf::DoubleValue& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool FromProtobuf(const ::google::protobuf::FloatValue& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool FromProtobuf(const ::google::protobuf::Int64Value& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool FromProtobuf(const ::google::protobuf::UInt64Value& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool FromProtobuf(const ::google::protobuf::Int32Value& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool FromProtobuf(const ::google::protobuf::UInt32Value& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool FromProtobuf(const ::google::protobuf::BoolValue& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool FromProtobuf(const ::google::protobuf::StringValue& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool FromProtobuf(const ::google::protobuf::BytesValue& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::DoubleValue* out);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::FloatValue* out);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::Int64Value* out);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::UInt64Value* out);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::Int32Value* out);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::UInt32Value* out);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::BoolValue* out);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::StringValue* out);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::BytesValue* out);
+
+inline bool FromProtobuf(const ::google::protobuf::DoubleValue& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	std::array<protocache::Unit,1> parts;
+	auto last = buf.Size();
+	if (!protocache::IsZero(message.value())) {
+		protocache::Serialize(message.value(), buf, parts[0]);
+	}
+	return protocache::SerializeMessage(parts, buf, last, unit);
+}
+
+inline bool FromProtobuf(const ::google::protobuf::DoubleValue& message, protocache::Buffer& buf) {
+	protocache::Unit dummy;
+	return FromProtobuf(message, buf, dummy);
+}
+
+inline bool FromProtobuf(const ::google::protobuf::FloatValue& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	std::array<protocache::Unit,1> parts;
+	auto last = buf.Size();
+	if (!protocache::IsZero(message.value())) {
+		protocache::Serialize(message.value(), buf, parts[0]);
+	}
+	return protocache::SerializeMessage(parts, buf, last, unit);
+}
+
+inline bool FromProtobuf(const ::google::protobuf::FloatValue& message, protocache::Buffer& buf) {
+	protocache::Unit dummy;
+	return FromProtobuf(message, buf, dummy);
+}
+
+inline bool FromProtobuf(const ::google::protobuf::Int64Value& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	std::array<protocache::Unit,1> parts;
+	auto last = buf.Size();
+	if (message.value() != 0) {
+		protocache::Serialize(message.value(), buf, parts[0]);
+	}
+	return protocache::SerializeMessage(parts, buf, last, unit);
+}
+
+inline bool FromProtobuf(const ::google::protobuf::Int64Value& message, protocache::Buffer& buf) {
+	protocache::Unit dummy;
+	return FromProtobuf(message, buf, dummy);
+}
+
+inline bool FromProtobuf(const ::google::protobuf::UInt64Value& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	std::array<protocache::Unit,1> parts;
+	auto last = buf.Size();
+	if (message.value() != 0) {
+		protocache::Serialize(message.value(), buf, parts[0]);
+	}
+	return protocache::SerializeMessage(parts, buf, last, unit);
+}
+
+inline bool FromProtobuf(const ::google::protobuf::UInt64Value& message, protocache::Buffer& buf) {
+	protocache::Unit dummy;
+	return FromProtobuf(message, buf, dummy);
+}
+
+inline bool FromProtobuf(const ::google::protobuf::Int32Value& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	std::array<protocache::Unit,1> parts;
+	auto last = buf.Size();
+	if (message.value() != 0) {
+		protocache::Serialize(message.value(), buf, parts[0]);
+	}
+	return protocache::SerializeMessage(parts, buf, last, unit);
+}
+
+inline bool FromProtobuf(const ::google::protobuf::Int32Value& message, protocache::Buffer& buf) {
+	protocache::Unit dummy;
+	return FromProtobuf(message, buf, dummy);
+}
+
+inline bool FromProtobuf(const ::google::protobuf::UInt32Value& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	std::array<protocache::Unit,1> parts;
+	auto last = buf.Size();
+	if (message.value() != 0) {
+		protocache::Serialize(message.value(), buf, parts[0]);
+	}
+	return protocache::SerializeMessage(parts, buf, last, unit);
+}
+
+inline bool FromProtobuf(const ::google::protobuf::UInt32Value& message, protocache::Buffer& buf) {
+	protocache::Unit dummy;
+	return FromProtobuf(message, buf, dummy);
+}
+
+inline bool FromProtobuf(const ::google::protobuf::BoolValue& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	std::array<protocache::Unit,1> parts;
+	auto last = buf.Size();
+	if (message.value()) {
+		protocache::Serialize(message.value(), buf, parts[0]);
+	}
+	return protocache::SerializeMessage(parts, buf, last, unit);
+}
+
+inline bool FromProtobuf(const ::google::protobuf::BoolValue& message, protocache::Buffer& buf) {
+	protocache::Unit dummy;
+	return FromProtobuf(message, buf, dummy);
+}
+
+inline bool FromProtobuf(const ::google::protobuf::StringValue& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	std::array<protocache::Unit,1> parts;
+	auto last = buf.Size();
+	if (!message.value().empty()) {
+		if (!protocache::Serialize(message.value(), buf, parts[0])) {
+			return false;
+		}
+		protocache::FoldField(buf, parts[0]);
+	}
+	return protocache::SerializeMessage(parts, buf, last, unit);
+}
+
+inline bool FromProtobuf(const ::google::protobuf::StringValue& message, protocache::Buffer& buf) {
+	protocache::Unit dummy;
+	return FromProtobuf(message, buf, dummy);
+}
+
+inline bool FromProtobuf(const ::google::protobuf::BytesValue& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	std::array<protocache::Unit,1> parts;
+	auto last = buf.Size();
+	if (!message.value().empty()) {
+		if (!protocache::Serialize(message.value(), buf, parts[0])) {
+			return false;
+		}
+		protocache::FoldField(buf, parts[0]);
+	}
+	return protocache::SerializeMessage(parts, buf, last, unit);
+}
+
+inline bool FromProtobuf(const ::google::protobuf::BytesValue& message, protocache::Buffer& buf) {
+	protocache::Unit dummy;
+	return FromProtobuf(message, buf, dummy);
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::DoubleValue* out) {
+	protocache::Message message(data, end);
+	if (!message) {
+		return false;
+	}
+	if (auto field = message.GetField(0, end); !!field) {
+		out->set_value(protocache::FieldT<double>(field).Get(end));
+	}
+	return true;
+}
+
+inline bool ToProtobuf(const protocache::Slice<uint32_t>& data, ::google::protobuf::DoubleValue* out) {
+	out->Clear();
+	return ToProtobuf(data.data(), data.end(), out);
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::FloatValue* out) {
+	protocache::Message message(data, end);
+	if (!message) {
+		return false;
+	}
+	if (auto field = message.GetField(0, end); !!field) {
+		out->set_value(protocache::FieldT<float>(field).Get(end));
+	}
+	return true;
+}
+
+inline bool ToProtobuf(const protocache::Slice<uint32_t>& data, ::google::protobuf::FloatValue* out) {
+	out->Clear();
+	return ToProtobuf(data.data(), data.end(), out);
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::Int64Value* out) {
+	protocache::Message message(data, end);
+	if (!message) {
+		return false;
+	}
+	if (auto field = message.GetField(0, end); !!field) {
+		out->set_value(protocache::FieldT<int64_t>(field).Get(end));
+	}
+	return true;
+}
+
+inline bool ToProtobuf(const protocache::Slice<uint32_t>& data, ::google::protobuf::Int64Value* out) {
+	out->Clear();
+	return ToProtobuf(data.data(), data.end(), out);
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::UInt64Value* out) {
+	protocache::Message message(data, end);
+	if (!message) {
+		return false;
+	}
+	if (auto field = message.GetField(0, end); !!field) {
+		out->set_value(protocache::FieldT<uint64_t>(field).Get(end));
+	}
+	return true;
+}
+
+inline bool ToProtobuf(const protocache::Slice<uint32_t>& data, ::google::protobuf::UInt64Value* out) {
+	out->Clear();
+	return ToProtobuf(data.data(), data.end(), out);
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::Int32Value* out) {
+	protocache::Message message(data, end);
+	if (!message) {
+		return false;
+	}
+	if (auto field = message.GetField(0, end); !!field) {
+		out->set_value(protocache::FieldT<int32_t>(field).Get(end));
+	}
+	return true;
+}
+
+inline bool ToProtobuf(const protocache::Slice<uint32_t>& data, ::google::protobuf::Int32Value* out) {
+	out->Clear();
+	return ToProtobuf(data.data(), data.end(), out);
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::UInt32Value* out) {
+	protocache::Message message(data, end);
+	if (!message) {
+		return false;
+	}
+	if (auto field = message.GetField(0, end); !!field) {
+		out->set_value(protocache::FieldT<uint32_t>(field).Get(end));
+	}
+	return true;
+}
+
+inline bool ToProtobuf(const protocache::Slice<uint32_t>& data, ::google::protobuf::UInt32Value* out) {
+	out->Clear();
+	return ToProtobuf(data.data(), data.end(), out);
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::BoolValue* out) {
+	protocache::Message message(data, end);
+	if (!message) {
+		return false;
+	}
+	if (auto field = message.GetField(0, end); !!field) {
+		out->set_value(protocache::FieldT<bool>(field).Get(end));
+	}
+	return true;
+}
+
+inline bool ToProtobuf(const protocache::Slice<uint32_t>& data, ::google::protobuf::BoolValue* out) {
+	out->Clear();
+	return ToProtobuf(data.data(), data.end(), out);
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::StringValue* out) {
+	protocache::Message message(data, end);
+	if (!message) {
+		return false;
+	}
+	if (auto field = message.GetField(0, end); !!field) {
+		auto v = protocache::FieldT<protocache::Slice<char>>(field).Get(end);
+		if (!v) {
+			return false;
+		}
+		out->mutable_value()->assign(v.data(), v.size());
+	}
+	return true;
+}
+
+inline bool ToProtobuf(const protocache::Slice<uint32_t>& data, ::google::protobuf::StringValue* out) {
+	out->Clear();
+	return ToProtobuf(data.data(), data.end(), out);
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::google::protobuf::BytesValue* out) {
+	protocache::Message message(data, end);
+	if (!message) {
+		return false;
+	}
+	if (auto field = message.GetField(0, end); !!field) {
+		auto v = protocache::FieldT<protocache::Slice<char>>(field).Get(end);
+		if (!v) {
+			return false;
+		}
+		out->mutable_value()->assign(v.data(), v.size());
+	}
+	return true;
+}
+
+inline bool ToProtobuf(const protocache::Slice<uint32_t>& data, ::google::protobuf::BytesValue* out) {
+	out->Clear();
+	return ToProtobuf(data.data(), data.end(), out);
+}
+
+} // protobuf
+} // google
+#endif // PROTOCACHE_INCLUDED_PB_google_protobuf_wrappers_proto
@@ -3,6 +3,7 @@
 #define PROTOCACHE_INCLUDED_wrappers_proto
 
 #include <protocache/access.h>
+#include <protocache/builder.h>
 
 namespace google {
 namespace protobuf {
@@ -36,9 +37,37 @@ public:
 		return view;
 	}
 
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0,
+			protocache::VerifyMarks* marks=nullptr) {
+		if (depth >= protocache::kVerifyDepthLimit || !protocache::Message::Verify(ptr, end)) return false;
+		protocache::Message core(ptr, end);
+		if (!protocache::VerifyField<double>(core, _::value, end, depth+1, marks)) return false;
+		return true;
+	}
+
+	static bool Project(const uint32_t* ptr, const uint32_t* end, const protocache::FieldTree& tree, unsigned node,
+			protocache::Buffer& buf, protocache::Unit& unit) {
+		protocache::Message core(ptr, end);
+		if (!core) return false;
+		return protocache::ProjectMessage(core, end, tree, node, buf, unit,
+				[&core, end, &buf](unsigned id, unsigned, protocache::Unit& one) {
+			switch (id) {
+				case _::value:
+					return protocache::CopyField<double>(core, id, end, buf, one);
+				default:
+					return false;
+			}
+		});
+	}
+
 	double value(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<double>(protocache::Message::Cast(this), _::value, end);
 	}
+	bool set_value_inplace(double val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::value, val, end);
+	}
+
+	class Builder;
 };
 
 class FloatValue final {
@@ -60,9 +89,37 @@ public:
 		return view;
 	}
 
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0,
+			protocache::VerifyMarks* marks=nullptr) {
+		if (depth >= protocache::kVerifyDepthLimit || !protocache::Message::Verify(ptr, end)) return false;
+		protocache::Message core(ptr, end);
+		if (!protocache::VerifyField<float>(core, _::value, end, depth+1, marks)) return false;
+		return true;
+	}
+
+	static bool Project(const uint32_t* ptr, const uint32_t* end, const protocache::FieldTree& tree, unsigned node,
+			protocache::Buffer& buf, protocache::Unit& unit) {
+		protocache::Message core(ptr, end);
+		if (!core) return false;
+		return protocache::ProjectMessage(core, end, tree, node, buf, unit,
+				[&core, end, &buf](unsigned id, unsigned, protocache::Unit& one) {
+			switch (id) {
+				case _::value:
+					return protocache::CopyField<float>(core, id, end, buf, one);
+				default:
+					return false;
+			}
+		});
+	}
+
 	float value(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<float>(protocache::Message::Cast(this), _::value, end);
 	}
+	bool set_value_inplace(float val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::value, val, end);
+	}
+
+	class Builder;
 };
 
 class Int64Value final {
@@ -84,9 +141,37 @@ public:
 		return view;
 	}
 
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0,
+			protocache::VerifyMarks* marks=nullptr) {
+		if (depth >= protocache::kVerifyDepthLimit || !protocache::Message::Verify(ptr, end)) return false;
+		protocache::Message core(ptr, end);
+		if (!protocache::VerifyField<int64_t>(core, _::value, end, depth+1, marks)) return false;
+		return true;
+	}
+
+	static bool Project(const uint32_t* ptr, const uint32_t* end, const protocache::FieldTree& tree, unsigned node,
+			protocache::Buffer& buf, protocache::Unit& unit) {
+		protocache::Message core(ptr, end);
+		if (!core) return false;
+		return protocache::ProjectMessage(core, end, tree, node, buf, unit,
+				[&core, end, &buf](unsigned id, unsigned, protocache::Unit& one) {
+			switch (id) {
+				case _::value:
+					return protocache::CopyField<int64_t>(core, id, end, buf, one);
+				default:
+					return false;
+			}
+		});
+	}
+
 	int64_t value(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<int64_t>(protocache::Message::Cast(this), _::value, end);
 	}
+	bool set_value_inplace(int64_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::value, val, end);
+	}
+
+	class Builder;
 };
 
 class UInt64Value final {
@@ -108,9 +193,37 @@ public:
 		return view;
 	}
 
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0,
+			protocache::VerifyMarks* marks=nullptr) {
+		if (depth >= protocache::kVerifyDepthLimit || !protocache::Message::Verify(ptr, end)) return false;
+		protocache::Message core(ptr, end);
+		if (!protocache::VerifyField<uint64_t>(core, _::value, end, depth+1, marks)) return false;
+		return true;
+	}
+
+	static bool Project(const uint32_t* ptr, const uint32_t* end, const protocache::FieldTree& tree, unsigned node,
+			protocache::Buffer& buf, protocache::Unit& unit) {
+		protocache::Message core(ptr, end);
+		if (!core) return false;
+		return protocache::ProjectMessage(core, end, tree, node, buf, unit,
+				[&core, end, &buf](unsigned id, unsigned, protocache::Unit& one) {
+			switch (id) {
+				case _::value:
+					return protocache::CopyField<uint64_t>(core, id, end, buf, one);
+				default:
+					return false;
+			}
+		});
+	}
+
 	uint64_t value(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<uint64_t>(protocache::Message::Cast(this), _::value, end);
 	}
+	bool set_value_inplace(uint64_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::value, val, end);
+	}
+
+	class Builder;
 };
 
 class Int32Value final {
@@ -132,9 +245,37 @@ public:
 		return view;
 	}
 
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0,
+			protocache::VerifyMarks* marks=nullptr) {
+		if (depth >= protocache::kVerifyDepthLimit || !protocache::Message::Verify(ptr, end)) return false;
+		protocache::Message core(ptr, end);
+		if (!protocache::VerifyField<int32_t>(core, _::value, end, depth+1, marks)) return false;
+		return true;
+	}
+
+	static bool Project(const uint32_t* ptr, const uint32_t* end, const protocache::FieldTree& tree, unsigned node,
+			protocache::Buffer& buf, protocache::Unit& unit) {
+		protocache::Message core(ptr, end);
+		if (!core) return false;
+		return protocache::ProjectMessage(core, end, tree, node, buf, unit,
+				[&core, end, &buf](unsigned id, unsigned, protocache::Unit& one) {
+			switch (id) {
+				case _::value:
+					return protocache::CopyField<int32_t>(core, id, end, buf, one);
+				default:
+					return false;
+			}
+		});
+	}
+
 	int32_t value(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<int32_t>(protocache::Message::Cast(this), _::value, end);
 	}
+	bool set_value_inplace(int32_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::value, val, end);
+	}
+
+	class Builder;
 };
 
 class UInt32Value final {
@@ -156,9 +297,37 @@ public:
 		return view;
 	}
 
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0,
+			protocache::VerifyMarks* marks=nullptr) {
+		if (depth >= protocache::kVerifyDepthLimit || !protocache::Message::Verify(ptr, end)) return false;
+		protocache::Message core(ptr, end);
+		if (!protocache::VerifyField<uint32_t>(core, _::value, end, depth+1, marks)) return false;
+		return true;
+	}
+
+	static bool Project(const uint32_t* ptr, const uint32_t* end, const protocache::FieldTree& tree, unsigned node,
+			protocache::Buffer& buf, protocache::Unit& unit) {
+		protocache::Message core(ptr, end);
+		if (!core) return false;
+		return protocache::ProjectMessage(core, end, tree, node, buf, unit,
+				[&core, end, &buf](unsigned id, unsigned, protocache::Unit& one) {
+			switch (id) {
+				case _::value:
+					return protocache::CopyField<uint32_t>(core, id, end, buf, one);
+				default:
+					return false;
+			}
+		});
+	}
+
 	uint32_t value(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<uint32_t>(protocache::Message::Cast(this), _::value, end);
 	}
+	bool set_value_inplace(uint32_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::value, val, end);
+	}
+
+	class Builder;
 };
 
 class BoolValue final {
@@ -180,9 +349,37 @@ public:
 		return view;
 	}
 
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0,
+			protocache::VerifyMarks* marks=nullptr) {
+		if (depth >= protocache::kVerifyDepthLimit || !protocache::Message::Verify(ptr, end)) return false;
+		protocache::Message core(ptr, end);
+		if (!protocache::VerifyField<bool>(core, _::value, end, depth+1, marks)) return false;
+		return true;
+	}
+
+	static bool Project(const uint32_t* ptr, const uint32_t* end, const protocache::FieldTree& tree, unsigned node,
+			protocache::Buffer& buf, protocache::Unit& unit) {
+		protocache::Message core(ptr, end);
+		if (!core) return false;
+		return protocache::ProjectMessage(core, end, tree, node, buf, unit,
+				[&core, end, &buf](unsigned id, unsigned, protocache::Unit& one) {
+			switch (id) {
+				case _::value:
+					return protocache::CopyField<bool>(core, id, end, buf, one);
+				default:
+					return false;
+			}
+		});
+	}
+
 	bool value(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<bool>(protocache::Message::Cast(this), _::value, end);
 	}
+	bool set_value_inplace(bool val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::value, val, end);
+	}
+
+	class Builder;
 };
 
 class StringValue final {
@@ -206,9 +403,34 @@ public:
 		return view;
 	}
 
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0,
+			protocache::VerifyMarks* marks=nullptr) {
+		if (depth >= protocache::kVerifyDepthLimit || !protocache::Message::Verify(ptr, end)) return false;
+		protocache::Message core(ptr, end);
+		if (!protocache::VerifyField<protocache::Slice<char>>(core, _::value, end, depth+1, marks)) return false;
+		return true;
+	}
+
+	static bool Project(const uint32_t* ptr, const uint32_t* end, const protocache::FieldTree& tree, unsigned node,
+			protocache::Buffer& buf, protocache::Unit& unit) {
+		protocache::Message core(ptr, end);
+		if (!core) return false;
+		return protocache::ProjectMessage(core, end, tree, node, buf, unit,
+				[&core, end, &buf](unsigned id, unsigned, protocache::Unit& one) {
+			switch (id) {
+				case _::value:
+					return protocache::CopyField<protocache::Slice<char>>(core, id, end, buf, one);
+				default:
+					return false;
+			}
+		});
+	}
+
 	protocache::Slice<char> value(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<protocache::Slice<char>>(protocache::Message::Cast(this), _::value, end);
 	}
+
+	class Builder;
 };
 
 class BytesValue final {
@@ -232,9 +454,90 @@ public:
 		return view;
 	}
 
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0,
+			protocache::VerifyMarks* marks=nullptr) {
+		if (depth >= protocache::kVerifyDepthLimit || !protocache::Message::Verify(ptr, end)) return false;
+		protocache::Message core(ptr, end);
+		if (!protocache::VerifyField<protocache::Slice<uint8_t>>(core, _::value, end, depth+1, marks)) return false;
+		return true;
+	}
+
+	static bool Project(const uint32_t* ptr, const uint32_t* end, const protocache::FieldTree& tree, unsigned node,
+			protocache::Buffer& buf, protocache::Unit& unit) {
+		protocache::Message core(ptr, end);
+		if (!core) return false;
+		return protocache::ProjectMessage(core, end, tree, node, buf, unit,
+				[&core, end, &buf](unsigned id, unsigned, protocache::Unit& one) {
+			switch (id) {
+				case _::value:
+					return protocache::CopyField<protocache::Slice<uint8_t>>(core, id, end, buf, one);
+				default:
+					return false;
+			}
+		});
+	}
+
 	protocache::Slice<uint8_t> value(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<protocache::Slice<uint8_t>>(protocache::Message::Cast(this), _::value, end);
 	}
+
+	class Builder;
+};
+
+class DoubleValue::Builder final : public protocache::MessageBuilder<1> {
+public:
+	using MessageBuilder::MessageBuilder;
+	void value(double v) { SetScalar(_::value, v); }
+};
+
+class FloatValue::Builder final : public protocache::MessageBuilder<1> {
+public:
+	using MessageBuilder::MessageBuilder;
+	void value(float v) { SetScalar(_::value, v); }
+};
+
+class Int64Value::Builder final : public protocache::MessageBuilder<1> {
+public:
+	using MessageBuilder::MessageBuilder;
+	void value(int64_t v) { SetScalar(_::value, v); }
+};
+
+class UInt64Value::Builder final : public protocache::MessageBuilder<1> {
+public:
+	using MessageBuilder::MessageBuilder;
+	void value(uint64_t v) { SetScalar(_::value, v); }
+};
+
+class Int32Value::Builder final : public protocache::MessageBuilder<1> {
+public:
+	using MessageBuilder::MessageBuilder;
+	void value(int32_t v) { SetScalar(_::value, v); }
+};
+
+class UInt32Value::Builder final : public protocache::MessageBuilder<1> {
+public:
+	using MessageBuilder::MessageBuilder;
+	void value(uint32_t v) { SetScalar(_::value, v); }
+};
+
+class BoolValue::Builder final : public protocache::MessageBuilder<1> {
+public:
+	using MessageBuilder::MessageBuilder;
+	void value(bool v) { SetScalar(_::value, v); }
+};
+
+class StringValue::Builder final : public protocache::MessageBuilder<1> {
+public:
+	using MessageBuilder::MessageBuilder;
+	template <typename S>
+	void value(const S& v) { SetString(_::value, protocache::StringOf(v)); }
+};
+
+class BytesValue::Builder final : public protocache::MessageBuilder<1> {
+public:
+	using MessageBuilder::MessageBuilder;
+	template <typename S>
+	void value(const S& v) { SetString(_::value, protocache::StringOf(v)); }
 };
 
 } // protobuf
@@ -13,6 +13,9 @@
 #include <array>
 #include <utility>
 #include <type_traits>
+#include <functional>
+#include <initializer_list>
+#include <unordered_map>
 #include "utils.h"
 #include "access.h"
 #include "perfect_hash.h"
@@ -45,11 +48,13 @@ private:
 struct Unit {
 	struct Seg {
 		uint32_t pos;
-		uint32_t len;
+		uint32_t len;	// exactly what Detect finds, when made with dedup
 		uint32_t end() const noexcept { return pos-len; }
 	};
 
-	unsigned len = 0;
+	uint16_t len = 0;
+	// refers to or contains references to deduplicated data, so it can't be moved
+	bool pinned = false;
 	union {
 		uint32_t data[3];
 		Seg seg = {0, 0};
@@ -71,7 +76,7 @@ static inline Unit Segment(size_t last, size_t now) {
 }
 
 static void FoldField(Buffer& buf, Unit& unit) {
-	if (unit.len == 0 && unit.seg.len != 0 && unit.seg.len < 4) {
+	if (unit.len == 0 && unit.seg.len != 0 && unit.seg.len < 4 && !unit.pinned) {
 		unit.len = unit.seg.len;
 		assert(unit.seg.pos == buf.Size());
 		auto src = buf.Head();
@@ -82,6 +87,113 @@ static void FoldField(Buffer& buf, Unit& unit) {
 	}
 }
 
+// Like FoldField, but for a nested message, array or map, which is dropped
+// when empty.
+static void FoldNested(Buffer& buf, Unit& unit) {
+	if (unit.size() == 1) {
+		if (unit.len == 0) {
+			buf.Shrink(1);
+		}
+		unit = {};
+		return;
+	}
+	FoldField(buf, unit);
+}
+
+// Candidate sizes of an array body for cell width 1, 2 and 3.
+struct ArraySize final {
+	size_t count = 0;
+	size_t sizes[3] = {0, 0, 0};
+
+	void Add(const Unit& one) noexcept {
+		count++;
+		sizes[0] += 1;
+		sizes[1] += 2;
+		sizes[2] += 3;
+		auto len = one.size();
+		if (len <= 1) {
+			return;
+		}
+		sizes[0] += len;
+		if (len <= 2) {
+			return;
+		}
+		sizes[1] += len;
+		if (len <= 3) {
+			return;
+		}
+		sizes[2] += len;
+	}
+
+	size_t Best(unsigned& m) const noexcept {
+		unsigned mode = 0;
+		for (unsigned i = 1; i < 3; i++) {
+			if (sizes[i] < sizes[mode]) {
+				mode = i;
+			}
+		}
+		m = mode + 1;
+		return sizes[mode];
+	}
+};
+
+// Remembers strings and objects written to a buffer, so later identical ones
+// become references to the first copy. Bind it by Buffer::SetDedup. A table
+// serves one top-level object, Clear it before serializing another one or
+// clearing the buffer.
+class DedupTable final {
+public:
+	void Clear() noexcept;
+	// bytes not written thanks to references
+	size_t SavedBytes() const noexcept {
+		return saved_ * sizeof(uint32_t);
+	}
+
+	// For data without offsets just written at buffer head. It is dropped if
+	// an identical one exists, otherwise remembered.
+	void Leaf(Buffer& buf, Unit& unit);
+
+	// Composite objects are keyed by their children, which are data for small
+	// ones and positions for others. Build a key by Begin and Append, then try
+	// Hit before writing and Remember after writing.
+	void Begin(uint32_t kind);
+	void Append(Buffer& buf, const Unit& unit);
+	void Append(const Slice<uint8_t>& bytes);
+	bool Hit(Buffer& buf, size_t last, Unit& unit);
+	void Remember(const Unit& unit, size_t own);
+
+	// Readers take the last child out of the body as the tail of an object,
+	// see Detect. A child referring to data beyond that tail breaks the rule,
+	// Detach gives it a private copy at buffer head instead.
+	bool Detach(Buffer& buf, Unit& unit);
+
+	// something was remembered after last, so data there should not move
+	bool Touched(size_t last) const noexcept {
+		return top_ > last;
+	}
+
+private:
+	struct Entry {
+		uint32_t pos;
+		uint32_t len;
+		uint32_t own;		// words of the object itself, without children
+		uint32_t key;		// offset in keys_, key_len == 0 for leaf
+		uint32_t key_len;
+	};
+	std::unordered_multimap<uint64_t, uint32_t> index_;
+	std::vector<Entry> entries_;
+	std::vector<uint32_t> keys_;
+	std::vector<uint32_t> key_;
+	uint64_t hash_ = 0;
+	size_t top_ = 0;
+	size_t saved_ = 0;
+
+	static bool Reachable(const Buffer& buf, uint32_t pos) noexcept {
+		// leave room for data written before the reference
+		return buf.Size() - pos < (1U << 29U);
+	}
+};
+
 template<typename T>
 static inline bool Serialize(T v, Buffer& buf, Unit& unit) {
 	static_assert(std::is_scalar_v<T>);
@@ -108,6 +220,36 @@ static inline bool Serialize(const std::string& str, Buffer& buf, Unit& unit) {
 	return Serialize(Slice<char>(str), buf, unit);
 }
 
+// array of 4 or 8 byte scalars, bool array is stored as bytes
+template <typename T>
+static inline bool SerializeArray(const Slice<T>& array, Buffer& buf, Unit& unit) {
+	if constexpr (std::is_same_v<T, bool>) {
+		return Serialize(array, buf, unit);
+	} else {
+		static_assert(std::is_scalar_v<T> && (sizeof(T) == 4 || sizeof(T) == 8));
+		constexpr unsigned m = sizeof(T) / 4;
+		if (array.size() == 0) {
+			unit.len = 1;
+			unit.data[0] = m;
+			return true;
+		} else if (m*array.size() >= (1U << 30U)) {
+			return false;
+		}
+		auto last = buf.Size();
+		auto head = buf.Expand(1 + m*array.size());
+		if (head == nullptr) {
+			return false;
+		}
+		*head = (array.size() << 2U) | m;
+		memcpy(head+1, array.data(), array.size()*sizeof(T));
+		unit = Segment(last, buf.Size());
+		if (buf.Dedup() != nullptr) {
+			buf.Dedup()->Leaf(buf, unit);
+		}
+		return true;
+	}
+}
+
 extern bool SerializeMessage(Span<Unit> fields, Buffer& buf, size_t last, Unit& unit);
 extern bool SerializeArray(std::vector<Unit>& elements, Buffer& buf, size_t last, Unit& unit);
 extern bool SerializeMap(const Slice<uint8_t>& index, std::vector<std::pair<Unit,Unit>>& pairs,
@@ -122,5 +264,149 @@ static inline bool SerializeMessage(std::array<Unit,N>& fields, Buffer& buf, siz
 	return SerializeMessage(Span(fields), buf, last, unit);
 }
 
+// worth spreading n heavy elements across threads
+static inline bool UseParallel(const Buffer& buf, size_t n) noexcept {
+	return buf.Threads() > 1 && n >= 256 && buf.Dedup() == nullptr;
+}
+
+// Serialize n independent elements with buf.Threads() workers. Element i fills
+// units[i*group, (i+1)*group) by fn(worker, i, part, out) into a private buffer
+// of the worker, then all parts are stitched into buf. The result is the same
+// as calling fn from n-1 down to 0 on buf.
+extern bool SerializeParallel(Buffer& buf, Unit units[], size_t n, unsigned group,
+							  const std::function<bool(unsigned, size_t, Buffer&, Unit*)>& fn);
+
+// Copy self-contained data, like an object detected by Detect. With fold,
+// data shorter than 4 words is kept in unit as a field.
+static inline bool Copy(const Slice<uint32_t>& src, Buffer& buf, Unit& unit, bool fold=false) {
+	if (fold && src.size() < 4) {
+		unit.len = src.size();
+		for (unsigned i = 0; i < unit.len; i++) {
+			unit.data[i] = src[i];
+		}
+		return true;
+	}
+	auto last = buf.Size();
+	if (!buf.Put(src)) {
+		return false;
+	}
+	unit = Segment(last, buf.Size());
+	if (buf.Dedup() != nullptr) {
+		buf.Dedup()->Leaf(buf, unit);	// copied data is self-contained
+	}
+	return true;
+}
+
+static inline bool MeasureCopy(const Slice<uint32_t>& src, Unit& unit, bool fold=false) {
+	if (fold && src.size() < 4) {
+		unit.len = src.size();
+		if (unit.len == 0) {
+			unit.seg.len = 0;
+		}
+		return true;
+	}
+	unit = Segment(0, src.size());
+	return true;
+}
+
+// Fields kept by projection, as a tree of field ids. Node 0 is for the root
+// message. A path keeps the whole field at its end, and covers longer paths
+// under it.
+class FieldTree final {
+public:
+	static constexpr unsigned kWhole = ~0U;
+	struct Child {
+		unsigned id;
+		unsigned node;		// kWhole, or node of the picked fields in it
+	};
+
+	FieldTree() : nodes_(1) {}
+	void Add(const unsigned* path, size_t len);
+	void Add(std::initializer_list<unsigned> path) {
+		Add(path.begin(), path.size());
+	}
+	// sorted by id
+	const std::vector<Child>& Children(unsigned node) const noexcept {
+		return nodes_[node];
+	}
+
+private:
+	std::vector<std::vector<Child>> nodes_;
+};
+
+// Writes a message with fields of the node only. fn(id, sub, unit) writes one
+// present field, the whole one if sub is FieldTree::kWhole, or fields picked
+// by node sub in it. Fields are visited from last to first.
+extern bool ProjectMessage(const Message& message, const uint32_t* end, const FieldTree& tree, unsigned node,
+						   Buffer& buf, Unit& unit, const std::function<bool(unsigned, unsigned, Unit&)>& fn);
+
+template <typename T>
+static inline bool CopyField(const Message& message, unsigned id, const uint32_t* end, Buffer& buf, Unit& unit) {
+	auto view = DetectField<T>(message, id, end);
+	return !!view && Copy(view, buf, unit, true);
+}
+
+// T is a generated message class
+template <typename T>
+static inline bool ProjectField(const Message& message, unsigned id, const uint32_t* end,
+								const FieldTree& tree, unsigned node, Buffer& buf, Unit& unit) {
+	if (!T::Project(message.GetField(id, end).GetObject(end), end, tree, node, buf, unit)) {
+		return false;
+	}
+	FoldNested(buf, unit);
+	return true;
+}
+
+// Writes a new message with fields in tree only. Kept fields are copied
+// verbatim, only messages on the paths are encoded again.
+template <typename T>
+static inline bool Project(const Slice<uint32_t>& data, const FieldTree& tree, Buffer* buf) {
+	Unit dummy;
+	return T::Project(data.data(), data.end(), tree, 0, *buf, dummy);
+}
+
+// Size pre-pass, mirrors the functions above without writing anything.
+// Units only carry sizes: len for inline data, seg.len for words in buffer.
+static inline void FoldSize(Unit& unit) {
+	if (unit.len == 0 && unit.seg.len != 0 && unit.seg.len < 4) {
+		unit.len = unit.seg.len;
+	}
+}
+
+template<typename T>
+static inline bool Measure(T, Unit& unit) {
+	static_assert(std::is_scalar_v<T>);
+	unit.len = sizeof(T)/sizeof(uint32_t);
+	return true;
+}
+
+static inline bool Measure(bool, Unit& unit) {
+	unit.len = 1;
+	return true;
+}
+
+extern bool MeasureString(size_t len, Unit& unit);
+
+static inline bool Measure(const Slice<char>& str, Unit& unit) {
+	return MeasureString(str.size(), unit);
+}
+static inline bool Measure(const std::string& str, Unit& unit) {
+	return MeasureString(str.size(), unit);
+}
+
+extern bool MeasureMessage(Span<Unit> fields, Unit& unit);
+extern bool MeasureArray(const ArraySize& elements, Unit& unit);
+// index_size is in bytes, see PerfectHash::DataSize
+extern bool MeasureMap(size_t index_size, const ArraySize& keys, const ArraySize& values, Unit& unit);
+
+static inline bool MeasureMessage(std::vector<Unit>& fields, Unit& unit) {
+	return MeasureMessage(Span(fields), unit);
+}
+
+template <size_t N>
+static inline bool MeasureMessage(std::array<Unit,N>& fields, Unit& unit) {
+	return MeasureMessage(Span(fields), unit);
+}
+
 } // protocache
 #endif //PROTOCACHE_SERIALIZE_H_
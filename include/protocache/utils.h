@@ -14,6 +14,7 @@
 #include <vector>
 #include <atomic>
 #include <memory>
+#include <memory_resource>
 
 namespace protocache {
 
@@ -88,6 +89,12 @@ static inline constexpr size_t WordSize(size_t sz) noexcept {
 	return (sz+3)/4;
 }
 
+static inline void Prefetch(const void* ptr) noexcept {
+#if defined(__GNUC__)
+	__builtin_prefetch(ptr);
+#endif
+}
+
 template<typename D, typename S>
 static inline constexpr Slice<D> SliceCast(const Slice<S>& src) noexcept {
 	static_assert(std::is_scalar_v<D> && std::is_scalar_v<S> && sizeof(D) == sizeof(S), "");
@@ -96,8 +103,143 @@ static inline constexpr Slice<D> SliceCast(const Slice<S>& src) noexcept {
 
 extern bool LoadFile(const std::string& path, std::string* out);
 
-extern void Compress(const uint8_t* src, size_t len, std::string* out);
+// Read-only memory mapped file, pages are loaded on demand.
+class MappedFile final {
+public:
+	enum Advice : uint8_t {
+		ADVICE_NORMAL = 0,
+		ADVICE_RANDOM = 1,
+		ADVICE_SEQUENTIAL = 2,
+		ADVICE_WILLNEED = 3,
+	};
+	struct Options {
+		bool populate = false;		// prefault all pages (MAP_POPULATE)
+		bool huge_pages = false;	// ask for transparent huge pages
+		Advice advice = ADVICE_NORMAL;
+	};
+
+	MappedFile() noexcept = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept : data_(other.data_), size_(other.size_) {
+		other.data_ = nullptr;
+		other.size_ = 0;
+	}
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile& operator=(MappedFile&& other) noexcept {
+		if (&other != this) {
+			this->~MappedFile();
+			new(this) MappedFile(std::move(other));
+		}
+		return *this;
+	}
+	~MappedFile() noexcept;
+
+	bool operator!() const noexcept {
+		return data_ == nullptr;
+	}
+	Slice<uint32_t> View() const noexcept {
+		return {reinterpret_cast<const uint32_t*>(data_), size_/sizeof(uint32_t)};
+	}
+	Slice<uint8_t> Bytes() const noexcept {
+		return {reinterpret_cast<const uint8_t*>(data_), size_};
+	}
+	size_t Size() const noexcept {
+		return size_;
+	}
+
+	// Fails on empty file, or file size is not multiple of 4.
+	static MappedFile Open(const std::string& path, const Options& options);
+	static MappedFile Open(const std::string& path) {
+		return Open(path, Options());
+	}
+
+private:
+	void* data_ = nullptr;
+	size_t size_ = 0;
+};
+
+// Writable file mapping of fixed size, so data can be serialized straight
+// into a file through Buffer(region, size).
+class MappedOutput final {
+public:
+	MappedOutput() noexcept = default;
+	MappedOutput(const MappedOutput&) = delete;
+	MappedOutput(MappedOutput&& other) noexcept
+		: data_(other.data_), size_(other.size_), path_(std::move(other.path_)) {
+		other.data_ = nullptr;
+		other.size_ = 0;
+	}
+	MappedOutput& operator=(const MappedOutput&) = delete;
+	MappedOutput& operator=(MappedOutput&& other) noexcept {
+		if (&other != this) {
+			this->~MappedOutput();
+			new(this) MappedOutput(std::move(other));
+		}
+		return *this;
+	}
+	~MappedOutput() noexcept;
+
+	bool operator!() const noexcept {
+		return data_ == nullptr;
+	}
+	uint32_t* Data() const noexcept {
+		return reinterpret_cast<uint32_t*>(data_);
+	}
+	// in bytes
+	size_t Size() const noexcept {
+		return size_;
+	}
+
+	// write back dirty pages, data also reaches the file without it
+	bool Sync();
+
+	// Creates or truncates the file to size, which should be multiple of 4.
+	static MappedOutput Create(const std::string& path, size_t size);
+
+private:
+	void* data_ = nullptr;
+	size_t size_ = 0;
+	std::string path_;
+};
+
+// Kernels of Compress, they give identical output. A kernel the CPU lacks
+// falls back to the best one it has.
+enum CodecKernel : uint8_t {
+	CODEC_SCALAR = 0,
+	CODEC_SSE4 = 1,
+	CODEC_AVX2 = 2,
+};
+
+// picked at runtime, used when no kernel is given
+extern CodecKernel BestCodecKernel() noexcept;
+
+// Formats of Compress output, Decompress reads both. CODEC_BYTES packs runs
+// of 0x00 and 0xff bytes. CODEC_WORDS packs 32-bit words by their nonzero
+// bytes, which suits ProtoCache data better, and its output starts with a
+// 0x00 byte, which CODEC_BYTES never writes. Data not made of whole words is
+// always packed by CODEC_BYTES.
+enum CodecVersion : uint8_t {
+	CODEC_BYTES = 1,
+	CODEC_WORDS = 2,
+};
+
+class Buffer;
+
+extern void Compress(const uint8_t* src, size_t len, std::string* out, CodecKernel kernel);
+extern void Compress(const uint8_t* src, size_t len, std::string* out, CodecVersion version);
 extern bool Decompress(const uint8_t* src, size_t len, std::string* out);
+// Bytes of decompressed data, read from the header only. It fails when the
+// header claims more than the len bytes can expand to.
+extern bool DecompressedSize(const uint8_t* src, size_t len, size_t* size) noexcept;
+// Writes straight into a region of words, fails if it is too small. The rest
+// of the last word is zeroed.
+extern bool Decompress(const uint8_t* src, size_t len, uint32_t* region, size_t words) noexcept;
+// Replaces content of buf with the data padded to words, memory is reused.
+extern bool Decompress(const uint8_t* src, size_t len, Buffer* buf);
+
+static inline void Compress(const uint8_t* src, size_t len, std::string* out) {
+	Compress(src, len, out, BestCodecKernel());
+}
 
 static inline void Compress(const std::string& src, std::string* out) {
 	Compress(reinterpret_cast<const uint8_t*>(src.data()), src.size(), out);
@@ -105,13 +247,147 @@ static inline void Compress(const std::string& src, std::string* out) {
 static inline bool Decompress(const std::string& src, std::string* out) {
 	return Decompress(reinterpret_cast<const uint8_t*>(src.data()), src.size(), out);
 }
+static inline bool Decompress(const std::string& src, Buffer* buf) {
+	return Decompress(reinterpret_cast<const uint8_t*>(src.data()), src.size(), buf);
+}
+
+// Splits data into blocks of block_size bytes, which should be a multiple of 4,
+// and compresses each one alone, so they can be read back one by one. The
+// output starts with block size, block count and data size, then offsets of
+// the blocks, all in little-endian.
+extern bool CompressBlocks(const uint8_t* src, size_t len, std::string* out, uint32_t block_size=65536);
+
+// Reader of CompressBlocks output. By default all blocks are decompressed on
+// Open. In lazy mode with block size of whole pages, View() is backed by memory
+// that faults in blocks on access, so accessors work on it as on plain data.
+// Lazy mode installs a process-wide SIGSEGV/SIGBUS handler on first use, which
+// passes other faults on to the previous handler; on platforms without mmap it
+// falls back to eager mode.
+class BlockReader final {
+public:
+	BlockReader() noexcept;
+	BlockReader(BlockReader&&) noexcept;
+	BlockReader& operator=(BlockReader&&) noexcept;
+	~BlockReader() noexcept;
+
+	bool operator!() const noexcept {
+		return state_ == nullptr;
+	}
+	Slice<uint32_t> View() const noexcept;
+	// in bytes
+	size_t Size() const noexcept;
+	// make sure blocks of bytes [off, off+len) are decompressed
+	bool Fetch(size_t off, size_t len) noexcept;
+	size_t LoadedBlocks() const noexcept;
+	// some block failed to decompress, it reads as zeros
+	bool Corrupted() const noexcept;
+
+	// compressed data should outlive the reader, fails on a header claiming
+	// more data than the blocks can hold
+	static BlockReader Open(const Slice<uint8_t>& blocks, bool lazy=false);
+
+private:
+	struct State;
+	std::unique_ptr<State> state_;
+
+	static void Load(State& state, size_t block) noexcept;
+	static bool Fault(const void* addr) noexcept;
+};
+
+class Dictionary;
+
+// Optional second stage for cold storage: zstd with a dictionary trained from
+// samples of one root message type, which helps small records most. It runs
+// on plain data, where zstd does better than on Compress output. Available
+// when built with PROTOCACHE_WITH_ZSTD, otherwise these always fail.
+extern bool Compress(const uint8_t* src, size_t len, std::string* out, const Dictionary& dict);
+// Frames declaring more than max_size bytes are refused before allocating.
+extern bool Decompress(const uint8_t* src, size_t len, std::string* out, const Dictionary& dict,
+					   size_t max_size=(1U<<26U));
+// Replaces content of buf with the data padded to words, memory is reused.
+extern bool Decompress(const uint8_t* src, size_t len, Buffer* buf, const Dictionary& dict,
+					   size_t max_size=(1U<<26U));
+
+class Dictionary final {
+public:
+	Dictionary() noexcept;
+	Dictionary(Dictionary&&) noexcept;
+	Dictionary& operator=(Dictionary&&) noexcept;
+	~Dictionary() noexcept;
+
+	bool operator!() const noexcept {
+		return state_ == nullptr;
+	}
+	// to store and Load later
+	Slice<uint8_t> Data() const noexcept;
+
+	static Dictionary Load(const Slice<uint8_t>& data, int level=3);
+	// samples are plain data of the same root message type
+	static Dictionary Train(const std::vector<std::string>& samples, size_t capacity=16384, int level=3);
+
+private:
+	struct State;
+	std::unique_ptr<State> state_;
+
+	friend bool Compress(const uint8_t*, size_t, std::string*, const Dictionary&);
+	friend bool Decompress(const uint8_t*, size_t, std::string*, const Dictionary&, size_t);
+	friend bool Decompress(const uint8_t*, size_t, Buffer*, const Dictionary&, size_t);
+};
+
+// Recycles blocks of power-of-two sizes, so buffers built and dropped over and
+// over reach a steady state without malloc. Blocks keep the default alignment
+// of operator new, requests for more are served apart without pooling. Not
+// thread-safe, memory from the pool of a thread should be released in the
+// same thread.
+class BufferPool final : public std::pmr::memory_resource {
+public:
+	BufferPool() noexcept = default;
+	BufferPool(const BufferPool&) = delete;
+	BufferPool& operator=(const BufferPool&) = delete;
+	~BufferPool() noexcept override {
+		Trim();
+	}
+
+	// free all cached blocks
+	void Trim() noexcept;
+
+	// Pool of current thread, destroyed when the thread exits. Buffers using
+	// it must be gone by then, so never keep them in static or thread_local
+	// objects, nor hand them to other threads.
+	static BufferPool* ThreadLocal() noexcept;
+
+private:
+	static constexpr unsigned kClasses = 48;
+	static constexpr unsigned kKeep = 4;
+	void* cache_[kClasses][kKeep] = {};
+	uint8_t count_[kClasses] = {};
+
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void* ptr, size_t bytes, size_t alignment) override;
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+		return this == &other;
+	}
+};
+
+class DedupTable;
 
 class Buffer final {
 public:
 	Buffer() = default;
+	// take memory from resource, which should outlive the buffer
+	explicit Buffer(std::pmr::memory_resource* resource) noexcept : resource_(resource) {}
+	// work in caller's region only, Expand fails instead of growing
+	Buffer(uint32_t* region, size_t size) noexcept
+		: data_(region), size_(size), off_(size), fixed_(true) {}
+	~Buffer() noexcept {
+		Release();
+	}
 	Buffer(const Buffer&) = delete;
 	Buffer(Buffer &&other) noexcept:
-		data_(std::move(other.data_)), size_(other.size_), off_(other.off_) {
+		data_(other.data_), size_(other.size_), off_(other.off_), resource_(other.resource_),
+		fixed_(other.fixed_), deterministic_(other.deterministic_), threads_(other.threads_),
+		dedup_(other.dedup_) {
+		other.data_ = nullptr;
 		other.size_ = 0;
 		other.off_ = 0;
 	}
@@ -125,34 +401,45 @@ public:
 	}
 
 	Slice<uint32_t> View() const noexcept {
-		return {data_.get()+off_, Size()};
+		return {data_+off_, Size()};
 	};
 	size_t Size() const noexcept {
 		return size_ - off_;
 	}
 	uint32_t* At(size_t size) noexcept {
-		return data_.get() + size_ - size;
+		return data_ + size_ - size;
 	}
 	uint32_t* Head() const noexcept {
-		return data_.get() + off_;
+		return data_ + off_;
 	}
+	// keep memory for reuse
 	void Clear() noexcept {
 		off_ = size_;
 	}
 
-	void Put(uint32_t v) noexcept {
-		*Expand(1) = v;
+	bool Put(uint32_t v) noexcept {
+		auto dest = Expand(1);
+		if (dest == nullptr) {
+			return false;
+		}
+		*dest = v;
+		return true;
 	}
-	void Put(const Slice<uint32_t>& data) noexcept {
+	bool Put(const Slice<uint32_t>& data) noexcept {
 		auto dest = Expand(data.size());
+		if (dest == nullptr) {
+			return false;
+		}
 		memcpy(dest, data.data(), data.size() * sizeof(uint32_t));
+		return true;
 	}
 
+	// returns nullptr only when a fixed region is used up
 	uint32_t* Expand(size_t delta) {
 		if (off_ >= delta) {
 			off_ -= delta;
-		} else {
-			DoExpand(delta);
+		} else if (!DoExpand(delta)) {
+			return nullptr;
 		}
 		return Head();
 	}
@@ -162,19 +449,58 @@ public:
 		off_ += delta;
 	}
 
-	void Reserve(size_t size) {
-		if (size > size_) {
-			DoReserve(size);
-		}
+	bool Reserve(size_t size) {
+		return size <= size_ || DoReserve(size);
+	}
+
+	// In deterministic mode, maps are serialized with sorted keys and seeds
+	// derived from them, so identical data always gives identical bytes.
+	void SetDeterministic(bool on) noexcept {
+		deterministic_ = on;
+	}
+	bool Deterministic() const noexcept {
+		return deterministic_;
+	}
+
+	// With more than one thread, large arrays and maps of messages are
+	// serialized in parallel. The output is the same as the serial one.
+	// Parts take memory from the same resource, under a lock. A buffer on
+	// a fixed region stays serial, as parts would need memory outside it.
+	void SetThreads(unsigned n) noexcept {
+		threads_ = n == 0 ? 1 : n;
+	}
+	unsigned Threads() const noexcept {
+		return threads_;
+	}
+	std::pmr::memory_resource* Resource() const noexcept {
+		return resource_;
+	}
+	bool Fixed() const noexcept {
+		return fixed_;
+	}
+
+	// Identical strings and objects are written once with a table, see DedupTable.
+	void SetDedup(DedupTable* table) noexcept {
+		dedup_ = table;
+	}
+	DedupTable* Dedup() const noexcept {
+		return dedup_;
 	}
 
 private:
-	std::unique_ptr<uint32_t[]> data_;
+	uint32_t* data_ = nullptr;
 	size_t size_ = 0;
 	size_t off_ = 0;
+	std::pmr::memory_resource* resource_ = nullptr;
+	bool fixed_ = false;
+	bool deterministic_ = false;
+	unsigned threads_ = 1;
+	DedupTable* dedup_ = nullptr;
 
-	void DoExpand(size_t delta);
-	void DoReserve(size_t size);
+	uint32_t* Allocate(size_t size);
+	void Release() noexcept;
+	bool DoExpand(size_t delta);
+	bool DoReserve(size_t size);
 };
 
 } // protocache
@@ -13,12 +13,15 @@ SDIST_NATIVE_ROOT = HERE / "native"
 STAGE_MARKER = SDIST_NATIVE_ROOT / ".checkout-stage"
 CORE_SOURCES = (
     "access.cc",
+    "blocks.cc",
+    "compress.cc",
+    "dictionary.cc",
     "hash.cc",
     "perfect_hash.cc",
     "serialize.cc",
     "utils.cc",
 )
-CORE_PRIVATE_HEADERS = ("hash.h",)
+CORE_PRIVATE_HEADERS = ("codec.h", "hash.h")
 
 
 def _has_native_sources(root):
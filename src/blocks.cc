@@ -0,0 +1,334 @@
+// Copyright (c) 2023, Ruan Kunliang.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include <algorithm>
+#include <new>
+#include <string>
+#include <vector>
+#if defined(__linux__)
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#include "protocache/utils.h"
+
+namespace protocache {
+
+static constexpr size_t kBlockHeader = 16;	// block size, count, data size
+// A mark byte unpacks to 8 bytes at most, with any codec version. It bounds
+// what a header may claim against the data behind it.
+static constexpr uint64_t kMaxExpansion = 8;
+
+bool CompressBlocks(const uint8_t* src, size_t len, std::string* out, uint32_t block_size) {
+	out->clear();
+	if (block_size == 0 || (block_size & 3U) != 0) {
+		return false;
+	}
+	uint64_t count = (len + block_size - 1) / block_size;
+	if (count > UINT32_MAX) {
+		return false;
+	}
+	std::vector<uint64_t> offsets(count+1);
+	out->resize(kBlockHeader + offsets.size()*sizeof(uint64_t));
+	uint32_t head[2] = {block_size, static_cast<uint32_t>(count)};
+	uint64_t size = len;
+	memcpy(const_cast<char*>(out->data()), head, 8);
+	memcpy(const_cast<char*>(out->data())+8, &size, 8);
+
+	auto base = out->size();
+	std::string block;
+	for (uint64_t i = 0; i < count; i++) {
+		auto off = i * block_size;
+		Compress(src + off, std::min<size_t>(block_size, len - off), &block);
+		out->append(block);
+		offsets[i+1] = out->size() - base;
+	}
+	memcpy(const_cast<char*>(out->data())+kBlockHeader, offsets.data(), offsets.size()*sizeof(uint64_t));
+	return true;
+}
+
+enum BlockMark : uint8_t {
+	BLOCK_NONE = 0,
+	BLOCK_LOADING = 1,
+	BLOCK_READY = 2,
+	BLOCK_BROKEN = 3,	// filled with zeros
+};
+
+struct BlockReader::State {
+	const uint8_t* data = nullptr;	// compressed blocks
+	std::vector<uint64_t> offsets;
+	size_t block_size = 0;
+	size_t size = 0;
+	uint32_t* view = nullptr;
+	size_t mapped = 0;	// bytes mapped for lazy mode, 0 for eager mode
+	int slot = -1;
+	std::unique_ptr<std::atomic<uint8_t>[]> marks;
+	std::atomic<size_t> loaded{0};
+	std::atomic<bool> corrupted{false};
+	~State() noexcept;
+};
+
+#if defined(__linux__)
+// Lazy readers to look up on faults. The handler only reads them.
+static constexpr int kMaxLazyReaders = 64;
+static std::atomic<void*> g_lazy_readers[kMaxLazyReaders];
+
+static bool (*g_block_fault)(const void*) = nullptr;
+static thread_local const void* g_last_fault = nullptr;
+static struct sigaction g_old_segv;
+static struct sigaction g_old_bus;
+
+static void OnBlockFault(int sig, siginfo_t* info, void* ctx) {
+	if (g_block_fault(info->si_addr)) {
+		return;
+	}
+	auto& old = sig == SIGBUS ? g_old_bus : g_old_segv;
+	if (old.sa_flags & SA_SIGINFO) {
+		old.sa_sigaction(sig, info, ctx);
+	} else if (old.sa_handler == SIG_DFL || old.sa_handler == SIG_IGN) {
+		// the access is retried and gets the default action
+		signal(sig, SIG_DFL);
+	} else {
+		old.sa_handler(sig);
+	}
+}
+
+static bool InstallBlockFaultHandler(bool (*fault)(const void*)) noexcept {
+	g_block_fault = fault;
+	struct sigaction act;
+	memset(&act, 0, sizeof(act));
+	act.sa_sigaction = OnBlockFault;
+	act.sa_flags = SA_SIGINFO | SA_NODEFER | SA_ONSTACK;
+	sigemptyset(&act.sa_mask);
+	return sigaction(SIGSEGV, &act, &g_old_segv) == 0
+		&& sigaction(SIGBUS, &act, &g_old_bus) == 0;
+}
+
+static size_t PageSize() noexcept {
+	static const size_t size = sysconf(_SC_PAGESIZE);
+	return size;
+}
+
+static size_t RoundUpToPage(size_t n) noexcept {
+	return (n + PageSize() - 1) & ~(PageSize() - 1);
+}
+#endif
+
+BlockReader::State::~State() noexcept {
+#if defined(__linux__)
+	if (slot >= 0) {
+		g_lazy_readers[slot].store(nullptr);
+	}
+	if (mapped != 0) {
+		munmap(view, mapped);
+		return;
+	}
+#endif
+	delete[] view;
+}
+
+// Decompresses a block in place. In lazy mode, it is unpacked in a scratch
+// mapping and moved over the inaccessible pages at once, so other threads
+// never see a partial block. Safe to run in the fault handler.
+void BlockReader::Load(State& state, size_t block) noexcept {
+	auto& mark = state.marks[block];
+	uint8_t expected = BLOCK_NONE;
+	if (!mark.compare_exchange_strong(expected, BLOCK_LOADING)) {
+		while (mark.load() == BLOCK_LOADING) {
+#if defined(__linux__)
+			sched_yield();
+#endif
+		}
+		return;
+	}
+	auto off = block * state.block_size;
+	auto len = std::min(state.block_size, state.size - off);
+	auto src = state.data + state.offsets[block];
+	auto src_len = state.offsets[block+1] - state.offsets[block];
+	auto dest = state.view + off/sizeof(uint32_t);
+	auto words = WordSize(len);
+
+#if defined(__linux__)
+	size_t room = 0;
+	void* scratch = MAP_FAILED;
+	if (state.mapped != 0) {
+		room = RoundUpToPage(len);
+		scratch = mmap(nullptr, room, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (scratch == MAP_FAILED) {
+			abort();	// out of address space while the data is needed
+		}
+		dest = static_cast<uint32_t*>(scratch);
+	}
+#endif
+	size_t size = 0;
+	bool done = DecompressedSize(src, src_len, &size) && size == len
+		&& Decompress(src, src_len, dest, words);
+	if (!done) {
+		memset(dest, 0, words*sizeof(uint32_t));
+		state.corrupted.store(true);
+	}
+#if defined(__linux__)
+	if (scratch != MAP_FAILED) {
+		auto target = state.view + off/sizeof(uint32_t);
+		if (mprotect(scratch, room, PROT_READ) != 0
+			|| mremap(scratch, room, room, MREMAP_MAYMOVE | MREMAP_FIXED, target) == MAP_FAILED) {
+			abort();
+		}
+	}
+#endif
+	state.loaded.fetch_add(1);
+	mark.store(done ? BLOCK_READY : BLOCK_BROKEN);
+}
+
+bool BlockReader::Fault(const void* addr) noexcept {
+#if defined(__linux__)
+	auto p = static_cast<const uint8_t*>(addr);
+	for (auto& slot : g_lazy_readers) {
+		auto state = static_cast<State*>(slot.load());
+		if (state == nullptr) {
+			continue;
+		}
+		auto begin = reinterpret_cast<const uint8_t*>(state->view);
+		if (p < begin || p >= begin + WordSize(state->size)*sizeof(uint32_t)) {
+			continue;
+		}
+		auto block = (p - begin) / state->block_size;
+		auto mark = state->marks[block].load();
+		if (mark == BLOCK_READY || mark == BLOCK_BROKEN) {
+			// loaded by another thread since the fault, or a real fault like
+			// writing, which comes again at once
+			if (g_last_fault == addr) {
+				g_last_fault = nullptr;
+				return false;
+			}
+			g_last_fault = addr;
+			return true;
+		}
+		g_last_fault = nullptr;
+		Load(*state, block);
+		return true;
+	}
+#endif
+	return false;
+}
+
+BlockReader::BlockReader() noexcept = default;
+BlockReader::BlockReader(BlockReader&&) noexcept = default;
+BlockReader& BlockReader::operator=(BlockReader&&) noexcept = default;
+BlockReader::~BlockReader() noexcept = default;
+
+Slice<uint32_t> BlockReader::View() const noexcept {
+	if (state_ == nullptr) {
+		return {};
+	}
+	return {state_->view, WordSize(state_->size)};
+}
+
+size_t BlockReader::Size() const noexcept {
+	return state_ == nullptr ? 0 : state_->size;
+}
+
+size_t BlockReader::LoadedBlocks() const noexcept {
+	return state_ == nullptr ? 0 : state_->loaded.load();
+}
+
+bool BlockReader::Corrupted() const noexcept {
+	return state_ != nullptr && state_->corrupted.load();
+}
+
+bool BlockReader::Fetch(size_t off, size_t len) noexcept {
+	if (state_ == nullptr || off > state_->size || len > state_->size - off) {
+		return false;
+	}
+	if (len == 0) {
+		return true;
+	}
+	bool done = true;
+	for (auto i = off / state_->block_size; i <= (off+len-1) / state_->block_size; i++) {
+		auto& mark = state_->marks[i];
+		if (mark.load() != BLOCK_READY && mark.load() != BLOCK_BROKEN) {
+			Load(*state_, i);
+		}
+		done = done && mark.load() == BLOCK_READY;
+	}
+	return done;
+}
+
+BlockReader BlockReader::Open(const Slice<uint8_t>& blocks, bool lazy) {
+	BlockReader out;
+	if (blocks.size() < kBlockHeader) {
+		return out;
+	}
+	uint32_t head[2];
+	uint64_t size;
+	memcpy(head, blocks.data(), 8);
+	memcpy(&size, blocks.data()+8, 8);
+	uint64_t block_size = head[0];
+	uint64_t count = head[1];
+	if (block_size == 0 || (block_size & 3U) != 0 || size > count * block_size
+		|| (count != 0 && size <= (count-1) * block_size)
+		|| (blocks.size() - kBlockHeader) / sizeof(uint64_t) < count + 1) {
+		return out;
+	}
+	std::unique_ptr<State> state(new State);
+	state->offsets.resize(count+1);
+	memcpy(state->offsets.data(), blocks.data()+kBlockHeader, state->offsets.size()*sizeof(uint64_t));
+	auto base = kBlockHeader + state->offsets.size()*sizeof(uint64_t);
+	if (state->offsets.front() != 0 || state->offsets.back() != blocks.size() - base) {
+		return out;
+	}
+	for (size_t i = 0; i < count; i++) {
+		auto len = std::min<uint64_t>(block_size, size - i*block_size);
+		if (state->offsets[i] >= state->offsets[i+1]
+			|| len > (state->offsets[i+1] - state->offsets[i]) * kMaxExpansion) {
+			return out;
+		}
+	}
+	state->data = blocks.data() + base;
+	state->block_size = block_size;
+	state->size = size;
+	state->marks.reset(new std::atomic<uint8_t>[count]);
+	for (size_t i = 0; i < count; i++) {
+		state->marks[i].store(BLOCK_NONE);
+	}
+
+#if defined(__linux__)
+	if (lazy && size != 0 && block_size % PageSize() == 0) {
+		// installed on the first lazy reader, eager ones leave signals alone
+		static const bool handled = InstallBlockFaultHandler(&BlockReader::Fault);
+		auto mapped = RoundUpToPage(size);
+		auto addr = !handled ? MAP_FAILED
+			: mmap(nullptr, mapped, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (addr != MAP_FAILED) {
+			state->view = static_cast<uint32_t*>(addr);
+			state->mapped = mapped;
+			// published with the view ready, the handler may look at it at once
+			for (int i = 0; i < kMaxLazyReaders; i++) {
+				void* expected = nullptr;
+				if (g_lazy_readers[i].compare_exchange_strong(expected, state.get())) {
+					state->slot = i;
+					out.state_ = std::move(state);
+					return out;
+				}
+			}
+			munmap(addr, mapped);
+			state->view = nullptr;
+			state->mapped = 0;
+		}
+	}
+#endif
+	// eager mode
+	state->view = new (std::nothrow) uint32_t[WordSize(size)];
+	if (state->view == nullptr) {
+		return out;
+	}
+	for (size_t i = 0; i < count; i++) {
+		Load(*state, i);
+	}
+	out.state_ = std::move(state);
+	return out;
+}
+
+} // protocache
@@ -0,0 +1,31 @@
+// Copyright (c) 2023, Ruan Kunliang.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include <immintrin.h>
+#include "codec.h"
+
+namespace protocache {
+namespace codec {
+
+size_t EncodeAVX2(const uint8_t* src, size_t len, uint8_t* dest) noexcept {
+	return EncodeWithMask(src, len, dest, [](const uint8_t* p, uint64_t& zero, uint64_t& full, uint8_t* cls) {
+		auto ff = _mm256_set1_epi8(-1);
+		uint32_t z[2], f[2];
+		for (unsigned i = 0; i < 2; i++) {
+			auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i*32));
+			auto vz = _mm256_cmpeq_epi8(v, _mm256_setzero_si256());
+			auto vf = _mm256_cmpeq_epi8(v, ff);
+			z[i] = _mm256_movemask_epi8(vz);
+			f[i] = _mm256_movemask_epi8(vf);
+			auto c = _mm256_or_si256(_mm256_and_si256(vz, _mm256_set1_epi8(8)),
+				_mm256_and_si256(vf, _mm256_set1_epi8(16)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(cls + i*32), c);
+		}
+		zero = (static_cast<uint64_t>(z[1]) << 32U) | z[0];
+		full = (static_cast<uint64_t>(f[1]) << 32U) | f[0];
+	});
+}
+
+} // codec
+} // protocache
@@ -0,0 +1,29 @@
+// Copyright (c) 2023, Ruan Kunliang.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include <immintrin.h>
+#include "codec.h"
+
+namespace protocache {
+namespace codec {
+
+size_t EncodeSSE4(const uint8_t* src, size_t len, uint8_t* dest) noexcept {
+	return EncodeWithMask(src, len, dest, [](const uint8_t* p, uint64_t& zero, uint64_t& full, uint8_t* cls) {
+		auto ff = _mm_set1_epi8(-1);
+		zero = 0;
+		full = 0;
+		for (unsigned i = 0; i < 64; i += 16) {
+			auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+			auto vz = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+			auto vf = _mm_cmpeq_epi8(v, ff);
+			zero |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(vz))) << i;
+			full |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(vf))) << i;
+			auto c = _mm_or_si128(_mm_and_si128(vz, _mm_set1_epi8(8)), _mm_and_si128(vf, _mm_set1_epi8(16)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(cls + i), c);
+		}
+	});
+}
+
+} // codec
+} // protocache
@@ -0,0 +1,163 @@
+// Copyright (c) 2023, Ruan Kunliang.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#pragma once
+#ifndef PROTOCACHE_CODEC_H
+#define PROTOCACHE_CODEC_H
+
+#include <cstdint>
+#include <cstring>
+
+// Kernels of the zero/0xff run codec behind Compress.
+// SIMD kernels live in their own translation units built with matching
+// instruction sets, so they must not touch any inline function with external
+// linkage (std::string and friends), which the linker may share with code
+// running on older CPUs.
+
+namespace protocache {
+namespace codec {
+
+// Writes tokens of src to dest, which has room for len + (len+13)/14 bytes.
+// Returns bytes written.
+extern size_t EncodeScalar(const uint8_t* src, size_t len, uint8_t* dest) noexcept;
+extern size_t EncodeSSE4(const uint8_t* src, size_t len, uint8_t* dest) noexcept;
+extern size_t EncodeAVX2(const uint8_t* src, size_t len, uint8_t* dest) noexcept;
+
+static inline unsigned CountTrailingZeros(uint64_t v) noexcept {
+#if defined(__GNUC__)
+	return __builtin_ctzll(v);
+#else
+	unsigned n = 0;
+	while ((v & 1) == 0) {
+		v >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+// One token at src.
+static inline uint8_t PickToken(const uint8_t*& src, const uint8_t* end) noexcept {
+	uint8_t cnt = 1;
+	auto ch = *src++;
+	int8_t x = ch;
+	if (x == (x >> 1)) {
+		while (src < end && cnt < 4 && *src == ch) {
+			src++;
+			cnt++;
+		}
+		return 0x8 | (ch & 0x4) | (cnt-1);
+	} else {
+		while (src < end && cnt < 7 && *src != 0 && *src != 0xff) {
+			src++;
+			cnt++;
+		}
+		return cnt;
+	}
+}
+
+static inline void CopyLiteral(uint8_t*& dest, const uint8_t* src, const uint8_t* end, unsigned len) noexcept {
+	if (src+8 <= end) {
+		memcpy(dest, src, 8);
+	} else {
+		memcpy(dest, src, len);
+	}
+	dest += len;
+}
+
+// Tokens of [src, end) in pairs, one byte at a time.
+static inline uint8_t* EncodeBytes(const uint8_t* src, const uint8_t* end, uint8_t* dest) noexcept {
+	while (src < end) {
+		auto x = src;
+		auto a = PickToken(src, end);
+		if (src == end) {
+			*dest++ = a;
+			if ((a & 0x8) == 0) {
+				CopyLiteral(dest, x, end, a);
+			}
+			break;
+		}
+		auto y = src;
+		auto b = PickToken(src, end);
+		*dest++ = a | (b<<4);
+		if ((a & 0x8) == 0) {
+			CopyLiteral(dest, x, end, a);
+		}
+		if ((b & 0x8) == 0) {
+			CopyLiteral(dest, y, end, b);
+		}
+	}
+	return dest;
+}
+
+// Starts of runs in mask, and boundaries every cap bytes after them inside
+// the runs. Steps of cap, 2*cap, 4*cap... are taken while they stay in run.
+template <unsigned kCap>
+static inline uint64_t SplitRuns(uint64_t mask) noexcept {
+	auto bounds = mask & ~(mask << 1U);
+	auto in_run = mask;	// bytes with step bytes before them in the same run
+	for (unsigned i = 0; i < kCap; i++) {
+		in_run &= mask << (i+1);
+	}
+	for (unsigned step = kCap; step < 64; step *= 2) {
+		bounds |= (bounds << step) & in_run;
+		in_run &= in_run << step;
+	}
+	return bounds;
+}
+
+// Token and bytes of literal by class (literal, zeros, 0xff) and length,
+// indexed by class<<3|length.
+static constexpr uint8_t kTokens[24] = {
+	0, 1, 2, 3, 4, 5, 6, 7,
+	0, 0x8, 0x9, 0xa, 0xb, 0, 0, 0,
+	0, 0xc, 0xd, 0xe, 0xf, 0, 0, 0,
+};
+static constexpr uint8_t kLiterals[24] = {
+	0, 1, 2, 3, 4, 5, 6, 7,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+// Encoder working on 64 bytes a round, where load(p, zero, full, cls) marks
+// bytes of 0x00 and 0xff in p[0,64) with bits and with classes as 8 and 16.
+// Tokens are split from runs of the same class with bit tricks, then each one
+// costs a few instructions without branches on data. Pairs starting within
+// the first 50 bytes end within the round, and 8 bytes can always be copied
+// for literals.
+template <typename Load>
+static inline size_t EncodeWithMask(const uint8_t* src, size_t len, uint8_t* dest, Load load) noexcept {
+	auto begin = dest;
+	auto end = src + len;
+	uint8_t cls[64];
+
+	while (src + 64 <= end) {
+		uint64_t zero, full;
+		load(src, zero, full, cls);
+		auto rest = SplitRuns<4>(zero) | SplitRuns<4>(full) | SplitRuns<7>(~(zero | full));
+		rest &= rest - 1;
+
+		unsigned p = 0;
+		do {
+			auto q = CountTrailingZeros(rest);
+			rest &= rest - 1;
+			auto r = CountTrailingZeros(rest);
+			rest &= rest - 1;
+			auto a = cls[p] + (q - p);
+			auto b = cls[q] + (r - q);
+			*dest++ = kTokens[a] | (kTokens[b] << 4U);
+			memcpy(dest, src + p, 8);
+			dest += kLiterals[a];
+			memcpy(dest, src + q, 8);
+			dest += kLiterals[b];
+			p = r;
+		} while (p <= 49);
+		src += p;
+	}
+	return EncodeBytes(src, end, dest) - begin;
+}
+
+} // codec
+} // protocache
+#endif //PROTOCACHE_CODEC_H
@@ -0,0 +1,469 @@
+// Copyright (c) 2023, Ruan Kunliang.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+#include "protocache/utils.h"
+#include "codec.h"
+
+namespace protocache {
+namespace codec {
+
+size_t EncodeScalar(const uint8_t* src, size_t len, uint8_t* dest) noexcept {
+	return EncodeBytes(src, src + len, dest) - dest;
+}
+
+} // codec
+
+#if defined(PROTOCACHE_CODEC_X86)
+static CodecKernel DetectCodecKernel() noexcept {
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return CODEC_AVX2;
+	}
+	if (__builtin_cpu_supports("sse4.1")) {
+		return CODEC_SSE4;
+	}
+	return CODEC_SCALAR;
+}
+#else
+static CodecKernel DetectCodecKernel() noexcept {
+	return CODEC_SCALAR;
+}
+#endif
+
+CodecKernel BestCodecKernel() noexcept {
+	static const CodecKernel best = DetectCodecKernel();
+	return best;
+}
+
+static void AppendSize(std::string* out, size_t n) {
+	while ((n & ~0x7fU) != 0) {
+		out->push_back(static_cast<char>(0x80U | (n & 0x7fU)));
+		n >>= 7U;
+	}
+	out->push_back(static_cast<char>(n));
+}
+
+void Compress(const uint8_t* src, size_t len, std::string* out, CodecKernel kernel) {
+	out->clear();
+	if (len == 0) {
+		return;
+	}
+	AppendSize(out, len);
+
+	unsigned off = out->size();
+	out->resize(off + len + (len+13)/14);
+	auto dest = reinterpret_cast<uint8_t*>(const_cast<char*>(out->data())) + off;
+
+	size_t m;
+	switch (std::min(kernel, BestCodecKernel())) {
+#if defined(PROTOCACHE_CODEC_X86)
+		case CODEC_AVX2:
+			m = codec::EncodeAVX2(src, len, dest);
+			break;
+		case CODEC_SSE4:
+			m = codec::EncodeSSE4(src, len, dest);
+			break;
+#endif
+		default:
+			m = codec::EncodeScalar(src, len, dest);
+			break;
+	}
+	out->resize(off + m);
+}
+
+// Word codec: after the tag and the size in words, each mark byte holds codes
+// of two tokens in nibbles, low first, followed by their bytes. A code is the
+// mask of bytes kept in a word, the rest of which are zeros. Two masks rarely
+// seen in ProtoCache data are taken for other uses: kWordNegative keeps the
+// low 2 bytes of 0xffffxxxx, and kWordRun is a byte of count-2 followed by
+// 2 to 257 raw words, which covers strings and other dense data.
+static constexpr uint8_t kWordCodecTag = 0x00;
+static constexpr unsigned kWordNegative = 0x5;
+static constexpr unsigned kWordRun = 0xa;
+static constexpr size_t kWordRunMax = 257;
+
+struct WordPick {
+	uint8_t width = 0;
+	uint8_t shift[4] = {};	// to move kept bytes to each byte of the word
+	uint32_t keep = 0;	// bytes of the word from kept bytes
+	uint32_t fill = 0;
+};
+
+struct WordPicks {
+	WordPick codes[16];
+};
+
+static constexpr WordPicks MakeWordPicks() noexcept {
+	WordPicks out;
+	for (unsigned code = 0; code < 16; code++) {
+		auto& pick = out.codes[code];
+		auto mask = code == kWordNegative ? 0x3U : code;
+		for (unsigned i = 0; i < 4; i++) {
+			if (mask & (1U << i)) {
+				pick.shift[i] = pick.width++ * 8;
+				pick.keep |= 0xffU << (i*8);
+			}
+		}
+		if (code == kWordNegative) {
+			pick.fill = 0xffff0000U;
+		}
+	}
+	return out;
+}
+
+static constexpr WordPicks kWordPicks = MakeWordPicks();
+
+// bytes after each mark of two plain tokens, 0 for marks with kWordRun
+struct WordMarks {
+	uint8_t bytes[256] = {};
+};
+
+static inline uint32_t LoadWord(const uint8_t* src, size_t i) noexcept {
+	uint32_t w;
+	memcpy(&w, src + i*4, 4);
+	return w;
+}
+
+static inline unsigned ByteMask(uint32_t w) noexcept {
+	w |= w >> 4U;
+	w |= w >> 2U;
+	w |= w >> 1U;
+	return ((w & 0x01010101U) * 0x01020408U) >> 24U;	// bit of each byte to bits 24-27
+}
+
+// Tokens of n words at src, with room of a byte more than needed in dest.
+static size_t EncodeWords(const uint8_t* src, size_t n, uint8_t* dest) noexcept {
+	auto begin = dest;
+	size_t i = 0;
+
+	auto put = [src, n, &i, &dest]()->unsigned {
+		auto w = LoadWord(src, i);
+		auto code = ByteMask(w);
+		if (code == 0xf && i+1 < n) {
+			// words with a single zero byte join a run when dense words follow
+			auto j = i + 1;
+			while (j < n && j - i < kWordRunMax) {
+				auto m = ByteMask(LoadWord(src, j));
+				if (m != 0xf && (kWordPicks.codes[m].width != 3 || j+1 >= n
+					|| ByteMask(LoadWord(src, j+1)) != 0xf)) {
+					break;
+				}
+				j++;
+			}
+			if (j - i >= 2) {
+				*dest++ = j - i - 2;
+				for (; i + 2 <= j; i += 2) {
+					memcpy(dest, src + i*4, 8);
+					dest += 8;
+				}
+				if (i < j) {
+					memcpy(dest, src + i*4, 4);
+					dest += 4;
+					i++;
+				}
+				return kWordRun;
+			}
+		}
+		i++;
+
+		if (code == kWordNegative || code == kWordRun) {
+			code |= code == kWordNegative ? 0x2 : 0x4;	// keep a zero byte more
+		}
+		auto keep = code;
+		if ((w >> 16U) == 0xffffU && kWordPicks.codes[code].width > 2) {
+			code = kWordNegative;
+			keep = 0x3;
+		}
+		for (unsigned k = 0; k < 4; k++) {
+			*dest = w >> (k*8);
+			dest += (keep >> k) & 1U;
+		}
+		return code;
+	};
+
+	while (i < n) {
+		auto mark = dest++;
+		auto a = put();
+		unsigned b = 0;	// ignored after the last word
+		if (i < n) {
+			b = put();
+		}
+		*mark = a | (b << 4U);
+	}
+	return dest - begin;
+}
+
+void Compress(const uint8_t* src, size_t len, std::string* out, CodecVersion version) {
+	if (version != CODEC_WORDS || (len & 3U) != 0) {
+		Compress(src, len, out, BestCodecKernel());
+		return;
+	}
+	out->clear();
+	if (len == 0) {
+		return;
+	}
+	out->push_back(static_cast<char>(kWordCodecTag));
+	auto n = len / 4;
+	AppendSize(out, n);
+
+	unsigned off = out->size();
+	out->resize(off + len + n + 1);
+	auto dest = reinterpret_cast<uint8_t*>(const_cast<char*>(out->data())) + off;
+	out->resize(off + EncodeWords(src, n, dest));
+}
+
+// Parses the size header, returns bytes of it, or 0 when it is broken.
+static unsigned ParseSize(const uint8_t* src, const uint8_t* end, size_t* size) noexcept {
+	unsigned v = 0;
+	unsigned n = 0;
+	for (unsigned sft = 0; sft < 32U; sft += 7U) {
+		if (src + n >= end) {
+			return 0;
+		}
+		uint8_t b = src[n++];
+		if (b & 0x80U) {
+			v |= static_cast<unsigned>(b & 0x7fU) << sft;
+		} else {
+			v |= static_cast<unsigned>(b) << sft;
+			*size = v;
+			return n;
+		}
+	}
+	return 0;
+}
+
+// Expands tokens to exactly size bytes at dest, where room bytes are writable.
+// Fast stores of 4 or 8 bytes are used while they stay in room.
+static bool Unpack(const uint8_t* src, const uint8_t* end, uint8_t* dest, size_t size, size_t room) noexcept {
+	auto tail = dest + size;
+
+	auto unpack = [&src, end, &dest, tail](uint8_t mark, bool safe)->bool {
+		if (mark & 8) {
+			auto cnt = (mark & 3) + 1;
+			if (dest + cnt > tail) {
+				return false;
+			}
+			auto fill = static_cast<uint32_t>(0) - static_cast<uint32_t>((mark>>2) & 1);
+			if (safe) {
+				memset(dest, static_cast<uint8_t>(fill), cnt);
+			} else {
+				memcpy(dest, &fill, 4);
+			}
+			dest += cnt;
+		} else if (mark != 0) {
+			auto l = mark;
+			if (src+l > end || dest+l > tail) {
+				return false;
+			}
+			if (!safe && src+8 <= end) {
+				memcpy(dest, src, 8);
+			} else {
+				memcpy(dest, src, l);
+			}
+			src += l;
+			dest += l;
+		}
+		return true;
+	};
+
+	if (room >= 15) {
+		// a mark gives 14 bytes at most, with 8 bytes stored at its last token
+		auto fast = dest + room - 15;
+		while (src < end && dest <= fast) {
+			auto mark = *src++;
+			if (!unpack(mark & 0xf, false) || !unpack(mark >> 4, false)) {
+				return false;
+			}
+		}
+	}
+	while (src < end) {
+		auto mark = *src++;
+		if (!unpack(mark & 0xf, true) || !unpack(mark >> 4, true)) {
+			return false;
+		}
+	}
+	return dest == tail;
+}
+
+static constexpr WordMarks MakeWordMarks() noexcept {
+	WordMarks out;
+	for (unsigned mark = 0; mark < 256; mark++) {
+		auto lo = mark & 0xfU;
+		auto hi = mark >> 4U;
+		out.bytes[mark] = (lo == kWordRun || hi == kWordRun) ? 0
+			: kWordPicks.codes[lo].width + kWordPicks.codes[hi].width;
+	}
+	return out;
+}
+
+static constexpr WordMarks kWordMarks = MakeWordMarks();
+
+static inline uint32_t ExpandWord(uint32_t v, const WordPick& pick) noexcept {
+	return ((((v >> pick.shift[0]) & 0xffU) | ((v >> pick.shift[1]) & 0xffU) << 8U
+		| ((v >> pick.shift[2]) & 0xffU) << 16U | (v >> pick.shift[3]) << 24U) & pick.keep) | pick.fill;
+}
+
+// Expands tokens of the word codec to exactly size bytes at dest.
+static bool UnpackWords(const uint8_t* src, const uint8_t* end, uint8_t* dest, size_t size) noexcept {
+	auto tail = dest + size;
+	while (dest < tail) {
+		if (src >= end) {
+			return false;
+		}
+		unsigned mark = *src++;
+		auto n = kWordMarks.bytes[mark];
+		if (n != 0 && end - src >= 8 && tail - dest >= 8) {
+			// two plain words, bytes of the mark are all in reach
+			auto& a = kWordPicks.codes[mark & 0xfU];
+			auto& b = kWordPicks.codes[mark >> 4U];
+			uint32_t v[2];
+			memcpy(&v[0], src, 4);
+			memcpy(&v[1], src + a.width, 4);
+			const uint32_t w[2] = {ExpandWord(v[0], a), ExpandWord(v[1], b)};
+			memcpy(dest, w, 8);
+			src += n;
+			dest += 8;
+			continue;
+		}
+		for (unsigned half = 0; half < 2 && dest < tail; half++, mark >>= 4U) {
+			auto code = mark & 0xfU;
+			if (code == kWordRun) {
+				if (src >= end) {
+					return false;
+				}
+				size_t l = (*src++ + 2U) * 4U;
+				if (static_cast<size_t>(end - src) < l || static_cast<size_t>(tail - dest) < l) {
+					return false;
+				}
+				// runs are mostly short, fixed copies beat a call
+				size_t k = 0;
+				for (; k + 8 <= l; k += 8) {
+					memcpy(dest + k, src + k, 8);
+				}
+				if (k < l) {
+					memcpy(dest + k, src + k, 4);
+				}
+				src += l;
+				dest += l;
+				continue;
+			}
+			auto& pick = kWordPicks.codes[code];
+			uint32_t v = 0;
+			if (end - src >= 4) {
+				memcpy(&v, src, 4);
+			} else if (end - src >= pick.width) {
+				memcpy(&v, src, pick.width);
+			} else {
+				return false;
+			}
+			auto w = ExpandWord(v, pick);
+			memcpy(dest, &w, 4);
+			src += pick.width;
+			dest += 4;
+		}
+	}
+	return src == end;
+}
+
+// A mark byte of either codec expands to 8 bytes at most.
+static constexpr size_t kMaxExpansion = 8;
+
+// Parses the header of either codec, returns bytes of it, or 0 when it is
+// broken or claims more than the rest can expand to, so no caller allocates
+// for a forged size.
+static unsigned ParseHeader(const uint8_t* src, const uint8_t* end, size_t* size, CodecVersion* version) noexcept {
+	*version = CODEC_BYTES;
+	unsigned n = 0;
+	if (src < end && *src == kWordCodecTag) {
+		*version = CODEC_WORDS;
+		n = 1;
+	}
+	auto m = ParseSize(src + n, end, size);
+	if (m == 0) {
+		return 0;
+	}
+	if (*version == CODEC_WORDS) {
+		if (*size > SIZE_MAX / 4) {
+			return 0;	// 32-bit size_t
+		}
+		*size *= 4;
+	}
+	if (*size > static_cast<size_t>(end - src - (n + m)) * kMaxExpansion) {
+		return 0;
+	}
+	return n + m;
+}
+
+static bool Expand(const uint8_t* src, const uint8_t* end, uint8_t* dest, size_t size, size_t room,
+				   CodecVersion version) noexcept {
+	if (version == CODEC_WORDS) {
+		return UnpackWords(src, end, dest, size);
+	}
+	return Unpack(src, end, dest, size, room);
+}
+
+bool DecompressedSize(const uint8_t* src, size_t len, size_t* size) noexcept {
+	*size = 0;
+	CodecVersion version;
+	return len == 0 || ParseHeader(src, src + len, size, &version) != 0;
+}
+
+bool Decompress(const uint8_t* src, size_t len, std::string* out) {
+	out->clear();
+	if (len == 0) {
+		return true;
+	}
+	auto end = src + len;
+	size_t size = 0;
+	CodecVersion version;
+	auto n = ParseHeader(src, end, &size, &version);
+	if (n == 0) {
+		return false;
+	}
+	out->resize(size+7);	// extra space for fast fill
+	auto dest = reinterpret_cast<uint8_t*>(const_cast<char*>(out->data()));
+	auto done = Expand(src + n, end, dest, size, size+7, version);
+	out->resize(size);
+	return done;
+}
+
+bool Decompress(const uint8_t* src, size_t len, uint32_t* region, size_t words) noexcept {
+	size_t size = 0;
+	CodecVersion version = CODEC_BYTES;
+	auto n = len == 0 ? 0 : ParseHeader(src, src + len, &size, &version);
+	if (len != 0 && n == 0) {
+		return false;
+	}
+	if (WordSize(size) > words) {
+		return false;
+	}
+	auto dest = reinterpret_cast<uint8_t*>(region);
+	if (size != 0 && !Expand(src + n, src + len, dest, size, WordSize(size)*4, version)) {
+		return false;
+	}
+	memset(dest + size, 0, WordSize(size)*4 - size);
+	return true;
+}
+
+bool Decompress(const uint8_t* src, size_t len, Buffer* buf) {
+	buf->Clear();
+	size_t size = 0;
+	if (!DecompressedSize(src, len, &size)) {
+		return false;
+	}
+	auto words = WordSize(size);
+	if (words == 0) {
+		return true;
+	}
+	auto dest = buf->Expand(words);
+	if (dest == nullptr || !Decompress(src, len, dest, words)) {
+		buf->Clear();
+		return false;
+	}
+	return true;
+}
+
+} // protocache
@@ -0,0 +1,193 @@
+// Copyright (c) 2023, Ruan Kunliang.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include <string>
+#include <vector>
+#if defined(PROTOCACHE_WITH_ZSTD)
+#include <zstd.h>
+#include <zdict.h>
+#endif
+#include "protocache/utils.h"
+
+namespace protocache {
+
+#if defined(PROTOCACHE_WITH_ZSTD)
+struct Dictionary::State {
+	std::string data;
+	ZSTD_CDict* cdict = nullptr;
+	ZSTD_DDict* ddict = nullptr;
+
+	~State() noexcept {
+		ZSTD_freeCDict(cdict);
+		ZSTD_freeDDict(ddict);
+	}
+};
+
+// Contexts are kept per thread, as records are small and many.
+struct ZstdContexts {
+	ZSTD_CCtx* cctx = nullptr;
+	ZSTD_DCtx* dctx = nullptr;
+
+	~ZstdContexts() noexcept {
+		ZSTD_freeCCtx(cctx);
+		ZSTD_freeDCtx(dctx);
+	}
+};
+
+static thread_local ZstdContexts g_zstd;
+
+Dictionary Dictionary::Load(const Slice<uint8_t>& data, int level) {
+	Dictionary out;
+	if (data.size() == 0) {
+		return out;
+	}
+	std::unique_ptr<State> state(new State);
+	state->data.assign(reinterpret_cast<const char*>(data.data()), data.size());
+	state->cdict = ZSTD_createCDict(state->data.data(), state->data.size(), level);
+	state->ddict = ZSTD_createDDict(state->data.data(), state->data.size());
+	if (state->cdict == nullptr || state->ddict == nullptr) {
+		return out;
+	}
+	out.state_ = std::move(state);
+	return out;
+}
+
+Dictionary Dictionary::Train(const std::vector<std::string>& samples, size_t capacity, int level) {
+	std::string all;
+	std::vector<size_t> sizes;
+	sizes.reserve(samples.size());
+	for (auto& sample : samples) {
+		all += sample;
+		sizes.push_back(sample.size());
+	}
+	std::string dict(capacity, '\0');
+	auto n = ZDICT_trainFromBuffer(const_cast<char*>(dict.data()), dict.size(),
+								   all.data(), sizes.data(), sizes.size());
+	if (ZDICT_isError(n)) {
+		return {};
+	}
+	return Load(Slice<uint8_t>(reinterpret_cast<const uint8_t*>(dict.data()), n), level);
+}
+
+bool Compress(const uint8_t* src, size_t len, std::string* out, const Dictionary& dict) {
+	out->clear();
+	if (!dict) {
+		return false;
+	}
+	if (g_zstd.cctx == nullptr) {
+		g_zstd.cctx = ZSTD_createCCtx();
+		if (g_zstd.cctx == nullptr) {
+			return false;
+		}
+	}
+	out->resize(ZSTD_compressBound(len));
+	auto n = ZSTD_compress_usingCDict(g_zstd.cctx, const_cast<char*>(out->data()), out->size(),
+									  src, len, dict.state_->cdict);
+	if (ZSTD_isError(n)) {
+		out->clear();
+		return false;
+	}
+	out->resize(n);
+	return true;
+}
+
+// Decompresses the frame to size bytes at dest.
+static bool UnpackFrame(const uint8_t* src, size_t len, void* dest, size_t size, const ZSTD_DDict* ddict) noexcept {
+	if (g_zstd.dctx == nullptr) {
+		g_zstd.dctx = ZSTD_createDCtx();
+		if (g_zstd.dctx == nullptr) {
+			return false;
+		}
+	}
+	auto n = ZSTD_decompress_usingDDict(g_zstd.dctx, dest, size, src, len, ddict);
+	return !ZSTD_isError(n) && n == size;
+}
+
+// The size comes from the frame, check it before trusting it.
+static bool FrameSize(const uint8_t* src, size_t len, size_t max_size, size_t* size) noexcept {
+	auto n = ZSTD_getFrameContentSize(src, len);
+	if (n == ZSTD_CONTENTSIZE_UNKNOWN || n == ZSTD_CONTENTSIZE_ERROR || n > max_size) {
+		return false;
+	}
+	*size = n;
+	return true;
+}
+
+bool Decompress(const uint8_t* src, size_t len, std::string* out, const Dictionary& dict, size_t max_size) {
+	out->clear();
+	size_t size = 0;
+	if (!dict || !FrameSize(src, len, max_size, &size)) {
+		return false;
+	}
+	out->resize(size);
+	if (!UnpackFrame(src, len, const_cast<char*>(out->data()), size, dict.state_->ddict)) {
+		out->clear();
+		return false;
+	}
+	return true;
+}
+
+bool Decompress(const uint8_t* src, size_t len, Buffer* buf, const Dictionary& dict, size_t max_size) {
+	buf->Clear();
+	size_t size = 0;
+	if (!dict || !FrameSize(src, len, max_size, &size)) {
+		return false;
+	}
+	auto words = WordSize(size);
+	auto dest = buf->Expand(words);
+	if (words != 0) {
+		if (dest == nullptr) {
+			return false;
+		}
+		dest[words-1] = 0;	// zero the pad
+	}
+	if (!UnpackFrame(src, len, dest, size, dict.state_->ddict)) {
+		buf->Clear();
+		return false;
+	}
+	return true;
+}
+#else
+// built without zstd, all fail
+struct Dictionary::State {
+	std::string data;
+};
+
+Dictionary Dictionary::Load(const Slice<uint8_t>&, int) {
+	return {};
+}
+
+Dictionary Dictionary::Train(const std::vector<std::string>&, size_t, int) {
+	return {};
+}
+
+bool Compress(const uint8_t*, size_t, std::string* out, const Dictionary&) {
+	out->clear();
+	return false;
+}
+
+bool Decompress(const uint8_t*, size_t, std::string* out, const Dictionary&, size_t) {
+	out->clear();
+	return false;
+}
+
+bool Decompress(const uint8_t*, size_t, Buffer* buf, const Dictionary&, size_t) {
+	buf->Clear();
+	return false;
+}
+#endif
+
+Dictionary::Dictionary() noexcept = default;
+Dictionary::Dictionary(Dictionary&&) noexcept = default;
+Dictionary& Dictionary::operator=(Dictionary&&) noexcept = default;
+Dictionary::~Dictionary() noexcept = default;
+
+Slice<uint8_t> Dictionary::Data() const noexcept {
+	if (state_ == nullptr) {
+		return {};
+	}
+	return {reinterpret_cast<const uint8_t*>(state_->data.data()), state_->data.size()};
+}
+
+} // protocache
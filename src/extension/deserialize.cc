@@ -12,6 +12,7 @@
 #include <google/protobuf/reflection.h>
 #include <google/protobuf/descriptor.pb.h>
 #include "protocache/access.h"
+#include "protocache/extension/utils.h"
 
 namespace protocache {
 
@@ -182,6 +183,21 @@ static bool DeserializeMap(const uint32_t* data, const uint32_t* end,
 	return true;
 }
 
+static bool DeserializeField(const Message& src, const uint32_t* end,
+							 const google::protobuf::FieldDescriptor* field, google::protobuf::Message* out) {
+	auto src_field = src.GetField(field->number() - 1, end);
+	if (!src_field) {
+		return true;
+	}
+	if (!field->is_repeated()) {
+		return DeserializeSingle(src_field, end, field, out);
+	} else if (field->is_map()) {
+		return DeserializeMap(src_field.GetObject(end), end, field, out);
+	} else {
+		return DeserializeArray(src_field.GetObject(end), end, field, out);
+	}
+}
+
 static bool Deserialize(const uint32_t* data, const uint32_t* end, google::protobuf::Message* out) {
 	const auto* descriptor = out->GetDescriptor();
 	const auto field_count = descriptor->field_count();
@@ -207,18 +223,483 @@ static bool Deserialize(const uint32_t* data, const uint32_t* end, google::proto
 		if (field->options().deprecated()) {
 			continue;
 		}
-		const auto id = field->number() - 1;
-		auto src_field = src.GetField(id, end);
+		if (!DeserializeField(src, end, field, out)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool Deserialize(const uint32_t* data, const uint32_t* end, const MaskTree& mask,
+						unsigned node, google::protobuf::Message* out) {
+	Message src(data, end);
+	if (!src) {
+		return false;
+	}
+	auto reflection = out->GetReflection();
+	for (auto& child : mask.Children(node)) {
+		if (child.node == MaskTree::kWhole) {
+			if (!DeserializeField(src, end, child.field, out)) {
+				return false;
+			}
+			continue;
+		}
+		auto src_field = src.GetField(child.field->number() - 1, end);
+		if (!src_field) {
+			continue;
+		}
+		if (!Deserialize(src_field.GetObject(end), end, mask, child.node,
+						 reflection->MutableMessage(out, child.field))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Deserialize(const Slice<uint32_t>& raw, const MaskTree& mask, google::protobuf::Message* message) {
+	if (!mask || mask.Root() != message->GetDescriptor()) {
+		return false;
+	}
+	message->Clear();
+	return Deserialize(raw.data(), raw.end(), mask, 0, message);
+}
+
+bool Deserialize(const Slice<uint32_t>& raw, const google::protobuf::FieldMask& mask,
+				 google::protobuf::Message* message) {
+	return Deserialize(raw, MaskTree::Compile(message->GetDescriptor(), mask), message);
+}
+
+static bool IsAlias(const google::protobuf::Descriptor* descriptor) noexcept {
+	if (descriptor->field_count() != 1) {
+		return false;
+	}
+	auto field = descriptor->field(0);
+	return field->name() == "_" && field->number() == 1;
+}
+
+MaskTree MaskTree::Compile(const google::protobuf::Descriptor* descriptor, const google::protobuf::FieldMask& mask) {
+	MaskTree out;
+	if (IsAlias(descriptor)) {
+		return out;		// no field to pick
+	}
+	out.nodes_.emplace_back();
+	for (auto& path : mask.paths()) {
+		unsigned node = 0;
+		auto type = descriptor;
+		size_t pos = 0;
+		while (node != kWhole) {
+			auto next = path.find('.', pos);
+			auto name = path.substr(pos, next == std::string::npos ? std::string::npos : next - pos);
+			auto field = type->FindFieldByName(name);
+			if (field == nullptr || field->options().deprecated()) {
+				return {};
+			}
+			auto& children = out.nodes_[node].children;
+			auto it = std::find_if(children.begin(), children.end(),
+								   [field](const Child& one) { return one.field == field; });
+			if (next == std::string::npos) {
+				// the whole field, covers paths under it
+				if (it == children.end()) {
+					children.push_back({field, kWhole});
+				} else {
+					it->node = kWhole;
+				}
+				break;
+			}
+			// only singular messages can be walked through
+			if (field->is_repeated() || field->type() != google::protobuf::FieldDescriptor::Type::TYPE_MESSAGE) {
+				return {};
+			}
+			type = field->message_type();
+			pos = next + 1;
+			if (it != children.end()) {
+				node = it->node;
+				continue;
+			}
+			if (IsAlias(type)) {
+				// an alias is stored as a bare array or map, take it all
+				children.push_back({field, kWhole});
+				break;
+			}
+			node = out.nodes_.size();
+			children.push_back({field, node});
+			out.nodes_.emplace_back();	// children is invalid from here
+		}
+	}
+	out.descriptor_ = descriptor;
+	return out;
+}
+
+// Protobuf wire format is written by two walks of the same code. The first one
+// counts bytes and records the length of every length-delimited record in
+// pre-order, the second one writes into the exact sized output.
+static constexpr unsigned kWireVarint = 0;
+static constexpr unsigned kWireFixed64 = 1;
+static constexpr unsigned kWireBytes = 2;
+static constexpr unsigned kWireFixed32 = 5;
+static constexpr unsigned kWireDepthLimit = 100;
+
+static inline size_t VarintSize(uint64_t v) noexcept {
+	size_t n = 1;
+	while (v >= 0x80U) {
+		v >>= 7U;
+		n++;
+	}
+	return n;
+}
+
+class WireCounter final {
+public:
+	explicit WireCounter(std::vector<uint32_t>& lengths) : lengths_(lengths) {}
+
+	size_t Size() const noexcept {
+		return size_;
+	}
+	void Varint(uint64_t v) noexcept {
+		size_ += VarintSize(v);
+	}
+	void Fixed32(uint32_t) noexcept {
+		size_ += 4;
+	}
+	void Fixed64(uint64_t) noexcept {
+		size_ += 8;
+	}
+	void Bytes(const Slice<char>& data) noexcept {
+		size_ += VarintSize(data.size()) + data.size();
+	}
+	size_t Open() {
+		lengths_.push_back(0);
+		return size_;
+	}
+	// length of a record is counted after its content
+	bool Close(size_t mark, size_t idx) {
+		auto len = size_ - mark;
+		if (len > INT32_MAX) {
+			return false;
+		}
+		lengths_[idx] = len;
+		size_ += VarintSize(len);
+		return true;
+	}
+	size_t Next() const noexcept {
+		return lengths_.size();
+	}
+
+private:
+	std::vector<uint32_t>& lengths_;
+	size_t size_ = 0;
+};
+
+class WireWriter final {
+public:
+	WireWriter(const std::vector<uint32_t>& lengths, uint8_t* out) : lengths_(lengths), out_(out) {}
+
+	void Varint(uint64_t v) noexcept {
+		while (v >= 0x80U) {
+			*out_++ = static_cast<uint8_t>(v | 0x80U);
+			v >>= 7U;
+		}
+		*out_++ = static_cast<uint8_t>(v);
+	}
+	void Fixed32(uint32_t v) noexcept {
+		memcpy(out_, &v, 4);
+		out_ += 4;
+	}
+	void Fixed64(uint64_t v) noexcept {
+		memcpy(out_, &v, 8);
+		out_ += 8;
+	}
+	void Bytes(const Slice<char>& data) noexcept {
+		Varint(data.size());
+		if (!data.empty()) {
+			memcpy(out_, data.data(), data.size());
+			out_ += data.size();
+		}
+	}
+	size_t Open() noexcept {
+		Varint(lengths_[next_++]);
+		return 0;
+	}
+	bool Close(size_t, size_t) noexcept {
+		return true;
+	}
+	size_t Next() const noexcept {
+		return next_;
+	}
+
+private:
+	const std::vector<uint32_t>& lengths_;
+	uint8_t* out_;
+	size_t next_ = 0;
+};
+
+template <typename Sink>
+static inline void WireTag(int number, unsigned type, Sink& sink) {
+	sink.Varint((static_cast<uint32_t>(number) << 3U) | type);
+}
+
+static unsigned WireTypeOf(const google::protobuf::FieldDescriptor* field) noexcept {
+	switch (field->type()) {
+		case google::protobuf::FieldDescriptor::Type::TYPE_DOUBLE:
+		case google::protobuf::FieldDescriptor::Type::TYPE_FIXED64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SFIXED64:
+			return kWireFixed64;
+		case google::protobuf::FieldDescriptor::Type::TYPE_FLOAT:
+		case google::protobuf::FieldDescriptor::Type::TYPE_FIXED32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SFIXED32:
+			return kWireFixed32;
+		case google::protobuf::FieldDescriptor::Type::TYPE_MESSAGE:
+		case google::protobuf::FieldDescriptor::Type::TYPE_BYTES:
+		case google::protobuf::FieldDescriptor::Type::TYPE_STRING:
+			return kWireBytes;
+		default:
+			return kWireVarint;
+	}
+}
+
+// Writes the payload of a scalar from ProtoCache cells. Returns false for
+// types which are not scalars.
+template <typename Sink>
+static bool EmitScalar(const Slice<uint32_t>& cells, const google::protobuf::FieldDescriptor* field, Sink& sink) {
+	uint32_t u32 = cells[0];
+	uint64_t u64 = u32;
+	if (cells.size() > 1) {
+		u64 |= static_cast<uint64_t>(cells[1]) << 32U;
+	}
+	switch (field->type()) {
+		case google::protobuf::FieldDescriptor::Type::TYPE_DOUBLE:
+		case google::protobuf::FieldDescriptor::Type::TYPE_FIXED64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SFIXED64:
+			sink.Fixed64(u64);
+			return true;
+		case google::protobuf::FieldDescriptor::Type::TYPE_FLOAT:
+		case google::protobuf::FieldDescriptor::Type::TYPE_FIXED32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SFIXED32:
+			sink.Fixed32(u32);
+			return true;
+		case google::protobuf::FieldDescriptor::Type::TYPE_UINT64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_INT64:
+			sink.Varint(u64);
+			return true;
+		case google::protobuf::FieldDescriptor::Type::TYPE_SINT64:
+			sink.Varint((u64 << 1U) ^ static_cast<uint64_t>(static_cast<int64_t>(u64) >> 63U));
+			return true;
+		case google::protobuf::FieldDescriptor::Type::TYPE_UINT32:
+			sink.Varint(u32);
+			return true;
+		case google::protobuf::FieldDescriptor::Type::TYPE_INT32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_ENUM:
+			sink.Varint(static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(u32))));
+			return true;
+		case google::protobuf::FieldDescriptor::Type::TYPE_SINT32:
+			sink.Varint((u32 << 1U) ^ static_cast<uint32_t>(static_cast<int32_t>(u32) >> 31U));
+			return true;
+		case google::protobuf::FieldDescriptor::Type::TYPE_BOOL:
+			sink.Varint(u32 != 0);
+			return true;
+		default:
+			return false;
+	}
+}
+
+template <typename Sink>
+static bool EmitMessage(const uint32_t* data, const uint32_t* end,
+						const google::protobuf::Descriptor* descriptor, Sink& sink, unsigned depth);
+
+// Writes a single value with its tag, the value of a message field is a record.
+template <typename Sink>
+static bool EmitSingle(const Field& src, const uint32_t* end,
+					   const google::protobuf::FieldDescriptor* field, int number, Sink& sink, unsigned depth) {
+	auto type = WireTypeOf(field);
+	switch (field->type()) {
+		case google::protobuf::FieldDescriptor::Type::TYPE_MESSAGE:
+		{
+			WireTag(number, type, sink);
+			auto idx = sink.Next();
+			auto mark = sink.Open();
+			return EmitMessage(src.GetObject(end), end, field->message_type(), sink, depth+1)
+				&& sink.Close(mark, idx);
+		}
+		case google::protobuf::FieldDescriptor::Type::TYPE_BYTES:
+		case google::protobuf::FieldDescriptor::Type::TYPE_STRING:
+		{
+			auto str = FieldT<Slice<char>>(src).Get(end);
+			if (!str) {
+				return false;
+			}
+			WireTag(number, type, sink);
+			sink.Bytes(str);
+			return true;
+		}
+		default:
+		{
+			auto cells = src.GetValue(end);
+			if (!cells) {
+				return false;
+			}
+			WireTag(number, type, sink);
+			return EmitScalar(cells, field, sink);
+		}
+	}
+}
+
+// Single fields with implicit presence are not written when zero, like protobuf.
+static bool IsDefault(const Field& src, const uint32_t* end,
+					  const google::protobuf::FieldDescriptor* field) noexcept {
+	if (field->has_presence()) {
+		return false;
+	}
+	switch (field->type()) {
+		case google::protobuf::FieldDescriptor::Type::TYPE_BYTES:
+		case google::protobuf::FieldDescriptor::Type::TYPE_STRING:
+			return FieldT<Slice<char>>(src).Get(end).empty();
+		default:
+			for (auto cell : src.GetValue(end)) {
+				if (cell != 0) {
+					return false;
+				}
+			}
+			return true;
+	}
+}
+
+template <typename Sink>
+static bool EmitArray(const uint32_t* data, const uint32_t* end,
+					  const google::protobuf::FieldDescriptor* field, Sink& sink, unsigned depth) {
+	if (field->type() == google::protobuf::FieldDescriptor::Type::TYPE_BOOL) {
+		// bool array is stored as bytes
+		auto flags = String(data, end).GetBoolArray();
+		if (!flags) {
+			return false;
+		} else if (flags.empty()) {
+			return true;
+		}
+		if (field->is_packed()) {
+			WireTag(field->number(), kWireBytes, sink);
+			auto idx = sink.Next();
+			auto mark = sink.Open();
+			for (auto one : flags) {
+				sink.Varint(one);
+			}
+			return sink.Close(mark, idx);
+		}
+		for (auto one : flags) {
+			WireTag(field->number(), kWireVarint, sink);
+			sink.Varint(one);
+		}
+		return true;
+	}
+	Array array(data, end);
+	if (!array) {
+		return false;
+	} else if (array.Size() == 0) {
+		return true;
+	}
+	if (field->is_packed()) {
+		WireTag(field->number(), kWireBytes, sink);
+		auto idx = sink.Next();
+		auto mark = sink.Open();
+		for (auto one : array) {
+			if (!EmitScalar(one.GetValue(end), field, sink)) {
+				return false;
+			}
+		}
+		return sink.Close(mark, idx);
+	}
+	for (auto one : array) {
+		if (!EmitSingle(one, end, field, field->number(), sink, depth)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+template <typename Sink>
+static bool EmitMap(const uint32_t* data, const uint32_t* end,
+					const google::protobuf::FieldDescriptor* field, Sink& sink, unsigned depth) {
+	Map map(data, end);
+	if (!map) {
+		return false;
+	}
+	auto key_field = field->message_type()->map_key();
+	auto value_field = field->message_type()->map_value();
+	if (key_field->type() == google::protobuf::FieldDescriptor::Type::TYPE_BOOL) {
+		return false;
+	}
+	// protobuf writes both key and value of an entry, even when zero
+	for (auto pair : map) {
+		WireTag(field->number(), kWireBytes, sink);
+		auto idx = sink.Next();
+		auto mark = sink.Open();
+		if (!EmitSingle(pair.Key(), end, key_field, 1, sink, depth)
+			|| !EmitSingle(pair.Value(), end, value_field, 2, sink, depth)
+			|| !sink.Close(mark, idx)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+template <typename Sink>
+static bool EmitMessage(const uint32_t* data, const uint32_t* end,
+						const google::protobuf::Descriptor* descriptor, Sink& sink, unsigned depth) {
+	if (depth > kWireDepthLimit) {
+		return false;
+	}
+	const auto field_count = descriptor->field_count();
+	if (field_count == 1) {
+		if (const auto* field = descriptor->field(0); field->name() == "_" && field->number() == 1) {	// wrapper
+			if (!field->is_repeated()) {
+				return false;
+			} else if (field->is_map()) {
+				return EmitMap(data, end, field, sink, depth);
+			} else {
+				return EmitArray(data, end, field, sink, depth);
+			}
+		}
+	}
+
+	Message src(data, end);
+	if (!src) {
+		return false;
+	}
+
+	// protobuf writes fields in order of number
+	const google::protobuf::FieldDescriptor* sorted[64];
+	std::vector<const google::protobuf::FieldDescriptor*> more;
+	const google::protobuf::FieldDescriptor** fields = sorted;
+	if (field_count > 64) {
+		more.resize(field_count);
+		fields = more.data();
+	}
+	bool in_order = true;
+	for (int i = 0; i < field_count; i++) {
+		fields[i] = descriptor->field(i);
+		if (i != 0 && fields[i]->number() < fields[i-1]->number()) {
+			in_order = false;
+		}
+	}
+	if (!in_order) {
+		std::sort(fields, fields+field_count, [](const google::protobuf::FieldDescriptor* a,
+			const google::protobuf::FieldDescriptor* b) { return a->number() < b->number(); });
+	}
+
+	for (int i = 0; i < field_count; i++) {
+		const auto* field = fields[i];
+		if (field->options().deprecated()) {
+			continue;
+		}
+		auto src_field = src.GetField(field->number() - 1, end);
 		if (!src_field) {
 			continue;
 		}
 		bool ok = false;
 		if (!field->is_repeated()) {
-			ok = DeserializeSingle(src_field, end, field, out);
+			ok = IsDefault(src_field, end, field) || EmitSingle(src_field, end, field, field->number(), sink, depth);
 		} else if (field->is_map()) {
-			ok = DeserializeMap(src_field.GetObject(end), end, field, out);
+			ok = EmitMap(src_field.GetObject(end), end, field, sink, depth);
 		} else {
-			ok = DeserializeArray(src_field.GetObject(end), end, field, out);
+			ok = EmitArray(src_field.GetObject(end), end, field, sink, depth);
 		}
 		if (!ok) {
 			return false;
@@ -227,4 +708,17 @@ static bool Deserialize(const uint32_t* data, const uint32_t* end, google::proto
 	return true;
 }
 
+bool DeserializeToWire(const Slice<uint32_t>& raw, const google::protobuf::Descriptor* descriptor,
+					   std::string* out) {
+	thread_local std::vector<uint32_t> lengths;
+	lengths.clear();
+	WireCounter counter(lengths);
+	if (!EmitMessage(raw.data(), raw.end(), descriptor, counter, 0)) {
+		return false;
+	}
+	out->resize(counter.Size());
+	WireWriter writer(lengths, reinterpret_cast<uint8_t*>(out->data()));
+	return EmitMessage(raw.data(), raw.end(), descriptor, writer, 0);
+}
+
 } // protocache
@@ -4,6 +4,7 @@
 
 #include "protocache/extension/reflection.h"
 #include <string_view>
+#include "protocache/access.h"
 
 namespace protocache {
 namespace reflection {
@@ -254,5 +255,224 @@ bool DescriptorPool::Register(const google::protobuf::FileDescriptorProto& proto
 	return true;
 }
 
+static const Descriptor* ValueDescriptor(DescriptorPool& pool, const Field& field) {
+	if (field.value_descriptor != nullptr) {
+		return field.value_descriptor;
+	}
+	auto& name = field.value_type;
+	if (!name.empty() && name[0] == '.') {
+		return pool.Find(name.substr(1));
+	}
+	return pool.Find(name);
+}
+
+static const Field* FieldById(const Descriptor& descriptor, unsigned id) noexcept {
+	for (auto& [_, field] : descriptor.fields) {
+		if (field.id == id) {
+			return &field;
+		}
+	}
+	return nullptr;
+}
+
+static inline bool IsObject(Field::Type type) noexcept {
+	return type == Field::TYPE_MESSAGE || type == Field::TYPE_BYTES || type == Field::TYPE_STRING;
+}
+
+static inline Slice<uint32_t> Extend(const Slice<uint32_t>& view, const Slice<uint32_t>& tail) noexcept {
+	if (tail.end() > view.end()) {
+		return {view.data(), static_cast<size_t>(tail.end()-view.data())};
+	}
+	return view;
+}
+
+// Mirrors Detect of generated code. An object and its children are placed
+// together, children of later fields or elements at higher addresses.
+static Slice<uint32_t> DetectMessage(const uint32_t* ptr, const uint32_t* end, const Descriptor* descriptor,
+									 DescriptorPool& pool, unsigned depth);
+
+static Slice<uint32_t> DetectValue(const protocache::Field& cell, const uint32_t* end, Field::Type type,
+								   const Descriptor* descriptor, DescriptorPool& pool, unsigned depth) {
+	switch (type) {
+		case Field::TYPE_MESSAGE:
+			return DetectMessage(cell.GetObject(end), end, descriptor, pool, depth);
+		case Field::TYPE_BYTES:
+		case Field::TYPE_STRING:
+			return String::Detect(cell.GetObject(end), end);
+		default:
+			return cell.GetValue(end);
+	}
+}
+
+static Slice<uint32_t> DetectCollection(const uint32_t* ptr, const uint32_t* end, const Field& field,
+										DescriptorPool& pool, unsigned depth) {
+	if (depth >= kVerifyDepthLimit) {
+		return {};
+	}
+	if (field.IsMap()) {
+		auto view = Map::Detect(ptr, end);
+		if (!view || (!IsObject(field.key) && !IsObject(field.value))) {
+			return view;
+		}
+		const Descriptor* descriptor = nullptr;
+		if (field.value == Field::TYPE_MESSAGE) {
+			descriptor = ValueDescriptor(pool, field);
+		}
+		Map core(ptr);
+		for (auto it = core.end(); it != core.begin();) {
+			Pair pair(*--it);
+			if (IsObject(field.value)) {
+				auto t = DetectValue(pair.Value(), end, field.value, descriptor, pool, depth+1);
+				if (t.end() > view.end()) {
+					return Extend(view, t);
+				}
+			}
+			if (IsObject(field.key)) {
+				auto t = DetectValue(pair.Key(), end, field.key, nullptr, pool, depth+1);
+				if (t.end() > view.end()) {
+					return Extend(view, t);
+				}
+			}
+		}
+		return view;
+	}
+	if (field.value == Field::TYPE_BOOL) {
+		return String::Detect(ptr, end);	// bool array is stored as bytes
+	}
+	auto view = Array::Detect(ptr, end);
+	if (!view || !IsObject(field.value)) {
+		return view;
+	}
+	const Descriptor* descriptor = nullptr;
+	if (field.value == Field::TYPE_MESSAGE) {
+		descriptor = ValueDescriptor(pool, field);
+	}
+	Array core(ptr);
+	for (auto it = core.end(); it != core.begin();) {
+		auto t = DetectValue(*--it, end, field.value, descriptor, pool, depth+1);
+		if (t.end() > view.end()) {
+			return Extend(view, t);
+		}
+	}
+	return view;
+}
+
+static Slice<uint32_t> DetectField(const Message& core, const Field& field, const uint32_t* end,
+								   DescriptorPool& pool, unsigned depth) {
+	auto cell = core.GetField(field.id, end);
+	if (field.repeated) {
+		return DetectCollection(cell.GetObject(end), end, field, pool, depth);
+	}
+	const Descriptor* descriptor = nullptr;
+	if (field.value == Field::TYPE_MESSAGE) {
+		descriptor = ValueDescriptor(pool, field);
+	}
+	return DetectValue(cell, end, field.value, descriptor, pool, depth);
+}
+
+static Slice<uint32_t> DetectMessage(const uint32_t* ptr, const uint32_t* end, const Descriptor* descriptor,
+									 DescriptorPool& pool, unsigned depth) {
+	if (descriptor == nullptr || depth >= kVerifyDepthLimit) {
+		return {};
+	}
+	if (descriptor->IsAlias()) {
+		return DetectCollection(ptr, end, descriptor->alias, pool, depth+1);
+	}
+	auto view = Message::Detect(ptr, end);
+	if (!view) {
+		return {};
+	}
+	// the object placed last holds the tail
+	Message core(ptr, end);
+	const Field* last = nullptr;
+	const uint32_t* top = nullptr;
+	for (auto& [_, field] : descriptor->fields) {
+		if (!field.repeated && !IsObject(field.value)) {
+			continue;
+		}
+		auto obj = core.GetField(field.id, end).GetObject(end);
+		if (obj != nullptr && obj >= view.end() && obj > top) {
+			top = obj;
+			last = &field;
+		}
+	}
+	if (last == nullptr) {
+		return view;
+	}
+	return Extend(view, DetectField(core, *last, end, pool, depth+1));
+}
+
+bool BuildFieldTree(DescriptorPool& pool, const Descriptor& descriptor,
+					const google::protobuf::FieldMask& mask, FieldTree* tree) {
+	*tree = FieldTree();
+	std::vector<unsigned> ids;
+	for (auto& path : mask.paths()) {
+		ids.clear();
+		auto type = &descriptor;
+		size_t pos = 0;
+		while (true) {
+			auto next = path.find('.', pos);
+			auto name = path.substr(pos, next == std::string::npos ? std::string::npos : next - pos);
+			if (type == nullptr) {
+				return false;
+			}
+			auto it = type->fields.find(name);
+			if (it == type->fields.end()) {
+				return false;
+			}
+			auto& field = it->second;
+			ids.push_back(field.id);
+			if (next == std::string::npos) {
+				break;
+			}
+			// only singular messages can be walked through
+			if (field.repeated || field.value != Field::TYPE_MESSAGE) {
+				return false;
+			}
+			type = ValueDescriptor(pool, field);
+			pos = next + 1;
+		}
+		tree->Add(ids.data(), ids.size());
+	}
+	return true;
+}
+
+static bool Project(const uint32_t* ptr, const uint32_t* end, const Descriptor& descriptor, const FieldTree& tree,
+					unsigned node, DescriptorPool& pool, Buffer& buf, Unit& unit) {
+	if (descriptor.IsAlias()) {
+		return false;
+	}
+	Message core(ptr, end);
+	if (!core) {
+		return false;
+	}
+	return ProjectMessage(core, end, tree, node, buf, unit,
+						  [&core, end, &descriptor, &tree, &pool, &buf](unsigned id, unsigned sub, Unit& one) {
+		auto field = FieldById(descriptor, id);
+		if (field == nullptr) {
+			return false;
+		}
+		if (sub != FieldTree::kWhole && !field->repeated && field->value == Field::TYPE_MESSAGE) {
+			auto child = ValueDescriptor(pool, *field);
+			// an alias is stored as a bare array or map, keep it all
+			if (child != nullptr && !child->IsAlias()) {
+				if (!Project(core.GetField(id, end).GetObject(end), end, *child, tree, sub, pool, buf, one)) {
+					return false;
+				}
+				FoldNested(buf, one);
+				return true;
+			}
+		}
+		auto view = DetectField(core, *field, end, pool, 0);
+		return !!view && Copy(view, buf, one, true);
+	});
+}
+
+bool Project(const Slice<uint32_t>& data, DescriptorPool& pool, const Descriptor& descriptor,
+			 const FieldTree& tree, Buffer* buf) {
+	Unit dummy;
+	return Project(data.data(), data.end(), descriptor, tree, 0, pool, *buf, dummy);
+}
+
 } // reflection
 } // protocache
@@ -3,16 +3,21 @@
 // license that can be found in the LICENSE file.
 
 #include <cassert>
+#include <memory>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <algorithm>
 #include <type_traits>
+#include <unordered_map>
 #include <google/protobuf/message.h>
 #include <google/protobuf/reflection.h>
 #include <google/protobuf/descriptor.pb.h>
 #include "protocache/perfect_hash.h"
 #include "protocache/serialize.h"
+#include "protocache/builder.h"
+#include "protocache/extension/utils.h"
 
 namespace protocache {
 
@@ -73,11 +78,20 @@ bool SerializeContext::SerializeArray(const google::protobuf::RepeatedFieldRef<T
 		return false;
 	}
 	auto last = buf_.Size();
-	for (int i = array.size(); i-- > 0;) {
-		*reinterpret_cast<T*>(buf_.Expand(m)) = array.Get(i);
+	auto head = buf_.Expand(1 + m*array.size());
+	if (head == nullptr) {
+		return false;
+	}
+	*head = (array.size() << 2U) | m;
+	auto body = reinterpret_cast<T*>(head + 1);
+	for (int i = 0; i < array.size(); i++) {
+		T val = array.Get(i);
+		memcpy(body+i, &val, sizeof(T));
 	}
-	buf_.Put((array.size() << 2U) | m);
 	unit = Segment(last, buf_.Size());
+	if (buf_.Dedup() != nullptr) {
+		buf_.Dedup()->Leaf(buf_, unit);
+	}
 	return true;
 }
 
@@ -91,6 +105,16 @@ bool SerializeContext::SerializeArrayField(const google::protobuf::Message& mess
 		{
 			auto n = reflection->FieldSize(message, field);
 			std::vector<Unit> elements(n);
+			if (UseParallel(buf_, n)) {
+				if (!SerializeParallel(buf_, elements.data(), n, 1,
+						[&message, reflection, field](unsigned, size_t i, Buffer& buf, Unit* out)->bool {
+							SerializeContext ctx(buf);
+							return ctx.Serialize(reflection->GetRepeatedMessage(message, field, i), *out);
+						})) {
+					return false;
+				}
+				return ::protocache::SerializeArray(elements, buf_, last, unit);
+			}
 			for (int i = n-1; i >= 0; i--) {
 				if (!Serialize(reflection->GetRepeatedMessage(message, field, i), elements[i])) {
 					return false;
@@ -146,11 +170,18 @@ bool SerializeContext::SerializeArrayField(const google::protobuf::Message& mess
 			if (n >= (1U << 30U)) {
 				return false;
 			}
-			for (int i = n-1; i >= 0; i--) {
-				*reinterpret_cast<int32_t *>(buf_.Expand(1)) = reflection->GetRepeatedEnumValue(message, field, i);
+			auto head = buf_.Expand(1 + n);
+			if (head == nullptr) {
+				return false;
+			}
+			*head = (static_cast<uint32_t>(n) << 2U) | 1U;
+			for (int i = 0; i < n; i++) {
+				head[1+i] = reflection->GetRepeatedEnumValue(message, field, i);
 			}
-			buf_.Put((static_cast<uint32_t>(n) << 2U) | 1U);
 			unit = Segment(last, buf_.Size());
+			if (buf_.Dedup() != nullptr) {
+				buf_.Dedup()->Leaf(buf_, unit);
+			}
 			return true;
 		}
 		default:
@@ -233,9 +264,24 @@ bool SerializeContext::SerializeMapFieldByKey(
 		auto reflection = pair.GetReflection();
 		keys.push_back((reflection->*Getter)(pair, key_field));
 	}
+	std::vector<int> origin(keys.size());
+	for (size_t i = 0; i < origin.size(); i++) {
+		origin[i] = static_cast<int>(i);
+	}
+	if (buf_.Deterministic()) {
+		std::sort(origin.begin(), origin.end(), [&keys](int a, int b)->bool {
+			return keys[a] < keys[b];
+		});
+		std::vector<T> sorted;
+		sorted.reserve(keys.size());
+		for (auto i : origin) {
+			sorted.push_back(std::move(keys[i]));
+		}
+		keys.swap(sorted);
+	}
 
 	VectorReader<T> reader(keys);
-	auto index = PerfectHashObject::Build(reader, true);
+	auto index = PerfectHashObject::Build(reader, true, buf_.Deterministic());
 	if (!index) {
 		return false;
 	}
@@ -251,10 +297,32 @@ bool SerializeContext::SerializeMapFieldByKey(
 
 	auto last = buf_.Size();
 	std::vector<std::pair<Unit,Unit>> units(book.size());
+	if (value_field->type() == google::protobuf::FieldDescriptor::Type::TYPE_MESSAGE
+		&& UseParallel(buf_, book.size())) {
+		std::vector<std::unique_ptr<google::protobuf::Message>> scratch(buf_.Threads());
+		for (auto& one : scratch) {
+			one.reset(pairs.NewMessage());
+		}
+		std::vector<Unit> flat(book.size()*2);
+		if (!SerializeParallel(buf_, flat.data(), book.size(), 2,
+				[&](unsigned worker, size_t i, Buffer& buf, Unit* out)->bool {
+					auto pair_index = book[i];
+					auto& pair = pairs.Get(origin[pair_index], scratch[worker].get());
+					SerializeContext ctx(buf);
+					return ctx.SerializeSimpleField(pair, pair.GetReflection(), value_field, out[1])
+						&& ::protocache::Serialize(keys[pair_index], buf, out[0]);
+				})) {
+			return false;
+		}
+		for (size_t i = 0; i < units.size(); i++) {
+			units[i] = {flat[i*2], flat[i*2+1]};
+		}
+		return SerializeMap(index.Data(), units, buf_, last, unit);
+	}
 	std::unique_ptr<google::protobuf::Message> tmp(pairs.NewMessage());
 	for (size_t i = book.size(); i-- > 0;) {
 		auto pair_index = book[i];
-		auto& pair = pairs.Get(pair_index, tmp.get());
+		auto& pair = pairs.Get(origin[pair_index], tmp.get());
 		auto pair_reflection = pair.GetReflection();
 		if (!SerializeSimpleField(pair, pair_reflection, value_field, units[i].second)
 			|| !::protocache::Serialize(keys[pair_index], buf_, units[i].first)) {
@@ -338,9 +406,9 @@ bool SerializeContext::SerializeField(const google::protobuf::Message& message,
 	return true;
 }
 
-bool SerializeContext::Serialize(const google::protobuf::Message& message, Unit& unit) {
-	auto reflection = message.GetReflection();
-	auto descriptor = message.GetDescriptor();
+// fields indexed by id-1, nullptr for holes
+static bool CollectFields(const google::protobuf::Descriptor* descriptor,
+						  std::vector<const google::protobuf::FieldDescriptor*>& fields) {
 	auto field_count = descriptor->field_count();
 	if (field_count <= 0) {
 		return false;
@@ -356,7 +424,7 @@ bool SerializeContext::Serialize(const google::protobuf::Message& message, Unit&
 	if (max_id > (12 + 25*255) || (max_id - field_count > 6 && max_id > field_count*2)) {
 		return false;
 	}
-	std::vector<const google::protobuf::FieldDescriptor*> fields(max_id, nullptr);
+	fields.assign(max_id, nullptr);
 	for (int i = 0; i < field_count; i++) {
 		auto field = descriptor->field(i);
 		if (field->options().deprecated()) {
@@ -368,8 +436,21 @@ bool SerializeContext::Serialize(const google::protobuf::Message& message, Unit&
 		}
 		fields[j] = field;
 	}
+	return true;
+}
+
+static inline bool IsAliasField(const std::vector<const google::protobuf::FieldDescriptor*>& fields) {
+	return fields.size() == 1 && fields.front() != nullptr && fields.front()->name() == "_";
+}
+
+bool SerializeContext::Serialize(const google::protobuf::Message& message, Unit& unit) {
+	auto reflection = message.GetReflection();
+	std::vector<const google::protobuf::FieldDescriptor*> fields;
+	if (!CollectFields(message.GetDescriptor(), fields)) {
+		return false;
+	}
 
-	if (fields.size() == 1 && fields.front() != nullptr && fields.front()->name() == "_") {
+	if (IsAliasField(fields)) {
 		if (!fields.front()->is_repeated()
 			|| !SerializeField(message, reflection, fields.front(), unit)) {
 			return false;
@@ -403,4 +484,911 @@ bool SerializeContext::Serialize(const google::protobuf::Message& message, Unit&
 	return ::protocache::SerializeMessage(parts, buf_, last, unit);
 }
 
+class MeasureContext final {
+public:
+	bool Measure(const google::protobuf::Message& message, Unit& unit);
+
+private:
+	std::string tmp_str_;
+
+	bool MeasureSimpleField(const google::protobuf::Message& message,
+							const google::protobuf::Reflection* reflection,
+							const google::protobuf::FieldDescriptor* field, Unit& unit);
+
+	bool MeasureArrayField(const google::protobuf::Message& message,
+						   const google::protobuf::Reflection* reflection,
+						   const google::protobuf::FieldDescriptor* field, Unit& unit);
+
+	bool MeasureMapField(const google::protobuf::Message& message,
+						 const google::protobuf::Reflection* reflection,
+						 const google::protobuf::FieldDescriptor* field, Unit& unit);
+
+	bool MeasureField(const google::protobuf::Message& message,
+					  const google::protobuf::Reflection* reflection,
+					  const google::protobuf::FieldDescriptor* field, Unit& unit);
+};
+
+static bool MeasureScalarArray(size_t n, unsigned m, Unit& unit) {
+	if (n == 0) {
+		unit.len = 1;
+		return true;
+	} else if (m*n >= (1U << 30U)) {
+		return false;
+	}
+	unit = Segment(0, 1 + m*n);
+	return true;
+}
+
+bool MeasureContext::MeasureSimpleField(const google::protobuf::Message& message,
+										const google::protobuf::Reflection* reflection,
+										const google::protobuf::FieldDescriptor* field, Unit& unit) {
+	switch (field->type()) {
+		case google::protobuf::FieldDescriptor::Type::TYPE_MESSAGE:
+			return Measure(reflection->GetMessage(message, field), unit);
+		case google::protobuf::FieldDescriptor::Type::TYPE_BYTES:
+		case google::protobuf::FieldDescriptor::Type::TYPE_STRING:
+			return ::protocache::Measure(reflection->GetStringReference(message, field, &tmp_str_), unit);
+		case google::protobuf::FieldDescriptor::Type::TYPE_DOUBLE:
+		case google::protobuf::FieldDescriptor::Type::TYPE_FIXED64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_UINT64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SFIXED64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SINT64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_INT64:
+			unit.len = 2;
+			return true;
+		case google::protobuf::FieldDescriptor::Type::TYPE_FLOAT:
+		case google::protobuf::FieldDescriptor::Type::TYPE_FIXED32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_UINT32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SFIXED32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SINT32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_INT32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_BOOL:
+		case google::protobuf::FieldDescriptor::Type::TYPE_ENUM:
+			unit.len = 1;
+			return true;
+		default:
+			return false;
+	}
+}
+
+bool MeasureContext::MeasureArrayField(const google::protobuf::Message& message,
+									   const google::protobuf::Reflection* reflection,
+									   const google::protobuf::FieldDescriptor* field, Unit& unit) {
+	assert(field->is_repeated());
+	auto n = reflection->FieldSize(message, field);
+	switch (field->type()) {
+		case google::protobuf::FieldDescriptor::Type::TYPE_MESSAGE:
+		{
+			ArraySize elements;
+			for (int i = 0; i < n; i++) {
+				Unit one;
+				if (!Measure(reflection->GetRepeatedMessage(message, field, i), one)) {
+					return false;
+				}
+				elements.Add(one);
+			}
+			return MeasureArray(elements, unit);
+		}
+		case google::protobuf::FieldDescriptor::Type::TYPE_BYTES:
+		case google::protobuf::FieldDescriptor::Type::TYPE_STRING:
+		{
+			ArraySize elements;
+			for (int i = 0; i < n; i++) {
+				Unit one;
+				if (!::protocache::Measure(
+						reflection->GetRepeatedStringReference(message, field, i, &tmp_str_), one)) {
+					return false;
+				}
+				elements.Add(one);
+			}
+			return MeasureArray(elements, unit);
+		}
+		case google::protobuf::FieldDescriptor::Type::TYPE_DOUBLE:
+		case google::protobuf::FieldDescriptor::Type::TYPE_FIXED64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_UINT64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SFIXED64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SINT64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_INT64:
+			return MeasureScalarArray(n, 2, unit);
+		case google::protobuf::FieldDescriptor::Type::TYPE_FLOAT:
+		case google::protobuf::FieldDescriptor::Type::TYPE_FIXED32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_UINT32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SFIXED32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SINT32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_INT32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_ENUM:
+			return MeasureScalarArray(n, 1, unit);
+		case google::protobuf::FieldDescriptor::Type::TYPE_BOOL:
+			return MeasureString(n, unit);
+		default:
+			return false;
+	}
+}
+
+bool MeasureContext::MeasureMapField(const google::protobuf::Message& message,
+									 const google::protobuf::Reflection* reflection,
+									 const google::protobuf::FieldDescriptor* field, Unit& unit) {
+	assert(field->is_map());
+	auto key_field = field->message_type()->field(0);
+	auto value_field = field->message_type()->field(1);
+	switch (key_field->type()) {
+		case google::protobuf::FieldDescriptor::Type::TYPE_BYTES:
+		case google::protobuf::FieldDescriptor::Type::TYPE_STRING:
+		case google::protobuf::FieldDescriptor::Type::TYPE_FIXED64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_UINT64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_FIXED32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_UINT32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SFIXED64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SINT64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_INT64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SFIXED32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SINT32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_INT32:
+			break;
+		default:
+			return false;
+	}
+	auto pairs = reflection->GetRepeatedFieldRef<google::protobuf::Message>(message, field);
+	auto index_size = PerfectHash::DataSize(pairs.size());
+	if (index_size == 0) {
+		return false;
+	}
+	ArraySize keys;
+	ArraySize values;
+	for (auto& pair : pairs) {
+		auto pair_reflection = pair.GetReflection();
+		Unit key;
+		Unit value;
+		if (!MeasureSimpleField(pair, pair_reflection, key_field, key)
+			|| !MeasureSimpleField(pair, pair_reflection, value_field, value)) {
+			return false;
+		}
+		keys.Add(key);
+		values.Add(value);
+	}
+	return MeasureMap(index_size, keys, values, unit);
+}
+
+bool MeasureContext::MeasureField(const google::protobuf::Message& message,
+								  const google::protobuf::Reflection* reflection,
+								  const google::protobuf::FieldDescriptor* field, Unit& unit) {
+	if (field->is_repeated()) {
+		if (reflection->FieldSize(message, field) == 0) {
+			unit = {};
+			return true;
+		}
+		if (field->is_map()) {
+			return MeasureMapField(message, reflection, field, unit);
+		}
+		return MeasureArrayField(message, reflection, field, unit);
+	}
+	if (!reflection->HasField(message, field)) {
+		unit = {};
+		return true;
+	}
+	if (!MeasureSimpleField(message, reflection, field, unit)) {
+		return false;
+	}
+	if (unit.size() == 1 && field->type() == google::protobuf::FieldDescriptor::Type::TYPE_MESSAGE) {
+		unit = {};	// skip empty message field
+	}
+	return true;
+}
+
+bool MeasureContext::Measure(const google::protobuf::Message& message, Unit& unit) {
+	auto reflection = message.GetReflection();
+	std::vector<const google::protobuf::FieldDescriptor*> fields;
+	if (!CollectFields(message.GetDescriptor(), fields)) {
+		return false;
+	}
+
+	if (IsAliasField(fields)) {
+		if (!fields.front()->is_repeated()
+			|| !MeasureField(message, reflection, fields.front(), unit)) {
+			return false;
+		}
+		if (unit.size() == 0) {
+			unit.len = 1;
+		}
+		return true;
+	}
+
+	std::vector<Unit> parts(fields.size());
+	for (size_t i = 0; i < fields.size(); i++) {
+		if (fields[i] == nullptr) {
+			continue;
+		}
+		if (!MeasureField(message, reflection, fields[i], parts[i])) {
+			return false;
+		}
+		FoldSize(parts[i]);
+	}
+	return MeasureMessage(parts, unit);
+}
+
+bool SerializedSize(const google::protobuf::Message& message, size_t* size) {
+	Unit unit;
+	MeasureContext ctx;
+	if (!ctx.Measure(message, unit)) {
+		return false;
+	}
+	*size = unit.len == 0 ? unit.seg.len : 0;	// inline unit is not written
+	return true;
+}
+
+bool SerializeToFile(const google::protobuf::Message& message, const std::string& path) {
+	size_t size = 0;
+	if (!SerializedSize(message, &size) || size == 0) {
+		return false;
+	}
+	auto out = MappedOutput::Create(path, size*sizeof(uint32_t));
+	if (!out) {
+		return false;
+	}
+	Buffer buf(out.Data(), size);
+	return Serialize(message, &buf) && buf.Size() == size;
+}
+
+// Wire format of protobuf, see https://protobuf.dev/programming-guides/encoding/
+static constexpr unsigned kWireVarint = 0;
+static constexpr unsigned kWireFixed64 = 1;
+static constexpr unsigned kWireBytes = 2;
+static constexpr unsigned kWireGroupStart = 3;
+static constexpr unsigned kWireGroupEnd = 4;
+static constexpr unsigned kWireFixed32 = 5;
+static constexpr unsigned kTranscodeDepthLimit = 100;	// same as protobuf
+
+static inline bool ReadVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v) noexcept {
+	v = 0;
+	for (unsigned shift = 0; shift < 64 && p < end; shift += 7) {
+		auto b = *p++;
+		v |= static_cast<uint64_t>(b & 0x7fU) << shift;
+		if ((b & 0x80U) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static inline bool ReadFixed(const uint8_t*& p, const uint8_t* end, unsigned size, uint64_t& v) noexcept {
+	if (end - p < size) {
+		return false;
+	}
+	v = 0;
+	memcpy(&v, p, size);	// little endian only
+	p += size;
+	return true;
+}
+
+// skip a value after its tag, a group is skipped as a whole
+static bool SkipValue(const uint8_t*& p, const uint8_t* end, uint64_t tag, unsigned depth) {
+	uint64_t v;
+	switch (tag & 7U) {
+		case kWireVarint:
+			return ReadVarint(p, end, v);
+		case kWireFixed64:
+			return ReadFixed(p, end, 8, v);
+		case kWireFixed32:
+			return ReadFixed(p, end, 4, v);
+		case kWireBytes:
+			if (!ReadVarint(p, end, v) || v > static_cast<uint64_t>(end - p)) {
+				return false;
+			}
+			p += v;
+			return true;
+		case kWireGroupStart:
+			if (depth >= kTranscodeDepthLimit) {
+				return false;
+			}
+			while (true) {
+				uint64_t inner;
+				if (!ReadVarint(p, end, inner)) {
+					return false;
+				}
+				if ((inner & 7U) == kWireGroupEnd) {
+					return (inner >> 3U) == (tag >> 3U);
+				}
+				if (!SkipValue(p, end, inner, depth+1)) {
+					return false;
+				}
+			}
+		default:
+			return false;
+	}
+}
+
+static unsigned WireTypeOf(google::protobuf::FieldDescriptor::Type type) noexcept {
+	switch (type) {
+		case google::protobuf::FieldDescriptor::Type::TYPE_DOUBLE:
+		case google::protobuf::FieldDescriptor::Type::TYPE_FIXED64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SFIXED64:
+			return kWireFixed64;
+		case google::protobuf::FieldDescriptor::Type::TYPE_FLOAT:
+		case google::protobuf::FieldDescriptor::Type::TYPE_FIXED32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SFIXED32:
+			return kWireFixed32;
+		case google::protobuf::FieldDescriptor::Type::TYPE_MESSAGE:
+		case google::protobuf::FieldDescriptor::Type::TYPE_BYTES:
+		case google::protobuf::FieldDescriptor::Type::TYPE_STRING:
+			return kWireBytes;
+		case google::protobuf::FieldDescriptor::Type::TYPE_GROUP:
+			return kWireGroupStart;
+		default:
+			return kWireVarint;
+	}
+}
+
+static inline bool Is64Bits(google::protobuf::FieldDescriptor::Type type) noexcept {
+	switch (type) {
+		case google::protobuf::FieldDescriptor::Type::TYPE_DOUBLE:
+		case google::protobuf::FieldDescriptor::Type::TYPE_FIXED64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SFIXED64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_UINT64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_INT64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SINT64:
+			return true;
+		default:
+			return false;
+	}
+}
+
+// value bits in memory from raw value on wire
+static inline uint64_t CookValue(google::protobuf::FieldDescriptor::Type type, uint64_t raw) noexcept {
+	switch (type) {
+		case google::protobuf::FieldDescriptor::Type::TYPE_SINT32:
+		{
+			auto v = static_cast<uint32_t>(raw);
+			return (v >> 1U) ^ (0U - (v & 1U));
+		}
+		case google::protobuf::FieldDescriptor::Type::TYPE_SINT64:
+			return (raw >> 1U) ^ (0ULL - (raw & 1U));
+		case google::protobuf::FieldDescriptor::Type::TYPE_BOOL:
+			return raw != 0;
+		default:
+			return Is64Bits(type)? raw : static_cast<uint32_t>(raw);
+	}
+}
+
+// unknown values of closed enums are dropped by protobuf parser
+static inline bool IsKnownValue(const google::protobuf::FieldDescriptor* field, uint64_t v) {
+	if (field->type() != google::protobuf::FieldDescriptor::Type::TYPE_ENUM
+		|| field->enum_type()->file()->syntax() != google::protobuf::FileDescriptor::SYNTAX_PROTO2) {
+		return true;
+	}
+	return field->enum_type()->FindValueByNumber(static_cast<int32_t>(v)) != nullptr;
+}
+
+// calls fn with raw values in a record, which may be packed
+template <typename F>
+static bool ForEachValue(google::protobuf::FieldDescriptor::Type type,
+						 unsigned wire, uint64_t value, const uint8_t* data, F&& fn) {
+	auto expected = WireTypeOf(type);
+	if (wire == expected) {
+		fn(value);
+		return true;
+	}
+	assert(wire == kWireBytes);
+	auto p = data;
+	auto end = data + value;
+	while (p < end) {
+		uint64_t v;
+		bool ok;
+		if (expected == kWireVarint) {
+			ok = ReadVarint(p, end, v);
+		} else {
+			ok = ReadFixed(p, end, expected == kWireFixed64? 8 : 4, v);
+		}
+		if (!ok) {
+			return false;
+		}
+		fn(v);
+	}
+	return true;
+}
+
+struct WireRecord {
+	uint32_t field;		// id-1
+	uint32_t wire;
+	uint64_t value;		// varint, fixed value or length
+	const uint8_t* data;
+};
+
+struct TranscodePlan {
+	bool ok = false;
+	bool alias = false;
+	// indexed by id-1, nullptr for holes
+	std::vector<const google::protobuf::FieldDescriptor*> fields;
+	// deprecated ones included, which still affect oneofs
+	std::vector<const google::protobuf::FieldDescriptor*> known;
+};
+
+// scratch of one nesting level
+struct TranscodeFrame {
+	std::vector<WireRecord> records;
+	std::vector<uint32_t> order;	// record indexes grouped by field
+	std::vector<uint32_t> start;	// records of field j are order[first[j], start[j+1])
+	std::vector<uint32_t> first;	// after records dropped by oneof switch
+	std::vector<Unit> parts;
+	std::vector<Unit> elements;
+	std::vector<Slice<uint8_t>> slices;
+	std::vector<uint32_t> u32;
+	std::vector<uint64_t> u64;
+	std::basic_string<bool> bools;
+};
+
+class Transcoder::Context final {
+public:
+	explicit Context(const google::protobuf::Descriptor* root) : root_(root) {}
+
+	bool Transcode(const Slice<uint8_t>& data, Buffer& buf) {
+		buf_ = &buf;
+		Unit dummy;
+		return WriteMessage(root_, &data, 1, 0, dummy);
+	}
+
+private:
+	const google::protobuf::Descriptor* root_;
+	Buffer* buf_ = nullptr;
+	std::unordered_map<const google::protobuf::Descriptor*, TranscodePlan> plans_;
+	std::vector<std::unique_ptr<TranscodeFrame>> frames_;
+
+	const TranscodePlan& PlanOf(const google::protobuf::Descriptor* descriptor);
+	bool Scan(const google::protobuf::Descriptor* descriptor, const TranscodePlan& plan,
+			  const Slice<uint8_t>* parts, size_t n, unsigned depth, TranscodeFrame& frame);
+	bool WriteMessage(const google::protobuf::Descriptor* descriptor,
+					  const Slice<uint8_t>* parts, size_t n, unsigned depth, Unit& unit);
+	bool WriteField(const google::protobuf::FieldDescriptor* field, TranscodeFrame& frame,
+					uint32_t j, unsigned depth, Unit& unit);
+	bool WriteScalars(const google::protobuf::FieldDescriptor* field, TranscodeFrame& frame,
+					  uint32_t begin, uint32_t end, Unit& unit);
+	bool WriteMap(const google::protobuf::FieldDescriptor* field, TranscodeFrame& frame,
+				  uint32_t begin, uint32_t end, unsigned depth, Unit& unit);
+	template <typename K>
+	bool WriteMapBy(const google::protobuf::FieldDescriptor* field, TranscodeFrame& frame,
+					uint32_t begin, uint32_t end, unsigned depth, Unit& unit);
+	bool WriteValue(const google::protobuf::FieldDescriptor* field, uint64_t value, const uint8_t* data,
+					const Slice<uint8_t>* parts, size_t n, unsigned depth, Unit& unit);
+};
+
+const TranscodePlan& Transcoder::Context::PlanOf(const google::protobuf::Descriptor* descriptor) {
+	auto it = plans_.find(descriptor);
+	if (it != plans_.end()) {
+		return it->second;
+	}
+	auto& plan = plans_[descriptor];
+	if (!CollectFields(descriptor, plan.fields)) {
+		return plan;
+	}
+	plan.known.assign(plan.fields.size(), nullptr);
+	for (int i = 0; i < descriptor->field_count(); i++) {
+		auto field = descriptor->field(i);
+		plan.known[field->number()-1] = field;
+	}
+	plan.alias = IsAliasField(plan.fields);
+	plan.ok = !plan.alias || plan.fields.front()->is_repeated();
+	return plan;
+}
+
+bool Transcoder::Context::Scan(const google::protobuf::Descriptor* descriptor, const TranscodePlan& plan,
+							   const Slice<uint8_t>* parts, size_t n, unsigned depth, TranscodeFrame& frame) {
+	auto& records = frame.records;
+	records.clear();
+	for (size_t i = 0; i < n; i++) {
+		auto p = parts[i].data();
+		auto end = p + parts[i].size();
+		while (p < end) {
+			uint64_t tag;
+			if (!ReadVarint(p, end, tag) || (tag >> 3U) == 0) {
+				return false;
+			}
+			auto number = tag >> 3U;
+			auto wire = static_cast<unsigned>(tag & 7U);
+			auto field = number <= plan.known.size()? plan.known[number-1] : nullptr;
+			if (field == nullptr || (wire != WireTypeOf(field->type())
+									 && (wire != kWireBytes || !field->is_packable()))) {
+				// unknown field
+				if (!SkipValue(p, end, tag, depth)) {
+					return false;
+				}
+				continue;
+			}
+			WireRecord record = {static_cast<uint32_t>(number-1), wire, 0, nullptr};
+			bool ok = false;
+			switch (wire) {
+				case kWireVarint:
+					ok = ReadVarint(p, end, record.value);
+					break;
+				case kWireFixed64:
+					ok = ReadFixed(p, end, 8, record.value);
+					break;
+				case kWireFixed32:
+					ok = ReadFixed(p, end, 4, record.value);
+					break;
+				case kWireBytes:
+					ok = ReadVarint(p, end, record.value) && record.value <= static_cast<uint64_t>(end - p);
+					record.data = p;
+					p += ok? record.value : 0;
+					break;
+				default:
+					break;	// groups are not supported
+			}
+			if (!ok) {
+				return false;
+			}
+			records.push_back(record);
+		}
+	}
+
+	// group by field, keeping the order of each field
+	auto m = plan.known.size();
+	auto& start = frame.start;
+	start.assign(m+1, 0);
+	for (auto& one : records) {
+		start[one.field+1]++;
+	}
+	for (size_t j = 0; j < m; j++) {
+		start[j+1] += start[j];
+	}
+	auto& first = frame.first;
+	first.assign(start.begin(), start.end()-1);
+	frame.order.resize(records.size());
+	for (uint32_t i = 0; i < records.size(); i++) {
+		frame.order[first[records[i].field]++] = i;
+	}
+	first.assign(start.begin(), start.end()-1);
+
+	// only the last member of a oneof stays, and its records before the switch are dropped
+	for (int i = 0; i < descriptor->real_oneof_decl_count(); i++) {
+		auto oneof = descriptor->oneof_decl(i);
+		int64_t top = -1;
+		int64_t second = -1;
+		int winner = -1;
+		for (int k = 0; k < oneof->field_count(); k++) {
+			auto j = oneof->field(k)->number() - 1;
+			if (start[j] == start[j+1]) {
+				continue;
+			}
+			int64_t last = frame.order[start[j+1]-1];
+			if (last > top) {
+				second = top;
+				top = last;
+				winner = j;
+			} else if (last > second) {
+				second = last;
+			}
+		}
+		for (int k = 0; k < oneof->field_count(); k++) {
+			auto j = oneof->field(k)->number() - 1;
+			if (j != winner) {
+				first[j] = start[j+1];
+			}
+		}
+		if (winner >= 0) {
+			while (static_cast<int64_t>(frame.order[first[winner]]) < second) {
+				first[winner]++;
+			}
+		}
+	}
+	return true;
+}
+
+bool Transcoder::Context::WriteMessage(const google::protobuf::Descriptor* descriptor,
+									   const Slice<uint8_t>* parts, size_t n, unsigned depth, Unit& unit) {
+	if (depth >= kTranscodeDepthLimit) {
+		return false;
+	}
+	auto& plan = PlanOf(descriptor);
+	if (!plan.ok) {
+		return false;
+	}
+	while (frames_.size() <= depth) {
+		frames_.push_back(std::make_unique<TranscodeFrame>());
+	}
+	auto& frame = *frames_[depth];
+	if (!Scan(descriptor, plan, parts, n, depth, frame)) {
+		return false;
+	}
+
+	if (plan.alias) {
+		auto field = plan.fields.front();
+		if (!WriteField(field, frame, 0, depth, unit)) {
+			return false;
+		}
+		assert(unit.len == 0);
+		if (unit.seg.len == 0) {
+			if (field->is_map()) {
+				unit.data[0] = 5U << 28U;
+			} else {
+				unit.data[0] = 1U;
+			}
+			unit.len = 1;
+		}
+		return true;
+	}
+
+	auto last = buf_->Size();
+	auto& fields = frame.parts;
+	fields.assign(plan.fields.size(), Unit());
+	for (size_t i = fields.size(); i-- > 0;) {
+		auto field = plan.fields[i];
+		if (field == nullptr) {
+			continue;
+		}
+		if (!WriteField(field, frame, i, depth, fields[i])) {
+			return false;
+		}
+		FoldField(*buf_, fields[i]);
+	}
+	return SerializeMessage(fields, *buf_, last, unit);
+}
+
+bool Transcoder::Context::WriteValue(const google::protobuf::FieldDescriptor* field, uint64_t value,
+									 const uint8_t* data, const Slice<uint8_t>* parts, size_t n,
+									 unsigned depth, Unit& unit) {
+	auto type = field->type();
+	switch (type) {
+		case google::protobuf::FieldDescriptor::Type::TYPE_MESSAGE:
+			return WriteMessage(field->message_type(), parts, n, depth+1, unit);
+		case google::protobuf::FieldDescriptor::Type::TYPE_BYTES:
+		case google::protobuf::FieldDescriptor::Type::TYPE_STRING:
+			return ::protocache::Serialize(Slice<char>(reinterpret_cast<const char*>(data), value), *buf_, unit);
+		case google::protobuf::FieldDescriptor::Type::TYPE_BOOL:
+			return ::protocache::Serialize(value != 0, *buf_, unit);
+		default:
+			if (Is64Bits(type)) {
+				return ::protocache::Serialize(value, *buf_, unit);
+			}
+			return ::protocache::Serialize(static_cast<uint32_t>(value), *buf_, unit);
+	}
+}
+
+bool Transcoder::Context::WriteField(const google::protobuf::FieldDescriptor* field, TranscodeFrame& frame,
+									 uint32_t j, unsigned depth, Unit& unit) {
+	unit = {};
+	auto begin = frame.first[j];
+	auto end = frame.start[j+1];
+	if (begin == end) {
+		return true;
+	}
+	auto& records = frame.records;
+	if (field->is_map()) {
+		return WriteMap(field, frame, begin, end, depth, unit);
+	}
+	if (field->is_repeated()) {
+		switch (field->type()) {
+			case google::protobuf::FieldDescriptor::Type::TYPE_MESSAGE:
+			case google::protobuf::FieldDescriptor::Type::TYPE_BYTES:
+			case google::protobuf::FieldDescriptor::Type::TYPE_STRING:
+			{
+				auto& elements = frame.elements;
+				elements.assign(end - begin, Unit());
+				auto last = buf_->Size();
+				for (auto k = end; k-- > begin;) {
+					auto& one = records[frame.order[k]];
+					Slice<uint8_t> part(one.data, one.value);
+					if (!WriteValue(field, one.value, one.data, &part, 1, depth, elements[k-begin])) {
+						return false;
+					}
+				}
+				return ::protocache::SerializeArray(elements, *buf_, last, unit);
+			}
+			default:
+				return WriteScalars(field, frame, begin, end, unit);
+		}
+	}
+
+	switch (field->type()) {
+		case google::protobuf::FieldDescriptor::Type::TYPE_MESSAGE:
+		{
+			// occurrences of a message field are merged
+			auto& slices = frame.slices;
+			slices.clear();
+			for (auto k = begin; k < end; k++) {
+				auto& one = records[frame.order[k]];
+				slices.emplace_back(one.data, one.value);
+			}
+			if (!WriteValue(field, 0, nullptr, slices.data(), slices.size(), depth, unit)) {
+				return false;
+			}
+			FoldNested(*buf_, unit);
+			return true;
+		}
+		case google::protobuf::FieldDescriptor::Type::TYPE_BYTES:
+		case google::protobuf::FieldDescriptor::Type::TYPE_STRING:
+		{
+			auto& one = records[frame.order[end-1]];
+			if (one.value == 0 && !field->has_presence()) {
+				return true;
+			}
+			return WriteValue(field, one.value, one.data, nullptr, 0, depth, unit);
+		}
+		default:
+			for (auto k = end; k-- > begin;) {
+				auto& one = records[frame.order[k]];
+				if (!IsKnownValue(field, one.value)) {
+					continue;
+				}
+				auto value = CookValue(field->type(), one.value);
+				if (value == 0 && !field->has_presence()) {
+					return true;
+				}
+				return WriteValue(field, value, nullptr, nullptr, 0, depth, unit);
+			}
+			return true;
+	}
+}
+
+bool Transcoder::Context::WriteScalars(const google::protobuf::FieldDescriptor* field, TranscodeFrame& frame,
+									   uint32_t begin, uint32_t end, Unit& unit) {
+	auto type = field->type();
+	auto is_bool = type == google::protobuf::FieldDescriptor::Type::TYPE_BOOL;
+	auto is_64bits = Is64Bits(type);
+	frame.u32.clear();
+	frame.u64.clear();
+	frame.bools.clear();
+	for (auto k = begin; k < end; k++) {
+		auto& one = frame.records[frame.order[k]];
+		if (!ForEachValue(type, one.wire, one.value, one.data, [&](uint64_t raw) {
+				if (!IsKnownValue(field, raw)) {
+					return;
+				}
+				auto value = CookValue(type, raw);
+				if (is_bool) {
+					frame.bools.push_back(value != 0);
+				} else if (is_64bits) {
+					frame.u64.push_back(value);
+				} else {
+					frame.u32.push_back(static_cast<uint32_t>(value));
+				}
+			})) {
+			return false;
+		}
+	}
+	if (is_bool) {
+		return frame.bools.empty() || ::protocache::Serialize(Slice<bool>(frame.bools), *buf_, unit);
+	} else if (is_64bits) {
+		return frame.u64.empty() || ::protocache::SerializeArray(Slice<uint64_t>(frame.u64), *buf_, unit);
+	}
+	return frame.u32.empty() || ::protocache::SerializeArray(Slice<uint32_t>(frame.u32), *buf_, unit);
+}
+
+bool Transcoder::Context::WriteMap(const google::protobuf::FieldDescriptor* field, TranscodeFrame& frame,
+								   uint32_t begin, uint32_t end, unsigned depth, Unit& unit) {
+	switch (field->message_type()->map_key()->type()) {
+		case google::protobuf::FieldDescriptor::Type::TYPE_STRING:
+			return WriteMapBy<Slice<char>>(field, frame, begin, end, depth, unit);
+		case google::protobuf::FieldDescriptor::Type::TYPE_FIXED64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_UINT64:
+			return WriteMapBy<uint64_t>(field, frame, begin, end, depth, unit);
+		case google::protobuf::FieldDescriptor::Type::TYPE_FIXED32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_UINT32:
+			return WriteMapBy<uint32_t>(field, frame, begin, end, depth, unit);
+		case google::protobuf::FieldDescriptor::Type::TYPE_SFIXED64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SINT64:
+		case google::protobuf::FieldDescriptor::Type::TYPE_INT64:
+			return WriteMapBy<int64_t>(field, frame, begin, end, depth, unit);
+		case google::protobuf::FieldDescriptor::Type::TYPE_SFIXED32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_SINT32:
+		case google::protobuf::FieldDescriptor::Type::TYPE_INT32:
+			return WriteMapBy<int32_t>(field, frame, begin, end, depth, unit);
+		default:
+			return false;
+	}
+}
+
+template <typename K>
+bool Transcoder::Context::WriteMapBy(const google::protobuf::FieldDescriptor* field, TranscodeFrame& frame,
+									 uint32_t begin, uint32_t end, unsigned depth, Unit& unit) {
+	auto key_field = field->message_type()->map_key();
+	auto value_field = field->message_type()->map_value();
+	auto key_wire = WireTypeOf(key_field->type());
+	auto value_wire = WireTypeOf(value_field->type());
+	auto is_message = value_field->type() == google::protobuf::FieldDescriptor::Type::TYPE_MESSAGE;
+	struct Entry {
+		uint64_t value = 0;
+		const uint8_t* data = nullptr;
+		uint32_t slices_begin = 0;
+		uint32_t slices_end = 0;
+	};
+	using Key = std::conditional_t<std::is_same_v<K, Slice<char>>, std::string_view, K>;
+	std::vector<K> keys;
+	std::vector<Entry> entries;
+	std::unordered_map<Key, uint32_t> book;
+	auto& slices = frame.slices;
+	slices.clear();
+
+	for (auto k = begin; k < end; k++) {
+		auto& record = frame.records[frame.order[k]];
+		auto p = record.data;
+		auto tail = p + record.value;
+		uint64_t key = 0;
+		const uint8_t* key_data = reinterpret_cast<const uint8_t*>("");
+		Entry entry;
+		entry.data = key_data;	// empty
+		entry.slices_begin = slices.size();
+		while (p < tail) {
+			uint64_t tag;
+			if (!ReadVarint(p, tail, tag)) {
+				return false;
+			}
+			auto number = tag >> 3U;
+			auto wire = tag & 7U;
+			uint64_t v = 0;
+			bool ok = false;
+			if (number == 1 && wire == key_wire) {
+				if (wire == kWireBytes) {
+					ok = ReadVarint(p, tail, key) && key <= static_cast<uint64_t>(tail - p);
+					key_data = p;
+					p += ok? key : 0;
+				} else {
+					ok = wire == kWireVarint? ReadVarint(p, tail, v) : ReadFixed(p, tail, wire == kWireFixed64? 8 : 4, v);
+					key = CookValue(key_field->type(), v);
+				}
+			} else if (number == 2 && wire == value_wire) {
+				if (wire == kWireBytes) {
+					ok = ReadVarint(p, tail, entry.value) && entry.value <= static_cast<uint64_t>(tail - p);
+					if (ok) {
+						entry.data = p;
+						if (is_message) {
+							slices.emplace_back(p, entry.value);	// merged
+						}
+						p += entry.value;
+					}
+				} else {
+					ok = wire == kWireVarint? ReadVarint(p, tail, entry.value)
+							: ReadFixed(p, tail, wire == kWireFixed64? 8 : 4, entry.value);
+				}
+			} else {
+				ok = SkipValue(p, tail, tag, depth);
+			}
+			if (!ok) {
+				return false;
+			}
+		}
+		if (!IsKnownValue(value_field, entry.value)) {
+			continue;	// dropped as unknown field by protobuf
+		}
+		if (value_wire != kWireBytes) {
+			entry.value = CookValue(value_field->type(), entry.value);
+		}
+		entry.slices_end = slices.size();
+		K one;
+		if constexpr (std::is_same_v<K, Slice<char>>) {
+			one = Slice<char>(reinterpret_cast<const char*>(key_data), key);
+		} else {
+			one = static_cast<K>(key);
+		}
+		Key book_key;
+		if constexpr (std::is_same_v<K, Slice<char>>) {
+			book_key = std::string_view(one.data(), one.size());
+		} else {
+			book_key = one;
+		}
+		auto it = book.emplace(book_key, entries.size());
+		if (it.second) {
+			keys.push_back(one);
+			entries.push_back(entry);
+		} else {
+			entries[it.first->second] = entry;	// last one wins
+		}
+	}
+	if (keys.empty()) {
+		return true;
+	}
+	return SerializeMapBy<K>(keys, *buf_, unit, [&](size_t i, Unit& one)->bool {
+		auto& entry = entries[i];
+		return WriteValue(value_field, entry.value, entry.data, slices.data() + entry.slices_begin,
+						  entry.slices_end - entry.slices_begin, depth, one);
+	});
+}
+
+Transcoder::Transcoder(const google::protobuf::Descriptor* descriptor)
+	: ctx_(std::make_unique<Context>(descriptor)) {}
+
+Transcoder::~Transcoder() noexcept = default;
+
+bool Transcoder::Transcode(const Slice<uint8_t>& data, Buffer* buf) {
+	return ctx_->Transcode(data, *buf);
+}
+
 } // protocache
@@ -4,12 +4,19 @@
 
 #include <cassert>
 #include <cstdio>
+#include <vector>
 #include <cstring>
 #include <chrono>
 #include <memory>
 #include <algorithm>
-#if defined(__wasm__) && defined(__wasm_atomics__)
+#if !defined(__wasm__)
 #include <atomic>
+#include <thread>
+#elif defined(__wasm_atomics__)
+#include <atomic>
+#endif
+#if !defined(_WIN32) && !defined(__wasm__)
+#include <unistd.h>
 #endif
 #include "protocache/perfect_hash.h"
 #include "hash.h"
@@ -141,6 +148,22 @@ struct Header {
 	uint32_t seed;
 };
 
+uint32_t PerfectHash::DataSize(uint32_t total) noexcept {
+	if (total >= (1U << 28U)) {
+		return 0;
+	}
+	if (total <= 1) {
+		return 4;
+	}
+	auto bmsz = BitmapSize(Section(total));
+	auto bytes = sizeof(Header) + bmsz;
+	if (bmsz > 8) {
+		auto word = total > UINT16_MAX ? 4U : (total > UINT8_MAX ? 2U : 1U);
+		bytes += (bmsz/8) * word;
+	}
+	return bytes;
+}
+
 PerfectHash::PerfectHash(const uint8_t* data, uint32_t size) noexcept {
 	// size == 0 means size is unknown, run unsafely
 	if (size != 0 && size < 4) {
@@ -205,15 +228,22 @@ uint32_t PerfectHashObject::Locate(const uint8_t* key, unsigned key_len) const n
 	return PerfectHash::Locate(slots);
 }
 
-uint32_t PerfectHash::Locate(uint32_t slots[]) const noexcept {
-	auto header = reinterpret_cast<const Header*>(data_);
-	auto size = RealSize(header->size);
-	auto bitmap = data_ + sizeof(Header);
-	auto table = bitmap + BitmapSize(section_);
+static inline uint32_t PickSlot(const uint8_t* bitmap, const uint32_t slots[]) noexcept {
 	auto m = Bit2(bitmap,slots[0]) +
 			 Bit2(bitmap,slots[1]) + Bit2(bitmap,slots[2]);
+	return slots[m % 3];
+}
 
-	auto slot = slots[m % 3];
+static inline const uint8_t* TablePos(const uint8_t* table, uint32_t size, uint32_t a) noexcept {
+	if (size > UINT16_MAX) {
+		return table + a * 4;
+	} else if (size > UINT8_MAX) {
+		return table + a * 2;
+	}
+	return table + a;
+}
+
+static inline uint32_t SlotOffset(const uint8_t* bitmap, const uint8_t* table, uint32_t size, uint32_t slot) noexcept {
 	uint32_t a = slot >> 5;
 	uint32_t b = slot & 31U;
 
@@ -231,6 +261,88 @@ uint32_t PerfectHash::Locate(uint32_t slots[]) const noexcept {
 	return off + CountValidSlot(block);
 }
 
+uint32_t PerfectHash::Locate(uint32_t slots[]) const noexcept {
+	auto header = reinterpret_cast<const Header*>(data_);
+	auto bitmap = data_ + sizeof(Header);
+	auto table = bitmap + BitmapSize(section_);
+	return SlotOffset(bitmap, table, RealSize(header->size), PickSlot(bitmap, slots));
+}
+
+void PerfectHash::LocateBatch(const Slice<uint8_t> keys[], unsigned n, uint32_t out[]) const noexcept {
+	if (data_ == nullptr) {
+		std::fill(out, out+n, UINT32_MAX);
+		return;
+	}
+	auto header = reinterpret_cast<const Header*>(data_);
+	auto size = RealSize(header->size);
+	if (size < 2) {
+		std::fill(out, out+n, 0);
+		return;
+	}
+	auto bitmap = data_ + sizeof(Header);
+	auto table = bitmap + BitmapSize(section_);
+
+	constexpr unsigned kGroup = 16;
+	uint32_t slots[kGroup][3];
+	for (unsigned i = 0; i < n; i += kGroup) {
+		auto m = std::min(kGroup, n-i);
+		// stage 1: hash all keys, then touch the candidate bitmap bytes
+		for (unsigned j = 0; j < m; j++) {
+			auto& key = keys[i+j];
+			auto code = Hash128(key.data(), key.size(), header->seed);
+			auto& s = slots[j];
+			s[0] = code.u32[0] % section_;
+			s[1] = code.u32[1] % section_ + section_;
+			s[2] = code.u32[2] % section_ + section_ * 2;
+			Prefetch(bitmap + (s[0]>>2));
+			Prefetch(bitmap + (s[1]>>2));
+			Prefetch(bitmap + (s[2]>>2));
+		}
+		// stage 2: pick the slot, then touch its block and offset entry
+		for (unsigned j = 0; j < m; j++) {
+			auto slot = PickSlot(bitmap, slots[j]);
+			slots[j][0] = slot;
+			Prefetch(bitmap + (slot>>5)*8);
+			Prefetch(TablePos(table, size, slot>>5));
+		}
+		// stage 3: count
+		for (unsigned j = 0; j < m; j++) {
+			out[i+j] = SlotOffset(bitmap, table, size, slots[j][0]);
+		}
+	}
+}
+
+bool PerfectHash::Verify() const noexcept {
+	if (data_ == nullptr) {
+		return false;
+	}
+	auto size = Size();
+	if (size < 2) {
+		return true;
+	}
+	auto bitmap = data_ + sizeof(Header);
+	auto bmsz = BitmapSize(section_);
+	auto table = bitmap + bmsz;
+	uint32_t cnt = 0;
+	for (uint32_t i = 0; i < bmsz/8; i++) {
+		if (size > 24) {
+			uint32_t off = 0;
+			if (size > UINT16_MAX) {
+				off = reinterpret_cast<const uint32_t*>(table)[i];
+			} else if (size > UINT8_MAX) {
+				off = reinterpret_cast<const uint16_t*>(table)[i];
+			} else {
+				off = reinterpret_cast<const uint8_t*>(table)[i];
+			}
+			if (off != cnt) {
+				return false;
+			}
+		}
+		cnt += CountValidSlot(reinterpret_cast<const uint64_t*>(bitmap)[i]);
+	}
+	return cnt == size;
+}
+
 template <typename Word>
 struct Vertex {
 	Word slot;
@@ -320,32 +432,34 @@ static bool TearGraph(Graph<Word>& g, uint32_t n, Word free[], uint8_t* book) no
 	return tail == n;
 }
 
-template <typename Word>
-static void Mapping(Graph<Word>& g, uint32_t n, Word free[], uint8_t* book, uint8_t* bitmap) noexcept {
+// edges should be fed in reverse order of peeling, a, b, c are shifted slots
+static inline void MapEdge(uint8_t* book, uint8_t* bitmap, unsigned a, unsigned b, unsigned c) noexcept {
+	if (TestAndSetBit(book, a)) {
+		SetBit(book, b);
+		SetBit(book, c);
+		auto sum = Bit2(bitmap,b) + Bit2(bitmap,c);
+		SetBit2on11(bitmap, a, (6-sum)%3);
+	} else if (TestAndSetBit(book, b)) {
+		SetBit(book, c);
+		auto sum = Bit2(bitmap,a) + Bit2(bitmap,c);
+		SetBit2on11(bitmap, b, (7-sum)%3);
+	} else if (TestAndSetBit(book, c)) {
+		auto sum = Bit2(bitmap,a) + Bit2(bitmap,b);
+		SetBit2on11(bitmap, c, (8-sum)%3);
+	} else {
+		assert(false);
+	}
+}
+
+// slot_of(edge, j) gives the j-th vertex of an edge, without section shift
+template <typename Word, typename SlotOf>
+static void Mapping(SlotOf&& slot_of, uint32_t n, const Word free[], uint8_t* book, uint8_t* bitmap) noexcept {
 	auto m = Section(n);
 	memset(bitmap, ~0, BitmapSize(m));
 	memset(book, 0, (m*3+7)/8);
 	for (unsigned i = n; i > 0; ) {
 		auto idx = free[--i];
-		auto& edge = g.edges[idx];
-		unsigned a = edge[0].slot;
-		unsigned b = edge[1].slot + m;
-		unsigned c = edge[2].slot + m*2;
-		if (TestAndSetBit(book, a)) {
-			SetBit(book, b);
-			SetBit(book, c);
-			auto sum = Bit2(bitmap,b) + Bit2(bitmap,c);
-			SetBit2on11(bitmap, a, (6-sum)%3);
-		} else if (TestAndSetBit(book, b)) {
-			SetBit(book, c);
-			auto sum = Bit2(bitmap,a) + Bit2(bitmap,c);
-			SetBit2on11(bitmap, b, (7-sum)%3);
-		} else if (TestAndSetBit(book, c)) {
-			auto sum = Bit2(bitmap,a) + Bit2(bitmap,b);
-			SetBit2on11(bitmap, c, (8-sum)%3);
-		} else {
-			assert(false);
-		}
+		MapEdge(book, bitmap, slot_of(idx, 0), slot_of(idx, 1) + m, slot_of(idx, 2) + m*2);
 	}
 }
 
@@ -428,8 +542,62 @@ static inline uint32_t GetSeed() {
 }
 #endif
 
+// derived from the key set, ignoring key order
+static uint32_t KeySetSeed(KeyReader& source) {
+	uint64_t mix[3] = {0, 0, 0};
+	source.Reset();
+	auto total = source.Total();
+	for (size_t i = 0; i < total; i++) {
+		auto key = source.Read();
+		if (!key) {
+			break;
+		}
+		auto code = Hash128(key.data(), key.size());
+		mix[0] += code.u64[0];
+		mix[1] ^= code.u64[1];
+	}
+	mix[2] = total;
+	return Hash128(reinterpret_cast<const uint8_t*>(mix), sizeof(mix)).u32[0];
+}
+
+static inline uint32_t StartSeed(KeyReader& source, bool deterministic) {
+	return deterministic? KeySetSeed(source) : GetSeed();
+}
+
+// check(seed) should fail only if some keys are duplicate
+template <unsigned FIRST_TRIES, unsigned SECOND_TRIES, typename Attempt, typename Checker>
+static bool SearchSeed(uint32_t start, Attempt&& build, Checker&& check, Header* header, bool no_check) {
+	XorShift rand32(start);
+	for (unsigned i = 0; i < FIRST_TRIES; i++) {
+		header->seed = rand32.Next();
+		if (build(header->seed)) {
+			return true;
+		}
+	}
+	if (!no_check && !check(header->seed)) {
+		return false;
+	}
+	for (unsigned i = 0; i < SECOND_TRIES; i++) {
+		header->seed = rand32.Next();
+		if (build(header->seed)) {
+			return true;
+		}
+	}
+	return false;
+}
+
 template <typename Word>
-static std::unique_ptr<uint8_t[]> Build(KeyReader& source, uint32_t& data_size, bool no_check) {
+static void FillTable(const uint8_t* bitmap, uint32_t bmsz, Word table[], [[maybe_unused]] uint32_t total) noexcept {
+	Word cnt = 0;
+	for (unsigned i = 0; i < bmsz/8; i++) {
+		table[i] = cnt;
+		cnt += CountValidSlot(reinterpret_cast<const uint64_t*>(bitmap)[i]);
+	}
+	assert(cnt == total);
+}
+
+template <typename Word>
+static std::unique_ptr<uint8_t[]> Build(KeyReader& source, uint32_t& data_size, bool no_check, bool deterministic) {
 	auto total = source.Total();
 	auto section = Section(total);
 	auto bmsz = BitmapSize(section);
@@ -476,59 +644,446 @@ static std::unique_ptr<uint8_t[]> Build(KeyReader& source, uint32_t& data_size,
 			|| !TearGraph(graph, total, free, book)) {
 			return false;
 		}
-		Mapping(graph, total, free, book, bitmap);
+		Mapping([&graph](Word i, unsigned j)->unsigned {
+			return graph.edges[i][j].slot;
+		}, total, free, book, bitmap);
 		return true;
 	};
 
-	XorShift rand32(GetSeed());
-	for (unsigned i = 0; i < FIRST_TRIES; i++) {
-		header->seed = rand32.Next();
-		if (build(header->seed)) {
-			goto L_done;
+	V128* space = nullptr;
+	if (tmp_sz / sizeof(V128) > total*2U) {
+		space = reinterpret_cast<V128*>(temp.get());
+	}
+	auto check = [&source, total, space](uint32_t seed)->bool {
+		return Check(source, total, seed, space);
+	};
+	if (!SearchSeed<FIRST_TRIES,SECOND_TRIES>(StartSeed(source, deterministic), build, check, header, no_check)) {
+		return nullptr;
+	}
+	if (bmsz > 8) {
+		FillTable(bitmap, bmsz, table, total);
+	}
+	data_size = bytes;
+	return out;
+}
+
+#if !defined(__wasm__)
+// Keys are copied once, so they can be rehashed by many threads for each seed.
+class KeyArena final : public KeyReader {
+public:
+	bool Load(KeyReader& source, size_t n) {
+		offsets_.resize(n+1);
+		offsets_[0] = 0;
+		source.Reset();
+		for (size_t i = 0; i < n; i++) {
+			auto key = source.Read();
+			if (!key) {
+				return false;
+			}
+			bytes_.insert(bytes_.end(), key.begin(), key.end());
+			offsets_[i+1] = bytes_.size();
 		}
+		return true;
+	}
+	Slice<uint8_t> operator[](size_t i) const noexcept {
+		return {bytes_.data() + offsets_[i], static_cast<size_t>(offsets_[i+1] - offsets_[i])};
+	}
+
+	void Reset() override {
+		idx_ = 0;
 	}
-	if (!no_check) {
-		V128* space = nullptr;
-		if (tmp_sz / sizeof(V128) > header->size*2U) {
-			space = reinterpret_cast<V128*>(temp.get());
+	size_t Total() override {
+		return offsets_.size() - 1;
+	}
+	Slice<uint8_t> Read() override {
+		if (idx_ + 1 >= offsets_.size()) {
+			return {};
+		}
+		return (*this)[idx_++];
+	}
+
+private:
+	std::vector<uint8_t> bytes_;
+	std::vector<uint64_t> offsets_;
+	size_t idx_ = 0;
+};
+
+template <typename Fn>
+static void ParallelFor(unsigned threads, uint32_t n, Fn&& fn) {
+	auto step = (n + threads - 1) / threads;
+	std::vector<std::thread> workers;
+	for (uint32_t begin = step; begin < n; begin += step) {
+		workers.emplace_back(fn, begin, std::min(n, begin+step));
+	}
+	fn(0U, std::min(n, step));
+	for (auto& one : workers) {
+		one.join();
+	}
+}
+
+// Hashing and vertex filling run on all threads. Vertices keep degree and
+// xor of incident edges instead of linked lists, so they can be updated with
+// atomics, and peeling needs no more than them.
+static std::unique_ptr<uint8_t[]> BuildParallel(KeyReader& source, unsigned threads,
+												uint32_t& data_size, bool no_check, bool deterministic) {
+	uint32_t total = source.Total();
+	KeyArena keys;
+	if (!keys.Load(source, total)) {
+		return nullptr;
+	}
+	auto section = Section(total);
+	auto bmsz = BitmapSize(section);
+	auto bytes = sizeof(Header) + bmsz + (bmsz/8) * sizeof(uint32_t);
+	std::unique_ptr<uint8_t[]> out(new uint8_t[bytes+sizeof(Divisor)]);
+	auto& divisor = *reinterpret_cast<Divisor*>(out.get());
+	divisor = section;
+	auto data = out.get() + sizeof(Divisor);
+	auto header = reinterpret_cast<Header*>(data);
+	auto bitmap = data + sizeof(Header);
+	auto table = reinterpret_cast<uint32_t*>(bitmap + bmsz);
+	header->size = total;
+
+	auto slot_cnt = section * 3;
+	std::unique_ptr<uint32_t[]> edges(new uint32_t[total*3ULL]);
+	std::unique_ptr<std::atomic<uint32_t>[]> degree(new std::atomic<uint32_t>[slot_cnt]);
+	std::unique_ptr<std::atomic<uint32_t>[]> mixed(new std::atomic<uint32_t>[slot_cnt]);
+	std::unique_ptr<uint32_t[]> free(new uint32_t[total]);
+	std::unique_ptr<uint32_t[]> stack(new uint32_t[slot_cnt]);
+	std::unique_ptr<uint8_t[]> book(new uint8_t[(slot_cnt+7)/8]);
+
+	auto peel = [&]()->bool {
+		uint32_t top = 0;
+		for (uint32_t v = 0; v < slot_cnt; v++) {
+			if (degree[v].load(std::memory_order_relaxed) == 1) {
+				stack[top++] = v;
+			}
+		}
+		uint32_t tail = 0;
+		while (top != 0) {
+			auto v = stack[--top];
+			if (degree[v].load(std::memory_order_relaxed) != 1) {
+				continue;
+			}
+			auto e = mixed[v].load(std::memory_order_relaxed);
+			free[tail++] = e;
+			for (unsigned j = 0; j < 3; j++) {
+				auto u = edges[e*3ULL+j] + section*j;
+				mixed[u].store(mixed[u].load(std::memory_order_relaxed) ^ e, std::memory_order_relaxed);
+				auto d = degree[u].load(std::memory_order_relaxed) - 1;
+				degree[u].store(d, std::memory_order_relaxed);
+				if (d == 1) {
+					stack[top++] = u;
+				}
+			}
 		}
-		if (!Check(source, header->size, header->seed, space)) {
-			return nullptr;
+		return tail == total;
+	};
+
+	auto build = [&](uint32_t seed)->bool {
+#ifndef NDEBUG
+		printf("try with seed %08x\n", seed);
+#endif
+		ParallelFor(threads, slot_cnt, [&degree, &mixed](uint32_t begin, uint32_t end) {
+			for (auto i = begin; i < end; i++) {
+				degree[i].store(0, std::memory_order_relaxed);
+				mixed[i].store(0, std::memory_order_relaxed);
+			}
+		});
+		ParallelFor(threads, total, [&](uint32_t begin, uint32_t end) {
+			for (auto i = begin; i < end; i++) {
+				auto key = keys[i];
+				auto code = Hash128(key.data(), key.size(), seed);
+				for (unsigned j = 0; j < 3; j++) {
+					auto slot = code.u32[j] % divisor;
+					edges[i*3ULL+j] = slot;
+					degree[slot + section*j].fetch_add(1, std::memory_order_relaxed);
+					mixed[slot + section*j].fetch_xor(i, std::memory_order_relaxed);
+				}
+			}
+		});
+		if (!peel()) {
+			return false;
 		}
+		Mapping([&edges](uint32_t i, unsigned j)->unsigned {
+			return edges[i*3ULL+j];
+		}, total, free.get(), book.get(), bitmap);
+		return true;
+	};
+
+	auto check = [&keys, total](uint32_t seed)->bool {
+		return Check(keys, total, seed, nullptr);
+	};
+	if (!SearchSeed<4U,12U>(StartSeed(keys, deterministic), build, check, header, no_check)) {
+		return nullptr;
 	}
-	for (unsigned i = 0; i < SECOND_TRIES; i++) {
-		header->seed = rand32.Next();
-		if (build(header->seed)) {
-			goto L_done;
+	FillTable(bitmap, bmsz, table, total);
+	data_size = bytes;
+	return out;
+}
+#endif
+
+static std::FILE* TempFile(const std::string& dir) {
+#if defined(_WIN32) || defined(__wasm__)
+	(void)dir;
+	return std::tmpfile();
+#else
+	if (dir.empty()) {
+		return std::tmpfile();
+	}
+	std::string path = dir + "/protocache-XXXXXX";
+	auto fd = mkstemp(&path[0]);
+	if (fd < 0) {
+		return nullptr;
+	}
+	unlink(path.c_str());
+	auto file = fdopen(fd, "w+b");
+	if (file == nullptr) {
+		close(fd);
+	}
+	return file;
+#endif
+}
+
+static inline bool SeekTo(std::FILE* file, uint64_t offset) noexcept {
+#if defined(_WIN32)
+	return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, offset, SEEK_SET) == 0;
+#endif
+}
+
+namespace {
+struct FileCloser {
+	void operator()(std::FILE* file) const noexcept {
+		fclose(file);
+	}
+};
+using FilePtr = std::unique_ptr<std::FILE,FileCloser>;
+} // namespace
+
+static constexpr size_t kFileBuffer = 8192;
+
+// Detect duplicate keys with hash codes partitioned on disk, only one
+// partition is sorted in memory at a time. Half of the budget is for stdio
+// buffers of partition files, and half for the partition being sorted.
+static bool CheckExternal(KeyReader& source, uint32_t n, uint32_t seed,
+						  size_t budget, const std::string& temp_dir) {
+	// Check takes 2 codes per key
+	if (static_cast<uint64_t>(n) * sizeof(V128) * 2 <= budget) {
+		return Check(source, n, seed, nullptr);
+	}
+	// Partitions are filled to half of the limit on average. A full one comes
+	// from duplicate keys, or from luck too bad to care about.
+	size_t limit = budget / 2 / sizeof(V128);
+	if (limit < 2) {
+		return false;
+	}
+	auto parts = static_cast<uint32_t>((n + limit/2 - 1) / (limit/2));
+	if (static_cast<uint64_t>(parts) * kFileBuffer > budget / 2) {
+		return false;
+	}
+	std::unique_ptr<char[]> space(new char[parts * kFileBuffer]);
+	std::vector<FilePtr> files(parts);
+	for (uint32_t i = 0; i < parts; i++) {
+		files[i].reset(TempFile(temp_dir));
+		if (files[i] == nullptr
+			|| setvbuf(files[i].get(), space.get() + i*kFileBuffer, _IOFBF, kFileBuffer) != 0) {
+			return false;
 		}
 	}
-	return nullptr;
+	source.Reset();
+	for (uint32_t i = 0; i < n; i++) {
+		auto key = source.Read();
+		if (!key) {
+			return false;
+		}
+		auto code = Hash128(key.data(), key.size(), seed);
+		auto& file = files[code.u32[3] % parts];
+		if (fwrite(&code, sizeof(code), 1, file.get()) != 1) {
+			return false;
+		}
+	}
+	std::vector<V128> codes;
+	codes.reserve(limit);
+	for (auto& file : files) {
+		auto size = ftell(file.get());
+		if (size < 0 || static_cast<size_t>(size) / sizeof(V128) > limit) {
+			return false;
+		}
+		codes.resize(size / sizeof(V128));
+		rewind(file.get());
+		if (fread(codes.data(), sizeof(V128), codes.size(), file.get()) != codes.size()) {
+			return false;
+		}
+		file.reset();
+		std::sort(codes.begin(), codes.end(), [](const V128& a, const V128& b)->bool {
+			return a.u64[0] < b.u64[0] || (a.u64[0] == b.u64[0] && a.u64[1] < b.u64[1]);
+		});
+		for (size_t i = 1; i < codes.size(); i++) {
+			if (codes[i] == codes[i-1]) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
 
-L_done:
-	if (bmsz > 8) {
-		Word cnt = 0;
-		for (unsigned i = 0; i < bmsz/8; i++) {
-			table[i] = cnt;
-			cnt += CountValidSlot(reinterpret_cast<const uint64_t*>(bitmap)[i]);
+// Vertices keep an 8-bit degree and the xor of slot triples of their edges,
+// so a peeled vertex tells its edge without any per-key array. Peeled edges
+// are spilled to a file, and then mapped by reading it backward.
+static std::unique_ptr<uint8_t[]> BuildExternal(KeyReader& source, size_t budget, const std::string& temp_dir,
+												uint32_t& data_size, bool no_check, bool deterministic) {
+	uint32_t total = source.Total();
+	auto section = Section(total);
+	auto bmsz = BitmapSize(section);
+	auto bytes = sizeof(Header) + bmsz + (bmsz/8) * sizeof(uint32_t);
+	auto slot_cnt = section * 3;
+	size_t fixed = bytes + slot_cnt * (1ULL + sizeof(uint32_t)*3) + (slot_cnt+7)/8;
+	if (fixed >= budget) {
+		return nullptr;
+	}
+	// what left is shared by io buffers and peeling stack
+	auto chunk = std::min<size_t>(std::max<size_t>((budget - fixed) / 4 / (sizeof(uint32_t)*3), 1024), 1U << 22U);
+
+	std::unique_ptr<uint8_t[]> out(new uint8_t[bytes+sizeof(Divisor)]);
+	auto& divisor = *reinterpret_cast<Divisor*>(out.get());
+	divisor = section;
+	auto data = out.get() + sizeof(Divisor);
+	auto header = reinterpret_cast<Header*>(data);
+	auto bitmap = data + sizeof(Header);
+	auto table = reinterpret_cast<uint32_t*>(bitmap + bmsz);
+	header->size = total;
+
+	std::unique_ptr<uint8_t[]> degree(new uint8_t[slot_cnt]);
+	std::unique_ptr<uint32_t[]> mixed(new uint32_t[slot_cnt*3ULL]);
+	std::unique_ptr<uint8_t[]> book(new uint8_t[(slot_cnt+7)/8]);
+	std::vector<uint32_t> buffer;
+	buffer.reserve(chunk*3);
+	std::vector<uint32_t> stack;
+
+	auto fill = [&](uint32_t seed)->bool {
+		memset(degree.get(), 0, slot_cnt);
+		memset(mixed.get(), 0, slot_cnt*3ULL*sizeof(uint32_t));
+		source.Reset();
+		for (uint32_t i = 0; i < total; i++) {
+			auto key = source.Read();
+			if (!key) {
+				return false;
+			}
+			auto code = Hash128(key.data(), key.size(), seed);
+			uint32_t edge[3] = {code.u32[0] % divisor, code.u32[1] % divisor, code.u32[2] % divisor};
+			for (unsigned j = 0; j < 3; j++) {
+				auto v = edge[j] + section*j;
+				if (++degree[v] == 0) {	// too crowded
+					return false;
+				}
+				for (unsigned k = 0; k < 3; k++) {
+					mixed[v*3ULL+k] ^= edge[k];
+				}
+			}
+		}
+		return true;
+	};
+
+	auto peel = [&](std::FILE* file)->bool {
+		uint32_t cnt = 0;
+		buffer.clear();
+		auto flush = [&buffer, file]()->bool {
+			auto done = fwrite(buffer.data(), sizeof(uint32_t), buffer.size(), file) == buffer.size();
+			buffer.clear();
+			return done;
+		};
+		for (uint32_t s = 0; s < slot_cnt; s++) {
+			stack.clear();
+			stack.push_back(s);
+			while (!stack.empty()) {
+				auto v = stack.back();
+				stack.pop_back();
+				if (degree[v] != 1) {
+					continue;
+				}
+				uint32_t edge[3] = {mixed[v*3ULL], mixed[v*3ULL+1], mixed[v*3ULL+2]};
+				buffer.insert(buffer.end(), edge, edge+3);
+				if (buffer.size() >= chunk*3 && !flush()) {
+					return false;
+				}
+				cnt++;
+				for (unsigned j = 0; j < 3; j++) {
+					auto u = edge[j] + section*j;
+					for (unsigned k = 0; k < 3; k++) {
+						mixed[u*3ULL+k] ^= edge[k];
+					}
+					// later vertices will be met by the outer loop
+					if (--degree[u] == 1 && u < s) {
+						stack.push_back(u);
+					}
+				}
+			}
+		}
+		return flush() && cnt == total;
+	};
+
+	auto mapping = [&](std::FILE* file)->bool {
+		memset(bitmap, ~0, bmsz);
+		memset(book.get(), 0, (slot_cnt+7)/8);
+		auto remain = static_cast<size_t>(total) * 3;
+		while (remain != 0) {
+			auto n = std::min<size_t>(remain, chunk*3);
+			remain -= n;
+			buffer.resize(n);
+			if (!SeekTo(file, remain * sizeof(uint32_t))
+				|| fread(buffer.data(), sizeof(uint32_t), n, file) != n) {
+				return false;
+			}
+			for (auto i = n; i > 0; i -= 3) {
+				MapEdge(book.get(), bitmap, buffer[i-3], buffer[i-2] + section, buffer[i-1] + section*2);
+			}
 		}
-		assert(cnt == total);
+		return true;
+	};
+
+	auto build = [&](uint32_t seed)->bool {
+#ifndef NDEBUG
+		printf("try with seed %08x\n", seed);
+#endif
+		if (!fill(seed)) {
+			return false;
+		}
+		FilePtr file(TempFile(temp_dir));
+		return file != nullptr && peel(file.get()) && mapping(file.get());
+	};
+	auto check = [&](uint32_t seed)->bool {
+		degree.reset();	// give memory to check
+		mixed.reset();
+		std::vector<uint32_t>().swap(buffer);
+		std::vector<uint32_t>().swap(stack);
+		auto done = CheckExternal(source, total, seed, budget - bytes - (slot_cnt+7)/8, temp_dir);
+		degree.reset(new uint8_t[slot_cnt]);
+		mixed.reset(new uint32_t[slot_cnt*3ULL]);
+		buffer.reserve(chunk*3);
+		return done;
+	};
+
+	if (!SearchSeed<4U,12U>(StartSeed(source, deterministic), build, check, header, no_check)) {
+		return nullptr;
 	}
+	FillTable(bitmap, bmsz, table, total);
 	data_size = bytes;
 	return out;
 }
 
-PerfectHashObject PerfectHashObject::Build(KeyReader& source, bool no_check) {
+PerfectHashObject PerfectHashObject::Build(KeyReader& source, bool no_check, bool deterministic) {
 	PerfectHashObject out;
 	auto total = source.Total();
 	if (total >= (1U << 28U)) {
 		return out;
 	}
 	if (total > UINT16_MAX) {
-		out.buffer_ = ::protocache::Build<uint32_t>(source, out.data_size_, no_check);
+		out.buffer_ = ::protocache::Build<uint32_t>(source, out.data_size_, no_check, deterministic);
 	} else if (total > UINT8_MAX) {
-		out.buffer_ = ::protocache::Build<uint16_t>(source, out.data_size_, no_check);
+		out.buffer_ = ::protocache::Build<uint16_t>(source, out.data_size_, no_check, deterministic);
 	} else if (total > 1) {
-		out.buffer_ = ::protocache::Build<uint8_t>(source, out.data_size_, no_check);
+		out.buffer_ = ::protocache::Build<uint8_t>(source, out.data_size_, no_check, deterministic);
 	} else {
 		out.buffer_.reset(new uint8_t[4+sizeof(Divisor)]);
 		*reinterpret_cast<Divisor*>(out.buffer_.get()) = 0;
@@ -545,4 +1100,129 @@ PerfectHashObject PerfectHashObject::Build(KeyReader& source, bool no_check) {
 	return out;
 }
 
+PerfectHashObject PerfectHashObject::BuildParallel(KeyReader& source, unsigned threads,
+												   bool no_check, bool deterministic) {
+#if !defined(__wasm__)
+	if (threads == 0) {
+		threads = std::thread::hardware_concurrency();
+	}
+	auto total = source.Total();
+	// small tables gain nothing from threads
+	if (threads > 1 && total > UINT16_MAX && total < (1U << 28U)) {
+		PerfectHashObject out;
+		out.buffer_ = ::protocache::BuildParallel(source, threads, out.data_size_, no_check, deterministic);
+		if (out.buffer_ != nullptr) {
+			out.data_ = out.buffer_.get()+sizeof(Divisor);
+			out.section_ = Section(total);
+		}
+		return out;
+	}
+#endif
+	return Build(source, no_check, deterministic);
+}
+
+PerfectHashObject PerfectHashObject::BuildExternal(KeyReader& source, size_t memory_budget, const std::string& temp_dir,
+												   bool no_check, bool deterministic) {
+	auto total = source.Total();
+	if (total <= UINT16_MAX) {
+		return Build(source, no_check, deterministic);
+	}
+	PerfectHashObject out;
+	if (total >= (1U << 28U)) {
+		return out;
+	}
+	out.buffer_ = ::protocache::BuildExternal(source, memory_budget, temp_dir, out.data_size_, no_check, deterministic);
+	if (out.buffer_ != nullptr) {
+		out.data_ = out.buffer_.get()+sizeof(Divisor);
+		out.section_ = Section(total);
+	}
+	return out;
+}
+
+FileKeyReader::~FileKeyReader() noexcept {
+	if (file_ != nullptr) {
+		fclose(file_);
+	}
+}
+
+void FileKeyReader::Reset() {
+	if (file_ != nullptr) {
+		rewind(file_);
+		rest_ = size_;
+	}
+}
+
+Slice<uint8_t> FileKeyReader::Read() {
+	uint8_t head[4];
+	if (file_ == nullptr || fread(head, 1, 4, file_) != 4) {
+		return {};
+	}
+	uint32_t len = head[0] | (head[1] << 8U) | (head[2] << 16U) | ((uint32_t)head[3] << 24U);
+	if (rest_ < 4 || len > rest_ - 4) {
+		return {};	// broken length, do not trust it for allocation
+	}
+	buffer_.resize(len);
+	if (fread(&buffer_[0], 1, len, file_) != len) {
+		return {};
+	}
+	rest_ -= 4 + len;
+	return {reinterpret_cast<const uint8_t*>(buffer_.data()), len};
+}
+
+FileKeyReader FileKeyReader::Open(const std::string& path) {
+	FileKeyReader out;
+	out.file_ = fopen(path.c_str(), "rb");
+	if (out.file_ == nullptr) {
+		return out;
+	}
+	long size = -1;
+	if (fseek(out.file_, 0, SEEK_END) == 0) {
+		size = ftell(out.file_);
+	}
+	if (size < 0) {
+		fclose(out.file_);
+		out.file_ = nullptr;
+		return out;
+	}
+	out.size_ = size;
+	out.Reset();
+	size_t total = 0;
+	while (!!out.Read()) {
+		total++;
+	}
+	if (!feof(out.file_)) {
+		fclose(out.file_);
+		out.file_ = nullptr;
+		return out;
+	}
+	out.total_ = total;
+	out.Reset();
+	return out;
+}
+
+bool FileKeyReader::Dump(KeyReader& source, const std::string& path) {
+	FilePtr file(fopen(path.c_str(), "wb"));
+	if (file == nullptr) {
+		return false;
+	}
+	source.Reset();
+	auto total = source.Total();
+	for (size_t i = 0; i < total; i++) {
+		auto key = source.Read();
+		if (!key || key.size() > UINT32_MAX) {
+			return false;
+		}
+		uint32_t len = key.size();
+		uint8_t head[4] = {
+			static_cast<uint8_t>(len), static_cast<uint8_t>(len >> 8U),
+			static_cast<uint8_t>(len >> 16U), static_cast<uint8_t>(len >> 24U)
+		};
+		if (fwrite(head, 1, 4, file.get()) != 4
+			|| fwrite(key.data(), 1, key.size(), file.get()) != key.size()) {
+			return false;
+		}
+	}
+	return fclose(file.release()) == 0;
+}
+
 } //protocache
@@ -3,9 +3,16 @@
 // license that can be found in the LICENSE file.
 
 #include <cstring>
+#include <algorithm>
 #include <vector>
+#include <atomic>
+#include <mutex>
+#if !defined(__wasm__)
+#include <thread>
+#endif
 #include "protocache/perfect_hash.h"
 #include "protocache/serialize.h"
+#include "hash.h"
 #if defined(__i386__) || defined(__x86_64__)
 #include <immintrin.h>
 #endif
@@ -26,6 +33,121 @@ static inline uint32_t Offset(uint32_t off) noexcept {
 	return (off<<2U) | 3U;
 }
 
+enum : uint32_t {
+	KIND_MESSAGE = 1,
+	KIND_ARRAY = 2,
+	KIND_MAP = 3,
+};
+
+void DedupTable::Clear() noexcept {
+	index_.clear();
+	entries_.clear();
+	keys_.clear();
+	key_.clear();
+	hash_ = 0;
+	top_ = 0;
+	saved_ = 0;
+}
+
+void DedupTable::Leaf(Buffer& buf, Unit& unit) {
+	if (unit.len != 0 || unit.seg.len < 4) {
+		return;
+	}
+	assert(unit.seg.pos == buf.Size());
+	auto data = buf.Head();
+	auto len = unit.seg.len;
+	auto hash = Hash128(reinterpret_cast<const uint8_t*>(data), len*sizeof(uint32_t)).u64[0];
+	auto range = index_.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it) {
+		auto& entry = entries_[it->second];
+		if (entry.key_len == 0 && entry.len == len && Reachable(buf, entry.pos)
+			&& memcmp(buf.At(entry.pos), data, len*sizeof(uint32_t)) == 0) {
+			buf.Shrink(len);
+			unit.seg.pos = entry.pos;
+			unit.pinned = true;
+			saved_ += len;
+			return;
+		}
+	}
+	index_.emplace(hash, entries_.size());
+	entries_.push_back({unit.seg.pos, len, len, 0, 0});
+	top_ = std::max(top_, size_t{unit.seg.pos});
+}
+
+void DedupTable::Begin(uint32_t kind) {
+	key_.clear();
+	key_.push_back(kind);
+}
+
+void DedupTable::Append(Buffer& buf, const Unit& unit) {
+	if (unit.len != 0) {
+		key_.push_back(unit.len);
+		key_.insert(key_.end(), unit.data, unit.data + unit.len);
+	} else if (unit.seg.len == 0) {
+		key_.push_back(0);
+	} else if (unit.seg.len < 4 && !unit.pinned) {
+		// small data may be copied into cells, so it's compared by value
+		key_.push_back(4 + unit.seg.len);
+		auto src = buf.At(unit.seg.pos);
+		key_.insert(key_.end(), src, src + unit.seg.len);
+	} else {
+		key_.push_back(8);
+		key_.push_back(unit.seg.pos);
+	}
+}
+
+void DedupTable::Append(const Slice<uint8_t>& bytes) {
+	key_.push_back(bytes.size());
+	auto off = key_.size();
+	key_.resize(off + WordSize(bytes.size()), 0);
+	memcpy(key_.data() + off, bytes.data(), bytes.size());
+}
+
+bool DedupTable::Hit(Buffer& buf, size_t last, Unit& unit) {
+	hash_ = Hash128(reinterpret_cast<const uint8_t*>(key_.data()), key_.size()*sizeof(uint32_t)).u64[0];
+	if (Touched(last)) {
+		return false;	// some child is new, no match
+	}
+	auto range = index_.equal_range(hash_);
+	for (auto it = range.first; it != range.second; ++it) {
+		auto& entry = entries_[it->second];
+		if (entry.key_len == key_.size() && Reachable(buf, entry.pos)
+			&& memcmp(keys_.data() + entry.key, key_.data(), key_.size()*sizeof(uint32_t)) == 0) {
+			// only small children are left in the region
+			saved_ += entry.own + (buf.Size() - last);
+			buf.Shrink(buf.Size() - last);
+			unit = Segment(entry.pos - entry.len, entry.pos);
+			unit.pinned = true;
+			return true;
+		}
+	}
+	return false;
+}
+
+void DedupTable::Remember(const Unit& unit, size_t own) {
+	if (unit.len != 0 || unit.seg.len < 4 || keys_.size() + key_.size() > UINT32_MAX) {
+		return;
+	}
+	index_.emplace(hash_, entries_.size());
+	entries_.push_back({unit.seg.pos, unit.seg.len, static_cast<uint32_t>(own),
+						static_cast<uint32_t>(keys_.size()), static_cast<uint32_t>(key_.size())});
+	keys_.insert(keys_.end(), key_.begin(), key_.end());
+	top_ = std::max(top_, size_t{unit.seg.pos});
+}
+
+bool DedupTable::Detach(Buffer& buf, Unit& unit) {
+	auto last = buf.Size();
+	auto len = unit.seg.len;
+	auto dest = buf.Expand(len);
+	if (dest == nullptr) {
+		return false;
+	}
+	memcpy(dest, buf.At(unit.seg.pos), len*sizeof(uint32_t));	// self-contained
+	unit = Segment(last, buf.Size());
+	saved_ -= std::min(saved_, size_t{len});
+	return true;
+}
+
 bool Serialize(const Slice<char>& str, Buffer& buf, Unit& unit) {
 	if (str.size() >= (1U << 30U)) {
 		return false;
@@ -42,6 +164,9 @@ bool Serialize(const Slice<char>& str, Buffer& buf, Unit& unit) {
 	} else {
 		unit.len = 0;
 		dest = buf.Expand(size);
+		if (dest == nullptr) {
+			return false;
+		}
 	}
 	dest[size-1] = 0;
 	auto p = reinterpret_cast<uint8_t*>(dest);
@@ -51,43 +176,20 @@ bool Serialize(const Slice<char>& str, Buffer& buf, Unit& unit) {
 	memcpy(p, str.data(), str.size());
 	if (unit.len == 0) {
 		unit = Segment(last, buf.Size());
+		if (buf.Dedup() != nullptr) {
+			buf.Dedup()->Leaf(buf, unit);
+		}
 	}
 	return true;
 }
 
 template <typename T, typename F>
 static size_t BestArraySize(const std::vector<T>& elements, unsigned& m, F f) {
-	size_t sizes[3] = {0, 0, 0};
+	ArraySize sizes;
 	for (auto& raw : elements) {
-		auto& one = f(raw);
-		sizes[0] += 1;
-		sizes[1] += 2;
-		sizes[2] += 3;
-		auto len = one.len;
-		if (len == 0) {
-			len = one.seg.len;
-		}
-		if (len <= 1) {
-			continue;
-		}
-		sizes[0] += len;
-		if (len <= 2) {
-			continue;
-		}
-		sizes[1] += len;
-		if (len <= 3) {
-			continue;
-		}
-		sizes[2] += len;
-	}
-	unsigned mode = 0;
-	for (unsigned i = 1; i < 3; i++) {
-		if (sizes[i] < sizes[mode]) {
-			mode = i;
-		}
+		sizes.Add(f(raw));
 	}
-	m = mode + 1;
-	return sizes[mode];
+	return sizes.Best(m);
 }
 
 static inline void Pick(Unit& unit, Buffer& buf, uint32_t*& tail, unsigned m) {
@@ -130,8 +232,64 @@ static inline void Pick(Unit& unit, Buffer& buf, uint32_t*& tail, unsigned m) {
 	}
 }
 
-static inline void Mark(const Unit& unit, Buffer& buf, unsigned m) {
+// copy small data into the unit, but move nothing
+static inline void PickInPlace(Unit& unit, Buffer& buf, unsigned m) {
+	if (unit.len != 0 || unit.pinned || unit.seg.len > m) {
+		return;
+	}
+	unit.len = unit.seg.len;
+	auto src = buf.At(unit.seg.pos);
+	for (unsigned j = 0; j < unit.len; j++) {
+		unit.data[j] = src[j];
+	}
+}
+
+// Data after last can be moved only when nothing there is pinned or remembered.
+template <typename T, typename F>
+static bool Movable(const std::vector<T>& elements, const Buffer& buf, size_t last, F f) {
+	auto dedup = buf.Dedup();
+	if (dedup == nullptr) {
+		return true;
+	}
+	if (dedup->Touched(last)) {
+		return false;
+	}
+	for (auto& one : elements) {
+		if (f(one)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Find the child Detect takes as the tail, each visits children in the order
+// Detect checks them. Children reaching beyond it are detached.
+template <typename F>
+static bool Confine(Buffer& buf, const Unit*& tail, F each) {
+	auto dedup = buf.Dedup();
+	tail = nullptr;
+	return each([dedup, &buf, &tail](Unit& unit)->bool {
+		if (unit.len != 0 || unit.seg.len == 0) {
+			return true;
+		}
+		if (tail == nullptr) {
+			tail = &unit;
+			return true;
+		}
+		return unit.seg.end() >= tail->seg.end() || dedup->Detach(buf, unit);
+	});
+}
+
+// Dedup needs the region Detect finds, which skips small data left in place.
+static inline Unit Region(const Unit* tail, size_t own, size_t now) {
+	return Segment(tail != nullptr? tail->seg.end() : now - own, now);
+}
+
+static inline bool Mark(const Unit& unit, Buffer& buf, unsigned m) {
 	auto cell = buf.Expand(m);
+	if (cell == nullptr) {
+		return false;
+	}
 	if (unit.len == 0) {
 		*cell = Offset(buf.Size() - unit.seg.pos);
 		for (unsigned i = 1; i < m; i++) {
@@ -146,6 +304,7 @@ static inline void Mark(const Unit& unit, Buffer& buf, unsigned m) {
 			cell[i] = 0;
 		}
 	}
+	return true;
 }
 
 bool SerializeArray(std::vector<Unit>& elements, Buffer& buf, size_t last, Unit& unit) {
@@ -155,22 +314,61 @@ bool SerializeArray(std::vector<Unit>& elements, Buffer& buf, size_t last, Unit&
 		return true;
 	}
 
+	auto dedup = buf.Dedup();
+	if (dedup != nullptr) {
+		dedup->Begin(KIND_ARRAY);
+		for (auto& one : elements) {
+			dedup->Append(buf, one);
+		}
+		if (dedup->Hit(buf, last, unit)) {
+			return true;
+		}
+	}
+
 	unsigned m = 0;
 	size_t size = BestArraySize(elements, m, [](const Unit& u)->const Unit&{ return u; });
 	if (size >= (1U<<30U)) {
 		return false;
 	}
 
-	auto tail = buf.At(last);
-	for (int i = static_cast<int>(elements.size())-1; i >= 0; i--) {
-		Pick(elements[i], buf, tail, m);
+	auto pinned = !Movable(elements, buf, last, [](const Unit& u)->bool{ return u.pinned; });
+	if (!pinned) {
+		auto tail = buf.At(last);
+		for (int i = static_cast<int>(elements.size())-1; i >= 0; i--) {
+			Pick(elements[i], buf, tail, m);
+		}
+		buf.Shrink(tail - buf.Head());
+	} else {
+		for (auto& one : elements) {
+			PickInPlace(one, buf, m);
+		}
+	}
+	const Unit* tail = nullptr;
+	if (dedup != nullptr && !Confine(buf, tail, [&elements](auto&& fn)->bool {
+			for (auto it = elements.rbegin(); it != elements.rend(); ++it) {
+				if (!fn(*it)) {
+					return false;
+				}
+			}
+			return true;
+		})) {
+		return false;
 	}
-	buf.Shrink(tail - buf.Head());
 	for (int i = static_cast<int>(elements.size())-1; i >= 0; i--) {
-		Mark(elements[i], buf, m);
+		if (!Mark(elements[i], buf, m)) {
+			return false;
+		}
+	}
+	if (!buf.Put((elements.size() << 2U) | m)) {
+		return false;
 	}
-	buf.Put((elements.size() << 2U) | m);
 	unit = Segment(last, buf.Size());
+	if (dedup != nullptr) {
+		auto own = 1 + elements.size()*m;
+		unit = Region(tail, own, buf.Size());
+		unit.pinned = pinned;
+		dedup->Remember(unit, own);
+	}
 	return true;
 }
 
@@ -182,6 +380,19 @@ bool SerializeMap(const Slice<uint8_t>& index, std::vector<std::pair<Unit,Unit>>
 		return true;
 	}
 
+	auto dedup = buf.Dedup();
+	if (dedup != nullptr) {
+		dedup->Begin(KIND_MAP);
+		dedup->Append(index);
+		for (auto& one : pairs) {
+			dedup->Append(buf, one.first);
+			dedup->Append(buf, one.second);
+		}
+		if (dedup->Hit(buf, last, unit)) {
+			return true;
+		}
+	}
+
 	unsigned m1 = 0;
 	auto key_size = BestArraySize(pairs, m1,
 		[](const std::pair<Unit,Unit>& p)->const Unit&{ return p.first; });
@@ -195,21 +406,52 @@ bool SerializeMap(const Slice<uint8_t>& index, std::vector<std::pair<Unit,Unit>>
 		return false;
 	}
 
-	auto tail = buf.At(last);
-	for (auto it = pairs.rbegin(); it != pairs.rend(); ++it) {
-		Pick(it->second, buf, tail, m2);
-		Pick(it->first, buf, tail, m1);
+	auto pinned = !Movable(pairs, buf, last, [](const std::pair<Unit,Unit>& p)->bool{
+		return p.first.pinned || p.second.pinned;
+	});
+	if (!pinned) {
+		auto tail = buf.At(last);
+		for (auto it = pairs.rbegin(); it != pairs.rend(); ++it) {
+			Pick(it->second, buf, tail, m2);
+			Pick(it->first, buf, tail, m1);
+		}
+		buf.Shrink(tail - buf.Head());
+	} else {
+		for (auto& one : pairs) {
+			PickInPlace(one.second, buf, m2);
+			PickInPlace(one.first, buf, m1);
+		}
+	}
+	const Unit* tail = nullptr;
+	if (dedup != nullptr && !Confine(buf, tail, [&pairs](auto&& fn)->bool {
+			for (auto it = pairs.rbegin(); it != pairs.rend(); ++it) {
+				if (!fn(it->second) || !fn(it->first)) {
+					return false;
+				}
+			}
+			return true;
+		})) {
+		return false;
 	}
-	buf.Shrink(tail - buf.Head());
 	for (auto it = pairs.rbegin(); it != pairs.rend(); ++it) {
-		Mark(it->second, buf, m2);
-		Mark(it->first, buf, m1);
+		if (!Mark(it->second, buf, m2) || !Mark(it->first, buf, m1)) {
+			return false;
+		}
 	}
 	auto head = buf.Expand(index_size);
+	if (head == nullptr) {
+		return false;
+	}
 	head[index_size-1] = 0;
 	memcpy(head, index.data(), index.size());
-	*head |= (m1<<30U) | (m2<<28U);
+	*head = (*head & 0x0fffffffU) | (m1<<30U) | (m2<<28U);	// index may come from old data
 	unit = Segment(last, buf.Size());
+	if (dedup != nullptr) {
+		auto own = index_size + pairs.size()*(m1+m2);
+		unit = Region(tail, own, buf.Size());
+		unit.pinned = pinned;
+		dedup->Remember(unit, own);
+	}
 	return true;
 }
 
@@ -222,10 +464,35 @@ bool SerializeMessage(Span<Unit> fields, Buffer& buf, size_t last, Unit& unit) {
 	}
 	if (fields.empty()) {
 		// top api will skip unit, don't embed data into it
-		buf.Put(0);
+		if (!buf.Put(0)) {
+			return false;
+		}
 		unit = Segment(last, buf.Size());
 		return true;
 	}
+	auto dedup = buf.Dedup();
+	bool pinned = false;
+	if (dedup != nullptr) {
+		dedup->Begin(KIND_MESSAGE);
+		for (auto& field : fields) {
+			dedup->Append(buf, field);
+			pinned |= field.pinned;
+		}
+		if (dedup->Hit(buf, last, unit)) {
+			return true;
+		}
+	}
+	const Unit* tail = nullptr;
+	if (dedup != nullptr && !Confine(buf, tail, [&fields](auto&& fn)->bool {
+			for (auto i = fields.size(); i-- > 0;) {
+				if (!fn(fields[i])) {
+					return false;
+				}
+			}
+			return true;
+		})) {
+		return false;
+	}
 	//auto tail = buf.At(last);
 	size_t size = 0;
 	unsigned body_size = 0;
@@ -251,6 +518,9 @@ bool SerializeMessage(Span<Unit> fields, Buffer& buf, size_t last, Unit& unit) {
 	auto head_size = 1 + section*2;
 	//buf.Shrink(tail - buf.Head());
 	auto head = buf.Expand(head_size + body_size);
+	if (head == nullptr) {
+		return false;
+	}
 	auto body = head + head_size;
 	auto pos = buf.Size() - head_size;
 
@@ -298,6 +568,237 @@ bool SerializeMessage(Span<Unit> fields, Buffer& buf, size_t last, Unit& unit) {
 		*blk++ = mark;
 	}
 	unit = Segment(last, buf.Size());
+	if (dedup != nullptr) {
+		unit = Region(tail, head_size + body_size, buf.Size());
+		unit.pinned = pinned;
+		dedup->Remember(unit, head_size + body_size);
+	}
+	return true;
+}
+
+void FieldTree::Add(const unsigned* path, size_t len) {
+	unsigned node = 0;
+	for (size_t i = 0; i < len && node != kWhole; i++) {
+		auto& children = nodes_[node];
+		auto it = std::lower_bound(children.begin(), children.end(), path[i],
+								   [](const Child& one, unsigned id) { return one.id < id; });
+		if (i+1 == len) {
+			if (it == children.end() || it->id != path[i]) {
+				children.insert(it, {path[i], kWhole});
+			} else {
+				it->node = kWhole;
+			}
+			return;
+		}
+		if (it != children.end() && it->id == path[i]) {
+			node = it->node;
+			continue;
+		}
+		unsigned next = nodes_.size();
+		children.insert(it, {path[i], next});
+		nodes_.emplace_back();	// children is invalid from here
+		node = next;
+	}
+}
+
+bool ProjectMessage(const Message& message, const uint32_t* end, const FieldTree& tree, unsigned node,
+					Buffer& buf, Unit& unit, const std::function<bool(unsigned, unsigned, Unit&)>& fn) {
+	auto& picks = tree.Children(node);
+	std::vector<Unit> fields(picks.empty()? 1 : picks.back().id+1);
+	auto last = buf.Size();
+	for (auto it = picks.rbegin(); it != picks.rend(); ++it) {
+		if (message.HasField(it->id, end) && !fn(it->id, it->node, fields[it->id])) {
+			return false;
+		}
+	}
+	return SerializeMessage(fields, buf, last, unit);
+}
+
+// Lets workers share the resource of the output buffer.
+class LockedResource final : public std::pmr::memory_resource {
+public:
+	explicit LockedResource(std::pmr::memory_resource* upstream) noexcept : upstream_(upstream) {}
+
+private:
+	std::pmr::memory_resource* upstream_;
+	std::mutex mutex_;
+
+	void* do_allocate(size_t bytes, size_t alignment) override {
+		std::lock_guard<std::mutex> guard(mutex_);
+		return upstream_->allocate(bytes, alignment);
+	}
+	void do_deallocate(void* ptr, size_t bytes, size_t alignment) override {
+		std::lock_guard<std::mutex> guard(mutex_);
+		upstream_->deallocate(ptr, bytes, alignment);
+	}
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+		return this == &other;
+	}
+};
+
+bool SerializeParallel(Buffer& buf, Unit units[], size_t n, unsigned group,
+					   const std::function<bool(unsigned, size_t, Buffer&, Unit*)>& fn) {
+	size_t threads = std::min(size_t(buf.Threads()), n);
+#if defined(__wasm__)
+	threads = 1;
+#endif
+	if (buf.Fixed()) {
+		threads = 1;
+	}
+	if (threads <= 1) {
+		for (size_t i = n; i-- > 0;) {
+			if (!fn(0, i, buf, units + i*group)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// more chunks than workers, so a free worker picks up what is left
+	auto chunks = std::min(n, threads * 8);
+	auto range = [n, chunks](size_t k)->std::pair<size_t,size_t> {
+		return {n*k/chunks, n*(k+1)/chunks};
+	};
+	LockedResource resource(buf.Resource());
+	std::vector<Buffer> parts;
+	parts.reserve(chunks);
+	for (size_t k = 0; k < chunks; k++) {
+		parts.emplace_back(buf.Resource() == nullptr ? nullptr : &resource);
+		parts.back().SetDeterministic(buf.Deterministic());
+	}
+	std::atomic<size_t> next(0);
+	std::atomic<bool> failed(false);
+	auto work = [&](unsigned worker) {
+		while (!failed.load(std::memory_order_relaxed)) {
+			auto k = next.fetch_add(1, std::memory_order_relaxed);
+			if (k >= chunks) {
+				return;
+			}
+			auto [begin, end] = range(k);
+			for (auto i = end; i-- > begin;) {
+				if (!fn(worker, i, parts[k], units + i*group)) {
+					failed.store(true, std::memory_order_relaxed);
+					return;
+				}
+			}
+		}
+	};
+#if !defined(__wasm__)
+	std::vector<std::thread> workers;
+	workers.reserve(threads-1);
+	for (unsigned w = 1; w < threads; w++) {
+		workers.emplace_back(work, w);
+	}
+	work(0);
+	for (auto& one : workers) {
+		one.join();
+	}
+#endif
+	if (failed.load()) {
+		return false;
+	}
+
+	size_t total = buf.Size();
+	for (auto& part : parts) {
+		total += part.Size();
+	}
+	if (!buf.Reserve(total)) {
+		return false;
+	}
+	// offsets are relative, so a part can be moved as a whole
+	for (size_t k = chunks; k-- > 0;) {
+		auto base = buf.Size();
+		if (!buf.Put(parts[k].View())) {
+			return false;
+		}
+		auto [begin, end] = range(k);
+		for (auto unit = units + begin*group; unit < units + end*group; unit++) {
+			if (unit->len == 0 && unit->seg.len != 0) {
+				unit->seg.pos += base;
+			}
+		}
+	}
+	return true;
+}
+
+bool MeasureString(size_t len, Unit& unit) {
+	if (len >= (1U << 30U)) {
+		return false;
+	}
+	uint8_t header[5];
+	auto size = WordSize(WriteVarInt(header, len << 2U) + len);
+	if (size == 1) {
+		unit.len = 1;
+	} else {
+		unit = Segment(0, size);
+	}
+	return true;
+}
+
+bool MeasureArray(const ArraySize& elements, Unit& unit) {
+	if (elements.count == 0) {
+		unit.len = 1;
+		return true;
+	}
+	unsigned m = 0;
+	auto size = elements.Best(m);
+	if (size >= (1U<<30U)) {
+		return false;
+	}
+	unit = Segment(0, 1 + size);
+	return true;
+}
+
+bool MeasureMap(size_t index_size, const ArraySize& keys, const ArraySize& values, Unit& unit) {
+	if (keys.count == 0) {
+		unit.len = 1;
+		return true;
+	}
+	unsigned m = 0;
+	auto size = WordSize(index_size) + keys.Best(m) + values.Best(m);
+	if (size >= (1U<<30U)) {
+		return false;
+	}
+	unit = Segment(0, size);
+	return true;
+}
+
+bool MeasureMessage(Span<Unit> fields, Unit& unit) {
+	if (fields.empty()) {
+		return false;
+	}
+	while (!fields.empty() && fields.back().size() == 0) {
+		fields.pop_back();
+	}
+	if (fields.empty()) {
+		unit = Segment(0, 1);
+		return true;
+	}
+	size_t size = 0;
+	size_t extra = 0;
+	unsigned body_size = 0;
+	for (unsigned i = 0; i < fields.size(); i++) {
+		if (i >= 12 && (i - 12) % 25 == 0 && body_size >= (1U<<14U)) {
+			return false;
+		}
+		auto& field = fields[i];
+		if (field.len != 0) {
+			size += field.len;
+			body_size += field.len;
+		} else if (field.seg.len != 0) {
+			size += field.seg.len;
+			extra += field.seg.len;
+			body_size += 1;
+		}
+	}
+	if (size >= (1U<<30U)) {
+		return false;
+	}
+	auto section = (fields.size() + 12) / 25;
+	if (section > 0xff) {
+		return false;
+	}
+	unit = Segment(0, 1 + section*2 + body_size + extra);
 	return true;
 }
 
@@ -2,8 +2,15 @@
 // Use of this source code is governed by a BSD-style
 // license that can be found in the LICENSE file.
 
+#include <new>
 #include <string>
 #include <fstream>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include "protocache/utils.h"
 
 namespace protocache {
@@ -26,166 +33,261 @@ bool LoadFile(const std::string& path, std::string* out) {
 	return true;
 }
 
-void Compress(const uint8_t* src, size_t len, std::string* out) {
-	out->clear();
-	if (len == 0) {
-		return;
-	}
-	auto n = len;
-	while ((n & ~0x7fU) != 0) {
-		out->push_back(static_cast<char>(0x80U | (n & 0x7fU)));
-		n >>= 7U;
-	}
-	out->push_back(static_cast<char>(n));
-
-	auto end = src + len;
-	auto pick = [&src, end]()->uint8_t {
-		uint8_t cnt = 1;
-		auto ch = *src++;
-		int8_t x = ch;
-		if (x == (x >> 1)) {
-			while (src < end && cnt < 4 && *src == ch) {
-				src++;
-				cnt++;
-			}
-			return 0x8 | (ch & 0x4) | (cnt-1);
-		} else {
-			while (src < end && cnt < 7 && *src != 0 && *src != 0xff) {
-				src++;
-				cnt++;
-			}
-			return cnt;
-		}
-	};
+#if defined(_WIN32)
+MappedFile::~MappedFile() noexcept {
+	delete[] reinterpret_cast<uint32_t*>(data_);
+}
 
-	unsigned off = out->size();
-	out->resize(off + len + (len+13)/14);
-	auto dest = reinterpret_cast<uint8_t*>(const_cast<char*>(out->data())) + off;
+// no mmap here, fallback to an aligned copy
+MappedFile MappedFile::Open(const std::string& path, const Options&) {
+	MappedFile out;
+	std::ifstream ifs(path, std::ios_base::in | std::ios_base::binary | std::ios_base::ate);
+	if (!ifs) {
+		return out;
+	}
+	auto pos = ifs.tellg();
+	if (pos <= 0 || (pos & 3) != 0) {
+		return out;
+	}
+	size_t size = static_cast<size_t>(pos);
+	std::unique_ptr<uint32_t[]> data(new uint32_t[size/sizeof(uint32_t)]);
+	ifs.seekg(0);
+	if (!ifs.read(reinterpret_cast<char*>(data.get()), size)) {
+		return out;
+	}
+	out.data_ = data.release();
+	out.size_ = size;
+	return out;
+}
+#else
+MappedFile::~MappedFile() noexcept {
+	if (data_ != nullptr) {
+		munmap(data_, size_);
+	}
+}
 
-	auto copy = [&dest, end](const uint8_t* s, unsigned l) {
-		if (s+8 <= end) {
-			*reinterpret_cast<uint64_t*>(dest) = *reinterpret_cast<const uint64_t*>(s);
-		} else {
-			memcpy(dest, s, l);
-		}
-		dest += l;
-	};
-
-	while (src < end) {
-		auto x = src;
-		auto a = pick();
-		if (src == end) {
-			*dest++ = a;
-			if ((a & 0x8) == 0) {
-				copy(x, a);
-			}
+MappedFile MappedFile::Open(const std::string& path, const Options& options) {
+	MappedFile out;
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return out;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0 || (st.st_size & 3) != 0) {
+		close(fd);
+		return out;
+	}
+	auto size = static_cast<size_t>(st.st_size);
+	int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+	if (options.populate) {
+		flags |= MAP_POPULATE;
+	}
+#endif
+	auto addr = mmap(nullptr, size, PROT_READ, flags, fd, 0);
+	close(fd);	// mapping keeps its own reference
+	if (addr == MAP_FAILED) {
+		return out;
+	}
+	if ((reinterpret_cast<uintptr_t>(addr) & 3U) != 0) {
+		munmap(addr, size);
+		return out;
+	}
+#ifdef MADV_HUGEPAGE
+	if (options.huge_pages) {
+		madvise(addr, size, MADV_HUGEPAGE);	// just a hint, may be unsupported
+	}
+#endif
+	switch (options.advice) {
+		case ADVICE_RANDOM:
+			madvise(addr, size, MADV_RANDOM);
+			break;
+		case ADVICE_SEQUENTIAL:
+			madvise(addr, size, MADV_SEQUENTIAL);
+			break;
+		case ADVICE_WILLNEED:
+			madvise(addr, size, MADV_WILLNEED);
+			break;
+		default:
 			break;
-		}
-		auto y = src;
-		auto b = pick();
-		*dest++ = a | (b<<4);
-		if ((a & 0x8) == 0) {
-			copy(x, a);
-		}
-		if ((b & 0x8) == 0) {
-			copy(y, b);
-		}
 	}
-	out->resize(reinterpret_cast<char*>(dest) - out->data());
+	out.data_ = addr;
+	out.size_ = size;
+	return out;
 }
+#endif
 
-bool Decompress(const uint8_t* src, size_t len, std::string* out) {
-	out->clear();
-	if (len == 0) {
-		return true;
+#if defined(_WIN32)
+MappedOutput::~MappedOutput() noexcept {
+	if (data_ != nullptr) {
+		Sync();
+		delete[] reinterpret_cast<uint32_t*>(data_);
 	}
-	auto end = src + len;
-
-	unsigned size = 0;
-	auto parse_size = [&size, &src, end]()->bool {
-		for (unsigned sft = 0; sft < 32U; sft += 7U) {
-			if (src >= end) {
-				return false;
-			}
-			uint8_t b = *src++;
-			if (b & 0x80U) {
-				size |= static_cast<unsigned>(b & 0x7fU) << sft;
-			} else {
-				size |= static_cast<unsigned>(b) << sft;
-				return true;
-			}
-		}
-		return false;
-	};
-	if (!parse_size()) {
+}
+
+// no mmap here, data is kept in memory and written on Sync
+bool MappedOutput::Sync() {
+	if (data_ == nullptr) {
 		return false;
 	}
+	std::ofstream ofs(path_, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+	return ofs.write(reinterpret_cast<const char*>(data_), size_) && ofs.flush();
+}
 
-	out->resize(size+7);	// extra space for fast fill
-	auto dest = reinterpret_cast<uint8_t*>(const_cast<char*>(out->data()));
-	auto tail = reinterpret_cast<const uint8_t*>(out->data()) + size;
-
-	auto unpack = [&src, end, &dest, tail](uint8_t mark)->bool {
-		if (mark & 8) {
-			auto cnt = (mark & 3) + 1;
-			if (dest + cnt > tail) {
-				return false;
-			}
-			*reinterpret_cast<uint32_t*>(dest) =  static_cast<uint32_t>(0) - static_cast<uint32_t>((mark>>2) & 1);
-			dest += cnt;
-		} else if (mark != 0) {
-			auto l = mark;
-			if (src+l > end || dest+l > tail) {
-				return false;
-			}
-			if (src+8 <= end) {
-				*reinterpret_cast<uint64_t*>(dest) = *reinterpret_cast<const uint64_t*>(src);
-			} else {
-				memcpy(dest, src, l);
-			}
-			src += l;
-			dest += l;
-		}
-		return true;
-	};
+MappedOutput MappedOutput::Create(const std::string& path, size_t size) {
+	MappedOutput out;
+	if (size == 0 || (size & 3) != 0) {
+		return out;
+	}
+	out.data_ = new uint32_t[size/sizeof(uint32_t)];
+	out.size_ = size;
+	out.path_ = path;
+	return out;
+}
+#else
+MappedOutput::~MappedOutput() noexcept {
+	if (data_ != nullptr) {
+		munmap(data_, size_);
+	}
+}
+
+bool MappedOutput::Sync() {
+	return data_ != nullptr && msync(data_, size_, MS_SYNC) == 0;
+}
+
+MappedOutput MappedOutput::Create(const std::string& path, size_t size) {
+	MappedOutput out;
+	if (size == 0 || (size & 3) != 0) {
+		return out;
+	}
+	int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		return out;
+	}
+	if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+		close(fd);
+		return out;
+	}
+	auto addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		return out;
+	}
+	out.data_ = addr;
+	out.size_ = size;
+	out.path_ = path;
+	return out;
+}
+#endif
+
+static inline unsigned SizeClass(size_t bytes) noexcept {
+	unsigned k = 6;
+	while ((size_t(1) << k) < bytes) {
+		k++;
+	}
+	return k;
+}
+
+// Pooled blocks come from plain operator new, over-aligned requests bypass
+// the pool.
+static inline bool OverAligned(size_t alignment) noexcept {
+	return alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+}
+
+void* BufferPool::do_allocate(size_t bytes, size_t alignment) {
+	if (OverAligned(alignment)) {
+		return ::operator new(bytes, std::align_val_t(alignment));
+	}
+	auto k = SizeClass(bytes);
+	if (k < kClasses && count_[k] != 0) {
+		return cache_[k][--count_[k]];
+	}
+	return ::operator new(size_t(1) << k);
+}
+
+void BufferPool::do_deallocate(void* ptr, size_t bytes, size_t alignment) {
+	if (OverAligned(alignment)) {
+		::operator delete(ptr, std::align_val_t(alignment));
+		return;
+	}
+	auto k = SizeClass(bytes);
+	if (k < kClasses && count_[k] < kKeep) {
+		cache_[k][count_[k]++] = ptr;
+		return;
+	}
+	::operator delete(ptr);
+}
 
-	while (src < end) {
-		auto mark = *src++;
-		if (!unpack(mark & 0xf) || !unpack(mark >> 4)) {
-			return false;
+void BufferPool::Trim() noexcept {
+	for (unsigned k = 0; k < kClasses; k++) {
+		while (count_[k] != 0) {
+			::operator delete(cache_[k][--count_[k]]);
 		}
 	}
-	out->resize(size);
-	return dest == tail;
 }
 
-void Buffer::DoExpand(size_t delta) {
+BufferPool* BufferPool::ThreadLocal() noexcept {
+	static thread_local BufferPool pool;
+	return &pool;
+}
+
+uint32_t* Buffer::Allocate(size_t size) {
+	if (resource_ != nullptr) {
+		return static_cast<uint32_t*>(resource_->allocate(size*sizeof(uint32_t), alignof(uint32_t)));
+	}
+	return new uint32_t[size];
+}
+
+void Buffer::Release() noexcept {
+	if (data_ == nullptr || fixed_) {
+		return;
+	}
+	if (resource_ != nullptr) {
+		resource_->deallocate(data_, size_*sizeof(uint32_t), alignof(uint32_t));
+	} else {
+		delete[] data_;
+	}
+}
+
+bool Buffer::DoExpand(size_t delta) {
+	if (fixed_) {
+		return false;
+	}
 	if (data_ == nullptr) {
 		size_ = std::max(delta, size_t{8});
-		data_.reset(new uint32_t[size_]);
+		data_ = Allocate(size_);
 		off_ = size_ - delta;
-		return;
+		return true;
 	}
 	auto size = size_ * 2;
 	if (size_ >= 256*1024) {
 		size = size_ * 3 / 2;
 	}
 	size = std::max(size, size_+delta);
-	std::unique_ptr<uint32_t[]> data(new uint32_t[size]);
+	auto data = Allocate(size);
 	auto off = size - Size();
-	memcpy(data.get()+off, data_.get()+off_, Size()*sizeof(uint32_t));
-	data_ = std::move(data);
+	memcpy(data+off, data_+off_, Size()*sizeof(uint32_t));
+	Release();
+	data_ = data;
 	size_ = size;
 	off_ = off - delta;
+	return true;
 }
 
-void Buffer::DoReserve(size_t size) {
-	std::unique_ptr<uint32_t[]> data(new uint32_t[size]);
+bool Buffer::DoReserve(size_t size) {
+	if (fixed_) {
+		return false;
+	}
+	auto data = Allocate(size);
 	auto off = size - Size();
-	memcpy(data.get()+off, data_.get()+off_, Size()*sizeof(uint32_t));
-	data_ = std::move(data);
+	if (data_ != nullptr) {
+		memcpy(data+off, data_+off_, Size()*sizeof(uint32_t));
+		Release();
+	}
+	data_ = data;
 	size_ = size;
 	off_ = off;
+	return true;
 }
 
 } // protocache
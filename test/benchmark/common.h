@@ -58,9 +58,17 @@ extern int BenchmarkFory();
 extern int BenchmarkProtoCacheEX();
 extern int BenchmarkProtobufSerialize(bool flat=false);
 extern int BenchmarkProtoCacheSerialize(bool partly=false);
+extern int BenchmarkProtoCacheSerializeAfterRead();
+extern int BenchmarkProtoCacheBuild();
 extern int BenchmarkForySerialize();
 
 extern int BenchmarkCompress(const char* name, const std::string& filepath);
+extern int BenchmarkCodecThroughput(const char* name, const std::string& filepath);
+
+extern int BenchmarkMapLookup();
+extern int BenchmarkMapPatch(size_t size=1000000);
 
 extern int BenchmarkTwitterSerializePB(bool flat=false);
 extern int BenchmarkTwitterSerializePC();
+extern int BenchmarkTwitterTranscode(bool direct=true);
+extern int BenchmarkTwitterToWire(bool direct=true);
@@ -0,0 +1,126 @@
+// Copyright (c) 2023, Ruan Kunliang.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "protocache/access-ex.h"
+#include "common.h"
+
+static int BenchmarkMapLookup(size_t size) {
+	std::vector<std::string> names(size);
+	protocache::MapEX<protocache::Slice<char>,int32_t> builder;
+	builder.reserve(size);
+	for (size_t i = 0; i < size; i++) {
+		names[i] = "feature-" + std::to_string(i * 2654435761U);
+		builder.emplace(names[i], static_cast<int32_t>(i));
+	}
+	protocache::Buffer buf;
+	if (!builder.Serialize(&buf)) {
+		puts("fail to serialize");
+		return -1;
+	}
+	builder.clear();
+	auto data = buf.View();
+	protocache::MapT<protocache::Slice<char>,int32_t> map(data.data(), data.end());
+	if (!map) {
+		puts("fail to load map");
+		return -1;
+	}
+
+	constexpr size_t kRequest = 256;
+	std::mt19937_64 rand(size);
+	std::vector<protocache::Slice<char>> keys(kLoop);
+	for (auto& key : keys) {
+		auto& name = names[rand() % size];
+		key = {name.data(), name.size()};
+	}
+	using Iterator = protocache::MapT<protocache::Slice<char>,int32_t>::Iterator;
+	std::vector<Iterator> out(kRequest);
+
+	Junk junk;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i + kRequest <= kLoop; i += kRequest) {
+		for (size_t j = 0; j < kRequest; j++) {
+			out[j] = map.Find(keys[i+j]);
+		}
+		for (auto& it : out) {
+			junk.u32 += (*it).Value();
+		}
+	}
+	auto delta_ms = DeltaMs(start);
+	printf("find-%lu: %ldms %x\n", size, delta_ms, junk.u32);
+
+	start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i + kRequest <= kLoop; i += kRequest) {
+		map.FindBatch(keys.data()+i, kRequest, out.data());
+		for (auto& it : out) {
+			junk.u32 += (*it).Value();
+		}
+	}
+	delta_ms = DeltaMs(start);
+	printf("find-batch-%lu: %ldms %x\n", size, delta_ms, junk.u32);
+	return 0;
+}
+
+int BenchmarkMapLookup() {
+	for (size_t size = 100; size <= 10000000; size *= 10) {
+		if (BenchmarkMapLookup(size) != 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// Patch one value of a map extracted from data, against adding a new key,
+// which needs a new index.
+int BenchmarkMapPatch(size_t size) {
+	protocache::MapEX<protocache::Slice<char>,int32_t> builder;
+	builder.reserve(size);
+	for (size_t i = 0; i < size; i++) {
+		builder.emplace("feature-" + std::to_string(i * 2654435761U), static_cast<int32_t>(i));
+	}
+	protocache::Buffer buf;
+	if (!builder.Serialize(&buf)) {
+		puts("fail to serialize");
+		return -1;
+	}
+	builder.clear();
+	auto data = buf.View();
+
+	constexpr size_t kRound = 10;
+	protocache::Buffer out;
+	unsigned cnt = 0;
+	long extract_ms = 0;
+	long patch_ms = 0;
+	long insert_ms = 0;
+	for (size_t i = 0; i < kRound; i++) {
+		auto start = std::chrono::steady_clock::now();
+		protocache::MapEX<protocache::Slice<char>,int32_t> map(data.data(), data.end());
+		auto mid = std::chrono::steady_clock::now();
+		extract_ms += DeltaMs(start, mid);
+		map.find("feature-0")->second = -1;
+		if (!map.Serialize(&out, data.end())) {
+			puts("fail to patch");
+			return -1;
+		}
+		patch_ms += DeltaMs(mid);
+		cnt += out.Size();
+		out.Clear();
+
+		start = std::chrono::steady_clock::now();
+		map.emplace("feature-new", -1);
+		if (!map.Serialize(&out, data.end())) {
+			puts("fail to insert");
+			return -1;
+		}
+		insert_ms += DeltaMs(start);
+		cnt += out.Size();
+		out.Clear();
+	}
+	printf("patch-%lu: extract %ldms, patch %ldms, insert %ldms %x\n",
+		size, extract_ms, patch_ms, insert_ms, cnt);
+	return 0;
+}
@@ -23,13 +23,23 @@ int main() {
 	std::cout << "========serialize========" << std::endl;
 	BenchmarkProtobufSerialize(false);
 	BenchmarkProtobufSerialize(true);
+	BenchmarkProtoCacheSerializeAfterRead();
 	BenchmarkProtoCacheSerialize(true);
 	BenchmarkProtoCacheSerialize(false);
+	BenchmarkProtoCacheBuild();
 
 	std::cout << "========compress========" << std::endl;
 	BenchmarkCompress("pb", "test.pb");
 	BenchmarkCompress("pc", "test.pc");
 	BenchmarkCompress("fb", "test.fb");
 	BenchmarkCompress("fr", "test.fr");
+	BenchmarkCodecThroughput("pb", "test.pb");
+	BenchmarkCodecThroughput("pc", "test.pc");
+	BenchmarkCodecThroughput("fb", "test.fb");
+	BenchmarkCodecThroughput("fr", "test.fr");
+
+	std::cout << "========lookup========" << std::endl;
+	BenchmarkMapLookup();
+	BenchmarkMapPatch();
 	return 0;
 }
\ No newline at end of file
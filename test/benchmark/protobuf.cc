@@ -339,3 +339,86 @@ int BenchmarkTwitterSerializePB(bool flat) {
 	}
 	return 0;
 }
+
+int BenchmarkTwitterTranscode(bool direct) {
+	std::string raw;
+	if (!protocache::LoadFile("twitter.pb", &raw)) {
+		puts("fail to load twitter.pb");
+		return -1;
+	}
+
+	unsigned cnt = 0;
+	protocache::Buffer buf;
+	auto start = std::chrono::steady_clock::now();
+	if (direct) {
+		protocache::Transcoder transcoder(::twitter::Root::descriptor());
+		for (size_t i = 0; i < kSmallLoop; i++) {
+			if (!transcoder.Transcode(raw, &buf)) {
+				puts("fail to transcode");
+				return -2;
+			}
+			cnt += buf.Size();
+			buf.Clear();
+		}
+		auto delta_ms = DeltaMs(start);
+		printf("transcode-twitter: %ldms %x\n", delta_ms, cnt);
+	} else {
+		for (size_t i = 0; i < kSmallLoop; i++) {
+			google::protobuf::Arena arena;
+			auto root = google::protobuf::Arena::CreateMessage<::twitter::Root>(&arena);
+			if (!root->ParseFromString(raw)) {
+				puts("fail to deserialize");
+				return -2;
+			}
+			protocache::Serialize(*root, &buf);
+			cnt += buf.Size();
+			buf.Clear();
+		}
+		auto delta_ms = DeltaMs(start);
+		printf("parse-serialize-twitter: %ldms %x\n", delta_ms, cnt);
+	}
+	return 0;
+}
+
+int BenchmarkTwitterToWire(bool direct) {
+	std::string raw;
+	if (!protocache::LoadFile("twitter.pb", &raw)) {
+		puts("fail to load twitter.pb");
+		return -1;
+	}
+	protocache::Buffer buf;
+	protocache::Transcoder transcoder(::twitter::Root::descriptor());
+	if (!transcoder.Transcode(raw, &buf)) {
+		puts("fail to transcode");
+		return -2;
+	}
+
+	unsigned cnt = 0;
+	std::string data;
+	auto start = std::chrono::steady_clock::now();
+	if (direct) {
+		for (size_t i = 0; i < kSmallLoop; i++) {
+			if (!protocache::DeserializeToWire(buf.View(), ::twitter::Root::descriptor(), &data)) {
+				puts("fail to emit");
+				return -3;
+			}
+			cnt += data.size();
+		}
+		auto delta_ms = DeltaMs(start);
+		printf("to-wire-twitter: %ldms %x\n", delta_ms, cnt);
+	} else {
+		for (size_t i = 0; i < kSmallLoop; i++) {
+			google::protobuf::Arena arena;
+			auto root = google::protobuf::Arena::CreateMessage<::twitter::Root>(&arena);
+			if (!protocache::Deserialize(buf.View(), root)) {
+				puts("fail to deserialize");
+				return -3;
+			}
+			root->SerializeToString(&data);
+			cnt += data.size();
+		}
+		auto delta_ms = DeltaMs(start);
+		printf("deserialize-serialize-twitter: %ldms %x\n", delta_ms, cnt);
+	}
+	return 0;
+}
@@ -2,7 +2,9 @@
 // Use of this source code is governed by a BSD-style
 // license that can be found in the LICENSE file.
 
+#include <algorithm>
 #include <cstdio>
+#include <utility>
 #include "protocache/extension/utils.h"
 #include "protocache/extension/reflection.h"
 #include "test.pc.h"
@@ -26,8 +28,11 @@ struct Junk2 : public Junk {
 	void Traverse(const protocache::reflection::Field& descriptor, protocache::Field field);
 	void Traverse(const protocache::reflection::Descriptor& descriptor, protocache::Message root);
 
-	void Traverse(::ex::test::Small& root);
-	void Traverse(::ex::test::Main& root);
+	// T may be const, then fields are read without being marked dirty
+	template <typename T>
+	void TraverseSmallEX(T& root);
+	template <typename T>
+	void TraverseMainEX(T& root);
 };
 
 inline void Junk2::Traverse(const ::test::Small& root) {
@@ -265,12 +270,14 @@ void Junk2::Traverse(const protocache::reflection::Descriptor& descriptor, proto
 	}
 }
 
-void Junk2::Traverse(::ex::test::Small& root) {
+template <typename T>
+void Junk2::TraverseSmallEX(T& root) {
 	u32 += root.i32() + root.flag();
 	u32 += JunkHash(root.str());
 }
 
-void Junk2::Traverse(::ex::test::Main& root) {
+template <typename T>
+void Junk2::TraverseMainEX(T& root) {
 	u32 += root.i32() + root.u32() + root.flag() + root.mode();
 	u32 += root.t_i32() + root.t_s32() + root.t_u32();
 	for (auto v : root.i32v()) {
@@ -304,9 +311,9 @@ void Junk2::Traverse(::ex::test::Main& root) {
 		f64 += v;
 	}
 
-	Traverse(*root.object());
+	TraverseSmallEX(*root.object());
 	for (auto& v : root.objectv()) {
-		Traverse(*v);
+		TraverseSmallEX(*v);
 	}
 
 	for (auto& p : root.index()) {
@@ -315,7 +322,7 @@ void Junk2::Traverse(::ex::test::Main& root) {
 
 	for (auto& p : root.objects()) {
 		u32 += p.first;
-		Traverse(*p.second);
+		TraverseSmallEX(*p.second);
 	}
 
 	for (auto& u : root.matrix()) {
@@ -405,7 +412,7 @@ int BenchmarkProtoCacheEX() {
 	auto start = std::chrono::steady_clock::now();
 	for (size_t i = 0; i < kLoop; i++) {
 		::ex::test::Main root(reinterpret_cast<const uint32_t*>(raw.data()));
-		junk.Traverse(root);
+		junk.TraverseMainEX(root);
 	}
 	auto delta_ms = DeltaMs(start);
 
@@ -437,7 +444,7 @@ int BenchmarkProtoCacheSerialize(bool partly) {
 		//root.objects();
 	} else {
 		Junk2 junk;
-		junk.Traverse(root);
+		junk.TraverseMainEX(root);
 	}
 
 	unsigned cnt = 0;
@@ -458,31 +465,159 @@ int BenchmarkProtoCacheSerialize(bool partly) {
 	return 0;
 }
 
-int BenchmarkCompress(const char* name, const std::string& filepath) {
+// fields read through const getters are still copied as they are
+int BenchmarkProtoCacheSerializeAfterRead() {
 	std::string raw;
-	if (!protocache::LoadFile(filepath, &raw)) {
-		printf("fail to load %s\n", filepath.c_str());
+	if (!protocache::LoadFile("test.pc", &raw)) {
+		puts("fail to load test.pc");
 		return -1;
 	}
-	std::string cooked;
-	cooked.reserve(raw.size());
+	::ex::test::Main root(reinterpret_cast<const uint32_t*>(raw.data()));
+	Junk2 junk;
+	junk.TraverseMainEX(std::as_const(root));
 
+	unsigned cnt = 0;
+	protocache::Buffer buf;
 	auto start = std::chrono::steady_clock::now();
 	for (size_t i = 0; i < kLoop; i++) {
-		protocache::Compress(raw, &cooked);
+		root.Serialize(&buf);
+		cnt += buf.Size();
+		buf.Clear();
 	}
 	auto delta_ms = DeltaMs(start);
-	printf("%s-compress: %luB %ldms\n", name, cooked.size(), delta_ms);
 
-	start = std::chrono::steady_clock::now();
+	printf("protocache-read: %ldms %x %016lx\n", delta_ms, cnt, junk.Fuse());
+	return 0;
+}
+
+int BenchmarkProtoCacheBuild() {
+	// same content as test.json, held in plain containers
+	const std::string data = "abc123!?$*&()'-=@~";
+	const std::vector<int32_t> i32v = {1, 2};
+	const std::vector<uint64_t> u64v = {12345678987654321ULL};
+	const std::vector<std::string> strv = {"abc", "apple", "banana", "orange", "pear",
+		"grape", "strawberry", "cherry", "mango", "watermelon"};
+	const std::vector<float> f32v = {1.1f, 2.2f};
+	const std::vector<double> f64v = {9.9, 8.8, 7.7, 6.6, 5.5};
+	const bool flags[] = {true, true, false, true, false, false, false};
+	const std::vector<std::string> keys = {"abc-1", "abc-2", "x-1", "x-2", "x-3", "x-4"};
+	const std::vector<int32_t> values = {1, 2, 1, 2, 3, 4};
+	const std::vector<int32_t> ids = {1, 2, 3, 4};
+	const std::vector<std::string> names = {"aaaaaaaaaaa", "b", "ccccccccccccccc", "ddddd"};
+	const std::vector<std::vector<float>> matrix = {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+
+	unsigned cnt = 0;
+	protocache::Buffer buf;
+	auto start = std::chrono::steady_clock::now();
 	for (size_t i = 0; i < kLoop; i++) {
-		if (!protocache::Decompress(cooked, &raw)) {
-			puts("fail to decompress");
-			return 1;
+		::test::Main::Builder root(buf);
+		root.i32(-999);
+		root.u32(1234);
+		root.i64(-9876543210LL);
+		root.u64(98765432123456789ULL);
+		root.flag(true);
+		root.mode(::test::MODE_C);
+		root.str("Hello World!");
+		root.data(data);
+		root.f32(-2.1f);
+		root.f64(1.0);
+		root.object([](::test::Small::Builder& one) {
+			one.i32(88);
+			one.str("tmp");
+		});
+		root.i32v(protocache::Slice<int32_t>(i32v));
+		root.u64v(protocache::Slice<uint64_t>(u64v));
+		root.strv(strv);
+		root.f32v(protocache::Slice<float>(f32v));
+		root.f64v(protocache::Slice<double>(f64v));
+		root.flags(protocache::Slice<bool>(flags, 7));
+		root.objectv(3, [](size_t j, ::test::Small::Builder& one) {
+			switch (j) {
+				case 0: one.i32(1); break;
+				case 1: one.flag(true); break;
+				default: one.str("good luck!"); break;
+			}
+		});
+		root.index(keys, [&values](size_t j) { return values[j]; });
+		root.objects(ids, [&ids, &names](size_t j, ::test::Small::Builder& one) {
+			one.i32(ids[j]);
+			one.str(names[j]);
+		});
+		root.matrix([&matrix](::test::Vec2D::Builder& one) {
+			one.Set(matrix.size(), [&matrix](size_t j, ::test::Vec2D::Vec1D::Builder& line) {
+				line.Set(protocache::Slice<float>(matrix[j]));
+			});
+		});
+		root.Finish();
+		cnt += buf.Size();
+		buf.Clear();
+	}
+	auto delta_ms = DeltaMs(start);
+
+	printf("protocache-build: %ldms %x\n", delta_ms, cnt);
+	return 0;
+}
+
+int BenchmarkCompress(const char* name, const std::string& filepath) {
+	std::string raw;
+	if (!protocache::LoadFile(filepath, &raw)) {
+		printf("fail to load %s\n", filepath.c_str());
+		return -1;
+	}
+	auto src = reinterpret_cast<const uint8_t*>(raw.data());
+	auto size = raw.size();
+	const std::pair<protocache::CodecVersion, const char*> versions[] = {
+		{protocache::CODEC_BYTES, ""},
+		{protocache::CODEC_WORDS, "-words"},
+	};
+	std::string cooked;
+	cooked.reserve(raw.size());
+	std::string out;
+	for (auto& [version, suffix] : versions) {
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < kLoop; i++) {
+			protocache::Compress(src, size, &cooked, version);
+		}
+		auto delta_ms = DeltaMs(start);
+		printf("%s-compress%s: %luB %ldms\n", name, suffix, cooked.size(), delta_ms);
+
+		start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < kLoop; i++) {
+			if (!protocache::Decompress(cooked, &out)) {
+				puts("fail to decompress");
+				return 1;
+			}
+		}
+		delta_ms = DeltaMs(start);
+		printf("%s-decompress%s: %ldms\n", name, suffix, delta_ms);
+	}
+	return 0;
+}
+
+int BenchmarkCodecThroughput(const char* name, const std::string& filepath) {
+	std::string raw;
+	if (!protocache::LoadFile(filepath, &raw)) {
+		printf("fail to load %s\n", filepath.c_str());
+		return -1;
+	}
+	auto src = reinterpret_cast<const uint8_t*>(raw.data());
+	const std::pair<protocache::CodecKernel, const char*> kernels[] = {
+		{protocache::CODEC_SCALAR, "scalar"},
+		{protocache::CODEC_SSE4, "sse4"},
+		{protocache::CODEC_AVX2, "avx2"},
+	};
+	std::string cooked;
+	for (auto& [kernel, kernel_name] : kernels) {
+		if (kernel > protocache::BestCodecKernel()) {
+			continue;
+		}
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < kLoop; i++) {
+			protocache::Compress(src, raw.size(), &cooked, kernel);
 		}
+		auto delta_ms = std::max(DeltaMs(start), 1L);
+		printf("%s-compress-%s: %luMB/s\n", name, kernel_name, raw.size() * kLoop / 1000 / delta_ms);
 	}
-	delta_ms = DeltaMs(start);
-	printf("%s-decompress: %ldms\n", name, delta_ms);
 	return 0;
 }
 
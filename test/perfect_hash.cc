@@ -2,6 +2,8 @@
 // Use of this source code is governed by a BSD-style
 // license that can be found in the LICENSE file.
 
+#include <filesystem>
+#include <fstream>
 #include <gtest/gtest.h>
 #include <protocache/perfect_hash.h>
 
@@ -28,14 +30,15 @@ private:
 	size_t idx_ = 0;
 };
 
-static void DoTest(unsigned size) {
+static void DoTest(unsigned size, unsigned threads=1) {
 	std::vector<std::string> keys(size);
 	for (unsigned i = 0; i < keys.size(); i++) {
 		keys[i] = std::to_string(i);
 	}
 	StrKeyReader reader(keys);
 
-	auto table = protocache::PerfectHashObject::Build(reader);
+	auto table = threads == 1? protocache::PerfectHashObject::Build(reader)
+		: protocache::PerfectHashObject::BuildParallel(reader, threads);
 	ASSERT_FALSE(!table);
 
 	std::vector<bool> mark(keys.size());
@@ -45,6 +48,17 @@ static void DoTest(unsigned size) {
 		ASSERT_FALSE(mark[pos]);
 		mark[pos] = true;
 	}
+
+	protocache::PerfectHash view(table.Data().data(), table.Data().size());
+	std::vector<protocache::Slice<uint8_t>> batch(keys.size());
+	for (unsigned i = 0; i < keys.size(); i++) {
+		batch[i] = {reinterpret_cast<const uint8_t*>(keys[i].data()), keys[i].size()};
+	}
+	std::vector<uint32_t> out(keys.size());
+	view.LocateBatch(batch.data(), batch.size(), out.data());
+	for (unsigned i = 0; i < keys.size(); i++) {
+		ASSERT_EQ(out[i], table.Locate(batch[i].data(), batch[i].size()));
+	}
 }
 
 TEST(PerfectHash, Tiny) {
@@ -64,3 +78,63 @@ TEST(PerfectHash, Big) {
 	DoTest(65535);
 	DoTest(100000);
 }
+
+TEST(PerfectHash, Parallel) {
+	DoTest(1000, 4);
+	DoTest(100000, 4);
+	DoTest(300000, 3);
+
+	std::vector<std::string> keys(100000);
+	for (unsigned i = 0; i < keys.size(); i++) {
+		keys[i] = std::to_string(i % 99999);
+	}
+	StrKeyReader reader(keys);
+	ASSERT_TRUE(!protocache::PerfectHashObject::BuildParallel(reader, 4));
+}
+
+TEST(PerfectHash, External) {
+	std::vector<std::string> keys(200000);
+	for (unsigned i = 0; i < keys.size(); i++) {
+		keys[i] = std::to_string(i);
+	}
+	const auto dir = std::filesystem::temp_directory_path();
+	const auto path = dir / "protocache-external-keys.bin";
+	StrKeyReader reader(keys);
+	ASSERT_TRUE(protocache::FileKeyReader::Dump(reader, path.string()));
+
+	auto source = protocache::FileKeyReader::Open(path.string());
+	ASSERT_FALSE(!source);
+	ASSERT_EQ(source.Total(), keys.size());
+	ASSERT_TRUE(!protocache::PerfectHashObject::BuildExternal(source, 1U << 20U, dir.string()));
+
+	auto table = protocache::PerfectHashObject::BuildExternal(source, 5U << 20U, dir.string());
+	ASSERT_FALSE(!table);
+	std::vector<bool> mark(keys.size());
+	for (auto& key : keys) {
+		auto pos = table.Locate(reinterpret_cast<const uint8_t *>(key.data()), key.size());
+		ASSERT_LT(pos, keys.size());
+		ASSERT_FALSE(mark[pos]);
+		mark[pos] = true;
+	}
+
+	keys[keys.size()-1] = keys[0];
+	ASSERT_TRUE(protocache::FileKeyReader::Dump(reader, path.string()));
+	source = protocache::FileKeyReader::Open(path.string());
+	ASSERT_FALSE(!source);
+	ASSERT_TRUE(!protocache::PerfectHashObject::BuildExternal(source, 5U << 20U, dir.string()));
+
+	// one key all over fills a single partition, which is refused at limit
+	std::fill(keys.begin(), keys.end(), keys[0]);
+	ASSERT_TRUE(protocache::FileKeyReader::Dump(reader, path.string()));
+	source = protocache::FileKeyReader::Open(path.string());
+	ASSERT_FALSE(!source);
+	ASSERT_TRUE(!protocache::PerfectHashObject::BuildExternal(source, 5U << 20U, dir.string()));
+
+	{	// a length beyond the file
+		std::ofstream file(path, std::ios_base::binary);
+		file.write("\xfc\xff\xff\xffkey", 7);
+	}
+	source = protocache::FileKeyReader::Open(path.string());
+	ASSERT_TRUE(!source);
+	std::filesystem::remove(path);
+}
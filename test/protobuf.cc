@@ -0,0 +1,78 @@
+// Copyright (c) 2023, Ruan Kunliang.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <gtest/gtest.h>
+#include <google/protobuf/arena.h>
+#include <google/protobuf/util/message_differencer.h>
+#include "protocache/extension/utils.h"
+#include "test.pb.h"
+#include "test.pc-pb.h"
+
+// Protobuf classes of test.proto are linked here, apart from protocache-test.
+
+TEST(Protobuf, FromProtobuf) {
+	for (auto json : {"test.json", "test-alias.json", "test-empty.json", "test-tiny.json"}) {
+		test::Main message;
+		ASSERT_TRUE(protocache::LoadJson(json, &message)) << json;
+
+		protocache::Buffer expected;
+		expected.SetDeterministic(true);
+		ASSERT_TRUE(protocache::Serialize(message, &expected)) << json;
+		protocache::Buffer buf;
+		buf.SetDeterministic(true);
+		ASSERT_TRUE(FromProtobuf(message, buf)) << json;
+		ASSERT_EQ(expected.Size(), buf.Size()) << json;
+		ASSERT_EQ(0, memcmp(expected.View().data(), buf.View().data(), buf.Size()*4)) << json;
+	}
+}
+
+TEST(Protobuf, ToProtobuf) {
+	for (auto json : {"test.json", "test-alias.json", "test-empty.json", "test-tiny.json"}) {
+		test::Main message;
+		ASSERT_TRUE(protocache::LoadJson(json, &message)) << json;
+		protocache::Buffer buf;
+		ASSERT_TRUE(protocache::Serialize(message, &buf)) << json;
+		auto data = buf.View();
+
+		test::Main expected;
+		ASSERT_TRUE(protocache::Deserialize(data, &expected)) << json;
+		test::Main out;
+		ASSERT_TRUE(ToProtobuf(data, &out)) << json;
+		ASSERT_TRUE(google::protobuf::util::MessageDifferencer::Equals(expected, out)) << json;
+
+		google::protobuf::Arena arena;
+		auto on_arena = protocache::DeserializeOn<test::Main>(&arena, data);
+		ASSERT_NE(on_arena, nullptr) << json;
+		ASSERT_EQ(on_arena->GetArena(), &arena);
+		ASSERT_TRUE(google::protobuf::util::MessageDifferencer::Equals(expected, *on_arena)) << json;
+
+		std::unique_ptr<test::Main> on_heap(protocache::DeserializeOn<test::Main>(nullptr, data));
+		ASSERT_NE(on_heap, nullptr) << json;
+		ASSERT_TRUE(google::protobuf::util::MessageDifferencer::Equals(expected, *on_heap)) << json;
+	}
+
+	// broken data fails, and nothing is left on heap
+	std::vector<uint32_t> junk = {0xffffffff, 0xffffffff};
+	protocache::Slice<uint32_t> bad(junk.data(), junk.size());
+	ASSERT_EQ(protocache::DeserializeOn<test::Main>(nullptr, bad), nullptr);
+
+	// a string or array field cut by the end fails the whole message
+	test::Main str, array;
+	str.set_str(std::string(40, 's'));
+	for (int i = 0; i < 10; i++) {
+		array.add_i32v(i);
+	}
+	for (auto message : {&str, &array}) {
+		protocache::Buffer buf;
+		ASSERT_TRUE(FromProtobuf(*message, buf));
+		auto data = buf.View();
+		test::Main out;
+		ASSERT_TRUE(ToProtobuf(data, &out));
+		ASSERT_TRUE(google::protobuf::util::MessageDifferencer::Equals(*message, out));
+		ASSERT_FALSE(ToProtobuf(protocache::Slice<uint32_t>(data.data(), data.size()-1), &out));
+	}
+}
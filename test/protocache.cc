@@ -9,11 +9,16 @@
 #include <gtest/gtest.h>
 #include <google/protobuf/message.h>
 #include <google/protobuf/dynamic_message.h>
+#include <google/protobuf/util/field_mask_util.h>
+#include <google/protobuf/util/message_differencer.h>
 #include <google/protobuf/descriptor.pb.h>
 #include "protocache/extension/reflection.h"
 #include "protocache/extension/utils.h"
+#include "protocache/protobuf/any.pc.h"
+#include "protocache/protobuf/duration.pc.h"
 #include "test.pc.h"
 #include "test.pc-ex.h"
+#include "wkt.pc.h"
 
 TEST(PtotoCache, Empty) {
 	// no crash
@@ -43,7 +48,8 @@ TEST(PtotoCache, Empty) {
 	ASSERT_TRUE(!protocache::FieldT<protocache::Message>(field).Get());
 }
 
-static bool SerializeByProtobuf(const std::string& json, protocache::Buffer& buf) {
+static bool SerializeByProtobuf(const std::string& json, protocache::Buffer& buf,
+								size_t* size=nullptr, const std::string& path={}) {
 	std::string err;
 	google::protobuf::FileDescriptorProto file;
 	if (!protocache::ParseProtoFile("test.proto", &file, &err)) {
@@ -75,6 +81,12 @@ static bool SerializeByProtobuf(const std::string& json, protocache::Buffer& buf
 		std::cerr << "fail to load json: " << json << std::endl;
 		return false;
 	}
+	if (size != nullptr && !protocache::SerializedSize(*message, size)) {
+		return false;
+	}
+	if (!path.empty() && !protocache::SerializeToFile(*message, path)) {
+		return false;
+	}
 	return protocache::Serialize(*message, &buf);
 }
 
@@ -387,6 +399,9 @@ TEST(PtotoCache, BigObject) {
 	auto view = buf.View();
 	auto end = view.data() + view.size();
 	protocache::Message unit(view.data(), end);
+	size_t size = 0;
+	ASSERT_TRUE(protocache::SerializedSize(*message, &size));
+	ASSERT_EQ(size, view.size());
 
 	for (int i = 1; i <= fields_cnt; i++) {
 		snprintf(name, sizeof(name), "i%d", i);
@@ -397,6 +412,43 @@ TEST(PtotoCache, BigObject) {
 	}
 }
 
+TEST(PtotoCache, MutableView) {
+	protocache::Buffer buffer;
+	ASSERT_TRUE(SerializeByProtobuf("test.json", buffer));
+	std::vector<uint32_t> data(buffer.View().begin(), buffer.View().end());
+	auto end = data.data() + data.size();
+	protocache::MutableView view(data.data(), end);
+	ASSERT_FALSE(!view);
+	auto root = view.Cast<test::Main>();
+
+	ASSERT_TRUE(root->set_i32_inplace(5, end));
+	ASSERT_TRUE(root->set_u64_inplace(1ULL << 40U, end));
+	ASSERT_TRUE(root->set_flag_inplace(false, end));
+	ASSERT_TRUE(root->set_f64_inplace(2.5, end));
+	ASSERT_TRUE(root->set_i32v_inplace(1, -7, end));
+	ASSERT_TRUE(root->set_u64v_inplace(0, 3, end));
+	ASSERT_TRUE(view.GetMessage(test::Main::_::object, end).Cast<test::Small>()->set_i32_inplace(99, end));
+
+	// absent field, element out of range and other width
+	ASSERT_FALSE(root->set_t_i32_inplace(1, end));
+	ASSERT_FALSE(root->set_i32v_inplace(2, 1, end));
+	ASSERT_FALSE(view.SetElement<int64_t>(test::Main::_::i32v, 0, 1, end));
+	ASSERT_FALSE(view.Set<int64_t>(test::Main::_::i32, 1, end));
+	ASSERT_TRUE(!view.GetMessage(test::Main::_::t_i32, end));
+
+	ASSERT_TRUE(test::Main::Verify(data.data(), end));
+	ASSERT_EQ(root->i32(end), 5);
+	ASSERT_EQ(root->u64(end), 1ULL << 40U);
+	ASSERT_FALSE(root->flag(end));
+	ASSERT_EQ(root->f64(end), 2.5);
+	ASSERT_EQ(root->i32v(end)[0], 1);
+	ASSERT_EQ(root->i32v(end)[1], -7);
+	ASSERT_EQ(root->u64v(end)[0], 3);
+	ASSERT_EQ(root->object(end)->i32(end), 99);
+	ASSERT_EQ(root->str(end), "Hello World!");
+	ASSERT_EQ(root->u32(end), 1234);
+}
+
 TEST(PtotoCacheEX, Basic) {
 	protocache::Buffer buffer;
 	ASSERT_TRUE(SerializeByProtobuf("test.json", buffer));
@@ -511,6 +563,665 @@ TEST(PtotoCache, Tiny) {
 	ASSERT_EQ(2, buffer.Size());
 }
 
+TEST(PtotoCache, FindBatch) {
+	protocache::MapEX<protocache::Slice<char>,int32_t> str_map;
+	protocache::MapEX<uint64_t,int32_t> num_map;
+	std::vector<std::string> names;
+	for (int i = 0; i < 1000; i++) {
+		names.push_back("key-" + std::to_string(i));
+		str_map.emplace(names.back(), i);
+		num_map.emplace(i * 7919ULL, i);
+	}
+	for (int i = 1000; i < 1100; i++) {	// misses
+		names.push_back("key-" + std::to_string(i));
+	}
+
+	protocache::Buffer str_buf, num_buf;
+	ASSERT_TRUE(str_map.Serialize(&str_buf));
+	ASSERT_TRUE(num_map.Serialize(&num_buf));
+	auto str_end = str_buf.View().end();
+	auto num_end = num_buf.View().end();
+	protocache::MapT<protocache::Slice<char>,int32_t> str_view(str_buf.View().data(), str_end);
+	protocache::MapT<uint64_t,int32_t> num_view(num_buf.View().data(), num_end);
+	ASSERT_FALSE(!str_view);
+	ASSERT_FALSE(!num_view);
+
+	std::vector<protocache::Slice<char>> str_keys;
+	std::vector<uint64_t> num_keys;
+	for (unsigned i = 0; i < names.size(); i++) {
+		str_keys.emplace_back(names[i].data(), names[i].size());
+		num_keys.push_back(i * 7919ULL);
+	}
+	std::vector<protocache::MapT<protocache::Slice<char>,int32_t>::Iterator> str_out(str_keys.size());
+	std::vector<protocache::MapT<uint64_t,int32_t>::Iterator> num_out(num_keys.size());
+	str_view.FindBatch(str_keys.data(), str_keys.size(), str_out.data(), str_end);
+	num_view.FindBatch(num_keys.data(), num_keys.size(), num_out.data(), num_end);
+	for (unsigned i = 0; i < names.size(); i++) {
+		ASSERT_EQ(str_out[i], str_view.Find(str_keys[i], str_end));
+		ASSERT_EQ(num_out[i], num_view.Find(num_keys[i], num_end));
+		if (i < 1000) {
+			ASSERT_EQ((*str_out[i]).Value(str_end), i);
+			ASSERT_EQ((*num_out[i]).Value(num_end), i);
+		} else {
+			ASSERT_EQ(str_out[i], str_view.end());
+			ASSERT_EQ(num_out[i], num_view.end());
+		}
+	}
+}
+
+TEST(PtotoCache, Deterministic) {
+	protocache::Buffer a, b;
+	a.SetDeterministic(true);
+	b.SetDeterministic(true);
+	ASSERT_TRUE(SerializeByProtobuf("test.json", a));
+	ASSERT_TRUE(SerializeByProtobuf("test.json", b));
+	ASSERT_EQ(a.Size(), b.Size());
+	ASSERT_EQ(0, memcmp(a.View().data(), b.View().data(), a.Size()*4));
+
+	protocache::MapEX<protocache::Slice<char>,int32_t> m1, m2;
+	m2.reserve(5000);
+	for (int i = 0; i < 1000; i++) {
+		m1.emplace(std::to_string(i), i);
+		m2.emplace(std::to_string(999-i), 999-i);
+	}
+	a.Clear();
+	b.Clear();
+	ASSERT_TRUE(m1.Serialize(&a));
+	ASSERT_TRUE(m2.Serialize(&b));
+	ASSERT_EQ(a.Size(), b.Size());
+	ASSERT_EQ(0, memcmp(a.View().data(), b.View().data(), a.Size()*4));
+
+	auto data = a.View();
+	protocache::MapT<protocache::Slice<char>,int32_t> view(data.data(), data.end());
+	ASSERT_EQ(view.Size(), 1000);
+	auto it = view.Find(protocache::Slice<char>("123"), data.end());
+	ASSERT_NE(it, view.end());
+	ASSERT_EQ((*it).Value(data.end()), 123);
+
+	// same logical data from two writers, their map indexes differ
+	protocache::Buffer expected, first, second;
+	expected.SetDeterministic(true);
+	ASSERT_TRUE(SerializeByProtobuf("test.json", expected));
+	ASSERT_TRUE(SerializeByProtobuf("test.json", first));
+	{
+		::ex::test::Main ex(first.View());
+		auto& index = ex.index(first.View().end());
+		ASSERT_TRUE(index.erase("abc-1"));
+		index.emplace("abc-1", 1);
+		ASSERT_TRUE(ex.Serialize(&second));
+	}
+	for (auto src : {&first, &second}) {
+		auto view = src->View();
+		protocache::Buffer out;
+		out.SetDeterministic(true);
+		::ex::test::Main ex(view);
+		ASSERT_TRUE(ex.Serialize(&out, view.end()));
+		ASSERT_EQ(out.Size(), expected.Size());
+		ASSERT_EQ(0, memcmp(out.View().data(), expected.View().data(), expected.Size()*4));
+
+		// a clean map alone
+		auto field = protocache::Message(view.data()).GetField(test::Main::_::index, view.end());
+		protocache::MapEX<protocache::Slice<char>,int32_t> map(field.GetObject(view.end()), view.end());
+		out.Clear();
+		ASSERT_TRUE(map.Serialize(&out, view.end()));
+		protocache::Buffer sorted;
+		sorted.SetDeterministic(true);
+		protocache::MapEX<protocache::Slice<char>,int32_t> copy(map);
+		ASSERT_TRUE(copy.Serialize(&sorted, view.end()));
+		ASSERT_EQ(out.Size(), sorted.Size());
+		ASSERT_EQ(0, memcmp(out.View().data(), sorted.View().data(), sorted.Size()*4));
+	}
+}
+
+TEST(Buffer, Storage) {
+	protocache::Buffer heap;
+	heap.SetDeterministic(true);
+	ASSERT_TRUE(SerializeByProtobuf("test.json", heap));
+	auto expected = heap.View();
+
+	std::vector<uint32_t> region(expected.size());
+	protocache::Buffer fixed(region.data(), region.size());
+	fixed.SetDeterministic(true);
+	ASSERT_TRUE(SerializeByProtobuf("test.json", fixed));
+	ASSERT_EQ(fixed.View().data(), region.data());
+	ASSERT_EQ(0, memcmp(region.data(), expected.data(), expected.size()*4));
+
+	protocache::Buffer small(region.data(), region.size()-1);
+	ASSERT_FALSE(SerializeByProtobuf("test.json", small));
+	ASSERT_FALSE(small.Reserve(region.size()));
+
+	auto pool = protocache::BufferPool::ThreadLocal();
+	const uint32_t* last = nullptr;
+	for (int i = 0; i < 3; i++) {
+		protocache::Buffer pooled(pool);
+		pooled.SetDeterministic(true);
+		ASSERT_TRUE(SerializeByProtobuf("test.json", pooled));
+		ASSERT_EQ(pooled.Size(), expected.size());
+		ASSERT_EQ(0, memcmp(pooled.View().data(), expected.data(), expected.size()*4));
+		if (last != nullptr) {
+			ASSERT_EQ(pooled.View().data(), last);	// same block is recycled
+		}
+		last = pooled.View().data();
+	}
+	// over-aligned requests are served apart
+	for (size_t align : {size_t(64), size_t(4096)}) {
+		auto block = pool->allocate(100, align);
+		ASSERT_EQ(0, reinterpret_cast<uintptr_t>(block) % align);
+		pool->deallocate(block, 100, align);
+	}
+	pool->Trim();
+
+	uint8_t arena[4096];
+	std::pmr::monotonic_buffer_resource resource(arena, sizeof(arena));
+	protocache::Buffer pmr(&resource);
+	pmr.SetDeterministic(true);
+	ASSERT_TRUE(SerializeByProtobuf("test.json", pmr));
+	ASSERT_EQ(0, memcmp(pmr.View().data(), expected.data(), expected.size()*4));
+	auto addr = reinterpret_cast<const uint8_t*>(pmr.View().data());
+	ASSERT_TRUE(addr >= arena && addr < arena + sizeof(arena));
+}
+
+TEST(PtotoCache, SerializedSize) {
+	for (auto json : {"test.json", "test-alias.json", "test-empty.json", "test-tiny.json"}) {
+		size_t size = 0;
+		protocache::Buffer buf;
+		ASSERT_TRUE(SerializeByProtobuf(json, buf, &size));
+		ASSERT_EQ(size, buf.Size()) << json;
+	}
+
+	size_t size = 0;
+	protocache::Buffer probe;
+	ASSERT_TRUE(SerializeByProtobuf("test.json", probe, &size));
+	std::vector<uint32_t> region(size);
+	protocache::Buffer exact(region.data(), region.size());
+	ASSERT_TRUE(SerializeByProtobuf("test.json", exact));
+	ASSERT_EQ(exact.View().data(), region.data());
+
+	const std::string path = "serialized-size.pc";
+	protocache::Buffer buf;
+	buf.SetDeterministic(true);
+	ASSERT_TRUE(SerializeByProtobuf("test.json", buf, nullptr, path));
+	auto file = protocache::MappedFile::Open(path);
+	ASSERT_FALSE(!file);
+	ASSERT_EQ(file.Size(), buf.Size()*4);
+	auto view = file.View();
+	auto& root = *protocache::Message(view).Cast<test::Main>();
+	ASSERT_EQ(root.str(view.end()), "Hello World!");
+	std::filesystem::remove(path);
+}
+
+TEST(PtotoCacheEX, SerializedSize) {
+	protocache::Buffer buffer;
+	ASSERT_TRUE(SerializeByProtobuf("test.json", buffer));
+	auto data = buffer.View();
+	auto end = data.data() + data.size();
+	::ex::test::Main ex(data);
+	ASSERT_EQ(ex.SerializedSize(end), data.size());
+
+	ex.strv(end)[0] = "a much longer string than before";
+	ex.matrix(end)[1].emplace_back(7);
+	ex.objectv(end).emplace_back(std::make_unique<::ex::test::Small>());
+	ex.objectv(end).back()->i32() = 1;
+	for (int i = 0; i < 5; i++) {
+		ex.flags(end).emplace_back(1);
+	}
+	ex.str(end).clear();
+	auto& index = ex.index(end);
+	for (int i = 0; i < 300; i++) {
+		index.emplace(std::to_string(i*i), i);
+	}
+	auto& objects = ex.objects(end);
+	for (int i = 0; i < 100; i++) {
+		objects.emplace(i, std::make_unique<::ex::test::Small>());
+	}
+
+	protocache::Buffer buf;
+	ASSERT_TRUE(ex.Serialize(&buf));
+	ASSERT_EQ(ex.SerializedSize(end), buf.Size());
+
+	for (size_t n : {0, 1, 24, 25, 255, 256, 65535, 65536}) {
+		protocache::MapEX<uint64_t,protocache::Slice<char>> map;
+		map.reserve(n);
+		for (size_t i = 0; i < n; i++) {
+			map.emplace(i*7, std::string(i%13, 'x'));
+		}
+		protocache::Unit unit;
+		ASSERT_TRUE(map.Measure(unit, nullptr));
+		protocache::Buffer out;
+		ASSERT_TRUE(map.Serialize(&out));
+		ASSERT_EQ(unit.len == 0 ? unit.seg.len : 0, out.Size()) << n;
+	}
+}
+
+TEST(PtotoCache, Parallel) {
+	const std::string json = "parallel.json";
+	{
+		std::ofstream ofs(json);
+		ofs << "{\"str\": \"parallel\", \"objectv\": [";
+		for (int i = 0; i < 1000; i++) {
+			ofs << (i == 0 ? "" : ",") << "{\"i32\": " << i << ", \"str\": \"" << std::string(i%20, 'x') << "\"}";
+		}
+		ofs << "], \"objects\": {";
+		for (int i = 0; i < 1000; i++) {
+			ofs << (i == 0 ? "" : ",") << "\"" << i << "\": {\"i32\": " << -i << "}";
+		}
+		ofs << "}}";
+	}
+	protocache::Buffer serial;
+	serial.SetDeterministic(true);
+	ASSERT_TRUE(SerializeByProtobuf(json, serial));
+	protocache::Buffer parallel;
+	parallel.SetDeterministic(true);
+	parallel.SetThreads(4);
+	ASSERT_TRUE(SerializeByProtobuf(json, parallel));
+	std::filesystem::remove(json);
+	ASSERT_EQ(serial.Size(), parallel.Size());
+	ASSERT_EQ(0, memcmp(serial.View().data(), parallel.View().data(), serial.Size()*4));
+
+	auto source = parallel.View();
+	std::vector<uint32_t> copied(source.begin(), source.end());
+	protocache::Slice<uint32_t> data(copied.data(), copied.size());
+	::ex::test::Main ex(data);
+	ASSERT_EQ(ex.objectv(data.end()).size(), 1000);
+	for (auto& one : ex.objectv(data.end())) {
+		one->str(data.end()) += "!";
+	}
+	for (auto& pair : ex.objects(data.end())) {
+		pair.second->str(data.end()) = std::to_string(pair.first);
+	}
+	protocache::Buffer out1, out2;
+	out1.SetDeterministic(true);
+	out2.SetDeterministic(true);
+	out2.SetThreads(4);
+	ASSERT_TRUE(ex.Serialize(&out1));
+	ASSERT_TRUE(ex.Serialize(&out2));
+	ASSERT_EQ(out1.Size(), out2.Size());
+	ASSERT_EQ(0, memcmp(out1.View().data(), out2.View().data(), out1.Size()*4));
+
+	protocache::BufferPool pool;
+	protocache::Buffer out3(&pool);
+	out3.SetDeterministic(true);
+	out3.SetThreads(4);
+	ASSERT_TRUE(ex.Serialize(&out3));
+	ASSERT_EQ(out1.Size(), out3.Size());
+	ASSERT_EQ(0, memcmp(out1.View().data(), out3.View().data(), out1.Size()*4));
+
+	std::vector<uint32_t> region(out1.Size());
+	protocache::Buffer out4(region.data(), region.size());
+	out4.SetDeterministic(true);
+	out4.SetThreads(4);
+	ASSERT_TRUE(ex.Serialize(&out4));
+	ASSERT_EQ(out1.Size(), out4.Size());
+	ASSERT_EQ(0, memcmp(out1.View().data(), out4.View().data(), out1.Size()*4));
+
+	data = out2.View();
+	auto& root = *protocache::Message(data).Cast<test::Main>();
+	ASSERT_EQ(root.objectv(data.end()).Size(), 1000);
+	ASSERT_EQ(root.objectv(data.end())[999]->str(data.end()), std::string(19, 'x') + "!");
+	auto it = root.objects(data.end()).Find(321, data.end());
+	ASSERT_NE(it, root.objects(data.end()).end());
+	ASSERT_EQ((*it).Value(data.end())->i32(data.end()), -321);
+	ASSERT_EQ((*it).Value(data.end())->str(data.end()), "321");
+}
+
+TEST(PtotoCache, Dedup) {
+	const std::string json = "dedup.json";
+	const std::string text(40, 'd');
+	{
+		std::ofstream ofs(json);
+		ofs << "{\"str\": \"" << text << "\", \"strv\": [";
+		for (int i = 0; i < 100; i++) {
+			ofs << (i == 0 ? "" : ",") << "\"" << text << i%3 << "\"";
+		}
+		ofs << "], \"objectv\": [";
+		for (int i = 0; i < 100; i++) {
+			ofs << (i == 0 ? "" : ",") << "{\"i32\": " << i%5 << ", \"str\": \"" << text << "\"}";
+		}
+		ofs << "], \"objects\": {";
+		for (int i = 0; i < 100; i++) {
+			ofs << (i == 0 ? "" : ",") << "\"" << i << "\": {\"i32\": " << i%5 << ", \"str\": \"" << text << "\"}";
+		}
+		ofs << "}}";
+	}
+	protocache::Buffer plain;
+	ASSERT_TRUE(SerializeByProtobuf(json, plain));
+	protocache::DedupTable table;
+	protocache::Buffer buf;
+	buf.SetDedup(&table);
+	ASSERT_TRUE(SerializeByProtobuf(json, buf));
+	std::filesystem::remove(json);
+	ASSERT_LT(buf.Size(), plain.Size());
+	ASSERT_GT(table.SavedBytes(), 0);
+
+	auto check = [&text](const protocache::Slice<uint32_t>& data) {
+		auto end = data.end();
+		ASSERT_TRUE(test::Main::Verify(data.data(), end));
+		auto& root = *protocache::Message(data).Cast<test::Main>();
+		ASSERT_EQ(root.str(end), text);
+		ASSERT_EQ(root.strv(end).Size(), 100);
+		for (unsigned i = 0; i < 100; i++) {
+			ASSERT_EQ(root.strv(end)[i], text + std::to_string(i%3));
+		}
+		ASSERT_EQ(root.objectv(end).Size(), 100);
+		for (unsigned i = 0; i < 100; i++) {
+			auto one = root.objectv(end)[i];
+			ASSERT_EQ(one->i32(end), i%5);
+			ASSERT_EQ(one->str(end), text);
+		}
+		ASSERT_EQ(root.objects(end).Size(), 100);
+		for (auto pair : root.objects(end)) {
+			ASSERT_EQ(pair.Value(end)->i32(end), pair.Key(end)%5);
+			ASSERT_EQ(pair.Value(end)->str(end), text);
+		}
+	};
+	check(buf.View());
+
+	auto source = plain.View();
+	std::vector<uint32_t> copied(source.begin(), source.end());
+	protocache::Slice<uint32_t> data(copied.data(), copied.size());
+	::ex::test::Main ex(data);
+	for (auto& one : ex.objectv(data.end())) {
+		one->i32(data.end()) += 0;	// touch all, so they are serialized field by field
+	}
+	table.Clear();
+	protocache::Buffer out;
+	out.SetDedup(&table);
+	ASSERT_TRUE(ex.Serialize(&out));
+	ASSERT_LT(out.Size(), plain.Size());
+	ASSERT_GT(table.SavedBytes(), 0);
+	check(out.View());
+}
+
+TEST(PtotoCache, DedupReuse) {
+	// matrix is written after arrays, a line of it may refer to the older one
+	const std::vector<std::vector<std::vector<int>>> cases = {
+		{{1,2,3,4,5,6}, {7,8,9,10,11,12}},
+		{{1,2,3,4,5,6}, {7,8,9,10,11,12}, {1,2,3,4,5,6}},
+	};
+	for (auto& lines : cases) {
+		const std::string json = "dedup-reuse.json";
+		{
+			std::ofstream ofs(json);
+			ofs << "{\"arrays\": {\"_\": {\"k\": {\"_\": [1,2,3,4,5,6]}}}, \"matrix\": {\"_\": [";
+			for (unsigned i = 0; i < lines.size(); i++) {
+				ofs << (i == 0 ? "" : ",") << "{\"_\": [";
+				for (unsigned j = 0; j < lines[i].size(); j++) {
+					ofs << (j == 0 ? "" : ",") << lines[i][j];
+				}
+				ofs << "]}";
+			}
+			ofs << "]}}";
+		}
+		protocache::DedupTable table;
+		protocache::Buffer buf;
+		buf.SetDedup(&table);
+		ASSERT_TRUE(SerializeByProtobuf(json, buf));
+		std::filesystem::remove(json);
+
+		auto check = [&lines](const protocache::Slice<uint32_t>& data, bool extra) {
+			auto end = data.end();
+			ASSERT_TRUE(test::Main::Verify(data.data(), end));
+			auto& root = *protocache::Message(data).Cast<test::Main>();
+			auto matrix = root.matrix(end);
+			ASSERT_EQ(matrix.Size(), lines.size());
+			for (unsigned i = 0; i < lines.size(); i++) {
+				auto line = matrix[i];
+				ASSERT_EQ(line.Size(), lines[i].size());
+				for (unsigned j = 0; j < lines[i].size(); j++) {
+					ASSERT_EQ(line[j], lines[i][j]);
+				}
+			}
+			auto arrays = root.arrays(end);
+			ASSERT_EQ(arrays.Size(), extra? 2 : 1);
+			auto it = arrays.Find(protocache::Slice<char>("k"), end);
+			ASSERT_NE(it, arrays.end());
+			ASSERT_EQ((*it).Value(end).Size(), 6);
+		};
+		auto view = buf.View();
+		check(view, false);
+		if (lines.size() > 2) {
+			ASSERT_GT(table.SavedBytes(), 0);
+		}
+
+		// untouched parts of deduplicated data are copied as they are
+		::ex::test::Main ex(view);
+		ex.i32(view.end()) = 2;
+		ex.arrays(view.end()).emplace("zz", ::ex::test::ArrMap::Array::ALIAS());
+		protocache::Buffer out;
+		ASSERT_TRUE(ex.Serialize(&out, view.end()));
+		check(out.View(), true);
+
+		protocache::FieldTree ids;
+		ids.Add({test::Main::_::matrix});
+		ids.Add({test::Main::_::arrays});
+		out.Clear();
+		ASSERT_TRUE(protocache::Project<test::Main>(view, ids, &out));
+		check(out.View(), false);
+	}
+}
+
+TEST(PtotoCache, Builder) {
+	const std::vector<std::string> strv = {"a", "bb", "a long string in array"};
+	const std::vector<int32_t> i32v = {1, -2, 3};
+	const std::vector<std::string> names = {"x", "y", "z"};
+	const std::vector<int32_t> ids = {7, 8};
+	const std::vector<float> vec = {1.5f, 2.5f};
+
+	protocache::Buffer buf;
+	test::Main::Builder root(buf);
+	root.i32(-999);
+	root.u64(12345678987654321ULL);
+	root.flag(true);
+	root.mode(test::MODE_C);
+	root.str("Hello World!");
+	root.f64(3.14);
+	root.object([](test::Small::Builder& one) {
+		one.i32(88);
+		one.str(std::string("small"));
+	});
+	root.i32v(protocache::Slice<int32_t>(i32v));
+	root.strv(strv);
+	root.objectv(2, [](size_t i, test::Small::Builder& one) {
+		one.i32(static_cast<int32_t>(i)+1);
+		one.flag(i == 1);
+	});
+	root.index(names, [](size_t i) { return static_cast<int32_t>(i*10); });
+	root.objects(ids, [&ids](size_t i, test::Small::Builder& one) {
+		one.i32(-ids[i]);
+	});
+	root.matrix([&vec](test::Vec2D::Builder& matrix) {
+		matrix.Set(3, [&vec](size_t i, test::Vec2D::Vec1D::Builder& line) {
+			line.Set(protocache::Slice<float>(vec.data(), i));
+		});
+	});
+	root.arrays([&names, &vec](test::ArrMap::Builder& arrays) {
+		arrays.Set(names, [&vec](size_t, test::ArrMap::Array::Builder& one) {
+			one.Set(protocache::Slice<float>(vec));
+		});
+	});
+	ASSERT_TRUE(root.Finish());
+
+	auto data = buf.View();
+	auto end = data.end();
+	ASSERT_TRUE(test::Main::Verify(data.data(), end));
+	auto& main = *protocache::Message(data).Cast<test::Main>();
+	ASSERT_EQ(main.i32(end), -999);
+	ASSERT_EQ(main.u64(end), 12345678987654321ULL);
+	ASSERT_TRUE(main.flag(end));
+	ASSERT_EQ(main.mode(end), test::MODE_C);
+	ASSERT_EQ(main.str(end), "Hello World!");
+	ASSERT_EQ(main.f64(end), 3.14);
+	ASSERT_EQ(main.object(end)->i32(end), 88);
+	ASSERT_EQ(main.object(end)->str(end), "small");
+
+	auto i32s = main.i32v(end);
+	ASSERT_EQ(i32s.Size(), i32v.size());
+	for (unsigned i = 0; i < i32v.size(); i++) {
+		ASSERT_EQ(i32s[i], i32v[i]);
+	}
+	auto strs = main.strv(end);
+	ASSERT_EQ(strs.Size(), strv.size());
+	for (unsigned i = 0; i < strv.size(); i++) {
+		ASSERT_EQ(strs[i], strv[i]);
+	}
+	auto objs = main.objectv(end);
+	ASSERT_EQ(objs.Size(), 2);
+	ASSERT_EQ(objs[0]->i32(end), 1);
+	ASSERT_FALSE(objs[0]->flag(end));
+	ASSERT_EQ(objs[1]->i32(end), 2);
+	ASSERT_TRUE(objs[1]->flag(end));
+
+	auto index = main.index(end);
+	ASSERT_EQ(index.Size(), names.size());
+	for (unsigned i = 0; i < names.size(); i++) {
+		auto it = index.Find(protocache::Slice<char>(names[i]), end);
+		ASSERT_NE(it, index.end());
+		ASSERT_EQ((*it).Value(end), static_cast<int32_t>(i*10));
+	}
+	auto objects = main.objects(end);
+	ASSERT_EQ(objects.Size(), ids.size());
+	for (auto id : ids) {
+		auto it = objects.Find(id, end);
+		ASSERT_NE(it, objects.end());
+		ASSERT_EQ((*it).Value(end)->i32(end), -id);
+	}
+
+	auto matrix = main.matrix(end);
+	ASSERT_EQ(matrix.Size(), 3);
+	for (unsigned i = 0; i < 3; i++) {
+		ASSERT_EQ(matrix[i].Size(), i);
+	}
+	ASSERT_EQ(matrix[2][1], 2.5f);
+	auto arrays = main.arrays(end);
+	ASSERT_EQ(arrays.Size(), names.size());
+	auto it = arrays.Find(protocache::Slice<char>("y"), end);
+	ASSERT_NE(it, arrays.end());
+	ASSERT_EQ((*it).Value(end).Size(), vec.size());
+
+	// unset and empty fields are skipped
+	ASSERT_FALSE(main.HasField(test::Main::_::f32v, end));
+	ASSERT_FALSE(main.HasField(test::Main::_::vector, end));
+}
+
+TEST(PtotoCache, BuilderWithImports) {
+	const std::vector<std::string> tags = {"red", "green"};
+	protocache::Buffer buf;
+	test::wkt::Event::Builder root(buf);
+	root.name("launch");
+	root.time([](google::protobuf::Timestamp::Builder& time) {
+		time.seconds(1700000000);
+		time.nanos(500);
+	});
+	root.count([](google::protobuf::Int32Value::Builder& count) {
+		count.value(-3);
+	});
+	root.tags(tags.size(), [&tags](size_t i, google::protobuf::StringValue::Builder& tag) {
+		tag.value(tags[i]);
+	});
+	ASSERT_TRUE(root.Finish());
+
+	auto data = buf.View();
+	auto end = data.end();
+	ASSERT_TRUE(test::wkt::Event::Verify(data.data(), end));
+	auto& event = *protocache::Message(data).Cast<test::wkt::Event>();
+	ASSERT_EQ(event.name(end), "launch");
+	ASSERT_EQ(event.time(end)->seconds(end), 1700000000);
+	ASSERT_EQ(event.time(end)->nanos(end), 500);
+	ASSERT_EQ(event.count(end)->value(end), -3);
+	ASSERT_EQ(event.tags(end).Size(), tags.size());
+	ASSERT_EQ(event.tags(end)[1]->value(end), "green");
+
+	protocache::FieldTree tree;
+	tree.Add({test::wkt::Event::_::time, google::protobuf::Timestamp::_::nanos});
+	tree.Add({test::wkt::Event::_::count});
+	protocache::Buffer out;
+	ASSERT_TRUE(protocache::Project<test::wkt::Event>(data, tree, &out));
+	data = out.View();
+	end = data.end();
+	ASSERT_TRUE(test::wkt::Event::Verify(data.data(), end));
+	auto& part = *protocache::Message(data).Cast<test::wkt::Event>();
+	ASSERT_FALSE(part.HasField(test::wkt::Event::_::name, end));
+	ASSERT_FALSE(part.HasField(test::wkt::Event::_::tags, end));
+	ASSERT_EQ(part.time(end)->seconds(end), 0);
+	ASSERT_EQ(part.time(end)->nanos(end), 500);
+	ASSERT_EQ(part.count(end)->value(end), -3);
+}
+
+TEST(PtotoCache, Verify) {
+	protocache::Buffer buffer;
+	ASSERT_TRUE(SerializeByProtobuf("test.json", buffer));
+	auto data = buffer.View();
+	auto end = data.data() + data.size();
+	ASSERT_TRUE(test::Main::Verify(data.data(), end));
+
+	protocache::Verified<test::Main> root(data);
+	ASSERT_FALSE(!root);
+	ASSERT_EQ(-999, root->i32());
+	ASSERT_EQ(88, root->object()->i32());
+	ASSERT_EQ(root->strv().Size(), 10);
+	ASSERT_EQ(root->index().Size(), 6);
+
+	for (size_t i = 1; i < data.size(); i++) {
+		ASSERT_FALSE(test::Main::Verify(data.data(), data.data() + i));
+	}
+	ASSERT_FALSE(test::Main::Verify(data.data(), data.data()));
+	ASSERT_FALSE(test::Main::Verify(nullptr, end));
+
+	std::vector<uint32_t> copy(data.begin(), data.end());
+	for (size_t i = 0; i < copy.size() * 3; i++) {
+		auto word = copy[i/3];
+		const uint32_t patterns[] = {0xffffffffU, word + 4, word ^ 0x100};
+		copy[i/3] = patterns[i%3];
+		protocache::Verified<test::Main> bad(copy.data(), copy.data() + copy.size());
+		if (!!bad) {	// still well-formed, should be safe to walk
+			size_t total = bad->str().size();
+			for (auto one : bad->strv()) {
+				total += one.size();
+			}
+			for (auto pair : bad->objects()) {
+				total += pair.Value()->str().size();
+			}
+			ASSERT_LE(total, data.size() * 4);
+		}
+		copy[i/3] = word;
+	}
+	ASSERT_TRUE(test::Main::Verify(copy.data(), copy.data() + copy.size()));
+
+	copy[0] = 0xffffffffU;	// section count beyond data
+	ASSERT_FALSE(!!protocache::Verified<test::Main>(copy.data(), copy.data() + copy.size()));
+}
+
+template <unsigned N>
+struct Nested {
+	using Type = protocache::ArrayT<typename Nested<N-1>::Type>;
+};
+
+template <>
+struct Nested<0> {
+	using Type = protocache::ArrayT<int32_t>;
+};
+
+TEST(PtotoCache, VerifyAliased) {
+	// every level holds two references to the next one, 2^40 paths in all
+	constexpr unsigned kLevels = 40;
+	std::vector<uint32_t> data;
+	for (unsigned i = 0; i < kLevels; i++) {
+		data.push_back((2U << 2U) | 1U);
+		data.push_back((2U << 2U) | 3U);
+		data.push_back((1U << 2U) | 3U);
+	}
+	data.push_back((1U << 2U) | 1U);
+	data.push_back(123);
+	using Root = Nested<kLevels>::Type;
+	ASSERT_TRUE(Root::Verify(data.data(), data.data() + data.size()));
+	ASSERT_EQ(123, Root(data.data())[1][0][1][1][0][0][1][0][0][0][0][1]
+		[0][0][0][0][0][0][0][0][0][0][0][0][0][0][0][0][0][0]
+		[0][0][0][0][0][0][0][0][0][0][0]);
+
+	data[data.size()-2] = (2U << 2U) | 1U;	// shared leaf beyond data
+	ASSERT_FALSE(Root::Verify(data.data(), data.data() + data.size()));
+}
+
 TEST(PtotoCacheEX, Serialize) {
 	protocache::Buffer buffer;
 	ASSERT_TRUE(SerializeByProtobuf("test.json", buffer));
@@ -580,6 +1291,160 @@ TEST(PtotoCacheEX, Serialize) {
 	ASSERT_EQ(vec5[1], 92.0f);
 }
 
+TEST(PtotoCacheEX, ReadOnly) {
+	protocache::Buffer buffer;
+	ASSERT_TRUE(SerializeByProtobuf("test.json", buffer));
+	auto data = buffer.View();
+	auto end = data.data() + data.size();
+	::ex::test::Main ex(data);
+	const auto& view = ex;
+
+	ASSERT_EQ(-999, view.i32(end));
+	ASSERT_EQ(view.str(end), "Hello World!");
+	ASSERT_EQ(std::string(reinterpret_cast<const char*>(view.data(end).data()), view.data(end).size()),
+		"abc123!?$*&()'-=@~");
+	ASSERT_EQ(88, view.object(end)->i32(end));
+	ASSERT_EQ(view.object(end)->str(end), "tmp");
+	ASSERT_EQ(view.strv(end).size(), 10);
+	ASSERT_EQ(view.objects(end).size(), 4);
+	ASSERT_EQ(view.matrix(end).size(), 3);
+
+	protocache::Buffer buf;
+	ASSERT_TRUE(ex.Serialize(&buf, end));
+	ASSERT_EQ(buf.Size(), data.size());
+	ASSERT_EQ(memcmp(buf.View().data(), data.data(), data.size()*4), 0);
+
+	ex.i32(end) = 7;
+	ex.object(end)->str(end) = "xyz";
+	ASSERT_EQ(7, view.i32(end));
+	ASSERT_EQ(view.object(end)->str(end), "xyz");
+
+	buf.Clear();
+	ASSERT_TRUE(ex.Serialize(&buf, end));
+	auto modified = buf.View();
+	auto mend = modified.data() + modified.size();
+	auto& root = *protocache::Message(modified).Cast<test::Main>();
+	ASSERT_EQ(7, root.i32(mend));
+	ASSERT_EQ(root.object(mend)->str(mend), "xyz");
+	ASSERT_EQ(88, root.object(mend)->i32(mend));
+	ASSERT_EQ(root.strv(mend).Size(), 10);
+	ASSERT_EQ(root.objects(mend).Size(), 4);
+
+	// messages reached by const getters can still be changed
+	::ex::test::Main other(data);
+	const auto& other_view = other;
+	other_view.objectv(end)[0]->i32(end) = 1234;
+	other_view.objects(end).find(2)->second->str(end) = "changed";
+	buf.Clear();
+	ASSERT_TRUE(other.Serialize(&buf, end));
+	modified = buf.View();
+	mend = modified.data() + modified.size();
+	ASSERT_EQ(other.SerializedSize(end), modified.size());
+	auto& root2 = *protocache::Message(modified).Cast<test::Main>();
+	ASSERT_EQ(1234, root2.objectv(mend)[0]->i32(mend));
+	ASSERT_EQ((*root2.objects(mend).Find(2, mend)).Value(mend)->str(mend), "changed");
+	ASSERT_EQ(root2.str(mend), "Hello World!");
+}
+
+static protocache::Slice<uint8_t> MapIndex(const protocache::Slice<uint32_t>& data, unsigned id) {
+	auto end = data.data() + data.size();
+	auto field = protocache::Message(data.data(), end).GetField(id, end);
+	return protocache::Map(field.GetObject(end), end).Index();
+}
+
+static bool SameIndex(const protocache::Slice<uint8_t>& a, const protocache::Slice<uint8_t>& b) {
+	// cell widths in the top bits may differ
+	return a.size() == b.size() && a.size() >= 4
+		&& ((a[3] ^ b[3]) & 0x0f) == 0 && memcmp(a.data(), b.data(), 3) == 0
+		&& memcmp(a.data()+4, b.data()+4, a.size()-4) == 0;
+}
+
+TEST(PtotoCacheEX, Patch) {
+	protocache::Buffer buffer;
+	ASSERT_TRUE(SerializeByProtobuf("test.json", buffer));
+	auto data = buffer.View();
+	auto end = data.data() + data.size();
+	::ex::test::Main ex(data);
+
+	ex.index(end).find("x-2")->second = 22;
+	ex.objects(end).find(3)->second->i32(end) = 33;
+	ex.matrix(end)[1][1] = 55;
+
+	protocache::Buffer buf;
+	ASSERT_TRUE(ex.Serialize(&buf, end));
+	auto modified = buf.View();
+	auto mend = modified.data() + modified.size();
+	auto& root = *protocache::Message(modified).Cast<test::Main>();
+
+	// key sets are unchanged, so the original indexes are kept
+	ASSERT_TRUE(SameIndex(MapIndex(data, ::test::Main::_::index), MapIndex(modified, ::test::Main::_::index)));
+	ASSERT_TRUE(SameIndex(MapIndex(data, ::test::Main::_::objects), MapIndex(modified, ::test::Main::_::objects)));
+
+	auto index = root.index(mend);
+	ASSERT_EQ(index.Size(), 6);
+	ASSERT_EQ(22, (*index.Find(protocache::Slice<char>("x-2"), mend)).Value(mend));
+	ASSERT_EQ(3, (*index.Find(protocache::Slice<char>("x-3"), mend)).Value(mend));
+	ASSERT_EQ(1, (*index.Find(protocache::Slice<char>("abc-1"), mend)).Value(mend));
+
+	auto objects = root.objects(mend);
+	ASSERT_EQ(objects.Size(), 4);
+	for (auto pair : objects) {
+		auto key = pair.Key(mend);
+		auto val = pair.Value(mend);
+		ASSERT_EQ(val->i32(mend), key == 3? 33 : key);
+	}
+	ASSERT_EQ((*objects.Find(3, mend)).Value(mend)->str(mend), "ccccccccccccccc");
+
+	auto matrix = root.matrix(mend);
+	ASSERT_EQ(matrix.Size(), 3);
+	for (unsigned i = 0; i < 3; i++) {
+		for (unsigned j = 0; j < 3; j++) {
+			ASSERT_EQ(matrix[i][j], (i == 1 && j == 1)? 55 : i*3+j+1);
+		}
+	}
+
+	// a new key needs a new index
+	ex.index(end).emplace("y", 7);
+	buf.Clear();
+	ASSERT_TRUE(ex.Serialize(&buf, end));
+	modified = buf.View();
+	mend = modified.data() + modified.size();
+	auto& root2 = *protocache::Message(modified).Cast<test::Main>();
+	index = root2.index(mend);
+	ASSERT_EQ(index.Size(), 7);
+	ASSERT_EQ(7, (*index.Find(protocache::Slice<char>("y"), mend)).Value(mend));
+	ASSERT_EQ(22, (*index.Find(protocache::Slice<char>("x-2"), mend)).Value(mend));
+	ASSERT_EQ(ex.SerializedSize(end), modified.size());
+}
+
+TEST(PtotoCacheEX, PatchThroughConst) {
+	protocache::Buffer buffer;
+	ASSERT_TRUE(SerializeByProtobuf("test.json", buffer));
+	auto data = buffer.View();
+	auto end = data.data() + data.size();
+	::ex::test::Main ex(data);
+
+	// messages held by containers stay mutable through const references
+	const auto& objectv = ex.objectv(end);
+	objectv[0]->i32(end) = 4321;
+	const auto& objects = ex.objects(end);
+	objects.find(3)->second->i32(end) = 33;
+
+	protocache::Buffer buf;
+	ASSERT_TRUE(ex.Serialize(&buf, end));
+	auto modified = buf.View();
+	auto mend = modified.data() + modified.size();
+	ASSERT_EQ(ex.SerializedSize(end), modified.size());
+	auto& root = *protocache::Message(modified).Cast<test::Main>();
+	ASSERT_EQ(4321, root.objectv(mend)[0]->i32(mend));
+	ASSERT_EQ(root.objectv(mend).Size(), objectv.size());
+	ASSERT_TRUE(SameIndex(MapIndex(data, ::test::Main::_::objects), MapIndex(modified, ::test::Main::_::objects)));
+	for (auto pair : root.objects(mend)) {
+		auto key = pair.Key(mend);
+		ASSERT_EQ(pair.Value(mend)->i32(mend), key == 3? 33 : key);
+	}
+}
+
 TEST(PtotoCacheEX, Alias) {
 	::ex::test::Main root;
 	root.object()->i32() = 0;
@@ -652,6 +1517,345 @@ TEST(Compress, All) {
 	ASSERT_EQ(protocache::SliceCast<char>(view), protocache::Slice<char>(raw));
 }
 
+TEST(Compress, Kernels) {
+	const protocache::CodecKernel kernels[] = {
+		protocache::CODEC_SCALAR, protocache::CODEC_SSE4, protocache::CODEC_AVX2};
+	auto check = [&kernels](const std::string& raw) {
+		std::string expected;
+		protocache::Compress(reinterpret_cast<const uint8_t*>(raw.data()), raw.size(),
+							 &expected, protocache::CODEC_SCALAR);
+		for (auto kernel : kernels) {
+			std::string cooked;
+			protocache::Compress(reinterpret_cast<const uint8_t*>(raw.data()), raw.size(), &cooked, kernel);
+			ASSERT_EQ(expected, cooked) << "kernel " << unsigned(kernel) << ", size " << raw.size();
+			std::string out;
+			ASSERT_TRUE(protocache::Decompress(cooked, &out));
+			ASSERT_EQ(raw, out);
+		}
+	};
+
+	uint32_t seed = 12345;
+	auto rand = [&seed]() {
+		seed = seed * 1103515245U + 12345U;
+		return seed >> 16U;
+	};
+	for (unsigned len = 0; len < 300; len++) {
+		std::string raw(len, '\0');
+		for (auto& ch : raw) {
+			auto r = rand() % 8;
+			ch = r < 3 ? 0 : r < 5 ? '\xff' : static_cast<char>(rand());
+		}
+		check(raw);
+		// runs of each class longer than a token
+		for (size_t i = 0; i < raw.size();) {
+			auto r = rand() % 3;
+			auto n = std::min<size_t>(rand() % 20 + 1, raw.size() - i);
+			for (size_t j = 0; j < n; j++) {
+				raw[i++] = r == 0 ? 0 : r == 1 ? '\xff' : static_cast<char>(rand() % 254 + 1);
+			}
+		}
+		check(raw);
+		check(std::string(len, '\0'));
+		check(std::string(len, '\xff'));
+		check(std::string(len, 'x'));
+	}
+
+	protocache::Buffer buffer;
+	ASSERT_TRUE(SerializeByProtobuf("test.json", buffer));
+	auto data = buffer.View();
+	check(std::string(reinterpret_cast<const char*>(data.data()), data.size()*4));
+}
+
+TEST(Compress, Region) {
+	protocache::Buffer buffer;
+	ASSERT_TRUE(SerializeByProtobuf("test.json", buffer));
+	auto data = buffer.View();
+	std::string cooked;
+	protocache::Compress(reinterpret_cast<const uint8_t*>(data.data()), data.size()*4, &cooked);
+	auto src = reinterpret_cast<const uint8_t*>(cooked.data());
+
+	size_t size = 0;
+	ASSERT_TRUE(protocache::DecompressedSize(src, cooked.size(), &size));
+	ASSERT_EQ(data.size()*4, size);
+	ASSERT_FALSE(protocache::DecompressedSize(src, 1, &size));
+
+	std::vector<uint32_t> region(data.size());
+	ASSERT_FALSE(protocache::Decompress(src, cooked.size(), region.data(), region.size()-1));
+	ASSERT_TRUE(protocache::Decompress(src, cooked.size(), region.data(), region.size()));
+	ASSERT_EQ(0, memcmp(region.data(), data.data(), size));
+	auto end = region.data() + region.size();
+	auto& root = *protocache::Message(protocache::Slice<uint32_t>(region)).Cast<test::Main>();
+	ASSERT_EQ(-999, root.i32(end));
+
+	protocache::Buffer out;
+	ASSERT_TRUE(protocache::Decompress(cooked, &out));
+	ASSERT_EQ(data.size(), out.Size());
+	ASSERT_EQ(0, memcmp(out.Head(), data.data(), size));
+	auto head = out.Head();
+	ASSERT_TRUE(protocache::Decompress(cooked, &out));
+	ASSERT_EQ(head, out.Head());	// memory reused
+	ASSERT_FALSE(protocache::Decompress(src, cooked.size()-1, &out));
+	ASSERT_EQ(0, out.Size());
+
+	// a mark byte gives 8 bytes at most, a header claiming more is refused before allocating
+	std::string raw;
+	ASSERT_TRUE(protocache::Decompress(std::string("\x08\xff", 2), &raw));
+	ASSERT_EQ(raw, std::string(8, '\xff'));
+	ASSERT_FALSE(protocache::Decompress(std::string("\x09\xff", 2), &raw));
+	const std::string forged("\xf0\xff\xff\xff\x0f\xff\xff\xff\xff", 9);
+	ASSERT_FALSE(protocache::DecompressedSize(reinterpret_cast<const uint8_t*>(forged.data()), forged.size(), &size));
+	ASSERT_FALSE(protocache::Decompress(forged, &raw));
+	ASSERT_FALSE(protocache::Decompress(forged, &out));
+
+	protocache::Compress(std::string(), &cooked);
+	protocache::Buffer empty;
+	ASSERT_TRUE(protocache::Decompress(cooked, &empty));
+	ASSERT_EQ(0, empty.Size());
+
+	// tail of last word is zeroed
+	const std::string odd("\x01\x00\x00\x00\xff\xff", 6);
+	protocache::Compress(odd, &cooked);
+	uint32_t words[2] = {0xdeadbeef, 0xdeadbeef};
+	ASSERT_TRUE(protocache::Decompress(reinterpret_cast<const uint8_t*>(cooked.data()), cooked.size(), words, 2));
+	ASSERT_EQ(0, memcmp(words, "\x01\x00\x00\x00\xff\xff\x00\x00", 8));
+}
+
+TEST(Compress, Words) {
+	protocache::Buffer buffer;
+	ASSERT_TRUE(SerializeByProtobuf("test.json", buffer));
+	auto data = buffer.View();
+	auto src = reinterpret_cast<const uint8_t*>(data.data());
+	std::string bytes, words;
+	protocache::Compress(src, data.size()*4, &bytes, protocache::CODEC_BYTES);
+	protocache::Compress(src, data.size()*4, &words, protocache::CODEC_WORDS);
+	ASSERT_EQ(0, words[0]);
+	ASSERT_LT(words.size(), bytes.size());
+
+	size_t size = 0;
+	ASSERT_TRUE(protocache::DecompressedSize(reinterpret_cast<const uint8_t*>(words.data()), words.size(), &size));
+	ASSERT_EQ(data.size()*4, size);
+	protocache::Buffer out;
+	ASSERT_TRUE(protocache::Decompress(words, &out));
+	ASSERT_EQ(data.size(), out.Size());
+	ASSERT_EQ(0, memcmp(out.Head(), data.data(), size));
+	std::string raw;
+	ASSERT_FALSE(protocache::Decompress(words.substr(0, words.size()-1), &raw));
+	ASSERT_FALSE(protocache::Decompress(words + '\0', &raw));
+
+	// the size in words is checked after scaling to bytes
+	auto cut = words.substr(0, 8);
+	ASSERT_FALSE(protocache::DecompressedSize(reinterpret_cast<const uint8_t*>(cut.data()), cut.size(), &size));
+	ASSERT_FALSE(protocache::Decompress(cut, &out));
+	ASSERT_TRUE(protocache::Decompress(std::string("\x00\x02\x00", 3), &raw));
+	ASSERT_EQ(raw, std::string(8, '\0'));
+	ASSERT_FALSE(protocache::Decompress(std::string("\x00\x03\x00", 3), &raw));
+	const std::string forged("\x00\xff\xff\xff\xff\x0f\x00\x00\x00", 9);
+	ASSERT_FALSE(protocache::Decompress(forged, &raw));
+	ASSERT_FALSE(protocache::Decompress(forged, &out));
+
+	// not whole words
+	protocache::Compress(src, data.size()*4-1, &words, protocache::CODEC_WORDS);
+	protocache::Compress(src, data.size()*4-1, &bytes, protocache::CODEC_BYTES);
+	ASSERT_EQ(bytes, words);
+
+	uint32_t seed = 54321;
+	auto rand = [&seed]() {
+		seed = seed * 1103515245U + 12345U;
+		return seed >> 16U;
+	};
+	for (unsigned n = 0; n < 300; n++) {
+		std::vector<uint32_t> values(n);
+		for (size_t i = 0; i < n;) {
+			auto r = rand() % 6;
+			auto k = std::min<size_t>(r == 5 ? rand() % 300 + 1 : 1, n - i);
+			for (size_t j = 0; j < k; j++) {
+				uint32_t v = rand() << 16U | rand();
+				switch (r) {
+					case 0: v = 0; break;
+					case 1: v &= 0xff; break;
+					case 2: v <<= (rand() % 4) * 8; break;
+					case 3: v |= 0xffff0000U; break;
+					case 4: v &= 0xff00ff00U; break;
+					default: v |= 0x01010101U; break;
+				}
+				values[i++] = v;
+			}
+		}
+		protocache::Compress(reinterpret_cast<const uint8_t*>(values.data()), n*4, &words, protocache::CODEC_WORDS);
+		ASSERT_TRUE(protocache::Decompress(words, &raw));
+		ASSERT_EQ(n*4, raw.size());
+		ASSERT_EQ(0, memcmp(raw.data(), values.data(), raw.size())) << "words " << n;
+	}
+}
+
+TEST(Compress, Dictionary) {
+	protocache::Buffer buffer;
+	ASSERT_TRUE(SerializeByProtobuf("test.json", buffer));
+	auto data = buffer.View();
+	auto end = data.data() + data.size();
+
+	std::vector<std::string> samples;
+	for (int i = 0; i < 200; i++) {
+		::ex::test::Main ex(data);
+		ex.i32(end) = i * 7;
+		ex.str(end) = "Hello " + std::to_string(i);
+		ex.strv(end)[0] = std::to_string(i * i);
+		protocache::Buffer buf;
+		ASSERT_TRUE(ex.Serialize(&buf));
+		samples.emplace_back(reinterpret_cast<const char*>(buf.Head()), buf.Size()*4);
+	}
+	auto record = std::move(samples.back());
+	samples.pop_back();
+	auto src = reinterpret_cast<const uint8_t*>(record.data());
+
+	auto dict = protocache::Dictionary::Train(samples, 4096);
+	std::string cooked, raw;
+#if defined(PROTOCACHE_WITH_ZSTD)
+	ASSERT_FALSE(!dict);
+	ASSERT_TRUE(protocache::Compress(src, record.size(), &cooked, dict));
+	std::string packed;
+	protocache::Compress(src, record.size(), &packed);
+	ASSERT_LT(cooked.size()*2, packed.size());
+
+	ASSERT_TRUE(protocache::Decompress(reinterpret_cast<const uint8_t*>(cooked.data()), cooked.size(), &raw, dict));
+	ASSERT_EQ(record, raw);
+	auto loaded = protocache::Dictionary::Load(dict.Data());
+	ASSERT_FALSE(!loaded);
+	protocache::Buffer out;
+	ASSERT_TRUE(protocache::Decompress(reinterpret_cast<const uint8_t*>(cooked.data()), cooked.size(), &out, loaded));
+	ASSERT_EQ(record.size(), out.Size()*4);
+	ASSERT_EQ(0, memcmp(out.Head(), record.data(), record.size()));
+	ASSERT_FALSE(protocache::Decompress(reinterpret_cast<const uint8_t*>(cooked.data()), cooked.size()-1, &out, loaded));
+	ASSERT_EQ(0, out.Size());
+	// declared size over the limit
+	ASSERT_FALSE(protocache::Decompress(reinterpret_cast<const uint8_t*>(cooked.data()), cooked.size(), &out, loaded, record.size()-1));
+	ASSERT_EQ(0, out.Size());
+	ASSERT_FALSE(protocache::Decompress(reinterpret_cast<const uint8_t*>(cooked.data()), cooked.size(), &raw, loaded, record.size()-1));
+	ASSERT_TRUE(raw.empty());
+#else
+	ASSERT_TRUE(!dict);
+	ASSERT_FALSE(protocache::Compress(src, record.size(), &cooked, dict));
+	ASSERT_FALSE(protocache::Decompress(src, record.size(), &raw, dict));
+#endif
+}
+
+TEST(Compress, Blocks) {
+	protocache::Buffer buffer;
+	ASSERT_TRUE(SerializeByProtobuf("test.json", buffer));
+	auto data = buffer.View();
+	// message at the head, followed by far data
+	std::vector<uint32_t> raw(300000/4);
+	ASSERT_LT(data.size(), raw.size());
+	memcpy(raw.data(), data.data(), data.size()*4);
+	for (size_t i = data.size(); i < raw.size(); i++) {
+		raw[i] = i % 3 == 0 ? i : 0;
+	}
+	raw.back() = 0x12345678;
+	auto src = reinterpret_cast<const uint8_t*>(raw.data());
+
+	std::string cooked;
+	ASSERT_FALSE(protocache::CompressBlocks(src, raw.size()*4, &cooked, 4098));
+	ASSERT_TRUE(protocache::CompressBlocks(src, raw.size()*4, &cooked));
+
+	auto reader = protocache::BlockReader::Open(protocache::Slice<uint8_t>(
+		reinterpret_cast<const uint8_t*>(cooked.data()), cooked.size()), true);
+	ASSERT_FALSE(!reader);
+	ASSERT_EQ(raw.size()*4, reader.Size());
+	ASSERT_EQ(raw.size(), reader.View().size());
+	auto end = reader.View().end();
+	auto& root = *protocache::Message(reader.View()).Cast<test::Main>();
+	ASSERT_EQ(-999, root.i32(end));
+	ASSERT_EQ("Hello World!", root.str(end));
+	ASSERT_EQ(1, reader.LoadedBlocks());	// blocks are faulted in
+	ASSERT_EQ(0x12345678, reader.View()[raw.size()-1]);
+	ASSERT_EQ(2, reader.LoadedBlocks());
+	ASSERT_TRUE(reader.Fetch(0, reader.Size()));
+	ASSERT_EQ(5, reader.LoadedBlocks());
+	ASSERT_EQ(0, memcmp(reader.View().data(), raw.data(), reader.Size()));
+	ASSERT_FALSE(reader.Fetch(1, reader.Size()));
+	ASSERT_FALSE(reader.Corrupted());
+
+	// eager by default
+	reader = protocache::BlockReader::Open(protocache::Slice<uint8_t>(
+		reinterpret_cast<const uint8_t*>(cooked.data()), cooked.size()));
+	ASSERT_FALSE(!reader);
+	ASSERT_EQ(5, reader.LoadedBlocks());
+	ASSERT_TRUE(reader.Fetch(0, reader.Size()));
+	ASSERT_EQ(0, memcmp(reader.View().data(), raw.data(), reader.Size()));
+
+	// small blocks are loaded at once
+	ASSERT_TRUE(protocache::CompressBlocks(src, raw.size()*4, &cooked, 1000));
+	reader = protocache::BlockReader::Open(protocache::Slice<uint8_t>(
+		reinterpret_cast<const uint8_t*>(cooked.data()), cooked.size()), true);
+	ASSERT_FALSE(!reader);
+	ASSERT_EQ(300, reader.LoadedBlocks());
+	ASSERT_EQ(0, memcmp(reader.View().data(), raw.data(), reader.Size()));
+
+	// broken block reads as zeros
+	uint64_t last = 0;
+	memcpy(&last, cooked.data() + 16 + 299*8, 8);
+	cooked[16 + 301*8 + last] ^= 0x40;	// size of last block
+	reader = protocache::BlockReader::Open(protocache::Slice<uint8_t>(
+		reinterpret_cast<const uint8_t*>(cooked.data()), cooked.size()));
+	ASSERT_FALSE(!reader);
+	ASSERT_TRUE(reader.Corrupted());
+	ASSERT_FALSE(reader.Fetch(reader.Size()-4, 4));
+	ASSERT_EQ(0, reader.View()[raw.size()-1]);
+
+	cooked[4] ^= 1;	// block count
+	ASSERT_TRUE(!protocache::BlockReader::Open(protocache::Slice<uint8_t>(
+		reinterpret_cast<const uint8_t*>(cooked.data()), cooked.size())));
+	ASSERT_TRUE(!protocache::BlockReader::Open(protocache::Slice<uint8_t>(
+		reinterpret_cast<const uint8_t*>(cooked.data()), 10)));
+
+	// header claiming far more data than the block holds
+	uint32_t fake[10] = {0xfffffffc, 1, 0xfffffffc, 0, 0, 0, 8, 0, 0, 0};
+	ASSERT_TRUE(!protocache::BlockReader::Open(protocache::Slice<uint8_t>(
+		reinterpret_cast<const uint8_t*>(fake), sizeof(fake))));
+	fake[0] = fake[2] = 64;
+	ASSERT_FALSE(!protocache::BlockReader::Open(protocache::Slice<uint8_t>(
+		reinterpret_cast<const uint8_t*>(fake), sizeof(fake))));
+}
+
+TEST(MappedFile, Basic) {
+	protocache::Buffer buffer;
+	ASSERT_TRUE(SerializeByProtobuf("test.json", buffer));
+	auto data = buffer.View();
+
+	const auto path = std::filesystem::temp_directory_path() / "protocache-mapped-file-test.pc";
+	{
+		std::ofstream out(path, std::ios_base::out | std::ios_base::binary);
+		ASSERT_TRUE(out.good());
+		out.write(reinterpret_cast<const char*>(data.data()), data.size()*sizeof(uint32_t));
+	}
+	protocache::MappedFile::Options options;
+	options.advice = protocache::MappedFile::ADVICE_RANDOM;
+	auto file = protocache::MappedFile::Open(path.string(), options);
+	ASSERT_FALSE(!file);
+	ASSERT_EQ(file.Size(), data.size()*sizeof(uint32_t));
+	auto view = file.View();
+	ASSERT_EQ(view.size(), data.size());
+	ASSERT_EQ(0, memcmp(view.data(), data.data(), file.Size()));
+
+	auto end = view.end();
+	auto& root = *protocache::Message(view).Cast<test::Main>();
+	ASSERT_FALSE(!root);
+	ASSERT_EQ(-999, root.i32(end));
+	ASSERT_EQ(root.str(end), std::string("Hello World!"));
+
+	auto moved = std::move(file);
+	ASSERT_TRUE(!file);
+	ASSERT_FALSE(!moved);
+
+	{
+		std::ofstream out(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+		out.write("123456", 6);
+	}
+	ASSERT_TRUE(!protocache::MappedFile::Open(path.string()));
+	std::filesystem::remove(path);
+	ASSERT_TRUE(!protocache::MappedFile::Open(path.string()));
+}
+
 static bool BuildDynamicSchema(const std::string& proto_src,
 							   const std::string& root_message,
 							   google::protobuf::DescriptorPool& pool,
@@ -751,3 +1955,311 @@ TEST(PtotoCache, SerializeRejectsUnsupportedShapes) {
 		ASSERT_FALSE(protocache::Serialize(*message, &buf));
 	}
 }
+
+static void ExpectTranscoded(const google::protobuf::Descriptor* descriptor, const std::string& wire) {
+	SCOPED_TRACE(descriptor->full_name() + " " + std::to_string(wire.size()));
+	google::protobuf::DynamicMessageFactory factory(descriptor->file()->pool());
+	std::unique_ptr<google::protobuf::Message> message(factory.GetPrototype(descriptor)->New());
+	ASSERT_TRUE(message->ParseFromString(wire));
+	protocache::Buffer a, b;
+	a.SetDeterministic(true);
+	b.SetDeterministic(true);
+	ASSERT_TRUE(protocache::Serialize(*message, &a));
+	protocache::Transcoder transcoder(descriptor);
+	ASSERT_TRUE(transcoder.Transcode(wire, &b));
+	ASSERT_EQ(a.Size(), b.Size());
+	ASSERT_EQ(0, memcmp(a.View().data(), b.View().data(), a.Size()*4));
+	// cached layouts
+	b.Clear();
+	ASSERT_TRUE(transcoder.Transcode(wire, &b));
+	ASSERT_EQ(a.Size(), b.Size());
+	ASSERT_EQ(0, memcmp(a.View().data(), b.View().data(), a.Size()*4));
+}
+
+TEST(PtotoCache, Transcode) {
+	std::string err;
+	google::protobuf::FileDescriptorProto file;
+	ASSERT_TRUE(protocache::ParseProtoFile("test.proto", &file, &err));
+	google::protobuf::DescriptorPool pool(google::protobuf::DescriptorPool::generated_pool());
+	ASSERT_NE(pool.BuildFile(file), nullptr);
+	auto descriptor = pool.FindMessageTypeByName("test.Main");
+	ASSERT_NE(descriptor, nullptr);
+	google::protobuf::DynamicMessageFactory factory(&pool);
+	std::unique_ptr<google::protobuf::Message> message(factory.GetPrototype(descriptor)->New());
+	ASSERT_TRUE(protocache::LoadJson("test.json", message.get()));
+	ExpectTranscoded(descriptor, message->SerializeAsString());
+	ExpectTranscoded(pool.FindMessageTypeByName("test.Vec2D"), {});
+
+	// merged messages, oneof switches, closed enums, packed and unknown fields
+	google::protobuf::DescriptorPool pool2(google::protobuf::DescriptorPool::generated_pool());
+	ASSERT_TRUE(BuildDynamicSchema(
+			"syntax = \"proto2\";\n"
+			"package cov;\n"
+			"enum Color { RED = 0; BLUE = 1; }\n"
+			"message Inner {\n"
+			"  optional int32 a = 1;\n"
+			"  optional string s = 2;\n"
+			"  repeated int32 v = 3;\n"
+			"}\n"
+			"message Outer {\n"
+			"  optional Inner inner = 1;\n"
+			"  oneof pick {\n"
+			"    int32 n = 2;\n"
+			"    Inner m = 3;\n"
+			"    string t = 4;\n"
+			"  }\n"
+			"  repeated Color colors = 5;\n"
+			"  optional Color color = 6;\n"
+			"  map<string, Inner> dict = 7;\n"
+			"  repeated sint64 zs = 8 [packed = true];\n"
+			"  repeated fixed32 fs = 9;\n"
+			"  optional double d = 10;\n"
+			"}\n",
+			"cov.Outer", pool2, &descriptor, &err));
+	auto tag = [](unsigned number, unsigned wire) {
+		return std::string(1, static_cast<char>(number << 3U | wire));
+	};
+	auto bytes = [&tag](unsigned number, const std::string& data) {
+		return tag(number, 2) + static_cast<char>(data.size()) + data;
+	};
+	auto inner1 = tag(1, 0) + '\x05' + bytes(2, "abc") + tag(3, 0) + '\x01';
+	auto inner2 = tag(3, 0) + '\x02' + bytes(3, std::string("\x03\x04", 2));
+	auto entry1 = bytes(1, "k1") + bytes(2, inner1);
+	auto entry2 = bytes(1, "k2") + bytes(2, inner2);
+	auto entry3 = bytes(1, "k3") + bytes(2, inner2) + bytes(2, inner1);
+	std::string wire = bytes(1, inner1) + tag(2, 0) + '\x07' + bytes(3, inner1) + tag(5, 0) + '\x01'
+		+ tag(5, 0) + '\x09' + bytes(5, std::string("\x00\x01\x05", 3)) + tag(6, 0) + '\x01'
+		+ tag(6, 0) + '\x07' + bytes(7, entry1) + bytes(7, entry2) + bytes(1, inner2)
+		+ bytes(8, std::string("\x01\x02\x03", 3)) + tag(8, 0) + '\x04'
+		+ tag(9, 5) + std::string("\x01\x00\x00\x00", 4) + bytes(9, std::string("\x02\x00\x00\x00", 4))
+		+ tag(3, 2) + '\x00' + bytes(3, inner2) + bytes(7, entry3)
+		+ tag(15, 0) + '\x01' + tag(15, 3) + tag(1, 0) + '\x01' + tag(15, 4)
+		+ tag(10, 1) + std::string("\x00\x00\x00\x00\x00\x00\x00\x80", 8);
+	ExpectTranscoded(descriptor, wire);
+	ExpectTranscoded(descriptor, wire + tag(4, 2) + '\x00');
+	ExpectTranscoded(descriptor, wire + tag(4, 2) + '\x00' + tag(2, 0) + '\x00');
+
+	// last one wins for duplicate keys
+	protocache::Transcoder transcoder(descriptor);
+	protocache::Buffer a, b;
+	a.SetDeterministic(true);
+	b.SetDeterministic(true);
+	auto entry4 = bytes(1, "k1") + bytes(2, inner2);
+	ASSERT_TRUE(transcoder.Transcode(bytes(7, entry1) + bytes(7, entry2) + bytes(7, entry4), &a));
+	ASSERT_TRUE(transcoder.Transcode(bytes(7, entry2) + bytes(7, entry4), &b));
+	ASSERT_EQ(a.Size(), b.Size());
+	ASSERT_EQ(0, memcmp(a.View().data(), b.View().data(), a.Size()*4));
+
+	protocache::Buffer buf;
+	ASSERT_FALSE(transcoder.Transcode(wire.substr(0, wire.size()-1), &buf));
+	ASSERT_FALSE(transcoder.Transcode(tag(15, 4), &buf));
+}
+
+static void ExpectWire(const google::protobuf::Descriptor* descriptor, const protocache::Slice<uint32_t>& data, bool exact) {
+	SCOPED_TRACE(descriptor->full_name() + " " + std::to_string(data.size()));
+	google::protobuf::DynamicMessageFactory factory(descriptor->file()->pool());
+	std::unique_ptr<google::protobuf::Message> expected(factory.GetPrototype(descriptor)->New());
+	std::unique_ptr<google::protobuf::Message> actual(factory.GetPrototype(descriptor)->New());
+	ASSERT_TRUE(protocache::Deserialize(data, expected.get()));
+	std::string wire;
+	ASSERT_TRUE(protocache::DeserializeToWire(data, descriptor, &wire));
+	ASSERT_TRUE(actual->ParseFromString(wire));
+	ASSERT_TRUE(google::protobuf::util::MessageDifferencer::Equals(*expected, *actual));
+	if (exact) {
+		ASSERT_EQ(expected->SerializeAsString(), wire);
+	}
+}
+
+TEST(PtotoCache, DeserializeToWire) {
+	std::string err;
+	google::protobuf::FileDescriptorProto file;
+	ASSERT_TRUE(protocache::ParseProtoFile("test.proto", &file, &err));
+	google::protobuf::DescriptorPool pool(google::protobuf::DescriptorPool::generated_pool());
+	ASSERT_NE(pool.BuildFile(file), nullptr);
+	auto descriptor = pool.FindMessageTypeByName("test.Main");
+	ASSERT_NE(descriptor, nullptr);
+	google::protobuf::DynamicMessageFactory factory(&pool);
+	std::unique_ptr<google::protobuf::Message> message(factory.GetPrototype(descriptor)->New());
+	ASSERT_TRUE(protocache::LoadJson("test.json", message.get()));
+	protocache::Buffer buf;
+	ASSERT_TRUE(protocache::Serialize(*message, &buf));
+	ExpectWire(descriptor, buf.View(), false);
+
+	auto vec2d = pool.FindMessageTypeByName("test.Vec2D");
+	auto field = descriptor->FindFieldByName("matrix");
+	ASSERT_NE(field, nullptr);
+	auto& matrix = message->GetReflection()->GetMessage(*message, field);
+	buf.Clear();
+	ASSERT_TRUE(protocache::Serialize(matrix, &buf));
+	ExpectWire(vec2d, buf.View(), true);
+
+	// proto2 presence, closed enums, unpacked and packed arrays
+	google::protobuf::DescriptorPool pool2(google::protobuf::DescriptorPool::generated_pool());
+	ASSERT_TRUE(BuildDynamicSchema(
+			"syntax = \"proto2\";\n"
+			"package cov;\n"
+			"enum Color { RED = 0; BLUE = 1; }\n"
+			"message Inner {\n"
+			"  optional int32 a = 1;\n"
+			"  optional string s = 2;\n"
+			"}\n"
+			"message Outer {\n"
+			"  optional int32 zero = 1;\n"
+			"  oneof pick {\n"
+			"    sint32 n = 2;\n"
+			"    Inner m = 3;\n"
+			"  }\n"
+			"  repeated Color colors = 5;\n"
+			"  map<int64, Inner> dict = 7;\n"
+			"  repeated sint64 zs = 8 [packed = true];\n"
+			"  repeated bool bs = 9 [packed = true];\n"
+			"  repeated bool us = 10;\n"
+			"  optional double d = 4;\n"
+			"}\n",
+			"cov.Outer", pool2, &descriptor, &err));
+	google::protobuf::DynamicMessageFactory factory2(&pool2);
+	std::unique_ptr<google::protobuf::Message> outer(factory2.GetPrototype(descriptor)->New());
+	auto reflection = outer->GetReflection();
+	reflection->SetInt32(outer.get(), descriptor->FindFieldByName("zero"), 0);
+	reflection->SetInt32(outer.get(), descriptor->FindFieldByName("n"), -3);
+	reflection->AddEnumValue(outer.get(), descriptor->FindFieldByName("colors"), 1);
+	reflection->AddEnumValue(outer.get(), descriptor->FindFieldByName("colors"), 0);
+	reflection->AddInt64(outer.get(), descriptor->FindFieldByName("zs"), -1);
+	reflection->AddInt64(outer.get(), descriptor->FindFieldByName("zs"), INT64_MIN);
+	for (bool v : {true, false, true}) {
+		reflection->AddBool(outer.get(), descriptor->FindFieldByName("bs"), v);
+		reflection->AddBool(outer.get(), descriptor->FindFieldByName("us"), !v);
+	}
+	reflection->SetDouble(outer.get(), descriptor->FindFieldByName("d"), -0.0);
+	auto entry = reflection->AddMessage(outer.get(), descriptor->FindFieldByName("dict"));
+	entry->GetReflection()->SetInt64(entry, entry->GetDescriptor()->map_key(), -5);
+	buf.Clear();
+	ASSERT_TRUE(protocache::Serialize(*outer, &buf));
+	ExpectWire(descriptor, buf.View(), true);
+
+	std::string wire;
+	ASSERT_FALSE(protocache::DeserializeToWire({}, descriptor, &wire));
+}
+
+TEST(PtotoCache, DeserializeMasked) {
+	std::string err;
+	google::protobuf::FileDescriptorProto file;
+	ASSERT_TRUE(protocache::ParseProtoFile("test.proto", &file, &err));
+	google::protobuf::DescriptorPool pool(google::protobuf::DescriptorPool::generated_pool());
+	ASSERT_NE(pool.BuildFile(file), nullptr);
+	auto descriptor = pool.FindMessageTypeByName("test.Main");
+	ASSERT_NE(descriptor, nullptr);
+	google::protobuf::DynamicMessageFactory factory(&pool);
+	std::unique_ptr<google::protobuf::Message> message(factory.GetPrototype(descriptor)->New());
+	ASSERT_TRUE(protocache::LoadJson("test.json", message.get()));
+	protocache::Buffer buf;
+	ASSERT_TRUE(protocache::Serialize(*message, &buf));
+
+	google::protobuf::FieldMask mask;
+	for (auto path : {"i32", "object.str", "object.flag", "strv", "objects", "matrix", "arrays", "index"}) {
+		mask.add_paths(path);
+	}
+	std::unique_ptr<google::protobuf::Message> expected(message->New());
+	ASSERT_TRUE(protocache::Deserialize(buf.View(), expected.get()));
+	google::protobuf::util::FieldMaskUtil::TrimMessage(mask, expected.get());
+
+	std::unique_ptr<google::protobuf::Message> partial(message->New());
+	ASSERT_TRUE(protocache::Deserialize(buf.View(), mask, partial.get()));
+	ASSERT_TRUE(google::protobuf::util::MessageDifferencer::Equals(*expected, *partial));
+
+	// a whole field covers paths under it
+	mask.add_paths("object");
+	mask.add_paths("object.i32");
+	auto tree = protocache::MaskTree::Compile(descriptor, mask);
+	ASSERT_FALSE(!tree);
+	ASSERT_EQ(tree.Children(0).size(), 7U);
+	ASSERT_TRUE(protocache::Deserialize(buf.View(), tree, partial.get()));
+	ASSERT_TRUE(partial->GetReflection()->HasField(*partial, descriptor->FindFieldByName("object")));
+	ASSERT_NE(partial->GetReflection()->GetMessage(*partial, descriptor->FindFieldByName("object")).ByteSizeLong(), 0);
+
+	mask.Clear();
+	mask.add_paths("object.junk");
+	ASSERT_TRUE(!protocache::MaskTree::Compile(descriptor, mask));
+	mask.Clear();
+	mask.add_paths("objectv.str");
+	ASSERT_TRUE(!protocache::MaskTree::Compile(descriptor, mask));
+	mask.Clear();
+	mask.add_paths("nothing");
+	ASSERT_FALSE(protocache::Deserialize(buf.View(), mask, partial.get()));
+	mask.Clear();
+	ASSERT_TRUE(protocache::Deserialize(buf.View(), mask, partial.get()));
+	ASSERT_EQ(partial->ByteSizeLong(), 0);
+}
+
+TEST(PtotoCache, Project) {
+	std::string err;
+	google::protobuf::FileDescriptorProto file;
+	ASSERT_TRUE(protocache::ParseProtoFile("test.proto", &file, &err));
+	google::protobuf::DescriptorPool pool(google::protobuf::DescriptorPool::generated_pool());
+	ASSERT_NE(pool.BuildFile(file), nullptr);
+	auto descriptor = pool.FindMessageTypeByName("test.Main");
+	ASSERT_NE(descriptor, nullptr);
+	google::protobuf::DynamicMessageFactory factory(&pool);
+	std::unique_ptr<google::protobuf::Message> message(factory.GetPrototype(descriptor)->New());
+	ASSERT_TRUE(protocache::LoadJson("test.json", message.get()));
+	protocache::Buffer buf;
+	buf.SetDeterministic(true);
+	ASSERT_TRUE(protocache::Serialize(*message, &buf));
+
+	protocache::reflection::DescriptorPool reflection;
+	ASSERT_TRUE(reflection.Register(file));
+	auto root = reflection.Find("test.Main");
+	ASSERT_NE(root, nullptr);
+
+	google::protobuf::FieldMask mask;
+	for (auto path : {"i32", "object.str", "object.flag", "strv", "objectv", "objects", "matrix", "vector",
+					  "arrays", "index", "f64v", "flags", "modev", "t_s64"}) {
+		mask.add_paths(path);
+	}
+	protocache::FieldTree tree;
+	ASSERT_TRUE(protocache::reflection::BuildFieldTree(reflection, *root, mask, &tree));
+	ASSERT_EQ(tree.Children(0).size(), 13U);
+
+	// same as serializing the trimmed message
+	google::protobuf::util::FieldMaskUtil::TrimMessage(mask, message.get());
+	protocache::Buffer expected;
+	expected.SetDeterministic(true);
+	ASSERT_TRUE(protocache::Serialize(*message, &expected));
+
+	protocache::Buffer out;
+	ASSERT_TRUE(protocache::reflection::Project(buf.View(), reflection, *root, tree, &out));
+	ASSERT_EQ(expected.Size(), out.Size());
+	ASSERT_EQ(0, memcmp(expected.View().data(), out.View().data(), out.Size()*4));
+
+	protocache::FieldTree ids;
+	ids.Add({test::Main::_::object, test::Small::_::str});
+	ids.Add({test::Main::_::object, test::Small::_::flag});
+	for (auto id : {test::Main::_::i32, test::Main::_::strv, test::Main::_::objectv, test::Main::_::objects,
+					test::Main::_::matrix, test::Main::_::vector, test::Main::_::arrays, test::Main::_::index,
+					test::Main::_::f64v, test::Main::_::flags, test::Main::_::modev, test::Main::_::t_s64}) {
+		ids.Add({id});
+	}
+	out.Clear();
+	ASSERT_TRUE(protocache::Project<test::Main>(buf.View(), ids, &out));
+	ASSERT_EQ(expected.Size(), out.Size());
+	ASSERT_EQ(0, memcmp(expected.View().data(), out.View().data(), out.Size()*4));
+	auto& view = *protocache::Message(out.View()).Cast<test::Main>();
+	ASSERT_TRUE(view.object()->str() == std::string("tmp"));
+	ASSERT_EQ(view.object()->i32(), 0);
+
+	// a whole field covers paths under it
+	ids.Add({test::Main::_::object});
+	ids.Add({test::Main::_::object, test::Small::_::i32});
+	out.Clear();
+	ASSERT_TRUE(protocache::Project<test::Main>(buf.View(), ids, &out));
+	ASSERT_NE(protocache::Message(out.View()).Cast<test::Main>()->object()->i32(), 0);
+
+	mask.Clear();
+	mask.add_paths("objectv.str");
+	ASSERT_FALSE(protocache::reflection::BuildFieldTree(reflection, *root, mask, &tree));
+	mask.Clear();
+	out.Clear();
+	ASSERT_TRUE(protocache::reflection::BuildFieldTree(reflection, *root, mask, &tree));
+	ASSERT_TRUE(protocache::reflection::Project(buf.View(), reflection, *root, tree, &out));
+	ASSERT_EQ(out.Size(), 1U);
+}
@@ -24,12 +24,18 @@ struct Small final {
 	bool HasField(unsigned id, const uint32_t* end=nullptr) const noexcept {
 		return __view__.HasField(id, end);
 	}
+	// original data which can be copied as it is, or nullptr
+	const uint32_t* CleanHead() const noexcept {
+		auto clean_head = __view__.CleanHead();
+		if (clean_head == nullptr) return nullptr;
+		return clean_head;
+	}
 	bool Serialize(protocache::Buffer* buf, const uint32_t* end=nullptr) const {
 		protocache::Unit dummy;
 		return Serialize(*buf, dummy, end);
 	}
 	bool Serialize(protocache::Buffer& buf, protocache::Unit& unit, const uint32_t* end) const {
-		auto clean_head = __view__.CleanHead();
+		auto clean_head = CleanHead();
 		if (clean_head != nullptr) {
 			return protocache::Copy(Detect(clean_head, end), buf, unit);
 		}
@@ -40,16 +46,35 @@ struct Small final {
 		if (!__view__.SerializeField(_::i32, end, _i32, buf, parts[_::i32])) return false;
 		return protocache::SerializeMessage(parts, buf, last, unit);
 	}
+	size_t SerializedSize(const uint32_t* end=nullptr) const {
+		protocache::Unit unit;
+		return Measure(unit, end) ? unit.size() : 0;
+	}
+	bool Measure(protocache::Unit& unit, const uint32_t* end) const {
+		auto clean_head = CleanHead();
+		if (clean_head != nullptr) {
+			return protocache::MeasureCopy(Detect(clean_head, end), unit);
+		}
+		std::array<protocache::Unit,4> parts;
+		if (!__view__.MeasureField(_::i32, end, _i32, parts[_::i32])) return false;
+		if (!__view__.MeasureField(_::flag, end, _flag, parts[_::flag])) return false;
+		if (!__view__.MeasureField(_::str, end, _str, parts[_::str])) return false;
+		return protocache::MeasureMessage(parts, unit);
+	}
 
 	int32_t& i32(const uint32_t* end=nullptr) { return __view__.GetField(_::i32, end, _i32); }
 	bool& flag(const uint32_t* end=nullptr) { return __view__.GetField(_::flag, end, _flag); }
 	std::string& str(const uint32_t* end=nullptr) { return __view__.GetField(_::str, end, _str); }
 
+	int32_t i32(const uint32_t* end=nullptr) const { return __view__.ReadField(_::i32, end, _i32); }
+	bool flag(const uint32_t* end=nullptr) const { return __view__.ReadField(_::flag, end, _flag); }
+	protocache::Slice<char> str(const uint32_t* end=nullptr) const { return __view__.ReadField(_::str, end, _str); }
+
 private:
 	using _ = ::test::Small::_;
 	protocache::MessageEX<4> __view__;
-	int32_t _i32;
-	bool _flag;
+	int32_t _i32{};
+	bool _flag{};
 	std::string _str;
 };
 
@@ -79,12 +104,25 @@ struct Main final {
 	bool HasField(unsigned id, const uint32_t* end=nullptr) const noexcept {
 		return __view__.HasField(id, end);
 	}
+	// original data which can be copied as it is, or nullptr
+	const uint32_t* CleanHead() const noexcept {
+		auto clean_head = __view__.CleanHead();
+		if (clean_head == nullptr) return nullptr;
+		if (!__view__.FieldClean(_::object, _object)) return nullptr;
+		if (!__view__.FieldClean(_::objectv, _objectv)) return nullptr;
+		if (!__view__.FieldClean(_::index, _index)) return nullptr;
+		if (!__view__.FieldClean(_::objects, _objects)) return nullptr;
+		if (!__view__.FieldClean(_::matrix, _matrix)) return nullptr;
+		if (!__view__.FieldClean(_::vector, _vector)) return nullptr;
+		if (!__view__.FieldClean(_::arrays, _arrays)) return nullptr;
+		return clean_head;
+	}
 	bool Serialize(protocache::Buffer* buf, const uint32_t* end=nullptr) const {
 		protocache::Unit dummy;
 		return Serialize(*buf, dummy, end);
 	}
 	bool Serialize(protocache::Buffer& buf, protocache::Unit& unit, const uint32_t* end) const {
-		auto clean_head = __view__.CleanHead();
+		auto clean_head = buf.Deterministic()? nullptr : CleanHead();
 		if (clean_head != nullptr) {
 			return protocache::Copy(Detect(clean_head, end), buf, unit);
 		}
@@ -123,6 +161,49 @@ struct Main final {
 		if (!__view__.SerializeField(_::i32, end, _i32, buf, parts[_::i32])) return false;
 		return protocache::SerializeMessage(parts, buf, last, unit);
 	}
+	size_t SerializedSize(const uint32_t* end=nullptr) const {
+		protocache::Unit unit;
+		return Measure(unit, end) ? unit.size() : 0;
+	}
+	bool Measure(protocache::Unit& unit, const uint32_t* end) const {
+		auto clean_head = CleanHead();
+		if (clean_head != nullptr) {
+			return protocache::MeasureCopy(Detect(clean_head, end), unit);
+		}
+		std::array<protocache::Unit,32> parts;
+		if (!__view__.MeasureField(_::i32, end, _i32, parts[_::i32])) return false;
+		if (!__view__.MeasureField(_::u32, end, _u32, parts[_::u32])) return false;
+		if (!__view__.MeasureField(_::i64, end, _i64, parts[_::i64])) return false;
+		if (!__view__.MeasureField(_::u64, end, _u64, parts[_::u64])) return false;
+		if (!__view__.MeasureField(_::flag, end, _flag, parts[_::flag])) return false;
+		if (!__view__.MeasureField(_::mode, end, _mode, parts[_::mode])) return false;
+		if (!__view__.MeasureField(_::str, end, _str, parts[_::str])) return false;
+		if (!__view__.MeasureField(_::data, end, _data, parts[_::data])) return false;
+		if (!__view__.MeasureField(_::f32, end, _f32, parts[_::f32])) return false;
+		if (!__view__.MeasureField(_::f64, end, _f64, parts[_::f64])) return false;
+		if (!__view__.MeasureField(_::object, end, _object, parts[_::object])) return false;
+		if (!__view__.MeasureField(_::i32v, end, _i32v, parts[_::i32v])) return false;
+		if (!__view__.MeasureField(_::u64v, end, _u64v, parts[_::u64v])) return false;
+		if (!__view__.MeasureField(_::strv, end, _strv, parts[_::strv])) return false;
+		if (!__view__.MeasureField(_::datav, end, _datav, parts[_::datav])) return false;
+		if (!__view__.MeasureField(_::f32v, end, _f32v, parts[_::f32v])) return false;
+		if (!__view__.MeasureField(_::f64v, end, _f64v, parts[_::f64v])) return false;
+		if (!__view__.MeasureField(_::flags, end, _flags, parts[_::flags])) return false;
+		if (!__view__.MeasureField(_::objectv, end, _objectv, parts[_::objectv])) return false;
+		if (!__view__.MeasureField(_::t_u32, end, _t_u32, parts[_::t_u32])) return false;
+		if (!__view__.MeasureField(_::t_i32, end, _t_i32, parts[_::t_i32])) return false;
+		if (!__view__.MeasureField(_::t_s32, end, _t_s32, parts[_::t_s32])) return false;
+		if (!__view__.MeasureField(_::t_u64, end, _t_u64, parts[_::t_u64])) return false;
+		if (!__view__.MeasureField(_::t_i64, end, _t_i64, parts[_::t_i64])) return false;
+		if (!__view__.MeasureField(_::t_s64, end, _t_s64, parts[_::t_s64])) return false;
+		if (!__view__.MeasureField(_::index, end, _index, parts[_::index])) return false;
+		if (!__view__.MeasureField(_::objects, end, _objects, parts[_::objects])) return false;
+		if (!__view__.MeasureField(_::matrix, end, _matrix, parts[_::matrix])) return false;
+		if (!__view__.MeasureField(_::vector, end, _vector, parts[_::vector])) return false;
+		if (!__view__.MeasureField(_::arrays, end, _arrays, parts[_::arrays])) return false;
+		if (!__view__.MeasureField(_::modev, end, _modev, parts[_::modev])) return false;
+		return protocache::MeasureMessage(parts, unit);
+	}
 
 	int32_t& i32(const uint32_t* end=nullptr) { return __view__.GetField(_::i32, end, _i32); }
 	uint32_t& u32(const uint32_t* end=nullptr) { return __view__.GetField(_::u32, end, _u32); }
@@ -156,40 +237,72 @@ struct Main final {
 	::ex::test::ArrMap::ALIAS& arrays(const uint32_t* end=nullptr) { return __view__.GetField(_::arrays, end, _arrays); }
 	protocache::ArrayEX<protocache::EnumValue>& modev(const uint32_t* end=nullptr) { return __view__.GetField(_::modev, end, _modev); }
 
+	int32_t i32(const uint32_t* end=nullptr) const { return __view__.ReadField(_::i32, end, _i32); }
+	uint32_t u32(const uint32_t* end=nullptr) const { return __view__.ReadField(_::u32, end, _u32); }
+	int64_t i64(const uint32_t* end=nullptr) const { return __view__.ReadField(_::i64, end, _i64); }
+	uint64_t u64(const uint32_t* end=nullptr) const { return __view__.ReadField(_::u64, end, _u64); }
+	bool flag(const uint32_t* end=nullptr) const { return __view__.ReadField(_::flag, end, _flag); }
+	protocache::EnumValue mode(const uint32_t* end=nullptr) const { return __view__.ReadField(_::mode, end, _mode); }
+	protocache::Slice<char> str(const uint32_t* end=nullptr) const { return __view__.ReadField(_::str, end, _str); }
+	protocache::Slice<uint8_t> data(const uint32_t* end=nullptr) const { return protocache::SliceCast<uint8_t>(__view__.ReadField(_::data, end, _data)); }
+	float f32(const uint32_t* end=nullptr) const { return __view__.ReadField(_::f32, end, _f32); }
+	double f64(const uint32_t* end=nullptr) const { return __view__.ReadField(_::f64, end, _f64); }
+	const ::ex::test::Small* object(const uint32_t* end=nullptr) const { return __view__.ViewField(_::object, end, _object).get(); }
+	const protocache::ArrayEX<int32_t>& i32v(const uint32_t* end=nullptr) const { return __view__.ViewField(_::i32v, end, _i32v); }
+	const protocache::ArrayEX<uint64_t>& u64v(const uint32_t* end=nullptr) const { return __view__.ViewField(_::u64v, end, _u64v); }
+	const protocache::ArrayEX<protocache::Slice<char>>& strv(const uint32_t* end=nullptr) const { return __view__.ViewField(_::strv, end, _strv); }
+	const protocache::ArrayEX<protocache::Slice<uint8_t>>& datav(const uint32_t* end=nullptr) const { return __view__.ViewField(_::datav, end, _datav); }
+	const protocache::ArrayEX<float>& f32v(const uint32_t* end=nullptr) const { return __view__.ViewField(_::f32v, end, _f32v); }
+	const protocache::ArrayEX<double>& f64v(const uint32_t* end=nullptr) const { return __view__.ViewField(_::f64v, end, _f64v); }
+	const protocache::ArrayEX<bool>& flags(const uint32_t* end=nullptr) const { return __view__.ViewField(_::flags, end, _flags); }
+	const protocache::ArrayEX<std::unique_ptr<::ex::test::Small>>& objectv(const uint32_t* end=nullptr) const { return __view__.ViewField(_::objectv, end, _objectv); }
+	uint32_t t_u32(const uint32_t* end=nullptr) const { return __view__.ReadField(_::t_u32, end, _t_u32); }
+	int32_t t_i32(const uint32_t* end=nullptr) const { return __view__.ReadField(_::t_i32, end, _t_i32); }
+	int32_t t_s32(const uint32_t* end=nullptr) const { return __view__.ReadField(_::t_s32, end, _t_s32); }
+	uint64_t t_u64(const uint32_t* end=nullptr) const { return __view__.ReadField(_::t_u64, end, _t_u64); }
+	int64_t t_i64(const uint32_t* end=nullptr) const { return __view__.ReadField(_::t_i64, end, _t_i64); }
+	int64_t t_s64(const uint32_t* end=nullptr) const { return __view__.ReadField(_::t_s64, end, _t_s64); }
+	const protocache::MapEX<protocache::Slice<char>,int32_t>& index(const uint32_t* end=nullptr) const { return __view__.ViewField(_::index, end, _index); }
+	const protocache::MapEX<int32_t,std::unique_ptr<::ex::test::Small>>& objects(const uint32_t* end=nullptr) const { return __view__.ViewField(_::objects, end, _objects); }
+	const ::ex::test::Vec2D::ALIAS& matrix(const uint32_t* end=nullptr) const { return __view__.ViewField(_::matrix, end, _matrix); }
+	const protocache::ArrayEX<::ex::test::ArrMap::ALIAS>& vector(const uint32_t* end=nullptr) const { return __view__.ViewField(_::vector, end, _vector); }
+	const ::ex::test::ArrMap::ALIAS& arrays(const uint32_t* end=nullptr) const { return __view__.ViewField(_::arrays, end, _arrays); }
+	const protocache::ArrayEX<protocache::EnumValue>& modev(const uint32_t* end=nullptr) const { return __view__.ViewField(_::modev, end, _modev); }
+
 private:
 	using _ = ::test::Main::_;
 	protocache::MessageEX<32> __view__;
-	int32_t _i32;
-	uint32_t _u32;
-	int64_t _i64;
-	uint64_t _u64;
-	bool _flag;
-	protocache::EnumValue _mode;
+	int32_t _i32{};
+	uint32_t _u32{};
+	int64_t _i64{};
+	uint64_t _u64{};
+	bool _flag{};
+	protocache::EnumValue _mode{};
 	std::string _str;
 	std::string _data;
-	float _f32;
-	double _f64;
-	std::unique_ptr<::ex::test::Small> _object;
-	protocache::ArrayEX<int32_t> _i32v;
-	protocache::ArrayEX<uint64_t> _u64v;
-	protocache::ArrayEX<protocache::Slice<char>> _strv;
-	protocache::ArrayEX<protocache::Slice<uint8_t>> _datav;
-	protocache::ArrayEX<float> _f32v;
-	protocache::ArrayEX<double> _f64v;
-	protocache::ArrayEX<bool> _flags;
-	protocache::ArrayEX<std::unique_ptr<::ex::test::Small>> _objectv;
-	uint32_t _t_u32;
-	int32_t _t_i32;
-	int32_t _t_s32;
-	uint64_t _t_u64;
-	int64_t _t_i64;
-	int64_t _t_s64;
-	protocache::MapEX<protocache::Slice<char>,int32_t> _index;
-	protocache::MapEX<int32_t,std::unique_ptr<::ex::test::Small>> _objects;
-	::ex::test::Vec2D::ALIAS _matrix;
-	protocache::ArrayEX<::ex::test::ArrMap::ALIAS> _vector;
-	::ex::test::ArrMap::ALIAS _arrays;
-	protocache::ArrayEX<protocache::EnumValue> _modev;
+	float _f32{};
+	double _f64{};
+	mutable std::unique_ptr<::ex::test::Small> _object;
+	mutable protocache::ArrayEX<int32_t> _i32v;
+	mutable protocache::ArrayEX<uint64_t> _u64v;
+	mutable protocache::ArrayEX<protocache::Slice<char>> _strv;
+	mutable protocache::ArrayEX<protocache::Slice<uint8_t>> _datav;
+	mutable protocache::ArrayEX<float> _f32v;
+	mutable protocache::ArrayEX<double> _f64v;
+	mutable protocache::ArrayEX<bool> _flags;
+	mutable protocache::ArrayEX<std::unique_ptr<::ex::test::Small>> _objectv;
+	uint32_t _t_u32{};
+	int32_t _t_i32{};
+	int32_t _t_s32{};
+	uint64_t _t_u64{};
+	int64_t _t_i64{};
+	int64_t _t_s64{};
+	mutable protocache::MapEX<protocache::Slice<char>,int32_t> _index;
+	mutable protocache::MapEX<int32_t,std::unique_ptr<::ex::test::Small>> _objects;
+	mutable ::ex::test::Vec2D::ALIAS _matrix;
+	mutable protocache::ArrayEX<::ex::test::ArrMap::ALIAS> _vector;
+	mutable ::ex::test::ArrMap::ALIAS _arrays;
+	mutable protocache::ArrayEX<protocache::EnumValue> _modev;
 };
 
 struct CyclicA final {
@@ -202,12 +315,19 @@ struct CyclicA final {
 	bool HasField(unsigned id, const uint32_t* end=nullptr) const noexcept {
 		return __view__.HasField(id, end);
 	}
+	// original data which can be copied as it is, or nullptr
+	const uint32_t* CleanHead() const noexcept {
+		auto clean_head = __view__.CleanHead();
+		if (clean_head == nullptr) return nullptr;
+		if (!__view__.FieldClean(_::cyclic, _cyclic)) return nullptr;
+		return clean_head;
+	}
 	bool Serialize(protocache::Buffer* buf, const uint32_t* end=nullptr) const {
 		protocache::Unit dummy;
 		return Serialize(*buf, dummy, end);
 	}
 	bool Serialize(protocache::Buffer& buf, protocache::Unit& unit, const uint32_t* end) const {
-		auto clean_head = __view__.CleanHead();
+		auto clean_head = buf.Deterministic()? nullptr : CleanHead();
 		if (clean_head != nullptr) {
 			return protocache::Copy(Detect(clean_head, end), buf, unit);
 		}
@@ -217,15 +337,32 @@ struct CyclicA final {
 		if (!__view__.SerializeField(_::value, end, _value, buf, parts[_::value])) return false;
 		return protocache::SerializeMessage(parts, buf, last, unit);
 	}
+	size_t SerializedSize(const uint32_t* end=nullptr) const {
+		protocache::Unit unit;
+		return Measure(unit, end) ? unit.size() : 0;
+	}
+	bool Measure(protocache::Unit& unit, const uint32_t* end) const {
+		auto clean_head = CleanHead();
+		if (clean_head != nullptr) {
+			return protocache::MeasureCopy(Detect(clean_head, end), unit);
+		}
+		std::array<protocache::Unit,2> parts;
+		if (!__view__.MeasureField(_::value, end, _value, parts[_::value])) return false;
+		if (!__view__.MeasureField(_::cyclic, end, _cyclic, parts[_::cyclic])) return false;
+		return protocache::MeasureMessage(parts, unit);
+	}
 
 	int32_t& value(const uint32_t* end=nullptr) { return __view__.GetField(_::value, end, _value); }
 	std::unique_ptr<::ex::test::CyclicB>& cyclic(const uint32_t* end=nullptr) { return __view__.GetField(_::cyclic, end, _cyclic); }
 
+	int32_t value(const uint32_t* end=nullptr) const { return __view__.ReadField(_::value, end, _value); }
+	const ::ex::test::CyclicB* cyclic(const uint32_t* end=nullptr) const { return __view__.ViewField(_::cyclic, end, _cyclic).get(); }
+
 private:
 	using _ = ::test::CyclicA::_;
 	protocache::MessageEX<2> __view__;
-	int32_t _value;
-	std::unique_ptr<::ex::test::CyclicB> _cyclic;
+	int32_t _value{};
+	mutable std::unique_ptr<::ex::test::CyclicB> _cyclic;
 };
 
 struct CyclicB final {
@@ -238,12 +375,19 @@ struct CyclicB final {
 	bool HasField(unsigned id, const uint32_t* end=nullptr) const noexcept {
 		return __view__.HasField(id, end);
 	}
+	// original data which can be copied as it is, or nullptr
+	const uint32_t* CleanHead() const noexcept {
+		auto clean_head = __view__.CleanHead();
+		if (clean_head == nullptr) return nullptr;
+		if (!__view__.FieldClean(_::cyclic, _cyclic)) return nullptr;
+		return clean_head;
+	}
 	bool Serialize(protocache::Buffer* buf, const uint32_t* end=nullptr) const {
 		protocache::Unit dummy;
 		return Serialize(*buf, dummy, end);
 	}
 	bool Serialize(protocache::Buffer& buf, protocache::Unit& unit, const uint32_t* end) const {
-		auto clean_head = __view__.CleanHead();
+		auto clean_head = buf.Deterministic()? nullptr : CleanHead();
 		if (clean_head != nullptr) {
 			return protocache::Copy(Detect(clean_head, end), buf, unit);
 		}
@@ -253,15 +397,32 @@ struct CyclicB final {
 		if (!__view__.SerializeField(_::value, end, _value, buf, parts[_::value])) return false;
 		return protocache::SerializeMessage(parts, buf, last, unit);
 	}
+	size_t SerializedSize(const uint32_t* end=nullptr) const {
+		protocache::Unit unit;
+		return Measure(unit, end) ? unit.size() : 0;
+	}
+	bool Measure(protocache::Unit& unit, const uint32_t* end) const {
+		auto clean_head = CleanHead();
+		if (clean_head != nullptr) {
+			return protocache::MeasureCopy(Detect(clean_head, end), unit);
+		}
+		std::array<protocache::Unit,2> parts;
+		if (!__view__.MeasureField(_::value, end, _value, parts[_::value])) return false;
+		if (!__view__.MeasureField(_::cyclic, end, _cyclic, parts[_::cyclic])) return false;
+		return protocache::MeasureMessage(parts, unit);
+	}
 
 	int32_t& value(const uint32_t* end=nullptr) { return __view__.GetField(_::value, end, _value); }
 	std::unique_ptr<::ex::test::CyclicA>& cyclic(const uint32_t* end=nullptr) { return __view__.GetField(_::cyclic, end, _cyclic); }
 
+	int32_t value(const uint32_t* end=nullptr) const { return __view__.ReadField(_::value, end, _value); }
+	const ::ex::test::CyclicA* cyclic(const uint32_t* end=nullptr) const { return __view__.ViewField(_::cyclic, end, _cyclic).get(); }
+
 private:
 	using _ = ::test::CyclicB::_;
 	protocache::MessageEX<2> __view__;
-	int32_t _value;
-	std::unique_ptr<::ex::test::CyclicA> _cyclic;
+	int32_t _value{};
+	mutable std::unique_ptr<::ex::test::CyclicA> _cyclic;
 };
 
 struct Deprecated final {
@@ -277,12 +438,18 @@ struct Deprecated final {
 		bool HasField(unsigned id, const uint32_t* end=nullptr) const noexcept {
 			return __view__.HasField(id, end);
 		}
+		// original data which can be copied as it is, or nullptr
+		const uint32_t* CleanHead() const noexcept {
+			auto clean_head = __view__.CleanHead();
+			if (clean_head == nullptr) return nullptr;
+			return clean_head;
+		}
 		bool Serialize(protocache::Buffer* buf, const uint32_t* end=nullptr) const {
 			protocache::Unit dummy;
 			return Serialize(*buf, dummy, end);
 		}
 		bool Serialize(protocache::Buffer& buf, protocache::Unit& unit, const uint32_t* end) const {
-			auto clean_head = __view__.CleanHead();
+			auto clean_head = CleanHead();
 			if (clean_head != nullptr) {
 				return protocache::Copy(Detect(clean_head, end), buf, unit);
 			}
@@ -291,13 +458,28 @@ struct Deprecated final {
 			if (!__view__.SerializeField(_::val, end, _val, buf, parts[_::val])) return false;
 			return protocache::SerializeMessage(parts, buf, last, unit);
 		}
+		size_t SerializedSize(const uint32_t* end=nullptr) const {
+			protocache::Unit unit;
+			return Measure(unit, end) ? unit.size() : 0;
+		}
+		bool Measure(protocache::Unit& unit, const uint32_t* end) const {
+			auto clean_head = CleanHead();
+			if (clean_head != nullptr) {
+				return protocache::MeasureCopy(Detect(clean_head, end), unit);
+			}
+			std::array<protocache::Unit,1> parts;
+			if (!__view__.MeasureField(_::val, end, _val, parts[_::val])) return false;
+			return protocache::MeasureMessage(parts, unit);
+		}
 
 		int32_t& val(const uint32_t* end=nullptr) { return __view__.GetField(_::val, end, _val); }
 
+		int32_t val(const uint32_t* end=nullptr) const { return __view__.ReadField(_::val, end, _val); }
+
 	private:
 		using _ = ::test::Deprecated::Valid::_;
 		protocache::MessageEX<1> __view__;
-		int32_t _val;
+		int32_t _val{};
 	};
 
 };
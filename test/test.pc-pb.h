@@ -0,0 +1,671 @@
+#pragma once
+#ifndef PROTOCACHE_INCLUDED_PB_test_proto
+#define PROTOCACHE_INCLUDED_PB_test_proto
+
+#include <protocache/builder.h>
+#include <protocache/extension/utils.h>
+#include "test.pb.h"
+
+namespace test {
+
+inline bool FromProtobuf(const ::test::Small& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool FromProtobuf(const ::test::Vec2D::Vec1D& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool FromProtobuf(const ::test::Vec2D& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool FromProtobuf(const ::test::ArrMap::Array& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool FromProtobuf(const ::test::ArrMap& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool FromProtobuf(const ::test::Main& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool FromProtobuf(const ::test::CyclicA& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool FromProtobuf(const ::test::CyclicB& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool FromProtobuf(const ::test::Deprecated::Valid& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool FromProtobuf(const ::test::Deprecated& message, protocache::Buffer& buf, protocache::Unit& unit);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::Small* out);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::Vec2D::Vec1D* out);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::Vec2D* out);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::ArrMap::Array* out);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::ArrMap* out);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::Main* out);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::CyclicA* out);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::CyclicB* out);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::Deprecated::Valid* out);
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::Deprecated* out);
+
+inline bool FromProtobuf(const ::test::Small& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	std::array<protocache::Unit,4> parts;
+	auto last = buf.Size();
+	if (!message.str().empty()) {
+		if (!protocache::Serialize(message.str(), buf, parts[3])) {
+			return false;
+		}
+		protocache::FoldField(buf, parts[3]);
+	}
+	if (message.flag()) {
+		protocache::Serialize(message.flag(), buf, parts[1]);
+	}
+	if (message.i32() != 0) {
+		protocache::Serialize(message.i32(), buf, parts[0]);
+	}
+	return protocache::SerializeMessage(parts, buf, last, unit);
+}
+
+inline bool FromProtobuf(const ::test::Small& message, protocache::Buffer& buf) {
+	protocache::Unit dummy;
+	return FromProtobuf(message, buf, dummy);
+}
+
+inline bool FromProtobuf(const ::test::Vec2D::Vec1D& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	if (message.__size() == 0) {
+		unit.len = 1;
+		unit.data[0] = 1U;
+		return true;
+	}
+	return protocache::SerializeArray(protocache::Slice<float>(message._().data(), message.__size()), buf, unit);
+}
+
+inline bool FromProtobuf(const ::test::Vec2D& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	if (message.__size() == 0) {
+		unit.len = 1;
+		unit.data[0] = 1U;
+		return true;
+	}
+	return protocache::SerializeArrayBy(message.__size(), buf, unit, [&message, &buf](size_t i, protocache::Unit& one)->bool { return FromProtobuf(message._(i), buf, one); });
+}
+
+inline bool FromProtobuf(const ::test::ArrMap::Array& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	if (message.__size() == 0) {
+		unit.len = 1;
+		unit.data[0] = 1U;
+		return true;
+	}
+	return protocache::SerializeArray(protocache::Slice<float>(message._().data(), message.__size()), buf, unit);
+}
+
+inline bool FromProtobuf(const ::test::ArrMap& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	if (message.__size() == 0) {
+		unit.len = 1;
+		unit.data[0] = 5U << 28U;
+		return true;
+	}
+	return protocache::SerializeMapOf<protocache::Slice<char>>(message._(), buf, unit, [&buf](const auto& v, protocache::Unit& one)->bool { return FromProtobuf(v, buf, one); });
+}
+
+inline bool FromProtobuf(const ::test::Main& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	std::array<protocache::Unit,32> parts;
+	auto last = buf.Size();
+	if (message.modev_size() != 0) {
+		if (!protocache::SerializeArray(protocache::Slice<protocache::EnumValue>(message.modev().data(), message.modev_size()), buf, parts[31])) {
+			return false;
+		}
+		protocache::FoldField(buf, parts[31]);
+	}
+	if (message.has_arrays()) {
+		if (!FromProtobuf(message.arrays(), buf, parts[29])) {
+			return false;
+		}
+		protocache::FoldNested(buf, parts[29]);
+	}
+	if (message.vector_size() != 0) {
+		if (!protocache::SerializeArrayBy(message.vector_size(), buf, parts[28], [&message, &buf](size_t i, protocache::Unit& one)->bool { return FromProtobuf(message.vector(i), buf, one); })) {
+			return false;
+		}
+		protocache::FoldField(buf, parts[28]);
+	}
+	if (message.has_matrix()) {
+		if (!FromProtobuf(message.matrix(), buf, parts[27])) {
+			return false;
+		}
+		protocache::FoldNested(buf, parts[27]);
+	}
+	if (message.objects_size() != 0) {
+		if (!protocache::SerializeMapOf<int32_t>(message.objects(), buf, parts[26], [&buf](const auto& v, protocache::Unit& one)->bool { return FromProtobuf(v, buf, one); })) {
+			return false;
+		}
+		protocache::FoldField(buf, parts[26]);
+	}
+	if (message.index_size() != 0) {
+		if (!protocache::SerializeMapOf<protocache::Slice<char>>(message.index(), buf, parts[25], [&buf](const auto& v, protocache::Unit& one)->bool { return protocache::Serialize(v, buf, one); })) {
+			return false;
+		}
+		protocache::FoldField(buf, parts[25]);
+	}
+	if (message.t_s64() != 0) {
+		protocache::Serialize(message.t_s64(), buf, parts[24]);
+	}
+	if (message.t_i64() != 0) {
+		protocache::Serialize(message.t_i64(), buf, parts[23]);
+	}
+	if (message.t_u64() != 0) {
+		protocache::Serialize(message.t_u64(), buf, parts[22]);
+	}
+	if (message.t_s32() != 0) {
+		protocache::Serialize(message.t_s32(), buf, parts[21]);
+	}
+	if (message.t_i32() != 0) {
+		protocache::Serialize(message.t_i32(), buf, parts[20]);
+	}
+	if (message.t_u32() != 0) {
+		protocache::Serialize(message.t_u32(), buf, parts[19]);
+	}
+	if (message.objectv_size() != 0) {
+		if (!protocache::SerializeArrayBy(message.objectv_size(), buf, parts[18], [&message, &buf](size_t i, protocache::Unit& one)->bool { return FromProtobuf(message.objectv(i), buf, one); })) {
+			return false;
+		}
+		protocache::FoldField(buf, parts[18]);
+	}
+	if (message.flags_size() != 0) {
+		if (!protocache::SerializeArray(protocache::Slice<bool>(message.flags().data(), message.flags_size()), buf, parts[17])) {
+			return false;
+		}
+		protocache::FoldField(buf, parts[17]);
+	}
+	if (message.f64v_size() != 0) {
+		if (!protocache::SerializeArray(protocache::Slice<double>(message.f64v().data(), message.f64v_size()), buf, parts[16])) {
+			return false;
+		}
+		protocache::FoldField(buf, parts[16]);
+	}
+	if (message.f32v_size() != 0) {
+		if (!protocache::SerializeArray(protocache::Slice<float>(message.f32v().data(), message.f32v_size()), buf, parts[15])) {
+			return false;
+		}
+		protocache::FoldField(buf, parts[15]);
+	}
+	if (message.datav_size() != 0) {
+		if (!protocache::SerializeArrayBy(message.datav_size(), buf, parts[14], [&message, &buf](size_t i, protocache::Unit& one)->bool { return protocache::Serialize(message.datav(i), buf, one); })) {
+			return false;
+		}
+		protocache::FoldField(buf, parts[14]);
+	}
+	if (message.strv_size() != 0) {
+		if (!protocache::SerializeArrayBy(message.strv_size(), buf, parts[13], [&message, &buf](size_t i, protocache::Unit& one)->bool { return protocache::Serialize(message.strv(i), buf, one); })) {
+			return false;
+		}
+		protocache::FoldField(buf, parts[13]);
+	}
+	if (message.u64v_size() != 0) {
+		if (!protocache::SerializeArray(protocache::Slice<uint64_t>(message.u64v().data(), message.u64v_size()), buf, parts[12])) {
+			return false;
+		}
+		protocache::FoldField(buf, parts[12]);
+	}
+	if (message.i32v_size() != 0) {
+		if (!protocache::SerializeArray(protocache::Slice<int32_t>(message.i32v().data(), message.i32v_size()), buf, parts[11])) {
+			return false;
+		}
+		protocache::FoldField(buf, parts[11]);
+	}
+	if (message.has_object()) {
+		if (!FromProtobuf(message.object(), buf, parts[10])) {
+			return false;
+		}
+		protocache::FoldNested(buf, parts[10]);
+	}
+	if (!protocache::IsZero(message.f64())) {
+		protocache::Serialize(message.f64(), buf, parts[9]);
+	}
+	if (!protocache::IsZero(message.f32())) {
+		protocache::Serialize(message.f32(), buf, parts[8]);
+	}
+	if (!message.data().empty()) {
+		if (!protocache::Serialize(message.data(), buf, parts[7])) {
+			return false;
+		}
+		protocache::FoldField(buf, parts[7]);
+	}
+	if (!message.str().empty()) {
+		if (!protocache::Serialize(message.str(), buf, parts[6])) {
+			return false;
+		}
+		protocache::FoldField(buf, parts[6]);
+	}
+	if (message.mode() != 0) {
+		protocache::Serialize(static_cast<protocache::EnumValue>(message.mode()), buf, parts[5]);
+	}
+	if (message.flag()) {
+		protocache::Serialize(message.flag(), buf, parts[4]);
+	}
+	if (message.u64() != 0) {
+		protocache::Serialize(message.u64(), buf, parts[3]);
+	}
+	if (message.i64() != 0) {
+		protocache::Serialize(message.i64(), buf, parts[2]);
+	}
+	if (message.u32() != 0) {
+		protocache::Serialize(message.u32(), buf, parts[1]);
+	}
+	if (message.i32() != 0) {
+		protocache::Serialize(message.i32(), buf, parts[0]);
+	}
+	return protocache::SerializeMessage(parts, buf, last, unit);
+}
+
+inline bool FromProtobuf(const ::test::Main& message, protocache::Buffer& buf) {
+	protocache::Unit dummy;
+	return FromProtobuf(message, buf, dummy);
+}
+
+inline bool FromProtobuf(const ::test::CyclicA& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	std::array<protocache::Unit,2> parts;
+	auto last = buf.Size();
+	if (message.has_cyclic()) {
+		if (!FromProtobuf(message.cyclic(), buf, parts[1])) {
+			return false;
+		}
+		protocache::FoldNested(buf, parts[1]);
+	}
+	if (message.value() != 0) {
+		protocache::Serialize(message.value(), buf, parts[0]);
+	}
+	return protocache::SerializeMessage(parts, buf, last, unit);
+}
+
+inline bool FromProtobuf(const ::test::CyclicA& message, protocache::Buffer& buf) {
+	protocache::Unit dummy;
+	return FromProtobuf(message, buf, dummy);
+}
+
+inline bool FromProtobuf(const ::test::CyclicB& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	std::array<protocache::Unit,2> parts;
+	auto last = buf.Size();
+	if (message.has_cyclic()) {
+		if (!FromProtobuf(message.cyclic(), buf, parts[1])) {
+			return false;
+		}
+		protocache::FoldNested(buf, parts[1]);
+	}
+	if (message.value() != 0) {
+		protocache::Serialize(message.value(), buf, parts[0]);
+	}
+	return protocache::SerializeMessage(parts, buf, last, unit);
+}
+
+inline bool FromProtobuf(const ::test::CyclicB& message, protocache::Buffer& buf) {
+	protocache::Unit dummy;
+	return FromProtobuf(message, buf, dummy);
+}
+
+inline bool FromProtobuf(const ::test::Deprecated::Valid& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	std::array<protocache::Unit,1> parts;
+	auto last = buf.Size();
+	if (message.val() != 0) {
+		protocache::Serialize(message.val(), buf, parts[0]);
+	}
+	return protocache::SerializeMessage(parts, buf, last, unit);
+}
+
+inline bool FromProtobuf(const ::test::Deprecated::Valid& message, protocache::Buffer& buf) {
+	protocache::Unit dummy;
+	return FromProtobuf(message, buf, dummy);
+}
+
+inline bool FromProtobuf(const ::test::Deprecated& message, protocache::Buffer& buf, protocache::Unit& unit) {
+	(void)message;
+	std::array<protocache::Unit,1> parts;
+	auto last = buf.Size();
+	return protocache::SerializeMessage(parts, buf, last, unit);
+}
+
+inline bool FromProtobuf(const ::test::Deprecated& message, protocache::Buffer& buf) {
+	protocache::Unit dummy;
+	return FromProtobuf(message, buf, dummy);
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::Small* out) {
+	protocache::Message message(data, end);
+	if (!message) {
+		return false;
+	}
+	if (auto field = message.GetField(0, end); !!field) {
+		out->set_i32(protocache::FieldT<int32_t>(field).Get(end));
+	}
+	if (auto field = message.GetField(1, end); !!field) {
+		out->set_flag(protocache::FieldT<bool>(field).Get(end));
+	}
+	if (auto field = message.GetField(3, end); !!field) {
+		auto v = protocache::FieldT<protocache::Slice<char>>(field).Get(end);
+		if (!v) {
+			return false;
+		}
+		out->mutable_str()->assign(v.data(), v.size());
+	}
+	return true;
+}
+
+inline bool ToProtobuf(const protocache::Slice<uint32_t>& data, ::test::Small* out) {
+	out->Clear();
+	return ToProtobuf(data.data(), data.end(), out);
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::Vec2D::Vec1D* out) {
+	protocache::ArrayT<float> array(data, end);
+	if (!array) {
+		return false;
+	}
+	out->mutable__()->Add(array.begin(), array.end());
+	return true;
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::Vec2D* out) {
+	protocache::Array array(data, end);
+	if (!array) {
+		return false;
+	}
+	auto list = out->mutable__();
+	list->Reserve(list->size() + array.Size());
+	for (auto one : array) {
+		if (!ToProtobuf(one.GetObject(end), end, list->Add())) {
+			return false;
+		}
+	}
+	return true;
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::ArrMap::Array* out) {
+	protocache::ArrayT<float> array(data, end);
+	if (!array) {
+		return false;
+	}
+	out->mutable__()->Add(array.begin(), array.end());
+	return true;
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::ArrMap* out) {
+	protocache::Map map(data, end);
+	if (!map) {
+		return false;
+	}
+	auto& dict = *out->mutable__();
+	for (auto pair : map) {
+		auto key = protocache::FieldT<protocache::Slice<char>>(pair.Key()).Get(end);
+		if (!key) {
+			return false;
+		}
+		auto& value = dict[std::string(key.data(), key.size())];
+		if (!ToProtobuf(pair.Value().GetObject(end), end, &value)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::Main* out) {
+	protocache::Message message(data, end);
+	if (!message) {
+		return false;
+	}
+	if (auto field = message.GetField(0, end); !!field) {
+		out->set_i32(protocache::FieldT<int32_t>(field).Get(end));
+	}
+	if (auto field = message.GetField(1, end); !!field) {
+		out->set_u32(protocache::FieldT<uint32_t>(field).Get(end));
+	}
+	if (auto field = message.GetField(2, end); !!field) {
+		out->set_i64(protocache::FieldT<int64_t>(field).Get(end));
+	}
+	if (auto field = message.GetField(3, end); !!field) {
+		out->set_u64(protocache::FieldT<uint64_t>(field).Get(end));
+	}
+	if (auto field = message.GetField(4, end); !!field) {
+		out->set_flag(protocache::FieldT<bool>(field).Get(end));
+	}
+	if (auto field = message.GetField(5, end); !!field) {
+		out->set_mode(static_cast<::test::Mode>(protocache::FieldT<protocache::EnumValue>(field).Get(end)));
+	}
+	if (auto field = message.GetField(6, end); !!field) {
+		auto v = protocache::FieldT<protocache::Slice<char>>(field).Get(end);
+		if (!v) {
+			return false;
+		}
+		out->mutable_str()->assign(v.data(), v.size());
+	}
+	if (auto field = message.GetField(7, end); !!field) {
+		auto v = protocache::FieldT<protocache::Slice<char>>(field).Get(end);
+		if (!v) {
+			return false;
+		}
+		out->mutable_data()->assign(v.data(), v.size());
+	}
+	if (auto field = message.GetField(8, end); !!field) {
+		out->set_f32(protocache::FieldT<float>(field).Get(end));
+	}
+	if (auto field = message.GetField(9, end); !!field) {
+		out->set_f64(protocache::FieldT<double>(field).Get(end));
+	}
+	if (auto field = message.GetField(10, end); !!field) {
+		if (!ToProtobuf(field.GetObject(end), end, out->mutable_object())) {
+			return false;
+		}
+	}
+	if (auto field = message.GetField(11, end); !!field) {
+		protocache::ArrayT<int32_t> array(field.GetObject(end), end);
+		if (!array) {
+			return false;
+		}
+		out->mutable_i32v()->Add(array.begin(), array.end());
+	}
+	if (auto field = message.GetField(12, end); !!field) {
+		protocache::ArrayT<uint64_t> array(field.GetObject(end), end);
+		if (!array) {
+			return false;
+		}
+		out->mutable_u64v()->Add(array.begin(), array.end());
+	}
+	if (auto field = message.GetField(13, end); !!field) {
+		protocache::ArrayT<protocache::Slice<char>> array(field.GetObject(end), end);
+		if (!array) {
+			return false;
+		}
+		auto list = out->mutable_strv();
+		list->Reserve(list->size() + array.Size());
+		for (auto one : array) {
+			if (!one) {
+				return false;
+			}
+			list->Add()->assign(one.data(), one.size());
+		}
+	}
+	if (auto field = message.GetField(14, end); !!field) {
+		protocache::ArrayT<protocache::Slice<char>> array(field.GetObject(end), end);
+		if (!array) {
+			return false;
+		}
+		auto list = out->mutable_datav();
+		list->Reserve(list->size() + array.Size());
+		for (auto one : array) {
+			if (!one) {
+				return false;
+			}
+			list->Add()->assign(one.data(), one.size());
+		}
+	}
+	if (auto field = message.GetField(15, end); !!field) {
+		protocache::ArrayT<float> array(field.GetObject(end), end);
+		if (!array) {
+			return false;
+		}
+		out->mutable_f32v()->Add(array.begin(), array.end());
+	}
+	if (auto field = message.GetField(16, end); !!field) {
+		protocache::ArrayT<double> array(field.GetObject(end), end);
+		if (!array) {
+			return false;
+		}
+		out->mutable_f64v()->Add(array.begin(), array.end());
+	}
+	if (auto field = message.GetField(17, end); !!field) {
+		protocache::ArrayT<bool> array(field.GetObject(end), end);
+		if (!array) {
+			return false;
+		}
+		out->mutable_flags()->Add(array.begin(), array.end());
+	}
+	if (auto field = message.GetField(18, end); !!field) {
+		protocache::Array array(field.GetObject(end), end);
+		if (!array) {
+			return false;
+		}
+		auto list = out->mutable_objectv();
+		list->Reserve(list->size() + array.Size());
+		for (auto one : array) {
+			if (!ToProtobuf(one.GetObject(end), end, list->Add())) {
+				return false;
+			}
+		}
+	}
+	if (auto field = message.GetField(19, end); !!field) {
+		out->set_t_u32(protocache::FieldT<uint32_t>(field).Get(end));
+	}
+	if (auto field = message.GetField(20, end); !!field) {
+		out->set_t_i32(protocache::FieldT<int32_t>(field).Get(end));
+	}
+	if (auto field = message.GetField(21, end); !!field) {
+		out->set_t_s32(protocache::FieldT<int32_t>(field).Get(end));
+	}
+	if (auto field = message.GetField(22, end); !!field) {
+		out->set_t_u64(protocache::FieldT<uint64_t>(field).Get(end));
+	}
+	if (auto field = message.GetField(23, end); !!field) {
+		out->set_t_i64(protocache::FieldT<int64_t>(field).Get(end));
+	}
+	if (auto field = message.GetField(24, end); !!field) {
+		out->set_t_s64(protocache::FieldT<int64_t>(field).Get(end));
+	}
+	if (auto field = message.GetField(25, end); !!field) {
+		protocache::Map map(field.GetObject(end), end);
+		if (!map) {
+			return false;
+		}
+		auto& dict = *out->mutable_index();
+		for (auto pair : map) {
+			auto key = protocache::FieldT<protocache::Slice<char>>(pair.Key()).Get(end);
+			if (!key) {
+				return false;
+			}
+			auto& value = dict[std::string(key.data(), key.size())];
+			value = protocache::FieldT<int32_t>(pair.Value()).Get(end);
+		}
+	}
+	if (auto field = message.GetField(26, end); !!field) {
+		protocache::Map map(field.GetObject(end), end);
+		if (!map) {
+			return false;
+		}
+		auto& dict = *out->mutable_objects();
+		for (auto pair : map) {
+			auto& value = dict[protocache::FieldT<int32_t>(pair.Key()).Get(end)];
+			if (!ToProtobuf(pair.Value().GetObject(end), end, &value)) {
+				return false;
+			}
+		}
+	}
+	if (auto field = message.GetField(27, end); !!field) {
+		if (!ToProtobuf(field.GetObject(end), end, out->mutable_matrix())) {
+			return false;
+		}
+	}
+	if (auto field = message.GetField(28, end); !!field) {
+		protocache::Array array(field.GetObject(end), end);
+		if (!array) {
+			return false;
+		}
+		auto list = out->mutable_vector();
+		list->Reserve(list->size() + array.Size());
+		for (auto one : array) {
+			if (!ToProtobuf(one.GetObject(end), end, list->Add())) {
+				return false;
+			}
+		}
+	}
+	if (auto field = message.GetField(29, end); !!field) {
+		if (!ToProtobuf(field.GetObject(end), end, out->mutable_arrays())) {
+			return false;
+		}
+	}
+	if (auto field = message.GetField(31, end); !!field) {
+		protocache::ArrayT<protocache::EnumValue> array(field.GetObject(end), end);
+		if (!array) {
+			return false;
+		}
+		out->mutable_modev()->Add(array.begin(), array.end());
+	}
+	return true;
+}
+
+inline bool ToProtobuf(const protocache::Slice<uint32_t>& data, ::test::Main* out) {
+	out->Clear();
+	return ToProtobuf(data.data(), data.end(), out);
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::CyclicA* out) {
+	protocache::Message message(data, end);
+	if (!message) {
+		return false;
+	}
+	if (auto field = message.GetField(0, end); !!field) {
+		out->set_value(protocache::FieldT<int32_t>(field).Get(end));
+	}
+	if (auto field = message.GetField(1, end); !!field) {
+		if (!ToProtobuf(field.GetObject(end), end, out->mutable_cyclic())) {
+			return false;
+		}
+	}
+	return true;
+}
+
+inline bool ToProtobuf(const protocache::Slice<uint32_t>& data, ::test::CyclicA* out) {
+	out->Clear();
+	return ToProtobuf(data.data(), data.end(), out);
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::CyclicB* out) {
+	protocache::Message message(data, end);
+	if (!message) {
+		return false;
+	}
+	if (auto field = message.GetField(0, end); !!field) {
+		out->set_value(protocache::FieldT<int32_t>(field).Get(end));
+	}
+	if (auto field = message.GetField(1, end); !!field) {
+		if (!ToProtobuf(field.GetObject(end), end, out->mutable_cyclic())) {
+			return false;
+		}
+	}
+	return true;
+}
+
+inline bool ToProtobuf(const protocache::Slice<uint32_t>& data, ::test::CyclicB* out) {
+	out->Clear();
+	return ToProtobuf(data.data(), data.end(), out);
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::Deprecated::Valid* out) {
+	protocache::Message message(data, end);
+	if (!message) {
+		return false;
+	}
+	if (auto field = message.GetField(0, end); !!field) {
+		out->set_val(protocache::FieldT<int32_t>(field).Get(end));
+	}
+	return true;
+}
+
+inline bool ToProtobuf(const protocache::Slice<uint32_t>& data, ::test::Deprecated::Valid* out) {
+	out->Clear();
+	return ToProtobuf(data.data(), data.end(), out);
+}
+
+inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, ::test::Deprecated* out) {
+	protocache::Message message(data, end);
+	if (!message) {
+		return false;
+	}
+	(void)out;
+	return true;
+}
+
+inline bool ToProtobuf(const protocache::Slice<uint32_t>& data, ::test::Deprecated* out) {
+	out->Clear();
+	return ToProtobuf(data.data(), data.end(), out);
+}
+
+} // test
+#endif // PROTOCACHE_INCLUDED_PB_test_proto
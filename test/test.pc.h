@@ -3,6 +3,7 @@
 #define PROTOCACHE_INCLUDED_test_proto
 
 #include <protocache/access.h>
+#include <protocache/builder.h>
 
 namespace test {
 
@@ -41,6 +42,35 @@ public:
 		return view;
 	}
 
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0,
+			protocache::VerifyMarks* marks=nullptr) {
+		if (depth >= protocache::kVerifyDepthLimit || !protocache::Message::Verify(ptr, end)) return false;
+		protocache::Message core(ptr, end);
+		if (!protocache::VerifyField<int32_t>(core, _::i32, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<bool>(core, _::flag, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<protocache::Slice<char>>(core, _::str, end, depth+1, marks)) return false;
+		return true;
+	}
+
+	static bool Project(const uint32_t* ptr, const uint32_t* end, const protocache::FieldTree& tree, unsigned node,
+			protocache::Buffer& buf, protocache::Unit& unit) {
+		protocache::Message core(ptr, end);
+		if (!core) return false;
+		return protocache::ProjectMessage(core, end, tree, node, buf, unit,
+				[&core, end, &buf](unsigned id, unsigned, protocache::Unit& one) {
+			switch (id) {
+				case _::i32:
+					return protocache::CopyField<int32_t>(core, id, end, buf, one);
+				case _::flag:
+					return protocache::CopyField<bool>(core, id, end, buf, one);
+				case _::str:
+					return protocache::CopyField<protocache::Slice<char>>(core, id, end, buf, one);
+				default:
+					return false;
+			}
+		});
+	}
+
 	int32_t i32(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<int32_t>(protocache::Message::Cast(this), _::i32, end);
 	}
@@ -50,22 +80,34 @@ public:
 	protocache::Slice<char> str(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<protocache::Slice<char>>(protocache::Message::Cast(this), _::str, end);
 	}
+	bool set_i32_inplace(int32_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::i32, val, end);
+	}
+	bool set_flag_inplace(bool val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::flag, val, end);
+	}
+
+	class Builder;
 };
 
 struct Vec2D final {
 	struct Vec1D final {
 		using ALIAS = protocache::ArrayT<float>;
+		class Builder;
 	};
 
 	using ALIAS = protocache::ArrayT<::test::Vec2D::Vec1D::ALIAS>;
+	class Builder;
 };
 
 struct ArrMap final {
 	struct Array final {
 		using ALIAS = protocache::ArrayT<float>;
+		class Builder;
 	};
 
 	using ALIAS = protocache::MapT<protocache::Slice<char>,::test::ArrMap::Array::ALIAS>;
+	class Builder;
 };
 
 class Main final {
@@ -151,6 +193,125 @@ public:
 		return view;
 	}
 
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0,
+			protocache::VerifyMarks* marks=nullptr) {
+		if (depth >= protocache::kVerifyDepthLimit || !protocache::Message::Verify(ptr, end)) return false;
+		protocache::VerifyMarks local;
+		if (marks == nullptr) marks = &local;
+		if (!marks->Mark<Main>(ptr)) return true;
+		protocache::Message core(ptr, end);
+		if (!protocache::VerifyField<int32_t>(core, _::i32, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<uint32_t>(core, _::u32, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<int64_t>(core, _::i64, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<uint64_t>(core, _::u64, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<bool>(core, _::flag, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<protocache::EnumValue>(core, _::mode, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<protocache::Slice<char>>(core, _::str, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<protocache::Slice<uint8_t>>(core, _::data, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<float>(core, _::f32, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<double>(core, _::f64, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<const ::test::Small*>(core, _::object, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<protocache::ArrayT<int32_t>>(core, _::i32v, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<protocache::ArrayT<uint64_t>>(core, _::u64v, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<protocache::ArrayT<protocache::Slice<char>>>(core, _::strv, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<protocache::ArrayT<protocache::Slice<uint8_t>>>(core, _::datav, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<protocache::ArrayT<float>>(core, _::f32v, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<protocache::ArrayT<double>>(core, _::f64v, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<protocache::ArrayT<bool>>(core, _::flags, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<protocache::ArrayT<const ::test::Small*>>(core, _::objectv, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<uint32_t>(core, _::t_u32, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<int32_t>(core, _::t_i32, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<int32_t>(core, _::t_s32, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<uint64_t>(core, _::t_u64, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<int64_t>(core, _::t_i64, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<int64_t>(core, _::t_s64, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<protocache::MapT<protocache::Slice<char>,int32_t>>(core, _::index, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<protocache::MapT<int32_t,const ::test::Small*>>(core, _::objects, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<::test::Vec2D::ALIAS>(core, _::matrix, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<protocache::ArrayT<::test::ArrMap::ALIAS>>(core, _::vector, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<::test::ArrMap::ALIAS>(core, _::arrays, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<protocache::ArrayT<protocache::EnumValue>>(core, _::modev, end, depth+1, marks)) return false;
+		return true;
+	}
+
+	static bool Project(const uint32_t* ptr, const uint32_t* end, const protocache::FieldTree& tree, unsigned node,
+			protocache::Buffer& buf, protocache::Unit& unit) {
+		protocache::Message core(ptr, end);
+		if (!core) return false;
+		return protocache::ProjectMessage(core, end, tree, node, buf, unit,
+				[&core, end, &tree, &buf](unsigned id, unsigned sub, protocache::Unit& one) {
+			switch (id) {
+				case _::i32:
+					return protocache::CopyField<int32_t>(core, id, end, buf, one);
+				case _::u32:
+					return protocache::CopyField<uint32_t>(core, id, end, buf, one);
+				case _::i64:
+					return protocache::CopyField<int64_t>(core, id, end, buf, one);
+				case _::u64:
+					return protocache::CopyField<uint64_t>(core, id, end, buf, one);
+				case _::flag:
+					return protocache::CopyField<bool>(core, id, end, buf, one);
+				case _::mode:
+					return protocache::CopyField<protocache::EnumValue>(core, id, end, buf, one);
+				case _::str:
+					return protocache::CopyField<protocache::Slice<char>>(core, id, end, buf, one);
+				case _::data:
+					return protocache::CopyField<protocache::Slice<uint8_t>>(core, id, end, buf, one);
+				case _::f32:
+					return protocache::CopyField<float>(core, id, end, buf, one);
+				case _::f64:
+					return protocache::CopyField<double>(core, id, end, buf, one);
+				case _::object:
+					if (sub != protocache::FieldTree::kWhole) {
+						return protocache::ProjectField<::test::Small>(core, id, end, tree, sub, buf, one);
+					}
+					return protocache::CopyField<const ::test::Small*>(core, id, end, buf, one);
+				case _::i32v:
+					return protocache::CopyField<protocache::ArrayT<int32_t>>(core, id, end, buf, one);
+				case _::u64v:
+					return protocache::CopyField<protocache::ArrayT<uint64_t>>(core, id, end, buf, one);
+				case _::strv:
+					return protocache::CopyField<protocache::ArrayT<protocache::Slice<char>>>(core, id, end, buf, one);
+				case _::datav:
+					return protocache::CopyField<protocache::ArrayT<protocache::Slice<uint8_t>>>(core, id, end, buf, one);
+				case _::f32v:
+					return protocache::CopyField<protocache::ArrayT<float>>(core, id, end, buf, one);
+				case _::f64v:
+					return protocache::CopyField<protocache::ArrayT<double>>(core, id, end, buf, one);
+				case _::flags:
+					return protocache::CopyField<protocache::ArrayT<bool>>(core, id, end, buf, one);
+				case _::objectv:
+					return protocache::CopyField<protocache::ArrayT<const ::test::Small*>>(core, id, end, buf, one);
+				case _::t_u32:
+					return protocache::CopyField<uint32_t>(core, id, end, buf, one);
+				case _::t_i32:
+					return protocache::CopyField<int32_t>(core, id, end, buf, one);
+				case _::t_s32:
+					return protocache::CopyField<int32_t>(core, id, end, buf, one);
+				case _::t_u64:
+					return protocache::CopyField<uint64_t>(core, id, end, buf, one);
+				case _::t_i64:
+					return protocache::CopyField<int64_t>(core, id, end, buf, one);
+				case _::t_s64:
+					return protocache::CopyField<int64_t>(core, id, end, buf, one);
+				case _::index:
+					return protocache::CopyField<protocache::MapT<protocache::Slice<char>,int32_t>>(core, id, end, buf, one);
+				case _::objects:
+					return protocache::CopyField<protocache::MapT<int32_t,const ::test::Small*>>(core, id, end, buf, one);
+				case _::matrix:
+					return protocache::CopyField<::test::Vec2D::ALIAS>(core, id, end, buf, one);
+				case _::vector:
+					return protocache::CopyField<protocache::ArrayT<::test::ArrMap::ALIAS>>(core, id, end, buf, one);
+				case _::arrays:
+					return protocache::CopyField<::test::ArrMap::ALIAS>(core, id, end, buf, one);
+				case _::modev:
+					return protocache::CopyField<protocache::ArrayT<protocache::EnumValue>>(core, id, end, buf, one);
+				default:
+					return false;
+			}
+		});
+	}
+
 	int32_t i32(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<int32_t>(protocache::Message::Cast(this), _::i32, end);
 	}
@@ -244,6 +405,65 @@ public:
 	protocache::ArrayT<protocache::EnumValue> modev(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<protocache::ArrayT<protocache::EnumValue>>(protocache::Message::Cast(this), _::modev, end);
 	}
+	bool set_i32_inplace(int32_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::i32, val, end);
+	}
+	bool set_u32_inplace(uint32_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::u32, val, end);
+	}
+	bool set_i64_inplace(int64_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::i64, val, end);
+	}
+	bool set_u64_inplace(uint64_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::u64, val, end);
+	}
+	bool set_flag_inplace(bool val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::flag, val, end);
+	}
+	bool set_mode_inplace(protocache::EnumValue val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::mode, val, end);
+	}
+	bool set_f32_inplace(float val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::f32, val, end);
+	}
+	bool set_f64_inplace(double val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::f64, val, end);
+	}
+	bool set_i32v_inplace(uint32_t pos, int32_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).SetElement(_::i32v, pos, val, end);
+	}
+	bool set_u64v_inplace(uint32_t pos, uint64_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).SetElement(_::u64v, pos, val, end);
+	}
+	bool set_f32v_inplace(uint32_t pos, float val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).SetElement(_::f32v, pos, val, end);
+	}
+	bool set_f64v_inplace(uint32_t pos, double val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).SetElement(_::f64v, pos, val, end);
+	}
+	bool set_t_u32_inplace(uint32_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::t_u32, val, end);
+	}
+	bool set_t_i32_inplace(int32_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::t_i32, val, end);
+	}
+	bool set_t_s32_inplace(int32_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::t_s32, val, end);
+	}
+	bool set_t_u64_inplace(uint64_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::t_u64, val, end);
+	}
+	bool set_t_i64_inplace(int64_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::t_i64, val, end);
+	}
+	bool set_t_s64_inplace(int64_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::t_s64, val, end);
+	}
+	bool set_modev_inplace(uint32_t pos, protocache::EnumValue val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).SetElement(_::modev, pos, val, end);
+	}
+
+	class Builder;
 };
 
 class CyclicA final {
@@ -268,12 +488,49 @@ public:
 		return view;
 	}
 
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0,
+			protocache::VerifyMarks* marks=nullptr) {
+		if (depth >= protocache::kVerifyDepthLimit || !protocache::Message::Verify(ptr, end)) return false;
+		protocache::VerifyMarks local;
+		if (marks == nullptr) marks = &local;
+		if (!marks->Mark<CyclicA>(ptr)) return true;
+		protocache::Message core(ptr, end);
+		if (!protocache::VerifyField<int32_t>(core, _::value, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<const ::test::CyclicB*>(core, _::cyclic, end, depth+1, marks)) return false;
+		return true;
+	}
+
+	static bool Project(const uint32_t* ptr, const uint32_t* end, const protocache::FieldTree& tree, unsigned node,
+			protocache::Buffer& buf, protocache::Unit& unit) {
+		protocache::Message core(ptr, end);
+		if (!core) return false;
+		return protocache::ProjectMessage(core, end, tree, node, buf, unit,
+				[&core, end, &tree, &buf](unsigned id, unsigned sub, protocache::Unit& one) {
+			switch (id) {
+				case _::value:
+					return protocache::CopyField<int32_t>(core, id, end, buf, one);
+				case _::cyclic:
+					if (sub != protocache::FieldTree::kWhole) {
+						return protocache::ProjectField<::test::CyclicB>(core, id, end, tree, sub, buf, one);
+					}
+					return protocache::CopyField<const ::test::CyclicB*>(core, id, end, buf, one);
+				default:
+					return false;
+			}
+		});
+	}
+
 	int32_t value(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<int32_t>(protocache::Message::Cast(this), _::value, end);
 	}
 	const ::test::CyclicB* cyclic(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<const ::test::CyclicB*>(protocache::Message::Cast(this), _::cyclic, end);
 	}
+	bool set_value_inplace(int32_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::value, val, end);
+	}
+
+	class Builder;
 };
 
 class CyclicB final {
@@ -298,12 +555,49 @@ public:
 		return view;
 	}
 
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0,
+			protocache::VerifyMarks* marks=nullptr) {
+		if (depth >= protocache::kVerifyDepthLimit || !protocache::Message::Verify(ptr, end)) return false;
+		protocache::VerifyMarks local;
+		if (marks == nullptr) marks = &local;
+		if (!marks->Mark<CyclicB>(ptr)) return true;
+		protocache::Message core(ptr, end);
+		if (!protocache::VerifyField<int32_t>(core, _::value, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<const ::test::CyclicA*>(core, _::cyclic, end, depth+1, marks)) return false;
+		return true;
+	}
+
+	static bool Project(const uint32_t* ptr, const uint32_t* end, const protocache::FieldTree& tree, unsigned node,
+			protocache::Buffer& buf, protocache::Unit& unit) {
+		protocache::Message core(ptr, end);
+		if (!core) return false;
+		return protocache::ProjectMessage(core, end, tree, node, buf, unit,
+				[&core, end, &tree, &buf](unsigned id, unsigned sub, protocache::Unit& one) {
+			switch (id) {
+				case _::value:
+					return protocache::CopyField<int32_t>(core, id, end, buf, one);
+				case _::cyclic:
+					if (sub != protocache::FieldTree::kWhole) {
+						return protocache::ProjectField<::test::CyclicA>(core, id, end, tree, sub, buf, one);
+					}
+					return protocache::CopyField<const ::test::CyclicA*>(core, id, end, buf, one);
+				default:
+					return false;
+			}
+		});
+	}
+
 	int32_t value(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<int32_t>(protocache::Message::Cast(this), _::value, end);
 	}
 	const ::test::CyclicA* cyclic(const uint32_t* end=nullptr) const noexcept {
 		return protocache::GetField<const ::test::CyclicA*>(protocache::Message::Cast(this), _::cyclic, end);
 	}
+	bool set_value_inplace(int32_t val, const uint32_t* end=nullptr) noexcept {
+		return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::value, val, end);
+	}
+
+	class Builder;
 };
 
 struct Deprecated final {
@@ -328,11 +622,143 @@ struct Deprecated final {
 			return view;
 		}
 
+		static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0,
+				protocache::VerifyMarks* marks=nullptr) {
+			if (depth >= protocache::kVerifyDepthLimit || !protocache::Message::Verify(ptr, end)) return false;
+			protocache::Message core(ptr, end);
+			if (!protocache::VerifyField<int32_t>(core, _::val, end, depth+1, marks)) return false;
+			return true;
+		}
+
+		static bool Project(const uint32_t* ptr, const uint32_t* end, const protocache::FieldTree& tree, unsigned node,
+				protocache::Buffer& buf, protocache::Unit& unit) {
+			protocache::Message core(ptr, end);
+			if (!core) return false;
+			return protocache::ProjectMessage(core, end, tree, node, buf, unit,
+					[&core, end, &buf](unsigned id, unsigned, protocache::Unit& one) {
+				switch (id) {
+					case _::val:
+						return protocache::CopyField<int32_t>(core, id, end, buf, one);
+					default:
+						return false;
+				}
+			});
+		}
+
 		int32_t val(const uint32_t* end=nullptr) const noexcept {
 			return protocache::GetField<int32_t>(protocache::Message::Cast(this), _::val, end);
 		}
+		bool set_val_inplace(int32_t val, const uint32_t* end=nullptr) noexcept {
+			return protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::val, val, end);
+		}
+
+		class Builder;
 	};
 
+	class Builder;
+};
+
+class Small::Builder final : public protocache::MessageBuilder<4> {
+public:
+	using MessageBuilder::MessageBuilder;
+	void i32(int32_t v) { SetScalar(_::i32, v); }
+	void flag(bool v) { SetScalar(_::flag, v); }
+	template <typename S>
+	void str(const S& v) { SetString(_::str, protocache::StringOf(v)); }
+};
+
+class Vec2D::Vec1D::Builder final : public protocache::ScalarArrayBuilder<float> {
+public:
+	using protocache::ScalarArrayBuilder<float>::ScalarArrayBuilder;
+};
+
+class Vec2D::Builder final : public protocache::ArrayBuilder<::test::Vec2D::Vec1D::Builder> {
+public:
+	using protocache::ArrayBuilder<::test::Vec2D::Vec1D::Builder>::ArrayBuilder;
+};
+
+class ArrMap::Array::Builder final : public protocache::ScalarArrayBuilder<float> {
+public:
+	using protocache::ScalarArrayBuilder<float>::ScalarArrayBuilder;
+};
+
+class ArrMap::Builder final : public protocache::MessageMapBuilder<protocache::Slice<char>,::test::ArrMap::Array::Builder> {
+public:
+	using protocache::MessageMapBuilder<protocache::Slice<char>,::test::ArrMap::Array::Builder>::MessageMapBuilder;
+};
+
+class Main::Builder final : public protocache::MessageBuilder<32> {
+public:
+	using MessageBuilder::MessageBuilder;
+	void i32(int32_t v) { SetScalar(_::i32, v); }
+	void u32(uint32_t v) { SetScalar(_::u32, v); }
+	void i64(int64_t v) { SetScalar(_::i64, v); }
+	void u64(uint64_t v) { SetScalar(_::u64, v); }
+	void flag(bool v) { SetScalar(_::flag, v); }
+	void mode(protocache::EnumValue v) { SetScalar(_::mode, v); }
+	template <typename S>
+	void str(const S& v) { SetString(_::str, protocache::StringOf(v)); }
+	template <typename S>
+	void data(const S& v) { SetString(_::data, protocache::StringOf(v)); }
+	void f32(float v) { SetScalar(_::f32, v); }
+	void f64(double v) { SetScalar(_::f64, v); }
+	template <typename F>
+	void object(F&& fill) { SetBy<::test::Small::Builder>(_::object, fill); }
+	void i32v(const protocache::Slice<int32_t>& v) { SetArray(_::i32v, v); }
+	void u64v(const protocache::Slice<uint64_t>& v) { SetArray(_::u64v, v); }
+	template <typename L>
+	void strv(const L& list) { SetStrings(_::strv, list); }
+	template <typename L>
+	void datav(const L& list) { SetStrings(_::datav, list); }
+	void f32v(const protocache::Slice<float>& v) { SetArray(_::f32v, v); }
+	void f64v(const protocache::Slice<double>& v) { SetArray(_::f64v, v); }
+	void flags(const protocache::Slice<bool>& v) { SetArray(_::flags, v); }
+	template <typename F>
+	void objectv(size_t n, F&& fill) { SetArrayBy<::test::Small::Builder>(_::objectv, n, fill); }
+	void t_u32(uint32_t v) { SetScalar(_::t_u32, v); }
+	void t_i32(int32_t v) { SetScalar(_::t_i32, v); }
+	void t_s32(int32_t v) { SetScalar(_::t_s32, v); }
+	void t_u64(uint64_t v) { SetScalar(_::t_u64, v); }
+	void t_i64(int64_t v) { SetScalar(_::t_i64, v); }
+	void t_s64(int64_t v) { SetScalar(_::t_s64, v); }
+	template <typename L, typename F>
+	void index(const L& keys, F&& value) { SetMap<protocache::Slice<char>,int32_t>(_::index, keys, value); }
+	template <typename L, typename F>
+	void objects(const L& keys, F&& fill) { SetMapBy<int32_t,::test::Small::Builder>(_::objects, keys, fill); }
+	template <typename F>
+	void matrix(F&& fill) { SetBy<::test::Vec2D::Builder>(_::matrix, fill); }
+	template <typename F>
+	void vector(size_t n, F&& fill) { SetArrayBy<::test::ArrMap::Builder>(_::vector, n, fill); }
+	template <typename F>
+	void arrays(F&& fill) { SetBy<::test::ArrMap::Builder>(_::arrays, fill); }
+	void modev(const protocache::Slice<protocache::EnumValue>& v) { SetArray(_::modev, v); }
+};
+
+class CyclicA::Builder final : public protocache::MessageBuilder<2> {
+public:
+	using MessageBuilder::MessageBuilder;
+	void value(int32_t v) { SetScalar(_::value, v); }
+	template <typename F>
+	void cyclic(F&& fill) { SetBy<::test::CyclicB::Builder>(_::cyclic, fill); }
+};
+
+class CyclicB::Builder final : public protocache::MessageBuilder<2> {
+public:
+	using MessageBuilder::MessageBuilder;
+	void value(int32_t v) { SetScalar(_::value, v); }
+	template <typename F>
+	void cyclic(F&& fill) { SetBy<::test::CyclicA::Builder>(_::cyclic, fill); }
+};
+
+class Deprecated::Valid::Builder final : public protocache::MessageBuilder<1> {
+public:
+	using MessageBuilder::MessageBuilder;
+	void val(int32_t v) { SetScalar(_::val, v); }
+};
+
+class Deprecated::Builder final : public protocache::MessageBuilder<1> {
+public:
+	using MessageBuilder::MessageBuilder;
 };
 
 } // test
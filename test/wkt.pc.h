@@ -0,0 +1,117 @@
+#pragma once
+#ifndef PROTOCACHE_INCLUDED_wkt_proto
+#define PROTOCACHE_INCLUDED_wkt_proto
+
+#include <protocache/access.h>
+#include <protocache/builder.h>
+#include <protocache/protobuf/timestamp.pc.h>
+#include <protocache/protobuf/wrappers.pc.h>
+
+namespace test {
+namespace wkt {
+
+class Event;
+
+class Event final {
+private:
+	Event() = default;
+public:
+	struct _ {
+		static constexpr unsigned name = 0;
+		static constexpr unsigned time = 1;
+		static constexpr unsigned count = 2;
+		static constexpr unsigned tags = 3;
+	};
+
+	bool operator!() const noexcept { return !protocache::Message::Cast(this); }
+	bool HasField(unsigned id, const uint32_t* end=nullptr) const noexcept { return protocache::Message::Cast(this).HasField(id,end); }
+
+	static protocache::Slice<uint32_t> Detect(const uint32_t* ptr, const uint32_t* end=nullptr) {
+		auto view = protocache::Message::Detect(ptr, end);
+		if (!view) return {};
+		protocache::Message core(ptr, end);
+		protocache::Slice<uint32_t> t;
+		t = protocache::DetectField<protocache::ArrayT<const ::google::protobuf::StringValue*>>(core, _::tags, end);
+		if (t.end() > view.end()) return {view.data(), static_cast<size_t>(t.end()-view.data())};
+		t = protocache::DetectField<const ::google::protobuf::Int32Value*>(core, _::count, end);
+		if (t.end() > view.end()) return {view.data(), static_cast<size_t>(t.end()-view.data())};
+		t = protocache::DetectField<const ::google::protobuf::Timestamp*>(core, _::time, end);
+		if (t.end() > view.end()) return {view.data(), static_cast<size_t>(t.end()-view.data())};
+		t = protocache::DetectField<protocache::Slice<char>>(core, _::name, end);
+		if (t.end() > view.end()) return {view.data(), static_cast<size_t>(t.end()-view.data())};
+		return view;
+	}
+
+	static bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0,
+			protocache::VerifyMarks* marks=nullptr) {
+		if (depth >= protocache::kVerifyDepthLimit || !protocache::Message::Verify(ptr, end)) return false;
+		protocache::VerifyMarks local;
+		if (marks == nullptr) marks = &local;
+		if (!marks->Mark<Event>(ptr)) return true;
+		protocache::Message core(ptr, end);
+		if (!protocache::VerifyField<protocache::Slice<char>>(core, _::name, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<const ::google::protobuf::Timestamp*>(core, _::time, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<const ::google::protobuf::Int32Value*>(core, _::count, end, depth+1, marks)) return false;
+		if (!protocache::VerifyField<protocache::ArrayT<const ::google::protobuf::StringValue*>>(core, _::tags, end, depth+1, marks)) return false;
+		return true;
+	}
+
+	static bool Project(const uint32_t* ptr, const uint32_t* end, const protocache::FieldTree& tree, unsigned node,
+			protocache::Buffer& buf, protocache::Unit& unit) {
+		protocache::Message core(ptr, end);
+		if (!core) return false;
+		return protocache::ProjectMessage(core, end, tree, node, buf, unit,
+				[&core, end, &tree, &buf](unsigned id, unsigned sub, protocache::Unit& one) {
+			switch (id) {
+				case _::name:
+					return protocache::CopyField<protocache::Slice<char>>(core, id, end, buf, one);
+				case _::time:
+					if (sub != protocache::FieldTree::kWhole) {
+						return protocache::ProjectField<::google::protobuf::Timestamp>(core, id, end, tree, sub, buf, one);
+					}
+					return protocache::CopyField<const ::google::protobuf::Timestamp*>(core, id, end, buf, one);
+				case _::count:
+					if (sub != protocache::FieldTree::kWhole) {
+						return protocache::ProjectField<::google::protobuf::Int32Value>(core, id, end, tree, sub, buf, one);
+					}
+					return protocache::CopyField<const ::google::protobuf::Int32Value*>(core, id, end, buf, one);
+				case _::tags:
+					return protocache::CopyField<protocache::ArrayT<const ::google::protobuf::StringValue*>>(core, id, end, buf, one);
+				default:
+					return false;
+			}
+		});
+	}
+
+	protocache::Slice<char> name(const uint32_t* end=nullptr) const noexcept {
+		return protocache::GetField<protocache::Slice<char>>(protocache::Message::Cast(this), _::name, end);
+	}
+	const ::google::protobuf::Timestamp* time(const uint32_t* end=nullptr) const noexcept {
+		return protocache::GetField<const ::google::protobuf::Timestamp*>(protocache::Message::Cast(this), _::time, end);
+	}
+	const ::google::protobuf::Int32Value* count(const uint32_t* end=nullptr) const noexcept {
+		return protocache::GetField<const ::google::protobuf::Int32Value*>(protocache::Message::Cast(this), _::count, end);
+	}
+	protocache::ArrayT<const ::google::protobuf::StringValue*> tags(const uint32_t* end=nullptr) const noexcept {
+		return protocache::GetField<protocache::ArrayT<const ::google::protobuf::StringValue*>>(protocache::Message::Cast(this), _::tags, end);
+	}
+
+	class Builder;
+};
+
+class Event::Builder final : public protocache::MessageBuilder<4> {
+public:
+	using MessageBuilder::MessageBuilder;
+	template <typename S>
+	void name(const S& v) { SetString(_::name, protocache::StringOf(v)); }
+	template <typename F>
+	void time(F&& fill) { SetBy<::google::protobuf::Timestamp::Builder>(_::time, fill); }
+	template <typename F>
+	void count(F&& fill) { SetBy<::google::protobuf::Int32Value::Builder>(_::count, fill); }
+	template <typename F>
+	void tags(size_t n, F&& fill) { SetArrayBy<::google::protobuf::StringValue::Builder>(_::tags, n, fill); }
+};
+
+} // wkt
+} // test
+#endif // PROTOCACHE_INCLUDED_wkt_proto
@@ -15,6 +15,7 @@ DEFINE_string(schema, "schema.proto", "schema file");
 DEFINE_string(root, "", "root message name");
 DEFINE_bool(flat, true, "input protocache binary instead of protobuf binary");
 DEFINE_bool(decompress, false, "decompress flat binary");
+DEFINE_string(dictionary, "", "decompress flat binary with zstd and dictionary from train-dictionary");
 
 int main(int argc, char* argv[]) {
 	google::ParseCommandLineFlags(&argc, &argv, true);
@@ -49,21 +50,38 @@ int main(int argc, char* argv[]) {
 	std::unique_ptr<google::protobuf::Message> message(prototype->New());
 
 	std::string raw;
-	if (!protocache::LoadFile(FLAGS_input, &raw)) {
+	if (FLAGS_flat && !FLAGS_decompress && FLAGS_dictionary.empty()) {
+		auto file = protocache::MappedFile::Open(FLAGS_input);
+		if (!file) {
+			std::cerr << "fail to load binary: " << FLAGS_input << std::endl;
+			return -3;
+		}
+		if (!protocache::Deserialize(file.View(), message.get())) {
+			std::cerr << "fail to deserialize" << std::endl;
+			return -4;
+		}
+	} else if (!protocache::LoadFile(FLAGS_input, &raw)) {
 		std::cerr << "fail to load binary: " << FLAGS_input << std::endl;
 		return -3;
-	}
-
-	if (FLAGS_flat) {
-		if (FLAGS_decompress) {
-			std::string tmp = std::move(raw);
-			if (!protocache::Decompress(tmp, &raw)) {
-				std::cerr << "fail to decompress" << std::endl;
+	} else if (FLAGS_flat) {
+		protocache::Buffer buf;
+		if (!FLAGS_dictionary.empty()) {
+			std::string dict_data;
+			if (!protocache::LoadFile(FLAGS_dictionary, &dict_data)) {
+				std::cerr << "fail to load dictionary: " << FLAGS_dictionary << std::endl;
+				return -5;
+			}
+			auto dict = protocache::Dictionary::Load(protocache::Slice<uint8_t>(
+				reinterpret_cast<const uint8_t*>(dict_data.data()), dict_data.size()));
+			if (!protocache::Decompress(reinterpret_cast<const uint8_t*>(raw.data()), raw.size(), &buf, dict)) {
+				std::cerr << "fail to decompress with dictionary" << std::endl;
 				return -4;
 			}
+		} else if (!protocache::Decompress(raw, &buf)) {
+			std::cerr << "fail to decompress" << std::endl;
+			return -4;
 		}
-		protocache::Slice<uint32_t> view(reinterpret_cast<const uint32_t *>(raw.data()), raw.size() / sizeof(uint32_t));
-		if (!protocache::Deserialize(view, message.get())) {
+		if (!protocache::Deserialize(buf.View(), message.get())) {
 			std::cerr << "fail to deserialize" << std::endl;
 			return -4;
 		}
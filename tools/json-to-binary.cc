@@ -15,6 +15,7 @@ DEFINE_string(schema, "schema.proto", "schema file");
 DEFINE_string(root, "", "root message name");
 DEFINE_bool(flat, true, "output protocache binary instead of protobuf binary");
 DEFINE_bool(compress, false, "compress flat binary");
+DEFINE_string(dictionary, "", "compress flat binary with zstd and dictionary from train-dictionary");
 
 int main(int argc, char* argv[]) {
 	google::ParseCommandLineFlags(&argc, &argv, true);
@@ -64,7 +65,21 @@ int main(int argc, char* argv[]) {
 			return -4;
 		}
 		auto view = buf.View();
-		if (FLAGS_compress) {
+		if (!FLAGS_dictionary.empty()) {
+			std::string raw;
+			if (!protocache::LoadFile(FLAGS_dictionary, &raw)) {
+				std::cerr << "fail to load dictionary: " << FLAGS_dictionary << std::endl;
+				return -5;
+			}
+			auto dict = protocache::Dictionary::Load(protocache::Slice<uint8_t>(
+				reinterpret_cast<const uint8_t*>(raw.data()), raw.size()));
+			std::string cooked;
+			if (!protocache::Compress(reinterpret_cast<const uint8_t*>(view.data()), view.size()*4U, &cooked, dict)) {
+				std::cerr << "fail to compress with dictionary" << std::endl;
+				return -5;
+			}
+			output.write(cooked.data(), cooked.size());
+		} else if (FLAGS_compress) {
 			std::string cooked;
 			protocache::Compress(reinterpret_cast<const uint8_t*>(view.data()), view.size()*4U, &cooked);
 			output.write(cooked.data(), cooked.size());
@@ -12,6 +12,8 @@
 #include "proto-gen-utils.h"
 
 static std::unordered_map<std::string, AliasUnit> g_alias_book;
+static bool g_builder = false;
+static bool g_project = false;
 
 static bool CollectAlias(const std::string& ns, const ::google::protobuf::DescriptorProto& proto) {
 	auto fullname = NaiveJoinName(ns, proto.name());
@@ -262,9 +264,15 @@ static std::string GenMessage(const std::string& ns, const ::google::protobuf::D
 			auto key = TypeName(it->second.key_type, {});
 			oss << "\tusing ALIAS = protocache::MapT<" << key << ',' << value << ">;\n";
 		}
+		if (g_builder) {
+			oss << "\tclass Builder;\n";
+		}
 		oss << "};\n\n";
 		return oss.str();
 	} else if (fields.empty()) {
+		if (g_builder) {
+			oss << "\tclass Builder;\n";
+		}
 		oss << "};\n\n";
 		return oss.str();
 	}
@@ -389,81 +397,326 @@ static std::string GenMessage(const std::string& ns, const ::google::protobuf::D
 		return {};
 	}
 
-	auto handle_get = [&oss](bool repeated, const std::string& field_name, const char* out_type) {
-		std::string tmp;
-		if (repeated) {
-			tmp = "protocache::ArrayT<";
-			tmp += out_type;
-			tmp += '>';
-			out_type = tmp.c_str();
-		}
-		oss << '\t' << out_type << ' ' << field_name << "(const uint32_t* end=nullptr) const noexcept {\n"
-			<< "\t\treturn protocache::GetField<" << out_type << ">(protocache::Message::Cast(this), _::" << field_name << ", end);\n"
-			<< "\t}\n";
+	auto array_of = [](const char* type)->std::string {
+		std::string out = "protocache::ArrayT<";
+		out += type;
+		out += '>';
+		return out;
 	};
 
-	for (auto one : fields) {
+	std::vector<std::string> types(fields.size());
+	for (unsigned i = 0; i < fields.size(); i++) {
+		auto one = fields[i];
+		auto& type = types[i];
 		switch (one->type()) {
 			case ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE:
 				if (IsRepeated(*one)) { // array or map
 					auto it = map_entries.find(one->type_name());
 					if (it != map_entries.end()) {
-						auto out_type = get_map_type(it->second);
-						if (out_type.empty()) {
+						type = get_map_type(it->second);
+						if (type.empty()) {
 							return {};
 						}
-						handle_get(false, one->name(), out_type.c_str());
 						break;
 					}
+					type = array_of(TypeName(one->type(), one->type_name()).c_str());
+				} else {
+					type = TypeName(one->type(), one->type_name());
 				}
-				handle_get(IsRepeated(*one), one->name(), TypeName(one->type(), one->type_name()).c_str());
 				break;
 			case ::google::protobuf::FieldDescriptorProto::TYPE_BYTES:
-				handle_get(IsRepeated(*one), one->name(), "protocache::Slice<uint8_t>");
+				type = IsRepeated(*one)? array_of("protocache::Slice<uint8_t>") : "protocache::Slice<uint8_t>";
 				break;
 			case ::google::protobuf::FieldDescriptorProto::TYPE_STRING:
-				handle_get(IsRepeated(*one), one->name(), "protocache::Slice<char>");
+				type = IsRepeated(*one)? array_of("protocache::Slice<char>") : "protocache::Slice<char>";
 				break;
 			case ::google::protobuf::FieldDescriptorProto::TYPE_DOUBLE:
-				handle_get(IsRepeated(*one), one->name(), "double");
+				type = IsRepeated(*one)? array_of("double") : "double";
 				break;
 			case ::google::protobuf::FieldDescriptorProto::TYPE_FLOAT:
-				handle_get(IsRepeated(*one), one->name(), "float");
+				type = IsRepeated(*one)? array_of("float") : "float";
 				break;
 			case ::google::protobuf::FieldDescriptorProto::TYPE_FIXED64:
 			case ::google::protobuf::FieldDescriptorProto::TYPE_UINT64:
-				handle_get(IsRepeated(*one), one->name(), "uint64_t");
+				type = IsRepeated(*one)? array_of("uint64_t") : "uint64_t";
 				break;
 			case ::google::protobuf::FieldDescriptorProto::TYPE_FIXED32:
 			case ::google::protobuf::FieldDescriptorProto::TYPE_UINT32:
-				handle_get(IsRepeated(*one), one->name(), "uint32_t");
+				type = IsRepeated(*one)? array_of("uint32_t") : "uint32_t";
 				break;
 			case ::google::protobuf::FieldDescriptorProto::TYPE_SFIXED64:
 			case ::google::protobuf::FieldDescriptorProto::TYPE_SINT64:
 			case ::google::protobuf::FieldDescriptorProto::TYPE_INT64:
-				handle_get(IsRepeated(*one), one->name(), "int64_t");
+				type = IsRepeated(*one)? array_of("int64_t") : "int64_t";
 				break;
 			case ::google::protobuf::FieldDescriptorProto::TYPE_SFIXED32:
 			case ::google::protobuf::FieldDescriptorProto::TYPE_SINT32:
 			case ::google::protobuf::FieldDescriptorProto::TYPE_INT32:
-				handle_get(IsRepeated(*one), one->name(), "int32_t");
+				type = IsRepeated(*one)? array_of("int32_t") : "int32_t";
 				break;
 			case ::google::protobuf::FieldDescriptorProto::TYPE_BOOL:
-				handle_get(IsRepeated(*one), one->name(), "bool");
+				type = IsRepeated(*one)? array_of("bool") : "bool";
 				break;
 			case ::google::protobuf::FieldDescriptorProto::TYPE_ENUM:
-				handle_get(IsRepeated(*one), one->name(), "protocache::EnumValue");
+				type = IsRepeated(*one)? array_of("protocache::EnumValue") : "protocache::EnumValue";
 				break;
 			default:
 				std::cerr << "unsupported field " << one->name() << " in message " << proto.name() << std::endl;
 				return {};
 		}
 	}
+
+	oss << "\tstatic bool Verify(const uint32_t* ptr, const uint32_t* end, unsigned depth=0,\n"
+		<< "\t\t\tprotocache::VerifyMarks* marks=nullptr) {\n"
+		<< "\t\tif (depth >= protocache::kVerifyDepthLimit || !protocache::Message::Verify(ptr, end)) return false;\n";
+	// only messages holding others are marked, the rest take constant work
+	bool nested = std::any_of(fields.begin(), fields.end(), [](const ::google::protobuf::FieldDescriptorProto* one) {
+		return one->type() == ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE;
+	});
+	if (nested) {
+		oss << "\t\tprotocache::VerifyMarks local;\n"
+			<< "\t\tif (marks == nullptr) marks = &local;\n"
+			<< "\t\tif (!marks->Mark<" << proto.name() << ">(ptr)) return true;\n";
+	} else if (fields.empty()) {
+		oss << "\t\t(void)marks;\n";
+	}
+	if (!fields.empty()) {
+		oss << "\t\tprotocache::Message core(ptr, end);\n";
+	}
+	for (unsigned i = 0; i < fields.size(); i++) {
+		oss << "\t\tif (!protocache::VerifyField<" << types[i] << ">(core, _::"
+			<< fields[i]->name() << ", end, depth+1, marks)) return false;\n";
+	}
+	oss << "\t\treturn true;\n"
+		<< "\t}\n\n";
+
+	if (g_project) {
+		auto projectable = [](const ::google::protobuf::FieldDescriptorProto& one) {
+			return one.type() == ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE && !IsRepeated(one)
+				&& g_alias_book.find(one.type_name()) == g_alias_book.end();
+		};
+		bool nested = std::any_of(fields.begin(), fields.end(),
+			[&projectable](const ::google::protobuf::FieldDescriptorProto* one) { return projectable(*one); });
+		oss << "\tstatic bool Project(const uint32_t* ptr, const uint32_t* end, const protocache::FieldTree& tree, unsigned node,\n"
+			<< "\t\t\tprotocache::Buffer& buf, protocache::Unit& unit) {\n"
+			<< "\t\tprotocache::Message core(ptr, end);\n"
+			<< "\t\tif (!core) return false;\n"
+			<< "\t\treturn protocache::ProjectMessage(core, end, tree, node, buf, unit,\n"
+			<< (nested? "\t\t\t\t[&core, end, &tree, &buf](unsigned id, unsigned sub, protocache::Unit& one) {\n"
+				: "\t\t\t\t[&core, end, &buf](unsigned id, unsigned, protocache::Unit& one) {\n")
+			<< "\t\t\tswitch (id) {\n";
+		for (unsigned i = 0; i < fields.size(); i++) {
+			auto one = fields[i];
+			auto& type = types[i];
+			oss << "\t\t\t\tcase _::" << one->name() << ":\n";
+			if (projectable(*one)) {
+				// type is "const X*"
+				oss << "\t\t\t\t\tif (sub != protocache::FieldTree::kWhole) {\n"
+					<< "\t\t\t\t\t\treturn protocache::ProjectField<" << type.substr(6, type.size()-7)
+					<< ">(core, id, end, tree, sub, buf, one);\n"
+					<< "\t\t\t\t\t}\n";
+			}
+			oss << "\t\t\t\t\treturn protocache::CopyField<" << type << ">(core, id, end, buf, one);\n";
+		}
+		oss << "\t\t\t\tdefault:\n"
+			<< "\t\t\t\t\treturn false;\n"
+			<< "\t\t\t}\n"
+			<< "\t\t});\n"
+			<< "\t}\n\n";
+	}
+
+	for (unsigned i = 0; i < fields.size(); i++) {
+		auto& name = fields[i]->name();
+		auto& type = types[i];
+		oss << '\t' << type << ' ' << name << "(const uint32_t* end=nullptr) const noexcept {\n"
+			<< "\t\treturn protocache::GetField<" << type << ">(protocache::Message::Cast(this), _::" << name << ", end);\n"
+			<< "\t}\n";
+	}
+
+	// in-place setters for scalar fields and elements of number arrays, see MutableView
+	static const std::unordered_set<std::string> kPatchable = {
+		"int32_t", "uint32_t", "int64_t", "uint64_t", "float", "double", "bool", "protocache::EnumValue",
+	};
+	static const std::string kArrayPrefix = "protocache::ArrayT<";
+	for (unsigned i = 0; i < fields.size(); i++) {
+		auto& name = fields[i]->name();
+		auto& type = types[i];
+		if (kPatchable.count(type) != 0) {
+			oss << "\tbool set_" << name << "_inplace(" << type << " val, const uint32_t* end=nullptr) noexcept {\n"
+				<< "\t\treturn protocache::MutableView(reinterpret_cast<uint32_t*>(this)).Set(_::" << name << ", val, end);\n"
+				<< "\t}\n";
+		} else if (type.compare(0, kArrayPrefix.size(), kArrayPrefix) == 0) {
+			auto element = type.substr(kArrayPrefix.size(), type.size()-kArrayPrefix.size()-1);
+			if (element == "bool" || kPatchable.count(element) == 0) {
+				continue;
+			}
+			oss << "\tbool set_" << name << "_inplace(uint32_t pos, " << element << " val, const uint32_t* end=nullptr) noexcept {\n"
+				<< "\t\treturn protocache::MutableView(reinterpret_cast<uint32_t*>(this)).SetElement(_::" << name << ", pos, val, end);\n"
+				<< "\t}\n";
+		}
+	}
+	if (g_builder) {
+		oss << "\n\tclass Builder;\n";
+	}
 	oss << "};\n\n";
 
 	return oss.str();
 }
 
+static std::string ClassName(const std::string& type_name) {
+	std::string name;
+	for (auto ch : type_name) {
+		if (ch == '.') {
+			name += "::";
+		} else {
+			name += ch;
+		}
+	}
+	return name;
+}
+
+// builder of array or map with given element types
+static std::string CollectionBuilderName(::google::protobuf::FieldDescriptorProto::Type key_type,
+		::google::protobuf::FieldDescriptorProto::Type value_type, const std::string& value_class) {
+	std::string out;
+	if (key_type == TYPE_NONE) {
+		switch (value_type) {
+			case ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE:
+				return "protocache::ArrayBuilder<" + ClassName(value_class) + "::Builder>";
+			case ::google::protobuf::FieldDescriptorProto::TYPE_BYTES:
+			case ::google::protobuf::FieldDescriptorProto::TYPE_STRING:
+				return "protocache::StringArrayBuilder";
+			default:
+				out = TypeName(value_type, {});
+				if (out.empty()) {
+					return {};
+				}
+				return "protocache::ScalarArrayBuilder<" + out + '>';
+		}
+	}
+	auto key = TypeName(key_type, {});
+	if (!CanBeKey(key_type) || key.empty()) {
+		return {};
+	}
+	if (value_type == ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE) {
+		return "protocache::MessageMapBuilder<" + key + ',' + ClassName(value_class) + "::Builder>";
+	}
+	out = TypeName(value_type, {});
+	if (out.empty()) {
+		return {};
+	}
+	return "protocache::MapBuilder<" + key + ',' + out + '>';
+}
+
+static std::string GenBuilder(const std::string& ns, const std::string& scope,
+							  const ::google::protobuf::DescriptorProto& proto) {
+	auto fullname = NaiveJoinName(ns, proto.name());
+	auto name = scope + proto.name() + "::Builder";
+	std::ostringstream oss;
+	std::unordered_map<std::string, const ::google::protobuf::DescriptorProto*> map_entries;
+	for (auto& one : proto.nested_type()) {
+		if (one.options().deprecated()) {
+			continue;
+		}
+		if (one.options().map_entry()) {
+			map_entries.emplace(NaiveJoinName(fullname, one.name()), &one);
+			continue;
+		}
+		auto piece = GenBuilder(fullname, scope + proto.name() + "::", one);
+		if (piece.empty()) {
+			return {};
+		}
+		oss << piece;
+	}
+
+	if (IsAlias(proto)) {
+		auto it = g_alias_book.find(fullname);
+		if (it == g_alias_book.end()) {
+			std::cerr << "alias lost: " << fullname << std::endl;
+			return {};
+		}
+		auto base = CollectionBuilderName(it->second.key_type, it->second.value_type, it->second.value_class);
+		if (base.empty()) {
+			std::cerr << "illegal alias: " << fullname << std::endl;
+			return {};
+		}
+		static const std::string prefix = "protocache::";
+		auto short_name = base.substr(prefix.size(), base.find('<') - prefix.size());
+		oss << "class " << name << " final : public " << base << " {\n"
+			<< "public:\n"
+			<< "\tusing " << base << "::" << short_name << ";\n"
+			<< "};\n\n";
+		return oss.str();
+	}
+
+	auto fields = FieldsInOrder(proto);
+	auto max_id = fields.empty()? 1 : fields.back()->number();
+	oss << "class " << name << " final : public protocache::MessageBuilder<" << max_id << "> {\n"
+		<< "public:\n"
+		<< "\tusing MessageBuilder::MessageBuilder;\n";
+	for (auto one : fields) {
+		auto& field = one->name();
+		if (IsRepeated(*one)) {
+			auto it = map_entries.find(one->type_name());
+			if (it != map_entries.end()) {
+				auto& key_field = it->second->field(0);
+				auto& value_field = it->second->field(1);
+				auto key = TypeName(key_field.type(), {});
+				if (value_field.type() == ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE) {
+					oss << "\ttemplate <typename L, typename F>\n"
+						<< "\tvoid " << field << "(const L& keys, F&& fill) { SetMapBy<" << key << ','
+						<< ClassName(value_field.type_name()) << "::Builder>(_::" << field << ", keys, fill); }\n";
+				} else {
+					auto value = TypeName(value_field.type(), {});
+					if (value.empty()) {
+						std::cerr << "illegal value type: " << value_field.type() << std::endl;
+						return {};
+					}
+					oss << "\ttemplate <typename L, typename F>\n"
+						<< "\tvoid " << field << "(const L& keys, F&& value) { SetMap<" << key << ','
+						<< value << ">(_::" << field << ", keys, value); }\n";
+				}
+				continue;
+			}
+			switch (one->type()) {
+				case ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE:
+					oss << "\ttemplate <typename F>\n"
+						<< "\tvoid " << field << "(size_t n, F&& fill) { SetArrayBy<"
+						<< ClassName(one->type_name()) << "::Builder>(_::" << field << ", n, fill); }\n";
+					break;
+				case ::google::protobuf::FieldDescriptorProto::TYPE_BYTES:
+				case ::google::protobuf::FieldDescriptorProto::TYPE_STRING:
+					oss << "\ttemplate <typename L>\n"
+						<< "\tvoid " << field << "(const L& list) { SetStrings(_::" << field << ", list); }\n";
+					break;
+				default:
+					oss << "\tvoid " << field << "(const protocache::Slice<" << TypeName(one->type(), {})
+						<< ">& v) { SetArray(_::" << field << ", v); }\n";
+					break;
+			}
+		} else {
+			switch (one->type()) {
+				case ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE:
+					oss << "\ttemplate <typename F>\n"
+						<< "\tvoid " << field << "(F&& fill) { SetBy<"
+						<< ClassName(one->type_name()) << "::Builder>(_::" << field << ", fill); }\n";
+					break;
+				case ::google::protobuf::FieldDescriptorProto::TYPE_BYTES:
+				case ::google::protobuf::FieldDescriptorProto::TYPE_STRING:
+					oss << "\ttemplate <typename S>\n"
+						<< "\tvoid " << field << "(const S& v) { SetString(_::" << field << ", protocache::StringOf(v)); }\n";
+					break;
+				default:
+					oss << "\tvoid " << field << '(' << TypeName(one->type(), {})
+						<< " v) { SetScalar(_::" << field << ", v); }\n";
+					break;
+			}
+		}
+	}
+	oss << "};\n\n";
+	return oss.str();
+}
+
 static std::string HeaderName(const std::string& proto_name) {
 	auto out = proto_name;
 	for (auto& ch : out) {
@@ -498,6 +751,11 @@ static std::string GenFile(const ::google::protobuf::FileDescriptorProto& proto)
 		<< "#define PROTOCACHE_INCLUDED_" << header_name << '\n';
 
 	oss << "\n#include <protocache/access.h>\n";
+	if (g_builder) {
+		oss << "#include <protocache/builder.h>\n";
+	} else if (g_project) {
+		oss << "#include <protocache/serialize.h>\n";
+	}
 	for (auto& one : proto.dependency()) {
 		auto it = g_predefined_proto.find(one);
 		if (it != g_predefined_proto.end()) {
@@ -541,6 +799,19 @@ static std::string GenFile(const ::google::protobuf::FileDescriptorProto& proto)
 		}
 		oss << piece;
 	}
+	if (g_builder) {
+		for (auto& one : proto.message_type()) {
+			if (one.options().deprecated()) {
+				continue;
+			}
+			auto piece = GenBuilder(ns, {}, one);
+			if (piece.empty()) {
+				std::cerr << "fail to gen builder for message: " << one.name() << std::endl;
+				return {};
+			}
+			oss << piece;
+		}
+	}
 	for (auto it = ns_parts.rbegin(); it != ns_parts.rend(); ++it) {
 		oss << "} // " << *it << '\n';
 	}
@@ -635,14 +906,33 @@ static std::string GenMessageEX(const std::string& ns, const ::google::protobuf:
 		<< "\t}\n"
 		<< "\tbool HasField(unsigned id, const uint32_t* end=nullptr) const noexcept {\n"
 		<< "\t\treturn __view__.HasField(id, end);\n"
+		<< "\t}\n"
+		<< "\t// original data which can be copied as it is, or nullptr\n"
+		<< "\tconst uint32_t* CleanHead() const noexcept {\n"
+		<< "\t\tauto clean_head = __view__.CleanHead();\n"
+		<< "\t\tif (clean_head == nullptr) return nullptr;\n";
+	// messages in fields read by const getters may be changed after all
+	for (auto one : fields) {
+		if (one->type() == ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE) {
+			oss << "\t\tif (!__view__.FieldClean(_::" << one->name() << ", _" << one->name() << ")) return nullptr;\n";
+		}
+	}
+	oss << "\t\treturn clean_head;\n"
 		<< "\t}\n"
 		<< "\tbool Serialize(protocache::Buffer* buf, const uint32_t* end=nullptr) const {\n"
 		<< "\t\tprotocache::Unit dummy;\n"
 		<< "\t\treturn Serialize(*buf, dummy, end);\n"
 		<< "\t}\n"
-		<< "\tbool Serialize(protocache::Buffer& buf, protocache::Unit& unit, const uint32_t* end) const {\n"
-		<< "\t\tauto clean_head = __view__.CleanHead();\n"
-		<< "\t\tif (clean_head != nullptr) {\n"
+		<< "\tbool Serialize(protocache::Buffer& buf, protocache::Unit& unit, const uint32_t* end) const {\n";
+	// maps inside may come from another writer, deterministic mode builds them again
+	if (std::any_of(fields.begin(), fields.end(), [](const ::google::protobuf::FieldDescriptorProto* one) {
+			return one->type() == ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE;
+		})) {
+		oss << "\t\tauto clean_head = buf.Deterministic()? nullptr : CleanHead();\n";
+	} else {
+		oss << "\t\tauto clean_head = CleanHead();\n";
+	}
+	oss << "\t\tif (clean_head != nullptr) {\n"
 		<< "\t\t\treturn protocache::Copy(Detect(clean_head, end), buf, unit);\n"
 		<< "\t\t}\n"
 		<< "\t\tstd::array<protocache::Unit," << max_id << "> parts;\n"
@@ -654,6 +944,22 @@ static std::string GenMessageEX(const std::string& ns, const ::google::protobuf:
 			<< one->name() << ", end, _" << one->name() << ", buf, parts[_::" << one->name() << "])) return false;\n";
 	}
 	oss << "\t\treturn protocache::SerializeMessage(parts, buf, last, unit);\n"
+		<< "\t}\n"
+		<< "\tsize_t SerializedSize(const uint32_t* end=nullptr) const {\n"
+		<< "\t\tprotocache::Unit unit;\n"
+		<< "\t\treturn Measure(unit, end) ? unit.size() : 0;\n"
+		<< "\t}\n"
+		<< "\tbool Measure(protocache::Unit& unit, const uint32_t* end) const {\n"
+		<< "\t\tauto clean_head = CleanHead();\n"
+		<< "\t\tif (clean_head != nullptr) {\n"
+		<< "\t\t\treturn protocache::MeasureCopy(Detect(clean_head, end), unit);\n"
+		<< "\t\t}\n"
+		<< "\t\tstd::array<protocache::Unit," << max_id << "> parts;\n";
+	for (auto one : fields) {
+		oss << "\t\tif (!__view__.MeasureField(_::"
+			<< one->name() << ", end, _" << one->name() << ", parts[_::" << one->name() << "])) return false;\n";
+	}
+	oss << "\t\treturn protocache::MeasureMessage(parts, unit);\n"
 		<< "\t}\n\n";
 
 	std::vector<std::string> types(fields.size());
@@ -735,11 +1041,44 @@ static std::string GenMessageEX(const std::string& ns, const ::google::protobuf:
 			<< one.name() << ", end, _" << one.name() << "); }\n";
 	}
 
+	// const getters read without marking fields dirty
+	std::vector<bool> composite(fields.size(), true);
+	oss << '\n';
+	for (unsigned i = 0; i < fields.size(); i++) {
+		auto& name = fields[i]->name();
+		auto& type = types[i];
+		static const std::string kUniquePtr = "std::unique_ptr<";
+		if (type.compare(0, kUniquePtr.size(), kUniquePtr) == 0) {
+			oss << "\tconst " << type.substr(kUniquePtr.size(), type.size()-kUniquePtr.size()-1) << "* " << name
+				<< "(const uint32_t* end=nullptr) const { return __view__.ViewField(_::"
+				<< name << ", end, _" << name << ").get(); }\n";
+		} else if (type.find('<') != std::string::npos || type.find("ALIAS") != std::string::npos) {
+			oss << "\tconst " << type << "& " << name << "(const uint32_t* end=nullptr) const { return __view__.ViewField(_::"
+				<< name << ", end, _" << name << "); }\n";
+		} else if (type == "std::string") {
+			composite[i] = false;
+			if (fields[i]->type() == ::google::protobuf::FieldDescriptorProto::TYPE_BYTES) {
+				oss << "\tprotocache::Slice<uint8_t> " << name << "(const uint32_t* end=nullptr) const { "
+					<< "return protocache::SliceCast<uint8_t>(__view__.ReadField(_::" << name << ", end, _" << name << ")); }\n";
+			} else {
+				oss << "\tprotocache::Slice<char> " << name << "(const uint32_t* end=nullptr) const { "
+					<< "return __view__.ReadField(_::" << name << ", end, _" << name << "); }\n";
+			}
+		} else {
+			composite[i] = false;
+			oss << '\t' << type << ' ' << name << "(const uint32_t* end=nullptr) const { return __view__.ReadField(_::"
+				<< name << ", end, _" << name << "); }\n";
+		}
+	}
+
 	oss << "\nprivate:\n"
 		<< "\tusing _ = " << cxx_ns << "_;\n"
 		<< "\tprotocache::MessageEX<" << max_id << "> __view__;\n";
 	for (unsigned i = 0; i < fields.size(); i++) {
-		oss << '\t' << types[i] << " _" << fields[i]->name() << ";\n";
+		// scalars are value-initialized, as they may be read before extracted
+		bool scalar = !composite[i] && types[i] != "std::string";
+		oss << '\t' << (composite[i]? "mutable " : "") << types[i] << " _" << fields[i]->name()
+			<< (scalar? "{};\n" : ";\n");
 	}
 	oss << "};\n\n";
 	return oss.str();
@@ -804,6 +1143,428 @@ static std::string GenFileEX(const ::google::protobuf::FileDescriptorProto& prot
 	return oss.str();
 }
 
+static std::string ConvertPbFilename(const std::string& name, const char* suffix) {
+	auto pos = name.rfind('.');
+	if (pos == std::string::npos) {
+		return name + suffix;
+	}
+	return name.substr(0, pos) + suffix;
+}
+
+// accessor name in code generated by protoc
+static std::string PbFieldName(const std::string& name) {
+	static const std::unordered_set<std::string> keywords = {
+		"alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break",
+		"case", "catch", "char", "char8_t", "char16_t", "char32_t", "class", "compl", "concept",
+		"const", "consteval", "constexpr", "constinit", "const_cast", "continue", "co_await",
+		"co_return", "co_yield", "decltype", "default", "delete", "do", "double", "dynamic_cast",
+		"else", "enum", "explicit", "export", "extern", "false", "float", "for", "friend", "goto",
+		"if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept", "not", "not_eq",
+		"nullptr", "operator", "or", "or_eq", "private", "protected", "public", "register",
+		"reinterpret_cast", "requires", "return", "short", "signed", "sizeof", "static",
+		"static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local",
+		"throw", "true", "try", "typedef", "typeid", "typename", "union", "unsigned", "using",
+		"virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq",
+	};
+	std::string out;
+	for (auto ch : name) {
+		out += static_cast<char>(std::tolower(ch));
+	}
+	if (keywords.find(out) != keywords.end()) {
+		out += '_';
+	}
+	return out;
+}
+
+// expression writing a non-empty field of message into target
+static std::string FromProtobufExpr(const ::google::protobuf::FieldDescriptorProto& field,
+		const ::google::protobuf::DescriptorProto* entry, const std::string& target) {
+	auto name = "message." + PbFieldName(field.name());
+	if (entry != nullptr) {
+		auto key = TypeName(entry->field(0).type(), {});
+		auto& value_field = entry->field(1);
+		std::string value;
+		switch (value_field.type()) {
+			case ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE:
+				value = "FromProtobuf(v, buf, one)";
+				break;
+			case ::google::protobuf::FieldDescriptorProto::TYPE_ENUM:
+				value = "protocache::Serialize(static_cast<protocache::EnumValue>(v), buf, one)";
+				break;
+			default:
+				value = "protocache::Serialize(v, buf, one)";
+				break;
+		}
+		return "protocache::SerializeMapOf<" + key + ">(" + name + "(), buf, " + target
+			+ ", [&buf](const auto& v, protocache::Unit& one)->bool { return " + value + "; })";
+	}
+	if (IsRepeated(field)) {
+		switch (field.type()) {
+			case ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE:
+				return "protocache::SerializeArrayBy(" + name + "_size(), buf, " + target
+					+ ", [&message, &buf](size_t i, protocache::Unit& one)->bool { return FromProtobuf("
+					+ name + "(i), buf, one); })";
+			case ::google::protobuf::FieldDescriptorProto::TYPE_BYTES:
+			case ::google::protobuf::FieldDescriptorProto::TYPE_STRING:
+				return "protocache::SerializeArrayBy(" + name + "_size(), buf, " + target
+					+ ", [&message, &buf](size_t i, protocache::Unit& one)->bool { return protocache::Serialize("
+					+ name + "(i), buf, one); })";
+			default:
+				return "protocache::SerializeArray(protocache::Slice<" + TypeName(field.type(), {}) + ">("
+					+ name + "().data(), " + name + "_size()), buf, " + target + ')';
+		}
+	}
+	switch (field.type()) {
+		case ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE:
+			return "FromProtobuf(" + name + "(), buf, " + target + ')';
+		case ::google::protobuf::FieldDescriptorProto::TYPE_ENUM:
+			return "protocache::Serialize(static_cast<protocache::EnumValue>(" + name + "()), buf, " + target + ')';
+		default:
+			return "protocache::Serialize(" + name + "(), buf, " + target + ')';
+	}
+}
+
+// same as HasField of protobuf reflection
+static std::string PbHasField(const ::google::protobuf::FieldDescriptorProto& field, bool proto3) {
+	auto name = "message." + PbFieldName(field.name());
+	if (IsRepeated(field)) {
+		return name + "_size() != 0";
+	}
+	if (!proto3 || field.type() == ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE
+		|| field.has_oneof_index()) {
+		return "message.has_" + PbFieldName(field.name()) + "()";
+	}
+	switch (field.type()) {
+		case ::google::protobuf::FieldDescriptorProto::TYPE_BYTES:
+		case ::google::protobuf::FieldDescriptorProto::TYPE_STRING:
+			return '!' + name + "().empty()";
+		case ::google::protobuf::FieldDescriptorProto::TYPE_DOUBLE:
+		case ::google::protobuf::FieldDescriptorProto::TYPE_FLOAT:
+			return "!protocache::IsZero(" + name + "())";
+		case ::google::protobuf::FieldDescriptorProto::TYPE_BOOL:
+			return name + "()";
+		default:
+			return name + "() != 0";
+	}
+}
+
+static std::string PbSignature(const std::string& fullname) {
+	return "inline bool FromProtobuf(const " + ClassName(fullname)
+		+ "& message, protocache::Buffer& buf, protocache::Unit& unit)";
+}
+
+// Converters from protobuf objects, which mirror protocache::Serialize of the
+// reflection extension, so the outputs are identical in deterministic mode.
+static bool GenFromProtobuf(const std::string& ns, const ::google::protobuf::DescriptorProto& proto,
+							bool proto3, std::ostream& decl, std::ostream& impl) {
+	auto fullname = NaiveJoinName(ns, proto.name());
+	std::unordered_map<std::string, const ::google::protobuf::DescriptorProto*> map_entries;
+	for (auto& one : proto.nested_type()) {
+		if (one.options().map_entry()) {
+			map_entries.emplace(NaiveJoinName(fullname, one.name()), &one);
+		} else if (!one.options().deprecated() && !GenFromProtobuf(fullname, one, proto3, decl, impl)) {
+			return false;
+		}
+	}
+	auto signature = PbSignature(fullname);
+	decl << signature << ";\n";
+	impl << signature << " {\n";
+
+	auto find_entry = [&map_entries](const ::google::protobuf::FieldDescriptorProto& field)
+			->const ::google::protobuf::DescriptorProto* {
+		if (!IsRepeated(field) || field.type() != ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE) {
+			return nullptr;
+		}
+		auto it = map_entries.find(field.type_name());
+		return it == map_entries.end()? nullptr : it->second;
+	};
+
+	if (IsAlias(proto)) {
+		auto& field = proto.field(0);
+		if (!IsRepeated(field)) {
+			std::cerr << "illegal alias: " << fullname << std::endl;
+			return false;
+		}
+		auto entry = find_entry(field);
+		impl << "\tif (message." << PbFieldName(field.name()) << "_size() == 0) {\n"
+			<< "\t\tunit.len = 1;\n"
+			<< "\t\tunit.data[0] = " << (entry != nullptr? "5U << 28U" : "1U") << ";\n"
+			<< "\t\treturn true;\n"
+			<< "\t}\n"
+			<< "\treturn " << FromProtobufExpr(field, entry, "unit") << ";\n"
+			<< "}\n\n";
+		return true;
+	}
+
+	auto fields = FieldsInOrder(proto);
+	auto max_id = fields.empty()? 1 : fields.back()->number();
+	if (fields.empty()) {
+		impl << "\t(void)message;\n";
+	}
+	impl << "\tstd::array<protocache::Unit," << max_id << "> parts;\n"
+		<< "\tauto last = buf.Size();\n";
+	for (auto it = fields.rbegin(); it != fields.rend(); ++it) {
+		auto& field = **it;
+		auto part = "parts[" + std::to_string(field.number()-1) + ']';
+		impl << "\tif (" << PbHasField(field, proto3) << ") {\n";
+		auto expr = FromProtobufExpr(field, find_entry(field), part);
+		if (!IsRepeated(field) && field.type() != ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE
+			&& field.type() != ::google::protobuf::FieldDescriptorProto::TYPE_STRING
+			&& field.type() != ::google::protobuf::FieldDescriptorProto::TYPE_BYTES) {
+			impl << "\t\t" << expr << ";\n";
+		} else {
+			impl << "\t\tif (!" << expr << ") {\n"
+				<< "\t\t\treturn false;\n"
+				<< "\t\t}\n";
+			if (!IsRepeated(field) && field.type() == ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE) {
+				impl << "\t\tprotocache::FoldNested(buf, " << part << ");\n";
+			} else {
+				impl << "\t\tprotocache::FoldField(buf, " << part << ");\n";
+			}
+		}
+		impl << "\t}\n";
+	}
+	impl << "\treturn protocache::SerializeMessage(parts, buf, last, unit);\n"
+		<< "}\n\n"
+		<< "inline bool FromProtobuf(const " << ClassName(fullname) << "& message, protocache::Buffer& buf) {\n"
+		<< "\tprotocache::Unit dummy;\n"
+		<< "\treturn FromProtobuf(message, buf, dummy);\n"
+		<< "}\n\n";
+	return true;
+}
+
+static std::string PbEnumCast(const ::google::protobuf::FieldDescriptorProto& field, const std::string& expr) {
+	if (field.type() != ::google::protobuf::FieldDescriptorProto::TYPE_ENUM) {
+		return expr;
+	}
+	return "static_cast<" + ClassName(field.type_name()) + ">(" + expr + ')';
+}
+
+// statements filling a repeated field or map of out from the object at ptr
+static std::string ToProtobufCollection(const ::google::protobuf::FieldDescriptorProto& field,
+		const ::google::protobuf::DescriptorProto* entry, const std::string& ptr, const std::string& indent) {
+	auto name = PbFieldName(field.name());
+	std::ostringstream oss;
+	if (entry != nullptr) {
+		auto& key_field = entry->field(0);
+		auto& value_field = entry->field(1);
+		oss << indent << "protocache::Map map(" << ptr << ", end);\n"
+			<< indent << "if (!map) {\n"
+			<< indent << "\treturn false;\n"
+			<< indent << "}\n"
+			<< indent << "auto& dict = *out->mutable_" << name << "();\n"
+			<< indent << "for (auto pair : map) {\n";
+		if (key_field.type() == ::google::protobuf::FieldDescriptorProto::TYPE_STRING) {
+			oss << indent << "\tauto key = protocache::FieldT<protocache::Slice<char>>(pair.Key()).Get(end);\n"
+				<< indent << "\tif (!key) {\n"
+				<< indent << "\t\treturn false;\n"
+				<< indent << "\t}\n"
+				<< indent << "\tauto& value = dict[std::string(key.data(), key.size())];\n";
+		} else {
+			oss << indent << "\tauto& value = dict[protocache::FieldT<" << TypeName(key_field.type(), {})
+				<< ">(pair.Key()).Get(end)];\n";
+		}
+		switch (value_field.type()) {
+			case ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE:
+				oss << indent << "\tif (!ToProtobuf(pair.Value().GetObject(end), end, &value)) {\n"
+					<< indent << "\t\treturn false;\n"
+					<< indent << "\t}\n";
+				break;
+			case ::google::protobuf::FieldDescriptorProto::TYPE_BYTES:
+			case ::google::protobuf::FieldDescriptorProto::TYPE_STRING:
+				oss << indent << "\tauto v = protocache::FieldT<protocache::Slice<char>>(pair.Value()).Get(end);\n"
+					<< indent << "\tif (!v) {\n"
+					<< indent << "\t\treturn false;\n"
+					<< indent << "\t}\n"
+					<< indent << "\tvalue.assign(v.data(), v.size());\n";
+				break;
+			default:
+				oss << indent << "\tvalue = " << PbEnumCast(value_field, "protocache::FieldT<"
+					+ TypeName(value_field.type(), {}) + ">(pair.Value()).Get(end)") << ";\n";
+				break;
+		}
+		oss << indent << "}\n";
+		return oss.str();
+	}
+	switch (field.type()) {
+		case ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE:
+			oss << indent << "protocache::Array array(" << ptr << ", end);\n"
+				<< indent << "if (!array) {\n"
+				<< indent << "\treturn false;\n"
+				<< indent << "}\n"
+				<< indent << "auto list = out->mutable_" << name << "();\n"
+				<< indent << "list->Reserve(list->size() + array.Size());\n"
+				<< indent << "for (auto one : array) {\n"
+				<< indent << "\tif (!ToProtobuf(one.GetObject(end), end, list->Add())) {\n"
+				<< indent << "\t\treturn false;\n"
+				<< indent << "\t}\n"
+				<< indent << "}\n";
+			break;
+		case ::google::protobuf::FieldDescriptorProto::TYPE_BYTES:
+		case ::google::protobuf::FieldDescriptorProto::TYPE_STRING:
+			oss << indent << "protocache::ArrayT<protocache::Slice<char>> array(" << ptr << ", end);\n"
+				<< indent << "if (!array) {\n"
+				<< indent << "\treturn false;\n"
+				<< indent << "}\n"
+				<< indent << "auto list = out->mutable_" << name << "();\n"
+				<< indent << "list->Reserve(list->size() + array.Size());\n"
+				<< indent << "for (auto one : array) {\n"
+				<< indent << "\tif (!one) {\n"
+				<< indent << "\t\treturn false;\n"
+				<< indent << "\t}\n"
+				<< indent << "\tlist->Add()->assign(one.data(), one.size());\n"
+				<< indent << "}\n";
+			break;
+		default:
+			// bulk copy from the raw numbers
+			oss << indent << "protocache::ArrayT<" << TypeName(field.type(), {}) << "> array(" << ptr << ", end);\n"
+				<< indent << "if (!array) {\n"
+				<< indent << "\treturn false;\n"
+				<< indent << "}\n"
+				<< indent << "out->mutable_" << name << "()->Add(array.begin(), array.end());\n";
+			break;
+	}
+	return oss.str();
+}
+
+static std::string PbToSignature(const std::string& fullname) {
+	return "inline bool ToProtobuf(const uint32_t* data, const uint32_t* end, " + ClassName(fullname) + "* out)";
+}
+
+// Converters to protobuf objects, which mirror protocache::Deserialize of the
+// reflection extension.
+static bool GenToProtobuf(const std::string& ns, const ::google::protobuf::DescriptorProto& proto,
+						  std::ostream& decl, std::ostream& impl) {
+	auto fullname = NaiveJoinName(ns, proto.name());
+	std::unordered_map<std::string, const ::google::protobuf::DescriptorProto*> map_entries;
+	for (auto& one : proto.nested_type()) {
+		if (one.options().map_entry()) {
+			map_entries.emplace(NaiveJoinName(fullname, one.name()), &one);
+		} else if (!one.options().deprecated() && !GenToProtobuf(fullname, one, decl, impl)) {
+			return false;
+		}
+	}
+	auto signature = PbToSignature(fullname);
+	decl << signature << ";\n";
+	impl << signature << " {\n";
+
+	auto find_entry = [&map_entries](const ::google::protobuf::FieldDescriptorProto& field)
+			->const ::google::protobuf::DescriptorProto* {
+		if (!IsRepeated(field) || field.type() != ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE) {
+			return nullptr;
+		}
+		auto it = map_entries.find(field.type_name());
+		return it == map_entries.end()? nullptr : it->second;
+	};
+
+	if (IsAlias(proto)) {
+		auto& field = proto.field(0);
+		impl << ToProtobufCollection(field, find_entry(field), "data", "\t")
+			<< "\treturn true;\n"
+			<< "}\n\n";
+		return true;
+	}
+
+	impl << "\tprotocache::Message message(data, end);\n"
+		<< "\tif (!message) {\n"
+		<< "\t\treturn false;\n"
+		<< "\t}\n";
+	auto fields = FieldsInOrder(proto);
+	if (fields.empty()) {
+		impl << "\t(void)out;\n";
+	}
+	for (auto one : fields) {
+		auto& field = *one;
+		auto name = PbFieldName(field.name());
+		impl << "\tif (auto field = message.GetField(" << (field.number()-1) << ", end); !!field) {\n";
+		if (IsRepeated(field)) {
+			impl << ToProtobufCollection(field, find_entry(field), "field.GetObject(end)", "\t\t");
+		} else {
+			switch (field.type()) {
+				case ::google::protobuf::FieldDescriptorProto::TYPE_MESSAGE:
+					impl << "\t\tif (!ToProtobuf(field.GetObject(end), end, out->mutable_" << name << "())) {\n"
+						<< "\t\t\treturn false;\n"
+						<< "\t\t}\n";
+					break;
+				case ::google::protobuf::FieldDescriptorProto::TYPE_BYTES:
+				case ::google::protobuf::FieldDescriptorProto::TYPE_STRING:
+					impl << "\t\tauto v = protocache::FieldT<protocache::Slice<char>>(field).Get(end);\n"
+						<< "\t\tif (!v) {\n"
+						<< "\t\t\treturn false;\n"
+						<< "\t\t}\n"
+						<< "\t\tout->mutable_" << name << "()->assign(v.data(), v.size());\n";
+					break;
+				default:
+					impl << "\t\tout->set_" << name << '(' << PbEnumCast(field, "protocache::FieldT<"
+						+ TypeName(field.type(), {}) + ">(field).Get(end)") << ");\n";
+					break;
+			}
+		}
+		impl << "\t}\n";
+	}
+	impl << "\treturn true;\n"
+		<< "}\n\n"
+		<< "inline bool ToProtobuf(const protocache::Slice<uint32_t>& data, " << ClassName(fullname) << "* out) {\n"
+		<< "\tout->Clear();\n"
+		<< "\treturn ToProtobuf(data.data(), data.end(), out);\n"
+		<< "}\n\n";
+	return true;
+}
+
+static std::string GenFilePB(const ::google::protobuf::FileDescriptorProto& proto) {
+	std::ostringstream oss;
+	auto header_name = HeaderName(proto.name());
+	oss << "#pragma once\n"
+		<< "#ifndef PROTOCACHE_INCLUDED_PB_" << header_name << '\n'
+		<< "#define PROTOCACHE_INCLUDED_PB_" << header_name << '\n';
+
+	oss << "\n#include <protocache/builder.h>\n"
+		<< "#include <protocache/extension/utils.h>\n"
+		<< "#include \"" << ConvertPbFilename(proto.name(), ".pb.h") << "\"\n";
+	for (auto& one : proto.dependency()) {
+		auto it = g_predefined_proto.find(one);
+		if (it != g_predefined_proto.end()) {
+			oss << "#include <" << ConvertPbFilename(it->second, ".pc-pb.h") << ">\n";
+		} else if (!IsIgnoredDependency(one)) {
+			oss << "#include \"" << ConvertPbFilename(one, ".pc-pb.h") << "\"\n";
+		}
+	}
+	oss << '\n';
+
+	std::string ns;
+	std::vector<std::string> ns_parts;
+	if (!proto.package().empty()) {
+		ns = '.' + proto.package();
+		Split(proto.package(), '.', &ns_parts);
+	}
+	for (auto& part : ns_parts) {
+		oss << "namespace " << part << " {\n";
+	}
+	oss << '\n';
+
+	std::ostringstream decl, impl;
+	auto proto3 = proto.syntax() == "proto3";
+	for (auto& one : proto.message_type()) {
+		if (!one.options().deprecated() && !GenFromProtobuf(ns, one, proto3, decl, impl)) {
+			std::cerr << "fail to gen converter for message: " << one.name() << std::endl;
+			return {};
+		}
+	}
+	for (auto& one : proto.message_type()) {
+		if (!one.options().deprecated() && !GenToProtobuf(ns, one, decl, impl)) {
+			std::cerr << "fail to gen converter for message: " << one.name() << std::endl;
+			return {};
+		}
+	}
+	oss << decl.str() << '\n' << impl.str();
+
+	for (auto it = ns_parts.rbegin(); it != ns_parts.rend(); ++it) {
+		oss << "} // " << *it << '\n';
+	}
+	oss << "#endif // PROTOCACHE_INCLUDED_PB_" << header_name << '\n';
+	return oss.str();
+}
+
 int main() {
 	if (!PrepareProtocPluginIO()) {
 		std::cerr << "fail to configure protoc plugin IO" << std::endl;
@@ -826,7 +1587,21 @@ int main() {
 		return 0;
 	}
 
-	bool extra = request.parameter() == "extra";
+	bool extra = false;
+	bool protobuf = false;
+	std::vector<std::string> options;
+	Split(request.parameter(), ',', &options);
+	for (auto& one : options) {
+		if (one == "extra") {
+			extra = true;
+		} else if (one == "builder") {
+			g_builder = true;
+		} else if (one == "protobuf") {
+			protobuf = true;
+		} else if (one == "project") {
+			g_project = true;
+		}
+	}
 
 	for (auto& proto : request.proto_file()) {
 		std::string ns;
@@ -863,6 +1638,15 @@ int main() {
 			ex->set_name(ConvertExFilename(proto.name()));
 			ex->set_content(GenFileEX(proto));
 		}
+		if (protobuf) {
+			auto pb = response.add_file();
+			pb->set_name(ConvertPbFilename(proto.name(), ".pc-pb.h"));
+			pb->set_content(GenFilePB(proto));
+			if (pb->content().empty()) {
+				std::cerr << "fail to generate converters for file: " << proto.name() << std::endl;
+				return -2;
+			}
+		}
 	}
 
 	if (!response.SerializeToFileDescriptor(STDOUT_FILENO)) {
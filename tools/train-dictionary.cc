@@ -0,0 +1,84 @@
+// Copyright (c) 2023, Ruan Kunliang.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <gflags/gflags.h>
+#include <google/protobuf/dynamic_message.h>
+#include "protocache/extension/utils.h"
+
+DEFINE_string(output, "dict.bin", "output file");
+DEFINE_string(schema, "schema.proto", "schema file");
+DEFINE_string(root, "", "root message name");
+DEFINE_uint64(capacity, 16384, "max size of dictionary");
+
+// Trains a dictionary for Compress with Dictionary from json samples given
+// as arguments, all of the root message type.
+int main(int argc, char* argv[]) {
+	google::ParseCommandLineFlags(&argc, &argv, true);
+
+	if (FLAGS_root.empty()) {
+		std::cerr << "need root message name" << std::endl;
+		return 1;
+	}
+	if (argc < 2) {
+		std::cerr << "need json samples" << std::endl;
+		return 1;
+	}
+
+	std::string err;
+	google::protobuf::FileDescriptorProto file;
+	if (!protocache::ParseProtoFile(FLAGS_schema, &file, &err)) {
+		std::cerr << "fail to load schema:\n" << err << std::endl;
+		return -1;
+	}
+	google::protobuf::DescriptorPool pool(google::protobuf::DescriptorPool::generated_pool());
+	if (pool.BuildFile(file) == nullptr) {
+		std::cerr << "fail to prepare descriptor pool" << std::endl;
+		return -1;
+	}
+	auto descriptor = pool.FindMessageTypeByName(FLAGS_root);
+	if (descriptor == nullptr) {
+		std::cerr << "fail to find root message: " << FLAGS_root << std::endl;
+		return -2;
+	}
+	google::protobuf::DynamicMessageFactory factory(&pool);
+	auto prototype = factory.GetPrototype(descriptor);
+	if (prototype == nullptr) {
+		std::cerr << "fail to create root message: " << FLAGS_root << std::endl;
+		return -2;
+	}
+
+	std::vector<std::string> samples;
+	samples.reserve(argc - 1);
+	protocache::Buffer buf;
+	for (int i = 1; i < argc; i++) {
+		std::unique_ptr<google::protobuf::Message> message(prototype->New());
+		if (!protocache::LoadJson(argv[i], message.get())) {
+			std::cerr << "fail to load json: " << argv[i] << std::endl;
+			return -3;
+		}
+		buf.Clear();
+		if (!protocache::Serialize(*message, &buf)) {
+			std::cerr << "fail to serialize: " << argv[i] << std::endl;
+			return -4;
+		}
+		samples.emplace_back(reinterpret_cast<const char*>(buf.Head()), buf.Size()*4U);
+	}
+
+	auto dict = protocache::Dictionary::Train(samples, FLAGS_capacity);
+	if (!dict) {
+		std::cerr << "fail to train dictionary, too few samples or built without zstd" << std::endl;
+		return -5;
+	}
+	std::ofstream output(FLAGS_output, std::ios_base::out | std::ios_base::binary);
+	if (!output) {
+		std::cerr << "fail to open file for output: " << FLAGS_output << std::endl;
+		return 2;
+	}
+	auto data = dict.Data();
+	output.write(reinterpret_cast<const char*>(data.data()), data.size());
+	return 0;
+}
@@ -71,20 +71,9 @@ struct BytesAllocation final {
 bool ValidDecompressedSizeHeader(
     const uint8_t* input,
     uint32_t input_len) noexcept {
-  if (input_len == 0) {
-    return true;
-  }
-  uint64_t size = 0;
-  for (uint32_t index = 0, shift = 0;
-       index < input_len && shift < 32;
-       ++index, shift += 7) {
-    const auto byte = input[index];
-    size |= static_cast<uint64_t>(byte & 0x7fU) << shift;
-    if ((byte & 0x80U) == 0) {
-      return size <= std::numeric_limits<uint32_t>::max() - 7U;
-    }
-  }
-  return false;
+  size_t size = 0;
+  return protocache::DecompressedSize(input, input_len, &size) &&
+         size <= std::numeric_limits<uint32_t>::max() - 7U;
 }
 
 int32_t TransformBytes(